@@ -53,6 +53,8 @@ static int babel_if_delete_hook (struct interface *ifp);
 static int interface_config_write (struct vty *vty);
 static babel_interface_nfo * babel_interface_allocate (void);
 static void babel_interface_free (babel_interface_nfo *bi);
+static void babel_interface_address_changed (struct interface *ifp,
+                                             int flush);
 
 
 static vector babel_enable_if;                 /* enable interfaces (by cmd). */
@@ -102,6 +104,57 @@ babel_interface_down (int cmd, struct zclient *client, zebra_size_t length)
     return 0;
 }
 
+/* Interfaces whose addresses changed in a bulk interface message,
+   flushed and announced once when it has been handled. */
+static struct list *babel_bulk_if_list = NULL;
+
+static void
+babel_interface_address_changed (struct interface *ifp, int flush)
+{
+    babel_interface_nfo *babel_ifp;
+
+    if (!zclient->interface_bulk) {
+        if (flush)
+            flush_interface_routes(ifp, 0);
+        send_request(ifp, NULL, 0);
+        send_update(ifp, 0, NULL, 0);
+        return;
+    }
+
+    babel_ifp = babel_get_if_nfo(ifp);
+    if (flush)
+        babel_ifp->bulk_flush_pending = 1;
+    if (babel_ifp->bulk_send_pending)
+        return;
+
+    if (babel_bulk_if_list == NULL)
+        babel_bulk_if_list = list_new();
+    listnode_add(babel_bulk_if_list, ifp);
+    babel_ifp->bulk_send_pending = 1;
+}
+
+void
+babel_interface_bulk_end (struct zclient *client)
+{
+    struct interface *ifp;
+    struct listnode *node, *nnode;
+    babel_interface_nfo *babel_ifp;
+
+    if (babel_bulk_if_list == NULL)
+        return;
+
+    for (ALL_LIST_ELEMENTS(babel_bulk_if_list, node, nnode, ifp)) {
+        babel_ifp = babel_get_if_nfo(ifp);
+        if (babel_ifp->bulk_flush_pending)
+            flush_interface_routes(ifp, 0);
+        babel_ifp->bulk_flush_pending = 0;
+        babel_ifp->bulk_send_pending = 0;
+        send_request(ifp, NULL, 0);
+        send_update(ifp, 0, NULL, 0);
+    }
+    list_delete_all_node(babel_bulk_if_list);
+}
+
 int
 babel_interface_add (int cmd, struct zclient *client, zebra_size_t length)
 {
@@ -139,7 +192,7 @@ babel_interface_delete (int cmd, struct zclient *client, zebra_size_t length)
 
     /* To support pseudo interface do not free interface structure.  */
     /* if_delete(ifp); */
-    ifp->ifindex = IFINDEX_INTERNAL;
+    if_set_index (ifp, IFINDEX_INTERNAL);
 
     return 0;
 }
@@ -163,7 +216,6 @@ babel_interface_address_add (int cmd, struct zclient *client,
     prefix = ifc->address;
 
     if (prefix->family == AF_INET) {
-        flush_interface_routes(ifc->ifp, 0);
         babel_ifp = babel_get_if_nfo(ifc->ifp);
         if (babel_ifp->ipv4 == NULL) {
             babel_ifp->ipv4 = malloc(4);
@@ -175,8 +227,7 @@ babel_interface_address_add (int cmd, struct zclient *client,
         }
     }
 
-    send_request(ifc->ifp, NULL, 0);
-    send_update(ifc->ifp, 0, NULL, 0);
+    babel_interface_address_changed(ifc->ifp, prefix->family == AF_INET);
 
     return 0;
 }
@@ -200,7 +251,6 @@ babel_interface_address_delete (int cmd, struct zclient *client,
     prefix = ifc->address;
 
     if (prefix->family == AF_INET) {
-        flush_interface_routes(ifc->ifp, 0);
         babel_ifp = babel_get_if_nfo(ifc->ifp);
         if (babel_ifp->ipv4 != NULL
             && memcmp(babel_ifp->ipv4, &prefix->u.prefix4, 4) == 0) {
@@ -209,8 +259,7 @@ babel_interface_address_delete (int cmd, struct zclient *client,
         }
     }
 
-    send_request(ifc->ifp, NULL, 0);
-    send_update(ifc->ifp, 0, NULL, 0);
+    babel_interface_address_changed(ifc->ifp, prefix->family == AF_INET);
 
     return 0;
 }
@@ -80,6 +80,10 @@ struct babel_interface {
     u_int16_t auth_packetcounter;
     u_int32_t auth_timestamp;
     struct babel_auth_stats auth_stats;
+    /* Route flush and request/update left to the end of a bulk
+       interface message. */
+    char bulk_flush_pending;
+    char bulk_send_pending;
 };
 
 typedef struct babel_interface babel_interface_nfo;
@@ -137,6 +141,7 @@ int babel_interface_add (int, struct zclient *, zebra_size_t);
 int babel_interface_delete (int, struct zclient *, zebra_size_t);
 int babel_interface_address_add (int, struct zclient *, zebra_size_t);
 int babel_interface_address_delete (int, struct zclient *, zebra_size_t);
+void babel_interface_bulk_end (struct zclient *);
 
 unsigned jitter(babel_interface_nfo *, int);
 unsigned update_jitter(babel_interface_nfo *babel_ifp, int urgent);
@@ -359,6 +359,8 @@ void babelz_zebra_init(void)
     zclient->interface_down = babel_interface_down;
     zclient->interface_address_add = babel_interface_address_add;
     zclient->interface_address_delete = babel_interface_address_delete;
+    zclient->interface_bulk_end = babel_interface_bulk_end;
+    zclient->interface_hold = ZAPI_INTERFACE_HOLD;
     zclient->ipv4_route_add = babel_zebra_read_ipv4;
     zclient->ipv4_route_delete = babel_zebra_read_ipv4;
     zclient->ipv6_route_add = babel_zebra_read_ipv6;
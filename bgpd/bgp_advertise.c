@@ -240,6 +240,8 @@ bgp_adj_out_set (struct bgp_node *rn, struct peer *peer, struct prefix *p,
         {
           BGP_ADJ_OUT_ADD (rn, adj);
           bgp_lock_node (rn);
+          adj->rn = rn;
+          BGP_PEER_LIST_ADD (peer->adj_out[afi][safi], adj);
         }
     }
 
@@ -306,6 +308,7 @@ bgp_adj_out_unset (struct bgp_node *rn, struct peer *peer, struct prefix *p,
     {
       /* Remove myself from adjacency. */
       BGP_ADJ_OUT_DEL (rn, adj);
+      BGP_PEER_LIST_DEL (peer->adj_out[afi][safi], adj);
       
       /* Free allocated information.  */
       bgp_adj_out_free (adj);
@@ -325,6 +328,7 @@ bgp_adj_out_remove (struct bgp_node *rn, struct bgp_adj_out *adj,
     bgp_advertise_clean (peer, adj, afi, safi);
 
   BGP_ADJ_OUT_DEL (rn, adj);
+  BGP_PEER_LIST_DEL (adj->peer->adj_out[afi][safi], adj);
   bgp_adj_out_free (adj);
 }
 
@@ -350,6 +354,8 @@ bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr)
   adj->attr = bgp_attr_intern (attr);
   BGP_ADJ_IN_ADD (rn, adj);
   bgp_lock_node (rn);
+  adj->rn = rn;
+  BGP_PEER_LIST_ADD (peer->adj_in[rn->table->afi][rn->table->safi], adj);
 }
 
 void
@@ -357,6 +363,7 @@ bgp_adj_in_remove (struct bgp_node *rn, struct bgp_adj_in *bai)
 {
   bgp_attr_unintern (bai->attr);
   BGP_ADJ_IN_DEL (rn, bai);
+  BGP_PEER_LIST_DEL (bai->peer->adj_in[rn->table->afi][rn->table->safi], bai);
   peer_unlock (bai->peer); /* adj_in peer reference */
   XFREE (MTYPE_BGP_ADJ_IN, bai);
 }
@@ -78,6 +78,11 @@ struct bgp_adj_out
 
   /* Advertisement information.  */
   struct bgp_advertise *adv;
+
+  /* Node of this adjacency and peer's list of adjacencies.  */
+  struct bgp_node *rn;
+  struct bgp_adj_out *peer_next;
+  struct bgp_adj_out *peer_prev;
 };
 
 /* BGP adjacency in. */
@@ -92,6 +97,11 @@ struct bgp_adj_in
 
   /* Received attribute.  */
   struct attr *attr;
+
+  /* Node of this adjacency and peer's list of adjacencies.  */
+  struct bgp_node *rn;
+  struct bgp_adj_in *peer_next;
+  struct bgp_adj_in *peer_prev;
 };
 
 /* BGP advertisement list.  */
@@ -122,6 +132,26 @@ struct bgp_synchronize
       (N)->TYPE = (A)->next;                          \
   } while (0)
 
+/* Per-peer lists, threaded through peer_next/peer_prev.  */
+#define BGP_PEER_LIST_ADD(H,A)                        \
+  do {                                                \
+    (A)->peer_prev = NULL;                            \
+    (A)->peer_next = (H);                             \
+    if (H)                                            \
+      (H)->peer_prev = (A);                           \
+    (H) = (A);                                        \
+  } while (0)
+
+#define BGP_PEER_LIST_DEL(H,A)                        \
+  do {                                                \
+    if ((A)->peer_next)                               \
+      (A)->peer_next->peer_prev = (A)->peer_prev;     \
+    if ((A)->peer_prev)                               \
+      (A)->peer_prev->peer_next = (A)->peer_next;     \
+    else                                              \
+      (H) = (A)->peer_next;                           \
+  } while (0)
+
 #define BGP_ADJ_IN_ADD(N,A)    BGP_INFO_ADD(N,A,adj_in)
 #define BGP_ADJ_IN_DEL(N,A)    BGP_INFO_DEL(N,A,adj_in)
 #define BGP_ADJ_OUT_ADD(N,A)   BGP_INFO_ADD(N,A,adj_out)
@@ -0,0 +1,1101 @@
+/* BGP Monitoring Protocol (RFC 7854) exporter.
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#include <zebra.h>
+
+#include "log.h"
+#include "stream.h"
+#include "sockunion.h"
+#include "network.h"
+#include "command.h"
+#include "prefix.h"
+#include "thread.h"
+#include "linklist.h"
+#include "memory.h"
+#include "version.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_open.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_bmp.h"
+
+/* BMP session state.  */
+enum bmp_state
+{
+  BMP_IDLE,
+  BMP_CONNECTING,
+  BMP_UP
+};
+
+static const char *bmp_state_str[] =
+{
+  "Idle",
+  "Connecting",
+  "Up"
+};
+
+/* One collector session per BGP instance.  Everything the routing
+   code hands us is encoded immediately and queued on obuf; the queue
+   is drained only when the socket is writable, so a slow collector
+   can never stall the main thread.  When the queue would grow past
+   queue_limit the session is reset and replayed from scratch, which
+   is the only recovery RFC 7854 allows for lost messages.  */
+struct bmp
+{
+  struct bgp *bgp;
+
+  /* Collector address and port.  */
+  union sockunion su;
+  u_int16_t port;
+
+  int fd;
+  enum bmp_state state;
+
+  /* Output queue.  */
+  struct stream_fifo *obuf;
+  size_t obuf_bytes;
+  size_t queue_limit;
+
+  int stats_interval;
+
+  struct thread *t_connect;
+  struct thread *t_read;
+  struct thread *t_write;
+  struct thread *t_dump;
+  struct thread *t_stats;
+
+  /* Initial table dump position.  dump_rn is kept locked.  */
+  afi_t dump_afi;
+  struct bgp_node *dump_rn;
+
+  /* Counters.  */
+  time_t uptime;
+  unsigned long connects;
+  unsigned long drops;
+  unsigned long msgs;
+  unsigned long bytes;
+};
+
+/* Scratch buffer every message is encoded into before being queued.  */
+static struct stream *bmp_work;
+
+static int bmp_write (struct thread *);
+static int bmp_read (struct thread *);
+static int bmp_dump (struct thread *);
+static int bmp_stats (struct thread *);
+static int bmp_reconnect (struct thread *);
+
+static void
+bmp_common_header (struct stream *s, u_char type)
+{
+  stream_reset (s);
+  stream_putc (s, BMP_VERSION);
+  stream_putl (s, 0);
+  stream_putc (s, type);
+}
+
+static void
+bmp_set_size (struct stream *s)
+{
+  stream_putl_at (s, 1, stream_get_endp (s));
+}
+
+/* IPv4 addresses are carried in the last four bytes of the 16 byte
+   address fields.  */
+static void
+bmp_put_addr (struct stream *s, union sockunion *su)
+{
+#ifdef HAVE_IPV6
+  if (su && su->sa.sa_family == AF_INET6)
+    {
+      stream_put (s, &su->sin6.sin6_addr, 16);
+      return;
+    }
+#endif /* HAVE_IPV6 */
+  stream_put (s, NULL, 12);
+  if (su && su->sa.sa_family == AF_INET)
+    stream_put_in_addr (s, &su->sin.sin_addr);
+  else
+    stream_putl (s, 0);
+}
+
+static void
+bmp_peer_header (struct stream *s, struct peer *peer, int post)
+{
+  struct timeval tv;
+  u_char flags = 0;
+
+#ifdef HAVE_IPV6
+  if (peer->su.sa.sa_family == AF_INET6)
+    SET_FLAG (flags, BMP_PEER_FLAG_V);
+#endif /* HAVE_IPV6 */
+  if (post)
+    SET_FLAG (flags, BMP_PEER_FLAG_L);
+
+  quagga_gettime (QUAGGA_CLK_REALTIME, &tv);
+
+  stream_putc (s, BMP_PEER_TYPE_GLOBAL);
+  stream_putc (s, flags);
+  stream_put (s, NULL, 8);		/* Peer distinguisher. */
+  bmp_put_addr (s, &peer->su);
+  stream_putl (s, peer->as);
+  stream_put_in_addr (s, &peer->remote_id);
+  stream_putl (s, tv.tv_sec);
+  stream_putl (s, tv.tv_usec);
+}
+
+/* Start an encapsulated BGP message, return its offset for
+   bmp_bgp_set_size.  */
+static size_t
+bmp_bgp_header (struct stream *s, u_char type)
+{
+  size_t start;
+  int i;
+
+  start = stream_get_endp (s);
+  for (i = 0; i < BGP_MARKER_SIZE; i++)
+    stream_putc (s, 0xff);
+  stream_putw (s, 0);
+  stream_putc (s, type);
+
+  return start;
+}
+
+static void
+bmp_bgp_set_size (struct stream *s, size_t start)
+{
+  stream_putw_at (s, start + BGP_MARKER_SIZE, stream_get_endp (s) - start);
+}
+
+static void
+bmp_info_tlv (struct stream *s, u_int16_t type, const char *str)
+{
+  stream_putw (s, type);
+  stream_putw (s, strlen (str));
+  stream_put (s, str, strlen (str));
+}
+
+/* Take a session down and arrange for it to be retried later.  */
+static void
+bmp_close (struct bmp *bmp)
+{
+  THREAD_OFF (bmp->t_connect);
+  THREAD_OFF (bmp->t_read);
+  THREAD_OFF (bmp->t_write);
+  THREAD_OFF (bmp->t_dump);
+  THREAD_OFF (bmp->t_stats);
+
+  if (bmp->dump_rn)
+    {
+      bgp_unlock_node (bmp->dump_rn);
+      bmp->dump_rn = NULL;
+    }
+  bmp->dump_afi = AFI_MAX;
+
+  stream_fifo_clean (bmp->obuf);
+  bmp->obuf_bytes = 0;
+
+  if (bmp->fd >= 0)
+    {
+      close (bmp->fd);
+      bmp->fd = -1;
+    }
+  bmp->state = BMP_IDLE;
+}
+
+static void
+bmp_reset (struct bmp *bmp)
+{
+  bmp_close (bmp);
+  bmp->t_connect = thread_add_timer (master, bmp_reconnect, bmp,
+				     BMP_RECONNECT_TIME);
+}
+
+/* Queue a copy of the encoded message.  */
+static void
+bmp_send (struct bmp *bmp, struct stream *s)
+{
+  size_t length;
+  char buf[SU_ADDRSTRLEN];
+
+  if (bmp->state != BMP_UP)
+    return;
+
+  length = stream_get_endp (s);
+  if (bmp->obuf_bytes + length > bmp->queue_limit)
+    {
+      zlog_warn ("BMP collector %s: output queue limit %lu exceeded, "
+		 "resetting session",
+		 sockunion2str (&bmp->su, buf, sizeof buf),
+		 (unsigned long) bmp->queue_limit);
+      bmp->drops++;
+      bmp_reset (bmp);
+      return;
+    }
+
+  stream_fifo_push (bmp->obuf, stream_dup (s));
+  bmp->obuf_bytes += length;
+
+  if (! bmp->t_write)
+    bmp->t_write = thread_add_write (master, bmp_write, bmp, bmp->fd);
+}
+
+static void
+bmp_send_initiation (struct bmp *bmp)
+{
+  struct stream *s = bmp_work;
+  char hostname[MAXHOSTNAMELEN];
+
+  if (host.name)
+    strncpy (hostname, host.name, sizeof hostname);
+  else if (gethostname (hostname, sizeof hostname) < 0)
+    strcpy (hostname, "bgpd");
+  hostname[sizeof hostname - 1] = '\0';
+
+  bmp_common_header (s, BMP_MSG_INITIATION);
+  bmp_info_tlv (s, BMP_INFO_SYS_DESCR, QUAGGA_PROGNAME " " QUAGGA_VERSION);
+  bmp_info_tlv (s, BMP_INFO_SYS_NAME, hostname);
+  bmp_set_size (s);
+
+  bmp_send (bmp, s);
+}
+
+/* The OPEN messages themselves are not kept once a session is
+   established, so Peer Up carries equivalent ones rebuilt from the
+   negotiated values.  Only the 4-octet AS capability is included,
+   which is what a collector needs to decode the AS_PATHs we send.  */
+static void
+bmp_put_open (struct stream *s, as_t as, u_int16_t holdtime,
+	      struct in_addr *id)
+{
+  size_t start;
+
+  start = bmp_bgp_header (s, BGP_MSG_OPEN);
+  stream_putc (s, BGP_VERSION_4);
+  stream_putw (s, as > BGP_AS_MAX ? BGP_AS_TRANS : as);
+  stream_putw (s, holdtime);
+  stream_put_in_addr (s, id);
+  stream_putc (s, 2 + 2 + CAPABILITY_CODE_AS4_LEN);
+  stream_putc (s, BGP_OPEN_OPT_CAP);
+  stream_putc (s, 2 + CAPABILITY_CODE_AS4_LEN);
+  stream_putc (s, CAPABILITY_CODE_AS4);
+  stream_putc (s, CAPABILITY_CODE_AS4_LEN);
+  stream_putl (s, as);
+  bmp_bgp_set_size (s, start);
+}
+
+static u_int16_t
+bmp_sockunion_port (union sockunion *su)
+{
+  if (su == NULL)
+    return 0;
+#ifdef HAVE_IPV6
+  if (su->sa.sa_family == AF_INET6)
+    return ntohs (su->sin6.sin6_port);
+#endif /* HAVE_IPV6 */
+  return ntohs (su->sin.sin_port);
+}
+
+static void
+bmp_send_peer_up (struct bmp *bmp, struct peer *peer)
+{
+  struct stream *s = bmp_work;
+
+  bmp_common_header (s, BMP_MSG_PEER_UP);
+  bmp_peer_header (s, peer, 0);
+  bmp_put_addr (s, peer->su_local);
+  stream_putw (s, bmp_sockunion_port (peer->su_local));
+  stream_putw (s, bmp_sockunion_port (peer->su_remote));
+  bmp_put_open (s, peer->change_local_as ? peer->change_local_as
+					  : peer->local_as,
+		peer->v_holdtime, &peer->local_id);
+  bmp_put_open (s, peer->as, peer->v_holdtime, &peer->remote_id);
+  bmp_set_size (s);
+
+  bmp_send (bmp, s);
+}
+
+static void
+bmp_put_notify (struct stream *s, u_char code, u_char subcode,
+		char *data, bgp_size_t length)
+{
+  size_t start;
+
+  start = bmp_bgp_header (s, BGP_MSG_NOTIFY);
+  stream_putc (s, code);
+  stream_putc (s, subcode);
+  if (data && length)
+    stream_put (s, data, length);
+  bmp_bgp_set_size (s, start);
+}
+
+static void
+bmp_send_peer_down (struct bmp *bmp, struct peer *peer)
+{
+  struct stream *s = bmp_work;
+
+  bmp_common_header (s, BMP_MSG_PEER_DOWN);
+  bmp_peer_header (s, peer, 0);
+
+  switch (peer->last_reset)
+    {
+    case PEER_DOWN_NOTIFY_RECEIVED:
+      stream_putc (s, BMP_PEERDOWN_REMOTE_NOTIFY);
+      bmp_put_notify (s, peer->notify.code, peer->notify.subcode,
+		      peer->notify.data, peer->notify.length);
+      break;
+    case PEER_DOWN_USER_RESET:
+      stream_putc (s, BMP_PEERDOWN_LOCAL_NOTIFY);
+      bmp_put_notify (s, BGP_NOTIFY_CEASE, BGP_NOTIFY_CEASE_ADMIN_RESET,
+		      NULL, 0);
+      break;
+    case PEER_DOWN_USER_SHUTDOWN:
+      stream_putc (s, BMP_PEERDOWN_LOCAL_NOTIFY);
+      bmp_put_notify (s, BGP_NOTIFY_CEASE, BGP_NOTIFY_CEASE_ADMIN_SHUTDOWN,
+		      NULL, 0);
+      break;
+    case PEER_DOWN_CLOSE_SESSION:
+    case PEER_DOWN_NSF_CLOSE_SESSION:
+      stream_putc (s, BMP_PEERDOWN_REMOTE_NODATA);
+      break;
+    default:
+      /* The FSM event is not recorded, report it as unknown. */
+      stream_putc (s, BMP_PEERDOWN_LOCAL_FSM);
+      stream_putw (s, 0);
+      break;
+    }
+  bmp_set_size (s);
+
+  bmp_send (bmp, s);
+}
+
+/* Route Monitoring, a NULL attr is a withdraw.  Only unicast is
+   exported, IPv6 reachability is carried in MP_REACH_NLRI as built by
+   bgp_dump_routes_attr.  */
+static void
+bmp_send_route (struct bmp *bmp, struct peer *peer, struct prefix *p,
+		struct attr *attr, int post)
+{
+  struct stream *s = bmp_work;
+  size_t start;
+  size_t pos;
+
+#ifdef HAVE_IPV6
+  /* bgp_dump_routes_attr can only encode a global IPv6 nexthop. */
+  if (attr && p->family == AF_INET6
+      && ! (attr->extra && (attr->extra->mp_nexthop_len == 16
+			    || attr->extra->mp_nexthop_len == 32)))
+    return;
+#endif /* HAVE_IPV6 */
+
+  bmp_common_header (s, BMP_MSG_ROUTE_MONITORING);
+  bmp_peer_header (s, peer, post);
+  start = bmp_bgp_header (s, BGP_MSG_UPDATE);
+
+  if (attr)
+    {
+      stream_putw (s, 0);
+      bgp_dump_routes_attr (s, attr, p);
+      if (p->family == AF_INET)
+	stream_put_prefix (s, p);
+    }
+  else if (p->family == AF_INET)
+    {
+      pos = stream_get_endp (s);
+      stream_putw (s, 0);
+      stream_putw_at (s, pos, stream_put_prefix (s, p));
+      stream_putw (s, 0);
+    }
+#ifdef HAVE_IPV6
+  else
+    {
+      stream_putw (s, 0);
+      pos = stream_get_endp (s);
+      stream_putw (s, 0);
+      stream_putc (s, BGP_ATTR_FLAG_OPTIONAL);
+      stream_putc (s, BGP_ATTR_MP_UNREACH_NLRI);
+      stream_putc (s, 0);
+      stream_putw (s, AFI_IP6);
+      stream_putc (s, SAFI_UNICAST);
+      stream_put_prefix (s, p);
+      stream_putc_at (s, pos + 4, stream_get_endp (s) - pos - 5);
+      stream_putw_at (s, pos, stream_get_endp (s) - pos - 2);
+    }
+#endif /* HAVE_IPV6 */
+
+  bmp_bgp_set_size (s, start);
+  bmp_set_size (s);
+
+  bmp_send (bmp, s);
+}
+
+static void
+bmp_send_stats (struct bmp *bmp, struct peer *peer)
+{
+  struct stream *s = bmp_work;
+  size_t pos;
+  u_int32_t count = 1;
+  u_int64_t total = 0;
+  afi_t afi;
+  safi_t safi;
+
+  bmp_common_header (s, BMP_MSG_STATISTICS_REPORT);
+  bmp_peer_header (s, peer, 0);
+  pos = stream_get_endp (s);
+  stream_putl (s, 0);
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      if (peer->afc_nego[afi][safi])
+	{
+	  stream_putw (s, BMP_STAT_AF_ADJ_RIB_IN);
+	  stream_putw (s, 11);
+	  stream_putw (s, afi);
+	  stream_putc (s, safi);
+	  stream_putq (s, peer->pcount[afi][safi]);
+	  total += peer->pcount[afi][safi];
+	  count++;
+	}
+
+  stream_putw (s, BMP_STAT_ADJ_RIB_IN);
+  stream_putw (s, 8);
+  stream_putq (s, total);
+
+  stream_putl_at (s, pos, count);
+  bmp_set_size (s);
+
+  bmp_send (bmp, s);
+}
+
+/* Send a Termination message if it can be done without waiting.  */
+static void
+bmp_send_termination (struct bmp *bmp, u_int16_t reason)
+{
+  struct stream *s = bmp_work;
+
+  if (bmp->state != BMP_UP || stream_fifo_head (bmp->obuf))
+    return;
+
+  bmp_common_header (s, BMP_MSG_TERMINATION);
+  stream_putw (s, BMP_TERM_REASON);
+  stream_putw (s, 2);
+  stream_putw (s, reason);
+  bmp_set_size (s);
+
+  if (write (bmp->fd, STREAM_DATA (s), stream_get_endp (s)) < 0)
+    zlog_info ("BMP termination not sent: %s", safe_strerror (errno));
+}
+
+static int
+bmp_write (struct thread *thread)
+{
+  struct bmp *bmp;
+  struct stream *s;
+  ssize_t nbytes;
+  char buf[SU_ADDRSTRLEN];
+
+  bmp = THREAD_ARG (thread);
+  bmp->t_write = NULL;
+
+  while ((s = stream_fifo_head (bmp->obuf)) != NULL)
+    {
+      nbytes = write (bmp->fd, stream_pnt (s), STREAM_READABLE (s));
+      if (nbytes < 0)
+	{
+	  if (ERRNO_IO_RETRY (errno))
+	    break;
+	  zlog_warn ("BMP collector %s: write failed: %s",
+		     sockunion2str (&bmp->su, buf, sizeof buf),
+		     safe_strerror (errno));
+	  bmp_reset (bmp);
+	  return 0;
+	}
+
+      bmp->bytes += nbytes;
+      stream_forward_getp (s, nbytes);
+      if (STREAM_READABLE (s))
+	break;
+
+      bmp->obuf_bytes -= stream_get_endp (s);
+      stream_free (stream_fifo_pop (bmp->obuf));
+      bmp->msgs++;
+    }
+
+  if (stream_fifo_head (bmp->obuf))
+    bmp->t_write = thread_add_write (master, bmp_write, bmp, bmp->fd);
+
+  /* Resume a table dump which was waiting for the queue to drain. */
+  if (bmp->dump_afi < AFI_MAX && ! bmp->t_dump
+      && bmp->obuf_bytes <= bmp->queue_limit / 2)
+    bmp->t_dump = thread_add_background (master, bmp_dump, bmp, 0);
+
+  return 0;
+}
+
+/* The collector is not supposed to send anything.  Reading is only
+   used to notice the session going away.  */
+static int
+bmp_read (struct thread *thread)
+{
+  struct bmp *bmp;
+  ssize_t nbytes;
+  char buf[BUFSIZ];
+
+  bmp = THREAD_ARG (thread);
+  bmp->t_read = NULL;
+
+  nbytes = read (bmp->fd, buf, sizeof buf);
+  if (nbytes == 0 || (nbytes < 0 && ! ERRNO_IO_RETRY (errno)))
+    {
+      zlog_info ("BMP collector %s: connection closed",
+		 sockunion2str (&bmp->su, buf, sizeof buf));
+      bmp_reset (bmp);
+      return 0;
+    }
+
+  bmp->t_read = thread_add_read (master, bmp_read, bmp, bmp->fd);
+  return 0;
+}
+
+static void
+bmp_dump_node (struct bmp *bmp, struct bgp_node *rn)
+{
+  struct bgp_adj_in *ain;
+  struct bgp_info *ri;
+
+  /* Pre-policy routes are only known with soft-reconfiguration. */
+  for (ain = rn->adj_in; ain; ain = ain->next)
+    if (ain->peer->status == Established)
+      bmp_send_route (bmp, ain->peer, &rn->p, ain->attr, 0);
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer != bmp->bgp->peer_self
+	&& ri->peer->status == Established
+	&& ! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED | BGP_INFO_HISTORY))
+      bmp_send_route (bmp, ri->peer, &rn->p, ri->attr, 1);
+}
+
+/* Walk the unicast RIBs a batch of nodes at a time.  The walk stops
+   while the output queue is more than half full and bmp_write restarts
+   it once the collector has caught up.  */
+static int
+bmp_dump (struct thread *thread)
+{
+  struct bmp *bmp;
+  int count = 0;
+
+  bmp = THREAD_ARG (thread);
+  bmp->t_dump = NULL;
+
+  while (bmp->dump_afi < AFI_MAX)
+    {
+      if (bmp->dump_rn == NULL)
+	{
+	  if (++bmp->dump_afi < AFI_MAX)
+	    bmp->dump_rn = bgp_table_top (bmp->bgp->rib[bmp->dump_afi][SAFI_UNICAST]);
+	  continue;
+	}
+
+      if (bmp->obuf_bytes > bmp->queue_limit / 2)
+	return 0;
+
+      if (count++ >= BMP_DUMP_BATCH)
+	{
+	  bmp->t_dump = thread_add_background (master, bmp_dump, bmp, 0);
+	  return 0;
+	}
+
+      bmp_dump_node (bmp, bmp->dump_rn);
+      if (bmp->state != BMP_UP)
+	return 0;
+
+      bmp->dump_rn = bgp_route_next (bmp->dump_rn);
+    }
+
+  return 0;
+}
+
+static int
+bmp_stats (struct thread *thread)
+{
+  struct bmp *bmp;
+  struct peer *peer;
+  struct listnode *node, *nnode;
+
+  bmp = THREAD_ARG (thread);
+  bmp->t_stats = NULL;
+
+  for (ALL_LIST_ELEMENTS (bmp->bgp->peer, node, nnode, peer))
+    if (peer->status == Established && bmp->state == BMP_UP)
+      bmp_send_stats (bmp, peer);
+
+  if (bmp->state == BMP_UP && bmp->stats_interval)
+    bmp->t_stats = thread_add_timer (master, bmp_stats, bmp,
+				     bmp->stats_interval);
+  return 0;
+}
+
+/* Session is up: introduce ourselves, announce the peers which are
+   already established and start the table dump.  */
+static void
+bmp_established (struct bmp *bmp)
+{
+  struct peer *peer;
+  struct listnode *node, *nnode;
+  char buf[SU_ADDRSTRLEN];
+
+  zlog_info ("BMP collector %s: connection established",
+	     sockunion2str (&bmp->su, buf, sizeof buf));
+
+  bmp->state = BMP_UP;
+  bmp->uptime = bgp_clock ();
+  bmp->connects++;
+
+  bmp->t_read = thread_add_read (master, bmp_read, bmp, bmp->fd);
+
+  bmp_send_initiation (bmp);
+
+  for (ALL_LIST_ELEMENTS (bmp->bgp->peer, node, nnode, peer))
+    if (peer->status == Established && bmp->state == BMP_UP)
+      bmp_send_peer_up (bmp, peer);
+
+  if (bmp->state != BMP_UP)
+    return;
+
+  bmp->dump_afi = AFI_IP;
+  bmp->dump_rn = bgp_table_top (bmp->bgp->rib[AFI_IP][SAFI_UNICAST]);
+  bmp->t_dump = thread_add_background (master, bmp_dump, bmp, 0);
+
+  if (bmp->stats_interval)
+    bmp->t_stats = thread_add_timer (master, bmp_stats, bmp,
+				     bmp->stats_interval);
+}
+
+static int
+bmp_connect_check (struct thread *thread)
+{
+  struct bmp *bmp;
+  int status;
+  socklen_t slen;
+  char buf[SU_ADDRSTRLEN];
+
+  bmp = THREAD_ARG (thread);
+  bmp->t_connect = NULL;
+
+  slen = sizeof (status);
+  if (getsockopt (bmp->fd, SOL_SOCKET, SO_ERROR, (void *) &status, &slen) < 0)
+    status = errno;
+
+  if (status != 0)
+    {
+      zlog_info ("BMP collector %s: connect failed: %s",
+		 sockunion2str (&bmp->su, buf, sizeof buf),
+		 safe_strerror (status));
+      bmp_reset (bmp);
+      return 0;
+    }
+
+  bmp_established (bmp);
+  return 0;
+}
+
+static void
+bmp_connect (struct bmp *bmp)
+{
+  bmp->fd = sockunion_stream_socket (&bmp->su);
+  if (bmp->fd < 0)
+    {
+      bmp_reset (bmp);
+      return;
+    }
+
+  switch (sockunion_connect (bmp->fd, &bmp->su, htons (bmp->port), 0))
+    {
+    case connect_error:
+      bmp_reset (bmp);
+      break;
+    case connect_success:
+      set_nonblocking (bmp->fd);
+      bmp_established (bmp);
+      break;
+    case connect_in_progress:
+      set_nonblocking (bmp->fd);
+      bmp->state = BMP_CONNECTING;
+      bmp->t_connect = thread_add_write (master, bmp_connect_check, bmp,
+					 bmp->fd);
+      break;
+    }
+}
+
+static int
+bmp_reconnect (struct thread *thread)
+{
+  struct bmp *bmp;
+
+  bmp = THREAD_ARG (thread);
+  bmp->t_connect = NULL;
+
+  bmp_connect (bmp);
+  return 0;
+}
+
+static void
+bmp_free (struct bmp *bmp)
+{
+  bmp_send_termination (bmp, BMP_TERM_ADMIN_CLOSE);
+  bmp_close (bmp);
+  stream_fifo_free (bmp->obuf);
+  bmp->bgp->bmp = NULL;
+  XFREE (MTYPE_BGP_BMP, bmp);
+}
+
+/* Hooks called from the FSM and the update processing.  */
+void
+bgp_bmp_peer_up (struct peer *peer)
+{
+  struct bmp *bmp = peer->bgp->bmp;
+
+  if (bmp && bmp->state == BMP_UP)
+    bmp_send_peer_up (bmp, peer);
+}
+
+void
+bgp_bmp_peer_down (struct peer *peer)
+{
+  struct bmp *bmp = peer->bgp->bmp;
+
+  if (bmp && bmp->state == BMP_UP)
+    bmp_send_peer_down (bmp, peer);
+}
+
+void
+bgp_bmp_route_monitor (struct peer *peer, afi_t afi, safi_t safi,
+		       struct prefix *p, struct attr *attr, int post)
+{
+  struct bmp *bmp = peer->bgp->bmp;
+
+  if (bmp == NULL || bmp->state != BMP_UP)
+    return;
+  if (safi != SAFI_UNICAST || peer == peer->bgp->peer_self)
+    return;
+
+  bmp_send_route (bmp, peer, p, attr, post);
+}
+
+void
+bgp_bmp_delete (struct bgp *bgp)
+{
+  if (bgp->bmp)
+    bmp_free (bgp->bmp);
+}
+
+DEFUN (bmp_collector,
+       bmp_collector_cmd,
+       "bmp collector (A.B.C.D|X:X::X:X) port <1-65535>",
+       "BGP Monitoring Protocol\n"
+       "Export to a BMP collector\n"
+       "Collector IPv4 address\n"
+       "Collector IPv6 address\n"
+       "Collector TCP port\n"
+       "TCP port number\n")
+{
+  struct bgp *bgp;
+  struct bmp *bmp;
+  union sockunion su;
+  u_int16_t port;
+
+  bgp = vty->index;
+  if (! bgp)
+    return CMD_WARNING;
+
+  if (str2sockunion (argv[0], &su) < 0)
+    {
+      vty_out (vty, "%% Malformed address %s%s", argv[0], VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  VTY_GET_INTEGER_RANGE ("port", port, argv[1], 1, 65535);
+
+  bmp = bgp->bmp;
+  if (bmp)
+    {
+      if (sockunion_same (&bmp->su, &su) && bmp->port == port)
+	return CMD_SUCCESS;
+      bmp_send_termination (bmp, BMP_TERM_ADMIN_CLOSE);
+      bmp_close (bmp);
+    }
+  else
+    {
+      bmp = XCALLOC (MTYPE_BGP_BMP, sizeof (struct bmp));
+      bmp->bgp = bgp;
+      bmp->fd = -1;
+      bmp->obuf = stream_fifo_new ();
+      bmp->queue_limit = BMP_DEFAULT_QUEUE_LIMIT;
+      bmp->stats_interval = BMP_DEFAULT_STATS_INTERVAL;
+      bmp->dump_afi = AFI_MAX;
+      bgp->bmp = bmp;
+    }
+
+  bmp->su = su;
+  bmp->port = port;
+  bmp_connect (bmp);
+
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bmp_collector,
+       no_bmp_collector_cmd,
+       "no bmp collector",
+       NO_STR
+       "BGP Monitoring Protocol\n"
+       "Export to a BMP collector\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  if (! bgp)
+    return CMD_WARNING;
+
+  bgp_bmp_delete (bgp);
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_bmp_collector,
+       no_bmp_collector_val_cmd,
+       "no bmp collector (A.B.C.D|X:X::X:X) port <1-65535>",
+       NO_STR
+       "BGP Monitoring Protocol\n"
+       "Export to a BMP collector\n"
+       "Collector IPv4 address\n"
+       "Collector IPv6 address\n"
+       "Collector TCP port\n"
+       "TCP port number\n")
+
+DEFUN (bmp_stats_interval,
+       bmp_stats_interval_cmd,
+       "bmp stats-interval <0-3600>",
+       "BGP Monitoring Protocol\n"
+       "Interval between statistics reports\n"
+       "Seconds, 0 disables statistics reports\n")
+{
+  struct bgp *bgp;
+  struct bmp *bmp;
+  int interval;
+
+  bgp = vty->index;
+  if (! bgp)
+    return CMD_WARNING;
+
+  bmp = bgp->bmp;
+  if (! bmp)
+    {
+      vty_out (vty, "%% No BMP collector configured%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  VTY_GET_INTEGER_RANGE ("stats-interval", interval, argv[0], 0, 3600);
+  bmp->stats_interval = interval;
+
+  THREAD_OFF (bmp->t_stats);
+  if (bmp->state == BMP_UP && bmp->stats_interval)
+    bmp->t_stats = thread_add_timer (master, bmp_stats, bmp,
+				     bmp->stats_interval);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bmp_stats_interval,
+       no_bmp_stats_interval_cmd,
+       "no bmp stats-interval",
+       NO_STR
+       "BGP Monitoring Protocol\n"
+       "Interval between statistics reports\n")
+{
+  struct bgp *bgp;
+  struct bmp *bmp;
+
+  bgp = vty->index;
+  if (! bgp)
+    return CMD_WARNING;
+
+  bmp = bgp->bmp;
+  if (! bmp)
+    return CMD_SUCCESS;
+
+  bmp->stats_interval = BMP_DEFAULT_STATS_INTERVAL;
+  THREAD_OFF (bmp->t_stats);
+  if (bmp->state == BMP_UP)
+    bmp->t_stats = thread_add_timer (master, bmp_stats, bmp,
+				     bmp->stats_interval);
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_bmp_stats_interval,
+       no_bmp_stats_interval_val_cmd,
+       "no bmp stats-interval <0-3600>",
+       NO_STR
+       "BGP Monitoring Protocol\n"
+       "Interval between statistics reports\n"
+       "Seconds, 0 disables statistics reports\n")
+
+DEFUN (bmp_queue_limit,
+       bmp_queue_limit_cmd,
+       "bmp queue-limit <65536-1073741824>",
+       "BGP Monitoring Protocol\n"
+       "Maximum bytes queued for the collector before the session is reset\n"
+       "Bytes\n")
+{
+  struct bgp *bgp;
+  struct bmp *bmp;
+  unsigned long limit;
+
+  bgp = vty->index;
+  if (! bgp)
+    return CMD_WARNING;
+
+  bmp = bgp->bmp;
+  if (! bmp)
+    {
+      vty_out (vty, "%% No BMP collector configured%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  VTY_GET_INTEGER_RANGE ("queue-limit", limit, argv[0], 65536, 1073741824);
+  bmp->queue_limit = limit;
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bmp_queue_limit,
+       no_bmp_queue_limit_cmd,
+       "no bmp queue-limit",
+       NO_STR
+       "BGP Monitoring Protocol\n"
+       "Maximum bytes queued for the collector before the session is reset\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  if (! bgp)
+    return CMD_WARNING;
+
+  if (bgp->bmp)
+    bgp->bmp->queue_limit = BMP_DEFAULT_QUEUE_LIMIT;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_bmp_queue_limit,
+       no_bmp_queue_limit_val_cmd,
+       "no bmp queue-limit <65536-1073741824>",
+       NO_STR
+       "BGP Monitoring Protocol\n"
+       "Maximum bytes queued for the collector before the session is reset\n"
+       "Bytes\n")
+
+DEFUN (show_ip_bgp_bmp,
+       show_ip_bgp_bmp_cmd,
+       "show ip bgp bmp",
+       SHOW_STR
+       IP_STR
+       BGP_STR
+       "BGP Monitoring Protocol exporter\n")
+{
+  struct bgp *bgp;
+  struct bmp *bmp;
+  char buf[SU_ADDRSTRLEN];
+  char timebuf[BGP_UPTIME_LEN];
+
+  bgp = bgp_get_default ();
+  if (bgp == NULL || bgp->bmp == NULL)
+    {
+      vty_out (vty, "No BMP collector configured%s", VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+  bmp = bgp->bmp;
+
+  vty_out (vty, "BMP collector %s port %u, state %s",
+	   sockunion2str (&bmp->su, buf, sizeof buf), bmp->port,
+	   bmp_state_str[bmp->state]);
+  if (bmp->state == BMP_UP)
+    vty_out (vty, ", up for %s",
+	     peer_uptime (bmp->uptime, timebuf, BGP_UPTIME_LEN));
+  vty_out (vty, "%s", VTY_NEWLINE);
+
+  vty_out (vty, "  Sessions established %lu, queue overflows %lu%s",
+	   bmp->connects, bmp->drops, VTY_NEWLINE);
+  vty_out (vty, "  Messages sent %lu, bytes sent %lu%s",
+	   bmp->msgs, bmp->bytes, VTY_NEWLINE);
+  vty_out (vty, "  Output queue %lu messages, %lu bytes, limit %lu bytes%s",
+	   (unsigned long) bmp->obuf->count, (unsigned long) bmp->obuf_bytes,
+	   (unsigned long) bmp->queue_limit, VTY_NEWLINE);
+  if (bmp->stats_interval)
+    vty_out (vty, "  Statistics reports every %d seconds%s",
+	     bmp->stats_interval, VTY_NEWLINE);
+  else
+    vty_out (vty, "  Statistics reports disabled%s", VTY_NEWLINE);
+  if (bmp->state == BMP_UP)
+    vty_out (vty, "  Initial table dump %s%s",
+	     bmp->dump_afi < AFI_MAX ? "in progress" : "complete",
+	     VTY_NEWLINE);
+
+  return CMD_SUCCESS;
+}
+
+int
+bgp_config_write_bmp (struct vty *vty, struct bgp *bgp)
+{
+  struct bmp *bmp = bgp->bmp;
+  char buf[SU_ADDRSTRLEN];
+
+  if (! bmp)
+    return 0;
+
+  vty_out (vty, " bmp collector %s port %u%s",
+	   sockunion2str (&bmp->su, buf, sizeof buf), bmp->port,
+	   VTY_NEWLINE);
+  if (bmp->stats_interval != BMP_DEFAULT_STATS_INTERVAL)
+    vty_out (vty, " bmp stats-interval %d%s", bmp->stats_interval,
+	     VTY_NEWLINE);
+  if (bmp->queue_limit != BMP_DEFAULT_QUEUE_LIMIT)
+    vty_out (vty, " bmp queue-limit %lu%s",
+	     (unsigned long) bmp->queue_limit, VTY_NEWLINE);
+
+  return 1;
+}
+
+void
+bgp_bmp_init (void)
+{
+  bmp_work = stream_new (BMP_HEADER_SIZE + BMP_PEER_HEADER_SIZE
+			 + BGP_MAX_PACKET_SIZE);
+
+  install_element (BGP_NODE, &bmp_collector_cmd);
+  install_element (BGP_NODE, &no_bmp_collector_cmd);
+  install_element (BGP_NODE, &no_bmp_collector_val_cmd);
+  install_element (BGP_NODE, &bmp_stats_interval_cmd);
+  install_element (BGP_NODE, &no_bmp_stats_interval_cmd);
+  install_element (BGP_NODE, &no_bmp_stats_interval_val_cmd);
+  install_element (BGP_NODE, &bmp_queue_limit_cmd);
+  install_element (BGP_NODE, &no_bmp_queue_limit_cmd);
+  install_element (BGP_NODE, &no_bmp_queue_limit_val_cmd);
+
+  install_element (VIEW_NODE, &show_ip_bgp_bmp_cmd);
+  install_element (ENABLE_NODE, &show_ip_bgp_bmp_cmd);
+}
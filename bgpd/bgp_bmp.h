@@ -0,0 +1,79 @@
+/* BGP Monitoring Protocol (RFC 7854) exporter.
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#ifndef _QUAGGA_BGP_BMP_H
+#define _QUAGGA_BGP_BMP_H
+
+#define BMP_VERSION                      3
+
+/* BMP message types.  */
+#define BMP_MSG_ROUTE_MONITORING         0
+#define BMP_MSG_STATISTICS_REPORT        1
+#define BMP_MSG_PEER_DOWN                2
+#define BMP_MSG_PEER_UP                  3
+#define BMP_MSG_INITIATION               4
+#define BMP_MSG_TERMINATION              5
+
+/* Common header and per-peer header sizes.  */
+#define BMP_HEADER_SIZE                  6
+#define BMP_PEER_HEADER_SIZE            42
+
+/* Per-peer header flags.  */
+#define BMP_PEER_FLAG_V               0x80
+#define BMP_PEER_FLAG_L               0x40
+#define BMP_PEER_FLAG_A               0x20
+
+/* Peer types.  */
+#define BMP_PEER_TYPE_GLOBAL             0
+
+/* Initiation and termination information TLV types.  */
+#define BMP_INFO_STRING                  0
+#define BMP_INFO_SYS_DESCR               1
+#define BMP_INFO_SYS_NAME                2
+#define BMP_TERM_REASON                  1
+
+/* Termination reasons.  */
+#define BMP_TERM_ADMIN_CLOSE             0
+#define BMP_TERM_OUT_OF_RESOURCES        2
+
+/* Peer down reasons.  */
+#define BMP_PEERDOWN_LOCAL_NOTIFY        1
+#define BMP_PEERDOWN_LOCAL_FSM           2
+#define BMP_PEERDOWN_REMOTE_NOTIFY       3
+#define BMP_PEERDOWN_REMOTE_NODATA       4
+
+/* Statistics types.  */
+#define BMP_STAT_ADJ_RIB_IN              7
+#define BMP_STAT_AF_ADJ_RIB_IN           8
+
+/* Default values.  */
+#define BMP_DEFAULT_QUEUE_LIMIT    4194304
+#define BMP_DEFAULT_STATS_INTERVAL      60
+#define BMP_RECONNECT_TIME              30
+#define BMP_DUMP_BATCH                 256
+
+extern void bgp_bmp_init (void);
+extern void bgp_bmp_delete (struct bgp *);
+extern void bgp_bmp_peer_up (struct peer *);
+extern void bgp_bmp_peer_down (struct peer *);
+extern void bgp_bmp_route_monitor (struct peer *, afi_t, safi_t,
+				   struct prefix *, struct attr *, int);
+extern int bgp_config_write_bmp (struct vty *, struct bgp *);
+
+#endif /* _QUAGGA_BGP_BMP_H */
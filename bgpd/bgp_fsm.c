@@ -40,6 +40,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_dump.h"
 #include "bgpd/bgp_open.h"
+#include "bgpd/bgp_bmp.h"
 #ifdef HAVE_SNMP
 #include "bgpd/bgp_snmp.h"
 #endif /* HAVE_SNMP */
@@ -455,6 +456,8 @@ bgp_stop (struct peer *peer)
 	zlog_info ("%%ADJCHANGE: neighbor %s Down %s", peer->host,
                    peer_down_str [(int) peer->last_reset]);
 
+      bgp_bmp_peer_down (peer);
+
       /* graceful restart */
       if (peer->t_gr_stale)
 	{
@@ -464,6 +467,9 @@ bgp_stop (struct peer *peer)
 	}
       if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT))
 	{
+	  /* Everything learnt so far is now stale. */
+	  peer->gr_gen++;
+
 	  if (BGP_DEBUG (events, EVENTS))
 	    {
 	      zlog_debug ("%s graceful restart timer started for %d sec",
@@ -796,6 +802,8 @@ bgp_establish (struct peer *peer)
   if (bgp_flag_check (peer->bgp, BGP_FLAG_LOG_NEIGHBOR_CHANGES))
     zlog_info ("%%ADJCHANGE: neighbor %s Up", peer->host);
 
+  bgp_bmp_peer_up (peer);
+
   /* graceful restart */
   UNSET_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT);
   for (afi = AFI_IP ; afi < AFI_MAX ; afi++)
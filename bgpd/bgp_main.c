@@ -32,6 +32,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "privs.h"
 #include "sigevent.h"
 #include "zclient.h"
+#include "zring.h"
 #include "routemap.h"
 #include "filter.h"
 #include "plist.h"
@@ -61,6 +62,7 @@ static const struct option longopts[] =
   { "vty_port",    required_argument, NULL, 'P'},
   { "retain",      no_argument,       NULL, 'r'},
   { "no_kernel",   no_argument,       NULL, 'n'},
+  { "zebra_ring",  no_argument,       NULL, 'R'},
   { "user",        required_argument, NULL, 'u'},
   { "group",       required_argument, NULL, 'g'},
   { "version",     no_argument,       NULL, 'v'},
@@ -102,6 +104,9 @@ char config_default[] = SYSCONFDIR BGP_DEFAULT_CONFIG;
 /* Route retain mode flag. */
 static int retain_mode = 0;
 
+/* Offer zebra a shared memory ring to read the messages of bgpd from. */
+static int zebra_ring = 0;
+
 /* Master of threads. */
 struct thread_master *master;
 
@@ -157,6 +162,7 @@ Daemon which manages BGP.\n\n\
 -P, --vty_port     Set vty's port number\n\
 -r, --retain       When program terminates, retain added route by bgpd.\n\
 -n, --no_kernel    Do not install route to kernel.\n\
+-R, --zebra_ring   Write to zebra through shared memory, where supported\n\
 -u, --user         User to run as\n\
 -g, --group        Group to run as\n\
 -v, --version      Print program version\n\
@@ -338,7 +344,7 @@ main (int argc, char **argv)
   /* Command line argument treatment. */
   while (1) 
     {
-      opt = getopt_long (argc, argv, "df:i:z:hp:l:A:P:rnu:g:vC", longopts, 0);
+      opt = getopt_long (argc, argv, "df:i:z:hp:l:A:P:rnRu:g:vC", longopts, 0);
     
       if (opt == EOF)
 	break;
@@ -390,6 +396,9 @@ main (int argc, char **argv)
 	case 'n':
 	  bgp_option_set (BGP_OPT_NO_FIB);
 	  break;
+	case 'R':
+	  zebra_ring = 1;
+	  break;
 	case 'u':
 	  bgpd_privs.user = optarg;
 	  break;
@@ -425,6 +434,11 @@ main (int argc, char **argv)
 
   /* BGP related initialization.  */
   bgp_init ();
+  if (zebra_ring)
+    {
+      extern struct zclient *zclient;
+      zclient->ring_size = ZRING_SIZE_DEFAULT;
+    }
 
   /* Sort CLI commands. */
   sort_node ();
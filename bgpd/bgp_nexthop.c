@@ -37,6 +37,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_nexthop.h"
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_damp.h"
+#include "bgpd/bgp_zebra.h"
 #include "zebra/rib.h"
 #include "zebra/zserv.h"	/* For ZEBRA_SERV_PATH. */
 
@@ -598,6 +599,7 @@ bgp_scan (afi_t afi, safi_t safi)
                      * and reinstalled using freshly resolved IGP gateway.
                      */
                     SET_FLAG (bi->flags, BGP_INFO_IGP_CHANGED);
+                    bgp_zebra_nhg_scan (bi, 1);
                     goto nextprefix;
                   }
 
@@ -614,6 +616,9 @@ bgp_scan (afi_t afi, safi_t safi)
 	      else
 		UNSET_FLAG (bi->flags, BGP_INFO_IGP_CHANGED);
 
+	      if (afi == AFI_IP)
+		bgp_zebra_nhg_scan (bi, changed);
+
 	      if (valid != current)
 		{
 		  if (CHECK_FLAG (bi->flags, BGP_INFO_VALID))
@@ -645,6 +650,7 @@ nextprefix: ;
   bgp_nexthop_cache_reset (bnct_inactive (afi));
   if (afi == AFI_IP)
     {
+      bgp_zebra_nhg_scan_done ();
       for (dprn = route_top (desyncpfxs); dprn; dprn = route_next (dprn))
         dprn->info = NULL;
       route_table_finish (desyncpfxs);
@@ -534,7 +534,7 @@ bgp_write_packet (struct peer *peer)
 	      {
 		if (CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_RCV)
 		    && CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_ADV)
-		    && ! CHECK_FLAG (adv->binfo->flags, BGP_INFO_STALE)
+		    && ! BGP_INFO_IS_STALE (adv->binfo)
 		    && safi != SAFI_MPLS_VPN)
 		  {
 		    if (CHECK_FLAG (adv->binfo->peer->af_sflags[afi][safi],
@@ -54,6 +54,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_advertise.h"
 #include "bgpd/bgp_zebra.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_bmp.h"
 
 /* Extern from bgp_dump.c */
 extern const char *bgp_origin_str[];
@@ -192,6 +193,9 @@ bgp_info_add (struct bgp_node *rn, struct bgp_info *ri)
   if (top)
     top->prev = ri;
   rn->info = ri;
+
+  ri->net = rn;
+  BGP_PEER_LIST_ADD (ri->peer->paths[rn->table->afi][rn->table->safi], ri);
   
   bgp_info_lock (ri);
   bgp_lock_node (rn);
@@ -209,6 +213,8 @@ bgp_info_reap (struct bgp_node *rn, struct bgp_info *ri)
     ri->prev->next = ri->next;
   else
     rn->info = ri->next;
+
+  BGP_PEER_LIST_DEL (ri->peer->paths[rn->table->afi][rn->table->safi], ri);
   
   bgp_info_unlock (ri);
   bgp_unlock_node (rn);
@@ -1485,7 +1491,10 @@ bgp_process_main (struct work_queue *wq, void *data)
     {
       if (! CHECK_FLAG (old_select->flags, BGP_INFO_ATTR_CHANGED))
         {
-          if (CHECK_FLAG (old_select->flags, BGP_INFO_IGP_CHANGED))
+          /* Routes following a zebra nexthop group were updated
+             along with the group by the nexthop scan.  */
+          if (CHECK_FLAG (old_select->flags, BGP_INFO_IGP_CHANGED)
+              && ! bgp_zebra_nhg_covers (p, old_select, safi))
             bgp_zebra_announce (p, old_select, bgp, safi);
           
           UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
@@ -1825,6 +1834,7 @@ bgp_update_rsclient (struct peer *rsclient, afi_t afi, safi_t safi,
   if (ri)
     {
       ri->uptime = bgp_clock ();
+      ri->gr_gen = peer->gr_gen;
 
       /* Same attribute comes in. */
       if (!CHECK_FLAG(ri->flags, BGP_INFO_REMOVED)
@@ -1893,6 +1903,7 @@ bgp_update_rsclient (struct peer *rsclient, afi_t afi, safi_t safi,
   new->peer = peer;
   new->attr = attr_new;
   new->uptime = bgp_clock ();
+  new->gr_gen = peer->gr_gen;
 
   /* Update MPLS tag. */
   if (safi == SAFI_MPLS_VPN)
@@ -1991,6 +2002,10 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
       && peer != bgp->peer_self && ! soft_reconfig)
     bgp_adj_in_set (rn, peer, attr);
 
+  /* Export pre-policy Adj-RIB-In.  */
+  if (! soft_reconfig)
+    bgp_bmp_route_monitor (peer, afi, safi, p, attr, 0);
+
   /* Check previously received route. */
   for (ri = rn->info; ri; ri = ri->next)
     if (ri->peer == peer && ri->type == type && ri->sub_type == sub_type)
@@ -2091,6 +2106,8 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	      && peer_sort (peer) == BGP_PEER_EBGP
 	      && CHECK_FLAG (ri->flags, BGP_INFO_HISTORY))
 	    {
+	      ri->gr_gen = peer->gr_gen;
+
 	      if (BGP_DEBUG (update, UPDATE_IN))  
 		  zlog (peer->log, LOG_DEBUG, "%s rcvd %s/%d",
 		  peer->host,
@@ -2112,10 +2129,10 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 		inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN),
 		p->prefixlen);
 
-	      /* graceful restart STALE flag unset. */
-	      if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
+	      /* graceful restart, refreshed path is no longer stale. */
+	      if (BGP_INFO_IS_STALE (ri))
 		{
-		  bgp_info_unset_flag (rn, ri, BGP_INFO_STALE);
+		  ri->gr_gen = peer->gr_gen;
 		  bgp_process (bgp, rn, afi, safi);
 		}
 	    }
@@ -2127,6 +2144,9 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	  return 0;
 	}
 
+      /* Export post-policy Adj-RIB-In.  */
+      bgp_bmp_route_monitor (peer, afi, safi, p, attr_new, 1);
+
       /* Withdraw/Announce before we fully processed the withdraw */
       if (CHECK_FLAG(ri->flags, BGP_INFO_REMOVED))
         {
@@ -2145,9 +2165,8 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	      inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN),
 	      p->prefixlen);
 
-      /* graceful restart STALE flag unset. */
-      if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
-	bgp_info_unset_flag (rn, ri, BGP_INFO_STALE);
+      /* graceful restart, refreshed path is no longer stale. */
+      ri->gr_gen = peer->gr_gen;
 
       /* The attribute is changed. */
       bgp_info_set_flag (rn, ri, BGP_INFO_ATTR_CHANGED);
@@ -2224,6 +2243,9 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	    p->prefixlen);
     }
 
+  /* Export post-policy Adj-RIB-In.  */
+  bgp_bmp_route_monitor (peer, afi, safi, p, attr_new, 1);
+
   /* Make new BGP info. */
   new = bgp_info_new ();
   new->type = type;
@@ -2231,6 +2253,7 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
   new->peer = peer;
   new->attr = attr_new;
   new->uptime = bgp_clock ();
+  new->gr_gen = peer->gr_gen;
 
   /* Update MPLS tag. */
   if (safi == SAFI_MPLS_VPN)
@@ -2284,7 +2307,10 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	  p->prefixlen, reason);
 
   if (ri)
-    bgp_rib_remove (rn, ri, peer, afi, safi);
+    {
+      bgp_bmp_route_monitor (peer, afi, safi, p, NULL, 1);
+      bgp_rib_remove (rn, ri, peer, afi, safi);
+    }
 
   bgp_unlock_node (rn);
   
@@ -2356,6 +2382,8 @@ bgp_withdraw (struct peer *peer, struct prefix *p, struct attr *attr,
       && peer != bgp->peer_self)
     bgp_adj_in_unset (rn, peer);
 
+  bgp_bmp_route_monitor (peer, afi, safi, p, NULL, 0);
+
   /* Lookup withdrawn route. */
   for (ri = rn->info; ri; ri = ri->next)
     if (ri->peer == peer && ri->type == type && ri->sub_type == sub_type)
@@ -2363,7 +2391,10 @@ bgp_withdraw (struct peer *peer, struct prefix *p, struct attr *attr,
 
   /* Withdraw specified route from routing table. */
   if (ri && ! CHECK_FLAG (ri->flags, BGP_INFO_HISTORY))
-    bgp_rib_withdraw (rn, ri, peer, afi, safi);
+    {
+      bgp_bmp_route_monitor (peer, afi, safi, p, NULL, 1);
+      bgp_rib_withdraw (rn, ri, peer, afi, safi);
+    }
   else if (BGP_DEBUG (update, UPDATE_IN))
     zlog (peer->log, LOG_DEBUG, 
 	  "%s Can't find the route %s/%d", peer->host,
@@ -2566,51 +2597,24 @@ bgp_soft_reconfig_rsclient (struct peer *rsclient, afi_t afi, safi_t safi)
         bgp_soft_reconfig_table_rsclient (rsclient, afi, safi, table);
 }
 
-static void
-bgp_soft_reconfig_table (struct peer *peer, afi_t afi, safi_t safi,
-			 struct bgp_table *table)
-{
-  int ret;
-  struct bgp_node *rn;
-  struct bgp_adj_in *ain;
-
-  if (! table)
-    table = peer->bgp->rib[afi][safi];
-
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain; ain = ain->next)
-      {
-	if (ain->peer == peer)
-	  {
-	    ret = bgp_update (peer, &rn->p, ain->attr, afi, safi,
-			      ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
-			      NULL, NULL, 1);
-	    if (ret < 0)
-	      {
-		bgp_unlock_node (rn);
-		return;
-	      }
-	    continue;
-	  }
-      }
-}
-
 void
 bgp_soft_reconfig_in (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_node *rn;
-  struct bgp_table *table;
+  int ret;
+  struct bgp_adj_in *ain;
 
   if (peer->status != Established)
     return;
 
-  if (safi != SAFI_MPLS_VPN)
-    bgp_soft_reconfig_table (peer, afi, safi, NULL);
-  else
-    for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
-	 rn = bgp_route_next (rn))
-      if ((table = rn->info) != NULL)
-	bgp_soft_reconfig_table (peer, afi, safi, table);
+  /* Updates with soft_reconfig set leave the Adj-RIB-In alone, unless
+     the peer gets shut down, in which case we stop.  */
+  for (ain = peer->adj_in[afi][safi]; ain; ain = ain->peer_next)
+    {
+      ret = bgp_update (peer, &ain->rn->p, ain->attr, afi, safi,
+			ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL, 1);
+      if (ret < 0)
+	return;
+    }
 }
 
 
@@ -2635,14 +2639,7 @@ bgp_clear_route_node (struct work_queue *wq, void *data)
   for (ri = rn->info; ri; ri = ri->next)
     if (ri->peer == peer || cnq->purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
       {
-        /* graceful restart STALE flag set. */
-        if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT)
-            && peer->nsf[afi][safi]
-            && ! CHECK_FLAG (ri->flags, BGP_INFO_STALE)
-            && ! CHECK_FLAG (ri->flags, BGP_INFO_UNUSEABLE))
-          bgp_info_set_flag (rn, ri, BGP_INFO_STALE);
-        else
-          bgp_rib_remove (rn, ri, peer, afi, safi);
+        bgp_rib_remove (rn, ri, peer, afi, safi);
         break;
       }
   return WQ_SUCCESS;
@@ -2694,104 +2691,95 @@ bgp_clear_node_queue_init (struct peer *peer)
   peer->clear_node_queue->spec.data = peer;
 }
 
+/* Queue a node for bgp_clear_route_node.  */
+static void
+bgp_clear_node_queue_add (struct peer *peer, struct bgp_node *rn,
+                          enum bgp_clear_route_type purpose)
+{
+  struct bgp_clear_node_queue *cnq;
+
+  /* both unlocked in bgp_clear_node_queue_del */
+  bgp_table_lock (rn->table);
+  bgp_lock_node (rn);
+  cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
+                 sizeof (struct bgp_clear_node_queue));
+  cnq->rn = rn;
+  cnq->purpose = purpose;
+  work_queue_add (peer->clear_node_queue, cnq);
+}
+
+/* Clear a peer's paths and adjacencies from every table of an AFI/SAFI,
+ * through the peer's own lists of them.  Only the nodes the peer
+ * actually has state in are visited.
+ */
+static void
+bgp_clear_route_peer (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_info *ri;
+  struct bgp_adj_in *ain;
+  struct bgp_adj_out *aout;
+  struct bgp_node *rn;
+
+  /* Paths retained over a graceful restart need no visit, bgp_stop has
+   * already made them stale by moving the peer on to a new generation.
+   */
+  if (! (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT)
+         && peer->nsf[afi][safi]))
+    for (ri = peer->paths[afi][safi]; ri; ri = ri->peer_next)
+      bgp_clear_node_queue_add (peer, ri->net, BGP_CLEAR_ROUTE_NORMAL);
+
+  while ((ain = peer->adj_in[afi][safi]) != NULL)
+    {
+      rn = ain->rn;
+      bgp_adj_in_remove (rn, ain);
+      bgp_unlock_node (rn);
+    }
+
+  while ((aout = peer->adj_out[afi][safi]) != NULL)
+    {
+      rn = aout->rn;
+      bgp_adj_out_remove (rn, aout, peer, afi, safi);
+      bgp_unlock_node (rn);
+    }
+}
+
+/* Clear everything from a route server client's own table.  */
 static void
 bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
-                       struct bgp_table *table, struct peer *rsclient,
-                       enum bgp_clear_route_type purpose)
+                       struct bgp_table *table)
 {
   struct bgp_node *rn;
+  struct bgp_adj_in *ain;
+  struct bgp_adj_out *aout;
   
-  
-  if (! table)
-    table = (rsclient) ? rsclient->rib[afi][safi] : peer->bgp->rib[afi][safi];
-  
-  /* If still no table => afi/safi isn't configured at all or smth. */
+  /* If no table => afi/safi isn't configured at all or smth. */
   if (! table)
     return;
   
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
     {
-      struct bgp_info *ri;
-      struct bgp_adj_in *ain;
-      struct bgp_adj_out *aout;
-      
       if (rn->info == NULL)
         continue;
 
-      /* XXX:TODO: This is suboptimal, every non-empty route_node is
-       * queued for every clearing peer, regardless of whether it is
-       * relevant to the peer at hand.
-       *
-       * Overview: There are 3 different indices which need to be
-       * scrubbed, potentially, when a peer is removed:
-       *
-       * 1 peer's routes visible via the RIB (ie accepted routes)
-       * 2 peer's routes visible by the (optional) peer's adj-in index
-       * 3 other routes visible by the peer's adj-out index
-       *
-       * 3 there is no hurry in scrubbing, once the struct peer is
-       * removed from bgp->peer, we could just GC such deleted peer's
-       * adj-outs at our leisure.
-       *
-       * 1 and 2 must be 'scrubbed' in some way, at least made
-       * invisible via RIB index before peer session is allowed to be
-       * brought back up. So one needs to know when such a 'search' is
-       * complete.
-       *
-       * Ideally:
-       *
-       * - there'd be a single global queue or a single RIB walker
-       * - rather than tracking which route_nodes still need to be
-       *   examined on a peer basis, we'd track which peers still
-       *   aren't cleared
-       *
-       * Given that our per-peer prefix-counts now should be reliable,
-       * this may actually be achievable. It doesn't seem to be a huge
-       * problem at this time,
-       */
-      for (ri = rn->info; ri; ri = ri->next)
-        if (ri->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
-          {
-            struct bgp_clear_node_queue *cnq;
-
-            /* both unlocked in bgp_clear_node_queue_del */
-            bgp_table_lock (rn->table);
-            bgp_lock_node (rn);
-            cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
-                           sizeof (struct bgp_clear_node_queue));
-            cnq->rn = rn;
-            cnq->purpose = purpose;
-            work_queue_add (peer->clear_node_queue, cnq);
-            break;
-          }
+      bgp_clear_node_queue_add (peer, rn, BGP_CLEAR_ROUTE_MY_RSCLIENT);
 
-      for (ain = rn->adj_in; ain; ain = ain->next)
-        if (ain->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
-          {
-            bgp_adj_in_remove (rn, ain);
-            bgp_unlock_node (rn);
-            break;
-          }
-      for (aout = rn->adj_out; aout; aout = aout->next)
-        if (aout->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
-          {
-            bgp_adj_out_remove (rn, aout, peer, afi, safi);
-            bgp_unlock_node (rn);
-            break;
-          }
+      if ((ain = rn->adj_in) != NULL)
+        {
+          bgp_adj_in_remove (rn, ain);
+          bgp_unlock_node (rn);
+        }
+      if ((aout = rn->adj_out) != NULL)
+        {
+          bgp_adj_out_remove (rn, aout, aout->peer, afi, safi);
+          bgp_unlock_node (rn);
+        }
     }
-  return;
 }
 
 void
 bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi,
                  enum bgp_clear_route_type purpose)
 {
-  struct bgp_node *rn;
-  struct bgp_table *table;
-  struct peer *rsclient;
-  struct listnode *node, *nnode;
-
   if (peer->clear_node_queue == NULL)
     bgp_clear_node_queue_init (peer);
   
@@ -2813,22 +2801,12 @@ bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi,
   switch (purpose)
     {
     case BGP_CLEAR_ROUTE_NORMAL:
-      if (safi != SAFI_MPLS_VPN)
-        bgp_clear_route_table (peer, afi, safi, NULL, NULL, purpose);
-      else
-        for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
-             rn = bgp_route_next (rn))
-          if ((table = rn->info) != NULL)
-            bgp_clear_route_table (peer, afi, safi, table, NULL, purpose);
-
-      for (ALL_LIST_ELEMENTS (peer->bgp->rsclient, node, nnode, rsclient))
-        if (CHECK_FLAG(rsclient->af_flags[afi][safi],
-                       PEER_FLAG_RSERVER_CLIENT))
-          bgp_clear_route_table (peer, afi, safi, NULL, rsclient, purpose);
+      /* Covers MPLS VPN sub-tables and route server client tables. */
+      bgp_clear_route_peer (peer, afi, safi);
       break;
 
     case BGP_CLEAR_ROUTE_MY_RSCLIENT:
-      bgp_clear_route_table (peer, afi, safi, NULL, peer, purpose);
+      bgp_clear_route_table (peer, afi, safi, peer->rib[afi][safi]);
       break;
 
     default:
@@ -2838,8 +2816,6 @@ bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi,
   
   /* If no routes were cleared, nothing was added to workqueue, the
    * completion function won't be run by workqueue code - call it here. 
-   * XXX: Actually, this assumption doesn't hold, see
-   * bgp_clear_route_table(), we queue all non-empty nodes.
    *
    * Additionally, there is a presumption in FSM that clearing is only
    * really needed if peer state is Established - peers in
@@ -2873,41 +2849,142 @@ bgp_clear_route_all (struct peer *peer)
 void
 bgp_clear_adj_in (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_table *table;
   struct bgp_node *rn;
   struct bgp_adj_in *ain;
 
-  table = peer->bgp->rib[afi][safi];
+  while ((ain = peer->adj_in[afi][safi]) != NULL)
+    {
+      rn = ain->rn;
+      bgp_adj_in_remove (rn, ain);
+      bgp_unlock_node (rn);
+    }
+}
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain ; ain = ain->next)
-      if (ain->peer == peer)
-	{
-          bgp_adj_in_remove (rn, ain);
-          bgp_unlock_node (rn);
-          break;
-	}
+/* Remove paths older than the sweep's generation from a batch of
+ * nodes, then let the work queue decide whether to carry on or yield.
+ * Paths the peer sends while the sweep is running carry the current
+ * generation and are left alone, wherever the sweep happens to be.
+ */
+static wq_item_status
+bgp_stale_sweep_node (struct work_queue *wq, void *data)
+{
+  struct bgp_stale_sweep *sweep = data;
+  struct peer *peer = wq->spec.data;
+  struct bgp_info *ri;
+  int count = 0;
+
+  while (sweep->rn && count++ < BGP_STALE_SWEEP_BATCH)
+    {
+      for (ri = sweep->rn->info; ri; ri = ri->next)
+	if (ri->peer == peer)
+	  {
+	    if ((int32_t) (ri->gr_gen - sweep->gr_gen) < 0
+		&& ! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+	      {
+		bgp_rib_remove (sweep->rn, ri, peer, sweep->afi, sweep->safi);
+		sweep->removed++;
+	      }
+	    break;
+	  }
+      sweep->scanned++;
+      sweep->rn = bgp_route_next (sweep->rn);
+    }
+
+  return sweep->rn ? WQ_REQUEUE : WQ_SUCCESS;
+}
+
+static void
+bgp_stale_sweep_del (struct work_queue *wq, void *data)
+{
+  struct bgp_stale_sweep *sweep = data;
+  struct peer *peer = wq->spec.data;
+
+  if (BGP_DEBUG (events, EVENTS))
+    zlog_debug ("%s afi %d safi %d stale path sweep done, %lu paths removed",
+		peer->host, sweep->afi, sweep->safi, sweep->removed);
+
+  if (sweep->rn)
+    bgp_unlock_node (sweep->rn);
+  bgp_table_unlock (sweep->table);
+
+  peer->stale_swept += sweep->removed;
+  peer->stale_sweep[sweep->afi][sweep->safi] = NULL;
+  XFREE (MTYPE_BGP_STALE_SWEEP, sweep);
+}
+
+static void
+bgp_stale_sweep_complete (struct work_queue *wq)
+{
+  struct peer *peer = wq->spec.data;
+
+  peer_unlock (peer); /* bgp_clear_stale_route */
 }
 
+static void
+bgp_stale_sweep_queue_init (struct peer *peer)
+{
+  char wname[sizeof("stale xxxx:xxxx:xxxx:xxxx:xxxx:xxxx:xxxx:xxxx")];
+
+  snprintf (wname, sizeof(wname), "stale %s", peer->host);
+
+  if ( (peer->stale_sweep_queue = work_queue_new (bm->master, wname)) == NULL)
+    {
+      zlog_err ("%s: Failed to allocate work queue", __func__);
+      exit (1);
+    }
+  peer->stale_sweep_queue->spec.hold = 10;
+  peer->stale_sweep_queue->spec.workfunc = &bgp_stale_sweep_node;
+  peer->stale_sweep_queue->spec.del_item_data = &bgp_stale_sweep_del;
+  peer->stale_sweep_queue->spec.completion_func = &bgp_stale_sweep_complete;
+  peer->stale_sweep_queue->spec.max_retries = 0;
+
+  /* locked only while the queue is active */
+  peer->stale_sweep_queue->spec.data = peer;
+}
+
+/* Start removing the peer's stale paths from a table.  The sweep is
+ * done in the background by the peer's stale_sweep_queue.
+ */
 void
 bgp_clear_stale_route (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_node *rn;
-  struct bgp_info *ri;
+  struct bgp_stale_sweep *sweep;
   struct bgp_table *table;
 
   table = peer->bgp->rib[afi][safi];
+  if (! table)
+    return;
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+  if (peer->stale_sweep_queue == NULL)
+    bgp_stale_sweep_queue_init (peer);
+
+  sweep = peer->stale_sweep[afi][safi];
+  if (sweep)
     {
-      for (ri = rn->info; ri; ri = ri->next)
-	if (ri->peer == peer)
-	  {
-	    if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
-	      bgp_rib_remove (rn, ri, peer, afi, safi);
-	    break;
-	  }
+      /* Nodes already visited may hold paths of the generation the
+         sweep was keeping, start over. */
+      if (sweep->gr_gen == peer->gr_gen)
+	return;
+      if (sweep->rn)
+	bgp_unlock_node (sweep->rn);
     }
+  else
+    {
+      sweep = XCALLOC (MTYPE_BGP_STALE_SWEEP, sizeof (struct bgp_stale_sweep));
+      sweep->afi = afi;
+      sweep->safi = safi;
+      sweep->table = table;
+      bgp_table_lock (table);
+      peer->stale_sweep[afi][safi] = sweep;
+
+      if (! peer->stale_sweep_queue->thread)
+	peer_lock (peer); /* bgp_stale_sweep_complete */
+      work_queue_add (peer->stale_sweep_queue, sweep);
+    }
+
+  sweep->gr_gen = peer->gr_gen;
+  sweep->rn = bgp_table_top (table);
+  sweep->scanned = 0;
 }
 
 /* Delete all kernel routes. */
@@ -5466,7 +5543,7 @@ route_vty_short_status_out (struct vty *vty, struct bgp_info *binfo)
  /* Route status display. */
   if (CHECK_FLAG (binfo->flags, BGP_INFO_REMOVED))
     vty_out (vty, "R");
-  else if (CHECK_FLAG (binfo->flags, BGP_INFO_STALE))
+  else if (BGP_INFO_IS_STALE (binfo))
     vty_out (vty, "S");
   else if (binfo->extra && binfo->extra->suppress)
     vty_out (vty, "s");
@@ -5814,7 +5891,7 @@ route_vty_out_detail (struct vty *vty, struct bgp *bgp, struct prefix *p,
 
       if (CHECK_FLAG (binfo->flags, BGP_INFO_REMOVED))
         vty_out (vty, ", (removed)");
-      if (CHECK_FLAG (binfo->flags, BGP_INFO_STALE))
+      if (BGP_INFO_IS_STALE (binfo))
 	vty_out (vty, ", (stale)");
       if (CHECK_FLAG (attr->flag, ATTR_FLAG_BIT (BGP_ATTR_AGGREGATOR)))
 	vty_out (vty, ", (aggregated by %u %s)", 
@@ -5997,21 +6074,161 @@ enum bgp_show_type
   bgp_show_type_damp_neighbor
 };
 
+/* Number of table nodes visited per call of bgp_show_table_next(). */
+#define BGP_SHOW_BATCH 256
+
+/* A table walk for a "show ip bgp" command, resumed by the vty each time
+   its output buffer has drained. */
+struct bgp_show_cursor
+{
+  struct bgp_table *table;
+
+  /* Next node to be displayed, locked. */
+  struct bgp_node *rn;
+
+  struct in_addr router_id;
+  enum bgp_show_type type;
+
+  /* Filter argument, kept in a form which outlives the command. */
+  void *output_arg;
+  struct prefix prefix;
+  union sockunion su;
+
+  /* Adj-RIB display. */
+  struct peer *peer;
+  safi_t safi;
+  int in;
+  int header2;
+
+  /* Nodes holding the peer's adjacencies, in table order, locked.  */
+  struct bgp_node **nodes;
+  unsigned long nodes_count;
+  unsigned long nodes_next;
+
+  int header;
+  unsigned long output_count;
+};
+
+/* Release a filter argument whose ownership was passed to bgp_show(). */
+static void
+bgp_show_arg_free (enum bgp_show_type type, void *output_arg)
+{
+  switch (type)
+    {
+    case bgp_show_type_regexp:
+    case bgp_show_type_flap_regexp:
+      bgp_regex_free (output_arg);
+      break;
+    case bgp_show_type_community:
+    case bgp_show_type_community_exact:
+      community_free (output_arg);
+      break;
+    case bgp_show_type_prefix_list:
+    case bgp_show_type_flap_prefix_list:
+    case bgp_show_type_filter_list:
+    case bgp_show_type_flap_filter_list:
+    case bgp_show_type_route_map:
+    case bgp_show_type_flap_route_map:
+    case bgp_show_type_community_list:
+    case bgp_show_type_community_list_exact:
+      XFREE (MTYPE_TMP, output_arg);
+      break;
+    default:
+      break;
+    }
+}
+
+static void
+bgp_show_cursor_free (void *arg)
+{
+  struct bgp_show_cursor *bsc = arg;
+
+  if (bsc->rn)
+    bgp_unlock_node (bsc->rn);
+  while (bsc->nodes_next < bsc->nodes_count)
+    bgp_unlock_node (bsc->nodes[bsc->nodes_next++]);
+  if (bsc->nodes)
+    XFREE (MTYPE_BGP_SHOW_CURSOR, bsc->nodes);
+  bgp_table_unlock (bsc->table);
+  if (bsc->peer)
+    peer_unlock (bsc->peer);
+  bgp_show_arg_free (bsc->type, bsc->output_arg);
+  XFREE (MTYPE_BGP_SHOW_CURSOR, bsc);
+}
+
+/* Filters referenced by name are looked up again on every batch, since
+   they may be deleted while output is suspended. */
+static void *
+bgp_show_cursor_arg (struct bgp_show_cursor *bsc)
+{
+  switch (bsc->type)
+    {
+    case bgp_show_type_prefix_list:
+    case bgp_show_type_flap_prefix_list:
+      return prefix_list_lookup (bsc->table->afi, bsc->output_arg);
+    case bgp_show_type_filter_list:
+    case bgp_show_type_flap_filter_list:
+      return as_list_lookup (bsc->output_arg);
+    case bgp_show_type_route_map:
+    case bgp_show_type_flap_route_map:
+      return route_map_lookup_by_name (bsc->output_arg);
+    case bgp_show_type_community_list:
+    case bgp_show_type_community_list_exact:
+      return community_list_lookup (bgp_clist, bsc->output_arg,
+				    COMMUNITY_LIST_MASTER);
+    case bgp_show_type_neighbor:
+    case bgp_show_type_flap_neighbor:
+    case bgp_show_type_damp_neighbor:
+      return &bsc->su;
+    case bgp_show_type_prefix_longer:
+    case bgp_show_type_flap_prefix_longer:
+    case bgp_show_type_flap_address:
+    case bgp_show_type_flap_prefix:
+      return &bsc->prefix;
+    default:
+      return bsc->output_arg;
+    }
+}
+
+static struct bgp_show_cursor *
+bgp_show_cursor_new (struct bgp_table *table, struct in_addr *router_id,
+		     enum bgp_show_type type)
+{
+  struct bgp_show_cursor *bsc;
+
+  bsc = XCALLOC (MTYPE_BGP_SHOW_CURSOR, sizeof (struct bgp_show_cursor));
+  bsc->table = table;
+  bgp_table_lock (table);
+  bsc->rn = bgp_table_top (table);
+  bsc->router_id = *router_id;
+  bsc->type = type;
+  bsc->header = 1;
+
+  return bsc;
+}
+
+/* Display the next batch of routes.  Returns 0 once the walk is done. */
 static int
-bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router_id,
-	  enum bgp_show_type type, void *output_arg)
+bgp_show_table_next (struct vty *vty, void *arg)
 {
+  struct bgp_show_cursor *bsc = arg;
+  enum bgp_show_type type = bsc->type;
+  void *output_arg;
   struct bgp_info *ri;
   struct bgp_node *rn;
-  int header = 1;
   int display;
-  unsigned long output_count;
+  int count;
 
-  /* This is first entry point, so reset total line. */
-  output_count = 0;
+  output_arg = bgp_show_cursor_arg (bsc);
+  if (output_arg == NULL && bsc->output_arg)
+    {
+      vty_out (vty, "%% %s has been deleted%s", (char *) bsc->output_arg,
+	       VTY_NEWLINE);
+      return 0;
+    }
 
-  /* Start processing of routes. */
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn)) 
+  for (rn = bsc->rn, count = 0; rn && count < BGP_SHOW_BATCH;
+       rn = bgp_route_next (rn), count++)
     if (rn->info != NULL)
       {
 	display = 0;
@@ -6162,9 +6379,9 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
 		  continue;
 	      }
 
-	    if (header)
+	    if (bsc->header)
 	      {
-		vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (*router_id), VTY_NEWLINE);
+		vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (bsc->router_id), VTY_NEWLINE);
 		vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
 		vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
 		if (type == bgp_show_type_dampend_paths
@@ -6183,7 +6400,7 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
 		  vty_out (vty, BGP_SHOW_FLAP_HEADER, VTY_NEWLINE);
 		else
 		  vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
-		header = 0;
+		bsc->header = 0;
 	      }
 
 	    if (type == bgp_show_type_dampend_paths
@@ -6205,18 +6422,56 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
 	    display++;
 	  }
 	if (display)
-	  output_count++;
+	  bsc->output_count++;
       }
+  bsc->rn = rn;
+
+  if (rn)
+    return 1;
 
   /* No route is displayed */
-  if (output_count == 0)
+  if (bsc->output_count == 0)
     {
       if (type == bgp_show_type_normal)
 	vty_out (vty, "No BGP network exists%s", VTY_NEWLINE);
     }
   else
     vty_out (vty, "%sTotal number of prefixes %ld%s",
-	     VTY_NEWLINE, output_count, VTY_NEWLINE);
+	     VTY_NEWLINE, bsc->output_count, VTY_NEWLINE);
+
+  return 0;
+}
+
+/* Display a table.  Output is generated as the vty can take it, so the
+   filter argument is either copied, or owned by the walk from here on:
+   a compiled regexp, a community, or the name of a filter to look up. */
+static int
+bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router_id,
+	  enum bgp_show_type type, void *output_arg)
+{
+  struct bgp_show_cursor *bsc;
+
+  bsc = bgp_show_cursor_new (table, router_id, type);
+
+  switch (type)
+    {
+    case bgp_show_type_neighbor:
+    case bgp_show_type_flap_neighbor:
+    case bgp_show_type_damp_neighbor:
+      memcpy (&bsc->su, output_arg, sizeof (union sockunion));
+      break;
+    case bgp_show_type_prefix_longer:
+    case bgp_show_type_flap_prefix_longer:
+    case bgp_show_type_flap_address:
+    case bgp_show_type_flap_prefix:
+      prefix_copy (&bsc->prefix, output_arg);
+      break;
+    default:
+      bsc->output_arg = output_arg;
+      break;
+    }
+
+  vty_output_start (vty, bgp_show_table_next, bgp_show_cursor_free, bsc);
 
   return CMD_SUCCESS;
 }
@@ -6234,6 +6489,7 @@ bgp_show (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
   if (bgp == NULL)
     {
       vty_out (vty, "No BGP process is configured%s", VTY_NEWLINE);
+      bgp_show_arg_free (type, output_arg);
       return CMD_WARNING;
     }
 
@@ -6946,7 +7202,6 @@ bgp_show_regexp (struct vty *vty, int argc, const char **argv, afi_t afi,
   char *regstr;
   int first;
   regex_t *regex;
-  int rc;
   
   first = 0;
   b = buffer_new (1024);
@@ -6977,9 +7232,7 @@ bgp_show_regexp (struct vty *vty, int argc, const char **argv, afi_t afi,
       return CMD_WARNING;
     }
 
-  rc = bgp_show (vty, NULL, afi, safi, type, regex);
-  bgp_regex_free (regex);
-  return rc;
+  return bgp_show (vty, NULL, afi, safi, type, regex);
 }
 
 DEFUN (show_ip_bgp_regexp, 
@@ -7094,7 +7347,8 @@ bgp_show_prefix_list (struct vty *vty, const char *prefix_list_str, afi_t afi,
       return CMD_WARNING;
     }
 
-  return bgp_show (vty, NULL, afi, safi, type, plist);
+  return bgp_show (vty, NULL, afi, safi, type, 
+                   XSTRDUP (MTYPE_TMP, prefix_list_str));
 }
 
 DEFUN (show_ip_bgp_prefix_list, 
@@ -7208,7 +7462,8 @@ bgp_show_filter_list (struct vty *vty, const char *filter, afi_t afi,
       return CMD_WARNING;
     }
 
-  return bgp_show (vty, NULL, afi, safi, type, as_list);
+  return bgp_show (vty, NULL, afi, safi, type, 
+                   XSTRDUP (MTYPE_TMP, filter));
 }
 
 DEFUN (show_ip_bgp_filter_list, 
@@ -7323,7 +7578,8 @@ bgp_show_route_map (struct vty *vty, const char *rmap_str, afi_t afi,
       return CMD_WARNING;
     }
 
-  return bgp_show (vty, NULL, afi, safi, type, rmap);
+  return bgp_show (vty, NULL, afi, safi, type, 
+                   XSTRDUP (MTYPE_TMP, rmap_str));
 }
 
 DEFUN (show_ip_bgp_route_map, 
@@ -8724,7 +8980,8 @@ bgp_show_community_list (struct vty *vty, const char *com, int exact,
 
   return bgp_show (vty, NULL, afi, safi,
                    (exact ? bgp_show_type_community_list_exact :
-		            bgp_show_type_community_list), list);
+		            bgp_show_type_community_list), 
+                   XSTRDUP (MTYPE_TMP, com));
 }
 
 DEFUN (show_ip_bgp_community_list,
@@ -9501,7 +9758,7 @@ bgp_peer_count_walker (struct thread *t)
             pc->count[PCOUNT_HISTORY]++;
           if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
             pc->count[PCOUNT_REMOVED]++;
-          if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
+          if (BGP_INFO_IS_STALE (ri))
             pc->count[PCOUNT_STALE]++;
           if (CHECK_FLAG (ri->flags, BGP_INFO_VALID))
             pc->count[PCOUNT_VALID]++;
@@ -9670,18 +9927,98 @@ DEFUN (show_ip_bgp_vpnv4_neighbor_prefix_counts,
 }
 
 
+/* Display the next batch of a neighbor's Adj-RIB-In or Adj-RIB-Out.
+   Returns 0 once the walk is done. */
+static int
+show_adj_route_next (struct vty *vty, void *arg)
+{
+  struct bgp_show_cursor *bsc = arg;
+  struct peer *peer = bsc->peer;
+  struct bgp_adj_in *ain;
+  struct bgp_adj_out *adj;
+  struct bgp_node *rn;
+  struct attr *attr;
+  int count;
+
+  for (count = 0; bsc->nodes_next < bsc->nodes_count && count < BGP_SHOW_BATCH;
+       count++)
+    {
+      rn = bsc->nodes[bsc->nodes_next++];
+
+      /* The adjacency may have gone while output was suspended. */
+      attr = NULL;
+      if (bsc->in)
+	{
+	  for (ain = rn->adj_in; ain; ain = ain->next)
+	    if (ain->peer == peer)
+	      break;
+	  if (ain)
+	    attr = ain->attr;
+	}
+      else
+	{
+	  for (adj = rn->adj_out; adj; adj = adj->next)
+	    if (adj->peer == peer)
+	      break;
+	  if (adj)
+	    attr = adj->attr;
+	}
+
+      if (attr)
+	{
+	  if (bsc->header)
+	    {
+	      vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (bsc->router_id), VTY_NEWLINE);
+	      vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+	      vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+	      bsc->header = 0;
+	    }
+	  if (bsc->header2)
+	    {
+	      vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
+	      bsc->header2 = 0;
+	    }
+	  route_vty_out_tmp (vty, &rn->p, attr, bsc->safi);
+	  bsc->output_count++;
+	}
+
+      bgp_unlock_node (rn);
+    }
+
+  if (bsc->nodes_next < bsc->nodes_count)
+    return 1;
+
+  if (bsc->output_count != 0)
+    vty_out (vty, "%sTotal number of prefixes %ld%s",
+	     VTY_NEWLINE, bsc->output_count, VTY_NEWLINE);
+
+  return 0;
+}
+
+/* Order nodes of one table the way bgp_route_next visits them. */
+static int
+show_adj_route_cmp (const void *a, const void *b)
+{
+  const struct bgp_node *rn1 = *(struct bgp_node * const *) a;
+  const struct bgp_node *rn2 = *(struct bgp_node * const *) b;
+  int ret;
+
+  ret = memcmp (&rn1->p.u.prefix, &rn2->p.u.prefix, prefix_blen (&rn1->p));
+  if (ret)
+    return ret;
+  return rn1->p.prefixlen - rn2->p.prefixlen;
+}
+
 static void
 show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
 		int in)
 {
+  struct bgp_show_cursor *bsc;
+  struct bgp *bgp;
   struct bgp_table *table;
   struct bgp_adj_in *ain;
   struct bgp_adj_out *adj;
-  unsigned long output_count;
-  struct bgp_node *rn;
-  int header1 = 1;
-  struct bgp *bgp;
-  int header2 = 1;
+  unsigned long count;
 
   bgp = peer->bgp;
 
@@ -9689,9 +10026,53 @@ show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
     return;
 
   table = bgp->rib[afi][safi];
+  bsc = bgp_show_cursor_new (table, &bgp->router_id, bgp_show_type_normal);
+  bsc->peer = peer_lock (peer);
+  bsc->safi = safi;
+  bsc->in = in;
+  bsc->header2 = 1;
+
+  /* Take the nodes from the peer's own lists rather than walking the
+     table, and sort them back into table order. */
+  if (bsc->rn)
+    {
+      bgp_unlock_node (bsc->rn);
+      bsc->rn = NULL;
+    }
+
+  count = 0;
+  if (in)
+    {
+      for (ain = peer->adj_in[afi][safi]; ain; ain = ain->peer_next)
+	count++;
+    }
+  else
+    {
+      for (adj = peer->adj_out[afi][safi]; adj; adj = adj->peer_next)
+	count++;
+    }
+
+  if (count)
+    bsc->nodes = XMALLOC (MTYPE_BGP_SHOW_CURSOR,
+			  count * sizeof (struct bgp_node *));
+
+  if (in)
+    {
+      for (ain = peer->adj_in[afi][safi]; ain; ain = ain->peer_next)
+	if (ain->rn->table == table)
+	  bsc->nodes[bsc->nodes_count++] = bgp_lock_node (ain->rn);
+    }
+  else
+    {
+      for (adj = peer->adj_out[afi][safi]; adj; adj = adj->peer_next)
+	if (adj->rn->table == table)
+	  bsc->nodes[bsc->nodes_count++] = bgp_lock_node (adj->rn);
+    }
+
+  if (bsc->nodes_count > 1)
+    qsort (bsc->nodes, bsc->nodes_count, sizeof (struct bgp_node *),
+	   show_adj_route_cmp);
 
-  output_count = 0;
-	
   if (! in && CHECK_FLAG (peer->af_sflags[afi][safi],
 			  PEER_STATUS_DEFAULT_ORIGINATE))
     {
@@ -9701,62 +10082,10 @@ show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
 
       vty_out (vty, "Originating default network 0.0.0.0%s%s",
 	       VTY_NEWLINE, VTY_NEWLINE);
-      header1 = 0;
+      bsc->header = 0;
     }
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    if (in)
-      {
-	for (ain = rn->adj_in; ain; ain = ain->next)
-	  if (ain->peer == peer)
-	    {
-	      if (header1)
-		{
-		  vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (bgp->router_id), VTY_NEWLINE);
-		  vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-		  vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-		  header1 = 0;
-		}
-	      if (header2)
-		{
-		  vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
-		  header2 = 0;
-		}
-	      if (ain->attr)
-		{ 
-		  route_vty_out_tmp (vty, &rn->p, ain->attr, safi);
-		  output_count++;
-		}
-	    }
-      }
-    else
-      {
-	for (adj = rn->adj_out; adj; adj = adj->next)
-	  if (adj->peer == peer)
-	    {
-	      if (header1)
-		{
-		  vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (bgp->router_id), VTY_NEWLINE);
-		  vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-		  vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-		  header1 = 0;
-		}
-	      if (header2)
-		{
-		  vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
-		  header2 = 0;
-		}
-	      if (adj->attr)
-		{	
-		  route_vty_out_tmp (vty, &rn->p, adj->attr, safi);
-		  output_count++;
-		}
-	    }
-      }
-  
-  if (output_count != 0)
-    vty_out (vty, "%sTotal number of prefixes %ld%s",
-	     VTY_NEWLINE, output_count, VTY_NEWLINE);
+  vty_output_start (vty, show_adj_route_next, bgp_show_cursor_free, bsc);
 }
 
 static int
@@ -73,7 +73,6 @@ struct bgp_info
 #define BGP_INFO_ATTR_CHANGED   (1 << 5)
 #define BGP_INFO_DMED_CHECK     (1 << 6)
 #define BGP_INFO_DMED_SELECTED  (1 << 7)
-#define BGP_INFO_STALE          (1 << 8)
 #define BGP_INFO_REMOVED        (1 << 9)
 #define BGP_INFO_COUNTED	(1 << 10)
 
@@ -87,6 +86,17 @@ struct bgp_info
 #define BGP_ROUTE_STATIC       1
 #define BGP_ROUTE_AGGREGATE    2
 #define BGP_ROUTE_REDISTRIBUTE 3 
+
+  /* Peer's graceful restart generation when this path was last
+     received, see BGP_INFO_IS_STALE.  */
+  u_int32_t gr_gen;
+
+  /* Node holding this path.  */
+  struct bgp_node *net;
+
+  /* Peer's list of its paths for the node's AFI/SAFI.  */
+  struct bgp_info *peer_next;
+  struct bgp_info *peer_prev;
 };
 
 /* BGP static route configuration. */
@@ -129,6 +139,36 @@ struct bgp_static
   (! CHECK_FLAG ((BI)->flags, BGP_INFO_VALID) \
    || CHECK_FLAG ((BI)->flags, BGP_INFO_UNUSEABLE))
 
+/* Path was learnt before the peer last went down gracefully and has
+ * not been received again since.  Nothing is marked when the session
+ * drops, bgp_stop just moves the peer on to a new generation.
+ */
+#define BGP_INFO_IS_STALE(BI) \
+  ((BI)->gr_gen != (BI)->peer->gr_gen)
+
+/* Incremental removal of stale paths from one table, run from the
+ * peer's stale_sweep_queue.
+ */
+struct bgp_stale_sweep
+{
+  afi_t afi;
+  safi_t safi;
+  struct bgp_table *table;
+
+  /* Paths of older generations than this are removed.  */
+  u_int32_t gr_gen;
+
+  /* Next node to visit, locked.  */
+  struct bgp_node *rn;
+
+  /* Progress.  */
+  unsigned long scanned;
+  unsigned long removed;
+};
+
+/* Nodes visited per run of the stale path sweep.  */
+#define BGP_STALE_SWEEP_BATCH 256
+
 #define DISTRIBUTE_IN_NAME(F)   ((F)->dlist[FILTER_IN].name)
 #define DISTRIBUTE_IN(F)        ((F)->dlist[FILTER_IN].alist)
 #define DISTRIBUTE_OUT_NAME(F)  ((F)->dlist[FILTER_OUT].name)
@@ -30,6 +30,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "log.h"
 #include "memory.h"
 #include "hash.h"
+#include "workqueue.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_advertise.h"
@@ -7529,7 +7530,9 @@ bgp_show_peer (struct vty *vty, struct peer *p)
   /* graceful restart information */
   if (CHECK_FLAG (p->cap, PEER_CAP_RESTART_RCV)
       || p->t_gr_restart
-      || p->t_gr_stale)
+      || p->t_gr_stale
+      || p->stale_swept
+      || (p->stale_sweep_queue && p->stale_sweep_queue->thread))
     {
       int eor_send_af_count = 0;
       int eor_receive_af_count = 0;
@@ -7567,6 +7570,18 @@ bgp_show_peer (struct vty *vty, struct peer *p)
       if (p->t_gr_stale)
         vty_out (vty, "    The remaining time of stalepath timer is %ld%s",
                  thread_timer_remain_second (p->t_gr_stale), VTY_NEWLINE);
+
+      for (afi = AFI_IP ; afi < AFI_MAX ; afi++)
+	for (safi = SAFI_UNICAST ; safi < SAFI_MAX ; safi++)
+	  if (p->stale_sweep[afi][safi])
+	    vty_out (vty, "    Stale path sweep for %s: %lu prefixes scanned, "
+		     "%lu paths removed%s", afi_safi_print (afi, safi),
+		     p->stale_sweep[afi][safi]->scanned,
+		     p->stale_sweep[afi][safi]->removed, VTY_NEWLINE);
+
+      if (p->stale_swept)
+	vty_out (vty, "    Stale paths removed: %lu%s", p->stale_swept,
+		 VTY_NEWLINE);
     }
 
   /* Packet counts. */
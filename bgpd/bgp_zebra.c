@@ -29,6 +29,9 @@ Boston, MA 02111-1307, USA.  */
 #include "zclient.h"
 #include "routemap.h"
 #include "thread.h"
+#include "hash.h"
+#include "jhash.h"
+#include "memory.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_route.h"
@@ -93,7 +96,7 @@ bgp_interface_delete (int command, struct zclient *zclient,
 
   s = zclient->ibuf;
   ifp = zebra_interface_state_read (s);
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 
   if (BGP_DEBUG(zebra, ZEBRA))
     zlog_debug("Zebra rcvd: interface delete %s", ifp->name);
@@ -124,6 +127,42 @@ bgp_interface_up (int command, struct zclient *zclient, zebra_size_t length)
   return 0;
 }
 
+/* Interfaces gone down, their directly connected peers not yet
+   stopped. */
+static struct list *bgp_interface_down_list;
+
+/* Fast external-failover (Currently IPv4 only) */
+static void
+bgp_fast_external_failover (void)
+{
+  struct listnode *mnode, *node, *nnode;
+  struct bgp *bgp;
+  struct peer *peer;
+  struct interface *peer_if;
+
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, mnode, bgp))
+    {
+      if (CHECK_FLAG (bgp->flags, BGP_FLAG_NO_FAST_EXT_FAILOVER))
+	continue;
+
+      for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+	{
+	  if (peer->ttl != 1)
+	    continue;
+
+	  if (peer->su.sa.sa_family == AF_INET)
+	    peer_if = if_lookup_by_ipv4 (&peer->su.sin.sin_addr);
+	  else
+	    continue;
+
+	  if (peer_if && listnode_lookup (bgp_interface_down_list, peer_if))
+	    BGP_EVENT_ADD (peer, BGP_Stop);
+	}
+    }
+
+  list_delete_all_node (bgp_interface_down_list);
+}
+
 static int
 bgp_interface_down (int command, struct zclient *zclient, zebra_size_t length)
 {
@@ -143,37 +182,24 @@ bgp_interface_down (int command, struct zclient *zclient, zebra_size_t length)
   for (ALL_LIST_ELEMENTS (ifp->connected, node, nnode, c))
     bgp_connected_delete (c);
 
-  /* Fast external-failover (Currently IPv4 only) */
-  {
-    struct listnode *mnode;
-    struct bgp *bgp;
-    struct peer *peer;
-    struct interface *peer_if;
-
-    for (ALL_LIST_ELEMENTS_RO (bm->bgp, mnode, bgp))
-      {
-	if (CHECK_FLAG (bgp->flags, BGP_FLAG_NO_FAST_EXT_FAILOVER))
-	  continue;
-
-	for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
-	  {
-	    if (peer->ttl != 1)
-	      continue;
-
-	    if (peer->su.sa.sa_family == AF_INET)
-	      peer_if = if_lookup_by_ipv4 (&peer->su.sin.sin_addr);
-	    else
-	      continue;
-
-	    if (ifp == peer_if)
-	      BGP_EVENT_ADD (peer, BGP_Stop);
-	  }
-      }
-  }
+  /* Fast external-failover, once for a whole bulk message. */
+  if (! bgp_interface_down_list)
+    bgp_interface_down_list = list_new ();
+  if (! listnode_lookup (bgp_interface_down_list, ifp))
+    listnode_add (bgp_interface_down_list, ifp);
+  if (! zclient->interface_bulk)
+    bgp_fast_external_failover ();
 
   return 0;
 }
 
+static void
+bgp_interface_bulk_end (struct zclient *zclient)
+{
+  if (bgp_interface_down_list)
+    bgp_fast_external_failover ();
+}
+
 static int
 bgp_interface_address_add (int command, struct zclient *zclient,
 			   zebra_size_t length)
@@ -642,6 +668,212 @@ bgp_nexthop_set (union sockunion *local, union sockunion *remote,
   return ret;
 }
 
+/* Zebra route flags of the paths learnt from a peer. */
+static int
+bgp_zebra_flags (struct peer *peer)
+{
+  int flags = 0;
+
+  if (peer_sort (peer) == BGP_PEER_IBGP || peer_sort (peer) == BGP_PEER_CONFED)
+    {
+      SET_FLAG (flags, ZEBRA_FLAG_IBGP);
+      SET_FLAG (flags, ZEBRA_FLAG_INTERNAL);
+    }
+
+  if ((peer_sort (peer) == BGP_PEER_EBGP && peer->ttl != 1)
+      || CHECK_FLAG (peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK))
+    SET_FLAG (flags, ZEBRA_FLAG_INTERNAL);
+
+  return flags;
+}
+
+/* IPv4 unicast routes are installed in zebra through shared nexthop
+   groups, one per distinct nexthop and route flags.  When the IGP route
+   to a nexthop changes, the group is refreshed once instead of every
+   prefix using it being reinstalled.  */
+struct bgp_zebra_nhg
+{
+  struct in_addr nexthop;
+  u_char flags;
+  u_int32_t id;
+
+  /* The IGP resolution of the nexthop changed in the current scan. */
+  u_char changed;
+
+  /* Last scan pass which saw a path using the group. */
+  unsigned int pass;
+};
+
+static struct hash *bgp_nhg_hash;
+static u_int32_t bgp_nhg_next_id = 1;
+static unsigned int bgp_nhg_pass;
+
+/* Value of zclient->connects the groups were announced on. */
+static unsigned long bgp_nhg_connects;
+
+static unsigned int
+bgp_nhg_hash_key (void *arg)
+{
+  struct bgp_zebra_nhg *nhg = arg;
+
+  return jhash_2words (nhg->nexthop.s_addr, nhg->flags, 0);
+}
+
+static int
+bgp_nhg_hash_cmp (const void *a, const void *b)
+{
+  const struct bgp_zebra_nhg *nhg1 = a;
+  const struct bgp_zebra_nhg *nhg2 = b;
+
+  return nhg1->nexthop.s_addr == nhg2->nexthop.s_addr
+    && nhg1->flags == nhg2->flags;
+}
+
+static void *
+bgp_nhg_hash_alloc (void *arg)
+{
+  struct bgp_zebra_nhg *key = arg;
+  struct bgp_zebra_nhg *nhg;
+
+  nhg = XCALLOC (MTYPE_BGP_NHG, sizeof (struct bgp_zebra_nhg));
+  nhg->nexthop = key->nexthop;
+  nhg->flags = key->flags;
+  return nhg;
+}
+
+static void
+bgp_nhg_free (void *nhg)
+{
+  XFREE (MTYPE_BGP_NHG, nhg);
+}
+
+static void
+bgp_nhg_send (u_char cmd, struct bgp_zebra_nhg *nhg)
+{
+  struct zapi_nhg api;
+  struct in_addr *nexthop = &nhg->nexthop;
+
+  api.id = nhg->id;
+  api.flags = nhg->flags;
+  api.nexthop_num = 1;
+  api.nexthop = &nexthop;
+
+  if (BGP_DEBUG(zebra, ZEBRA))
+    zlog_debug("Zebra send: nexthop group %s %u nexthop %s",
+	       cmd == ZEBRA_NEXTHOP_GROUP_ADD ? "add" : "delete",
+	       nhg->id, inet_ntoa (nhg->nexthop));
+
+  zapi_nhg_send (cmd, zclient, &api);
+}
+
+/* Groups announced on an earlier connection are unknown to zebra. */
+static void
+bgp_nhg_check_connection (void)
+{
+  if (bgp_nhg_connects == zclient->connects)
+    return;
+  bgp_nhg_connects = zclient->connects;
+  hash_clean (bgp_nhg_hash, bgp_nhg_free);
+}
+
+static struct bgp_zebra_nhg *
+bgp_nhg_lookup (struct in_addr nexthop, int flags)
+{
+  struct bgp_zebra_nhg key;
+
+  bgp_nhg_check_connection ();
+
+  key.nexthop = nexthop;
+  key.flags = flags;
+  return hash_lookup (bgp_nhg_hash, &key);
+}
+
+/* Find the group of a nexthop, announcing it to zebra if new. */
+static struct bgp_zebra_nhg *
+bgp_nhg_get (struct in_addr nexthop, int flags)
+{
+  struct bgp_zebra_nhg key;
+  struct bgp_zebra_nhg *nhg;
+
+  bgp_nhg_check_connection ();
+
+  key.nexthop = nexthop;
+  key.flags = flags;
+  nhg = hash_get (bgp_nhg_hash, &key, bgp_nhg_hash_alloc);
+  if (! nhg->id)
+    {
+      nhg->id = bgp_nhg_next_id++;
+      nhg->pass = bgp_nhg_pass;
+      bgp_nhg_send (ZEBRA_NEXTHOP_GROUP_ADD, nhg);
+    }
+  return nhg;
+}
+
+/* Whether the zebra route of the given path follows a nexthop group, so
+   that a change of its IGP nexthop needs no reinstall of the prefix.  */
+int
+bgp_zebra_nhg_covers (struct prefix *p, struct bgp_info *info, safi_t safi)
+{
+  if (zclient->sock < 0 || p->family != AF_INET || safi != SAFI_UNICAST)
+    return 0;
+
+  return bgp_nhg_lookup (info->attr->nexthop,
+			 bgp_zebra_flags (info->peer)) != NULL;
+}
+
+/* Called by the nexthop scan for each IPv4 unicast path, with 'changed'
+   set if the IGP route to its nexthop changed.  */
+void
+bgp_zebra_nhg_scan (struct bgp_info *info, int changed)
+{
+  struct bgp_zebra_nhg *nhg;
+
+  if (zclient->sock < 0)
+    return;
+
+  nhg = bgp_nhg_lookup (info->attr->nexthop, bgp_zebra_flags (info->peer));
+  if (! nhg)
+    return;
+
+  nhg->pass = bgp_nhg_pass;
+  if (changed)
+    nhg->changed = 1;
+}
+
+static void
+bgp_nhg_scan_done_iter (struct hash_backet *backet, void *arg)
+{
+  struct bgp_zebra_nhg *nhg = backet->data;
+
+  if (nhg->pass != bgp_nhg_pass)
+    {
+      bgp_nhg_send (ZEBRA_NEXTHOP_GROUP_DELETE, nhg);
+      hash_release (bgp_nhg_hash, nhg);
+      bgp_nhg_free (nhg);
+      return;
+    }
+
+  /* Sending the group again has zebra resolve its nexthop again. */
+  if (nhg->changed)
+    {
+      nhg->changed = 0;
+      bgp_nhg_send (ZEBRA_NEXTHOP_GROUP_ADD, nhg);
+    }
+}
+
+/* End of a nexthop scan: refresh the groups whose IGP nexthop changed and
+   delete those no path used.  */
+void
+bgp_zebra_nhg_scan_done (void)
+{
+  if (zclient->sock < 0)
+    return;
+
+  bgp_nhg_check_connection ();
+  hash_iterate (bgp_nhg_hash, bgp_nhg_scan_done_iter, NULL);
+  bgp_nhg_pass++;
+}
+
 void
 bgp_zebra_announce (struct prefix *p, struct bgp_info *info, struct bgp *bgp, safi_t safi)
 {
@@ -655,18 +887,8 @@ bgp_zebra_announce (struct prefix *p, struct bgp_info *info, struct bgp *bgp, sa
   if (! zclient->redist[ZEBRA_ROUTE_BGP])
     return;
 
-  flags = 0;
   peer = info->peer;
-
-  if (peer_sort (peer) == BGP_PEER_IBGP || peer_sort (peer) == BGP_PEER_CONFED)
-    {
-      SET_FLAG (flags, ZEBRA_FLAG_IBGP);
-      SET_FLAG (flags, ZEBRA_FLAG_INTERNAL);
-    }
-
-  if ((peer_sort (peer) == BGP_PEER_EBGP && peer->ttl != 1)
-      || CHECK_FLAG (peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK))
-    SET_FLAG (flags, ZEBRA_FLAG_INTERNAL);
+  flags = bgp_zebra_flags (peer);
 
   if (p->family == AF_INET)
     {
@@ -679,10 +901,18 @@ bgp_zebra_announce (struct prefix *p, struct bgp_info *info, struct bgp *bgp, sa
       api.type = ZEBRA_ROUTE_BGP;
       api.message = 0;
       api.safi = safi;
-      SET_FLAG (api.message, ZAPI_MESSAGE_NEXTHOP);
-      api.nexthop_num = 1;
-      api.nexthop = &nexthop;
-      api.ifindex_num = 0;
+      if (safi == SAFI_UNICAST)
+	{
+	  SET_FLAG (api.message, ZAPI_MESSAGE_NEXTHOP_GROUP);
+	  api.nhg_id = bgp_nhg_get (*nexthop, flags)->id;
+	}
+      else
+	{
+	  SET_FLAG (api.message, ZAPI_MESSAGE_NEXTHOP);
+	  api.nexthop_num = 1;
+	  api.nexthop = &nexthop;
+	  api.ifindex_num = 0;
+	}
       SET_FLAG (api.message, ZAPI_MESSAGE_METRIC);
       api.metric = info->attr->med;
 
@@ -1059,11 +1289,15 @@ bgp_zebra_init (void)
   zclient->ipv4_route_delete = zebra_read_ipv4;
   zclient->interface_up = bgp_interface_up;
   zclient->interface_down = bgp_interface_down;
+  zclient->interface_bulk_end = bgp_interface_bulk_end;
+  zclient->interface_hold = ZAPI_INTERFACE_HOLD;
 #ifdef HAVE_IPV6
   zclient->ipv6_route_add = zebra_read_ipv6;
   zclient->ipv6_route_delete = zebra_read_ipv6;
 #endif /* HAVE_IPV6 */
 
+  bgp_nhg_hash = hash_create (bgp_nhg_hash_key, bgp_nhg_hash_cmp);
+
   /* Interface related init. */
   if_init ();
 }
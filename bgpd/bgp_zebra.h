@@ -27,6 +27,9 @@ extern int bgp_config_write_redistribute (struct vty *, struct bgp *, afi_t, saf
 				   int *);
 extern void bgp_zebra_announce (struct prefix *, struct bgp_info *, struct bgp *, safi_t);
 extern void bgp_zebra_withdraw (struct prefix *, struct bgp_info *, safi_t);
+extern int bgp_zebra_nhg_covers (struct prefix *, struct bgp_info *, safi_t);
+extern void bgp_zebra_nhg_scan (struct bgp_info *, int);
+extern void bgp_zebra_nhg_scan_done (void);
 
 extern int bgp_redistribute_set (struct bgp *, afi_t, int);
 extern int bgp_redistribute_rmap_set (struct bgp *, afi_t, int, const char *);
@@ -58,6 +58,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_advertise.h"
 #include "bgpd/bgp_network.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_bmp.h"
 #ifdef HAVE_SNMP
 #include "bgpd/bgp_snmp.h"
 #endif /* HAVE_SNMP */
@@ -729,6 +730,8 @@ peer_free (struct peer *peer)
     
   if (peer->clear_node_queue)
     work_queue_free (peer->clear_node_queue);
+  if (peer->stale_sweep_queue)
+    work_queue_free (peer->stale_sweep_queue);
   
   bgp_sync_delete (peer);
   memset (peer, 0, sizeof (struct peer));
@@ -2078,6 +2081,9 @@ bgp_delete (struct bgp *bgp)
   afi_t afi;
   int i;
 
+  /* Stop exporting before the peers go away. */
+  bgp_bmp_delete (bgp);
+
   /* Delete static route. */
   bgp_static_delete (bgp);
 
@@ -5290,6 +5296,9 @@ bgp_config_write (struct vty *vty)
 	vty_out (vty, " timers bgp %d %d%s", bgp->default_keepalive, 
 		 bgp->default_holdtime, VTY_NEWLINE);
 
+      /* BMP configuration. */
+      bgp_config_write_bmp (vty, bgp);
+
       /* peer-group */
       for (ALL_LIST_ELEMENTS (bgp->group, node, nnode, group))
 	{
@@ -5354,6 +5363,7 @@ bgp_init (void)
   bgp_attr_init ();
   bgp_debug_init ();
   bgp_dump_init ();
+  bgp_bmp_init ();
   bgp_route_init ();
   bgp_route_map_init ();
   bgp_scan_init ();
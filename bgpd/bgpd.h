@@ -163,6 +163,9 @@ struct bgp
   /* BGP graceful restart */
   u_int32_t restart_time;
   u_int32_t stalepath_time;
+
+  /* BGP Monitoring Protocol exporter.  */
+  struct bmp *bmp;
 };
 
 /* BGP peer-group support. */
@@ -367,6 +370,10 @@ struct peer
   /* NSF mode (graceful restart) */
   u_char nsf[AFI_MAX][SAFI_MAX];
 
+  /* Graceful restart generation, bumped each time the session goes
+     down with the peer's paths retained.  */
+  u_int32_t gr_gen;
+
   /* Per AF configuration flags. */
   u_int32_t af_flags[AFI_MAX][SAFI_MAX];
 #define PEER_FLAG_SEND_COMMUNITY            (1 << 0) /* send-community */
@@ -454,6 +461,11 @@ struct peer
   
   /* workqueues */
   struct work_queue *clear_node_queue;
+  struct work_queue *stale_sweep_queue;
+
+  /* Stale path sweeps in progress, and paths removed by past ones.  */
+  struct bgp_stale_sweep *stale_sweep[AFI_MAX][SAFI_MAX];
+  unsigned long stale_swept;
   
   /* Statistics field */
   u_int32_t open_in;		/* Open message input count */
@@ -474,6 +486,12 @@ struct peer
   u_int32_t established;	/* Established */
   u_int32_t dropped;		/* Dropped */
 
+  /* Paths, Adj-RIB-In and Adj-RIB-Out entries of this peer, so that
+     clearing the peer need not walk the whole table.  */
+  struct bgp_info *paths[AFI_MAX][SAFI_MAX];
+  struct bgp_adj_in *adj_in[AFI_MAX][SAFI_MAX];
+  struct bgp_adj_out *adj_out[AFI_MAX][SAFI_MAX];
+
   /* Syncronization list and time.  */
   struct bgp_synchronize *sync[AFI_MAX][SAFI_MAX];
   time_t synctime;
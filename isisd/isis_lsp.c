@@ -1605,6 +1605,35 @@ lsp_refresh_l2 (struct thread *thread)
   return ISIS_OK;
 }
 
+/*
+ * Regeneration held while a bulk interface message from zebra is
+ * handled, each area scheduled once when it is released.
+ */
+static int lsp_regenerate_held;
+static struct list *lsp_regenerate_held_areas;
+
+void
+lsp_regenerate_hold (void)
+{
+  lsp_regenerate_held = 1;
+}
+
+void
+lsp_regenerate_release (void)
+{
+  struct isis_area *area;
+  struct listnode *node, *nnode;
+
+  lsp_regenerate_held = 0;
+
+  if (!lsp_regenerate_held_areas)
+    return;
+
+  for (ALL_LIST_ELEMENTS (lsp_regenerate_held_areas, node, nnode, area))
+    lsp_regenerate_schedule (area);
+  list_delete_all_node (lsp_regenerate_held_areas);
+}
+
 /*
  * Something has changed -> regenerate LSP
  */
@@ -1637,6 +1666,16 @@ lsp_regenerate_schedule (struct isis_area *area)
   struct isis_lsp *lsp;
   u_char id[ISIS_SYS_ID_LEN + 2];
   time_t now, diff;
+
+  if (lsp_regenerate_held)
+    {
+      if (!lsp_regenerate_held_areas)
+	lsp_regenerate_held_areas = list_new ();
+      if (!listnode_lookup (lsp_regenerate_held_areas, area))
+	listnode_add (lsp_regenerate_held_areas, area);
+      return ISIS_OK;
+    }
+
   memcpy (id, isis->sysid, ISIS_SYS_ID_LEN);
   LSP_PSEUDO_ID (id) = LSP_FRAGMENT (id) = 0;
   now = time (NULL);
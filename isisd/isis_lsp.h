@@ -72,6 +72,8 @@ int lsp_l2_generate (struct isis_area *area);
 int lsp_refresh_l1 (struct thread *thread);
 int lsp_refresh_l2 (struct thread *thread);
 int lsp_regenerate_schedule (struct isis_area *area);
+void lsp_regenerate_hold (void);
+void lsp_regenerate_release (void);
 
 int lsp_l1_pseudo_generate (struct isis_circuit *circuit);
 int lsp_l2_pseudo_generate (struct isis_circuit *circuit);
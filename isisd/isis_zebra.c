@@ -40,6 +40,8 @@
 #include "isisd/isis_circuit.h"
 #include "isisd/isis_csm.h"
 #include "isisd/isis_route.h"
+#include "isisd/isis_tlv.h"
+#include "isisd/isis_lsp.h"
 #include "isisd/isis_zebra.h"
 
 struct zclient *zclient = NULL;
@@ -63,11 +65,28 @@ isis_router_id_update_zebra (int command, struct zclient *zclient,
   return 0;
 }
 
+/* Interface events of a bulk message only have the LSPs they touch
+   regenerated once, when the whole message has been handled. */
+static void
+isis_zebra_bulk_hold (struct zclient *zclient)
+{
+  if (zclient->interface_bulk)
+    lsp_regenerate_hold ();
+}
+
+static void
+isis_zebra_interface_bulk_end (struct zclient *zclient)
+{
+  lsp_regenerate_release ();
+}
+
 static int
 isis_zebra_if_add (int command, struct zclient *zclient, zebra_size_t length)
 {
   struct interface *ifp;
 
+  isis_zebra_bulk_hold (zclient);
+
   ifp = zebra_interface_add_read (zclient->ibuf);
 
   if (isis->debugs & DEBUG_ZEBRA)
@@ -86,6 +105,8 @@ isis_zebra_if_del (int command, struct zclient *zclient, zebra_size_t length)
   struct interface *ifp;
   struct stream *s;
 
+  isis_zebra_bulk_hold (zclient);
+
   s = zclient->ibuf;
   ifp = zebra_interface_state_read (s);
 
@@ -107,7 +128,7 @@ isis_zebra_if_del (int command, struct zclient *zclient, zebra_size_t length)
 
   isis_csm_state_change (IF_DOWN_FROM_Z, circuit_scan_by_ifp (ifp), ifp);
 
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 
   return 0;
 }
@@ -131,6 +152,8 @@ isis_zebra_if_state_up (int command, struct zclient *zclient,
 {
   struct interface *ifp;
 
+  isis_zebra_bulk_hold (zclient);
+
   ifp = zebra_interface_if_lookup (zclient->ibuf);
 
   if (!ifp)
@@ -158,6 +181,8 @@ isis_zebra_if_state_down (int command, struct zclient *zclient,
 {
   struct interface *ifp;
 
+  isis_zebra_bulk_hold (zclient);
+
   ifp = zebra_interface_if_lookup (zclient->ibuf);
 
   if (ifp == NULL)
@@ -180,6 +205,8 @@ isis_zebra_if_address_add (int command, struct zclient *zclient,
   struct prefix *p;
   char buf[BUFSIZ];
 
+  isis_zebra_bulk_hold (zclient);
+
   c = zebra_interface_address_read (ZEBRA_INTERFACE_ADDRESS_ADD,
 				    zclient->ibuf);
 
@@ -214,6 +241,8 @@ isis_zebra_if_address_del (int command, struct zclient *client,
   u_char buf[BUFSIZ];
 #endif /* EXTREME_DEBUG */
 
+  isis_zebra_bulk_hold (zclient);
+
   c = zebra_interface_address_read (ZEBRA_INTERFACE_ADDRESS_DELETE,
 				    zclient->ibuf);
 
@@ -615,6 +644,8 @@ isis_zebra_init ()
   zclient->interface_down = isis_zebra_if_state_down;
   zclient->interface_address_add = isis_zebra_if_address_add;
   zclient->interface_address_delete = isis_zebra_if_address_del;
+  zclient->interface_bulk_end = isis_zebra_interface_bulk_end;
+  zclient->interface_hold = ZAPI_INTERFACE_HOLD;
   zclient->ipv4_route_add = isis_zebra_read_ipv4;
   zclient->ipv4_route_delete = isis_zebra_read_ipv4;
 #ifdef HAVE_IPV6
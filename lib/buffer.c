@@ -127,6 +127,18 @@ buffer_empty (struct buffer *b)
   return (b->head == NULL);
 }
 
+/* Return number of bytes waiting to be flushed. */
+size_t
+buffer_pending (struct buffer *b)
+{
+  struct buffer_data *data;
+  size_t totlen = 0;
+
+  for (data = b->head; data; data = data->next)
+    totlen += data->cp - data->sp;
+  return totlen;
+}
+
 /* Clear and free all allocated data. */
 void
 buffer_reset (struct buffer *b)
@@ -52,6 +52,9 @@ char *buffer_getstr (struct buffer *);
 /* Returns 1 if there is no pending data in the buffer.  Otherwise returns 0. */
 int buffer_empty (struct buffer *);
 
+/* Returns the number of bytes queued in the buffer and not yet flushed. */
+extern size_t buffer_pending (struct buffer *);
+
 typedef enum
   {
     /* An I/O error occurred.  The buffer should be destroyed and the
@@ -28,6 +28,7 @@
 #include "sockunion.h"
 #include "buffer.h"
 #include "log.h"
+#include "stream.h"
 
 struct filter_cisco
 {
@@ -424,6 +425,50 @@ access_list_apply (struct access_list *access, void *object)
   return FILTER_DENY;
 }
 
+/* Put the entries of the access list into s as prefix_bgp_orf_entry()
+   does those of a prefix-list, for a peer to apply them as one.  A
+   zebra-style entry stands for the prefixes within its prefix, or only it
+   if it is exact.  Returns the number of entries put, or -1, leaving s
+   alone, if there are Cisco-style entries, which have no such
+   counterpart, or if they do not fit. */
+int
+access_list_orf_entry (struct stream *s, struct access_list *access,
+		       u_char permit_flag, u_char deny_flag)
+{
+  struct filter *filter;
+  struct prefix *p;
+  size_t size = 0;
+  u_int32_t seq = 0;
+  int maxlen;
+
+  if (access == NULL)
+    return 0;
+
+  for (filter = access->head; filter; filter = filter->next)
+    {
+      if (filter->cisco)
+	return -1;
+      size += 8 + PSIZE (filter->u.zfilter.prefix.prefixlen);
+    }
+  if (size > STREAM_WRITEABLE (s))
+    return -1;
+
+  for (filter = access->head; filter; filter = filter->next)
+    {
+      p = &filter->u.zfilter.prefix;
+      maxlen = p->family == AF_INET ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN;
+
+      stream_putc (s, filter->type == FILTER_PERMIT ? permit_flag : deny_flag);
+      stream_putl (s, (seq += 5));
+      stream_putc (s, 0);
+      stream_putc (s, (filter->u.zfilter.exact || p->prefixlen == maxlen)
+		      ? 0 : maxlen);
+      stream_put_prefix (s, p);
+    }
+
+  return seq / 5;
+}
+
 /* Add hook function. */
 void
 access_list_add_hook (void (*func) (struct access_list *access))
@@ -56,6 +56,8 @@ struct access_list
   struct filter *tail;
 };
 
+struct stream;
+
 /* Prototypes for access-list. */
 extern void access_list_init (void);
 extern void access_list_reset (void);
@@ -63,5 +65,7 @@ extern void access_list_add_hook (void (*func)(struct access_list *));
 extern void access_list_delete_hook (void (*func)(struct access_list *));
 extern struct access_list *access_list_lookup (afi_t, const char *);
 extern enum filter_type access_list_apply (struct access_list *, void *);
+extern int access_list_orf_entry (struct stream *, struct access_list *,
+				  u_char, u_char);
 
 #endif /* _ZEBRA_FILTER_H */
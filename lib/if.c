@@ -24,6 +24,8 @@
 #include <zebra.h>
 
 #include "linklist.h"
+#include "hash.h"
+#include "jhash.h"
 #include "vector.h"
 #include "vty.h"
 #include "command.h"
@@ -45,6 +47,71 @@ struct if_master
   int (*if_new_hook) (struct interface *);
   int (*if_delete_hook) (struct interface *);
 } if_master;
+
+/* Interfaces of iflist by name, and by ifindex but for IFINDEX_INTERNAL.
+   Of interfaces sharing an ifindex, as while one is being renamed, only
+   one is indexed at a time. */
+static struct hash *if_name_hash;
+static struct hash *if_index_hash;
+
+/* IPv4 connected addresses of all the interfaces by prefix, for
+   if_lookup_address().  Each node holds the list of the addresses. */
+static struct route_table *if_connected_table;
+
+static unsigned int
+if_name_hash_key (void *arg)
+{
+  return string_hash_make (((struct interface *) arg)->name);
+}
+
+static int
+if_name_hash_cmp (const void *a, const void *b)
+{
+  return strcmp (((const struct interface *) a)->name,
+		 ((const struct interface *) b)->name) == 0;
+}
+
+static unsigned int
+if_index_hash_key (void *arg)
+{
+  return jhash_1word (((struct interface *) arg)->ifindex, 0);
+}
+
+static int
+if_index_hash_cmp (const void *a, const void *b)
+{
+  return ((const struct interface *) a)->ifindex
+	 == ((const struct interface *) b)->ifindex;
+}
+
+/* Index IFP by its ifindex, unless another interface already is. */
+static void
+if_index_add (struct interface *ifp)
+{
+  if (ifp->ifindex != IFINDEX_INTERNAL)
+    hash_get (if_index_hash, ifp, hash_alloc_intern);
+}
+
+/* Remove IFP from the ifindex index, indexing instead another interface
+   with the same ifindex, if any. */
+static void
+if_index_delete (struct interface *ifp)
+{
+  struct listnode *node;
+  struct interface *other;
+
+  if (ifp->ifindex == IFINDEX_INTERNAL
+      || hash_lookup (if_index_hash, ifp) != ifp)
+    return;
+
+  hash_release (if_index_hash, ifp);
+  for (ALL_LIST_ELEMENTS_RO (iflist, node, other))
+    if (other != ifp && other->ifindex == ifp->ifindex)
+      {
+	hash_get (if_index_hash, other, hash_alloc_intern);
+	break;
+      }
+}
 
 /* Compare interface names, returning an integer greater than, equal to, or
  * less than 0, (following the strcmp convention), according to the
@@ -125,7 +192,10 @@ if_create (const char *name, int namelen)
   strncpy (ifp->name, name, namelen);
   ifp->name[namelen] = '\0';
   if (if_lookup_by_name(ifp->name) == NULL)
-    listnode_add_sort (iflist, ifp);
+    {
+      listnode_add_sort (iflist, ifp);
+      hash_get (if_name_hash, ifp, hash_alloc_intern);
+    }
   else
     zlog_err("if_create(%s): corruption detected -- interface with this "
 	     "name exists already!", ifp->name);
@@ -154,6 +224,9 @@ void
 if_delete (struct interface *ifp)
 {
   listnode_delete (iflist, ifp);
+  if (hash_lookup (if_name_hash, ifp) == ifp)
+    hash_release (if_name_hash, ifp);
+  if_index_delete (ifp);
 
   if_delete_retain(ifp);
 
@@ -176,12 +249,32 @@ if_add_hook (int type, int (*func)(struct interface *ifp))
   }
 }
 
+/* Change the ifindex of an interface.  The ifindex is never to be
+   assigned directly, so that the interface is found by it. */
+void
+if_set_index (struct interface *ifp, unsigned int ifindex)
+{
+  if (ifp->ifindex == ifindex)
+    return;
+
+  if_index_delete (ifp);
+  ifp->ifindex = ifindex;
+  if_index_add (ifp);
+}
+
 /* Interface existance check by index. */
 struct interface *
 if_lookup_by_index (unsigned int index)
 {
   struct listnode *node;
   struct interface *ifp;
+  struct interface key;
+
+  if (index != IFINDEX_INTERNAL)
+    {
+      key.ifindex = index;
+      return hash_lookup (if_index_hash, &key);
+    }
 
   for (ALL_LIST_ELEMENTS_RO(iflist, node, ifp))
     {
@@ -213,33 +306,22 @@ ifname2ifindex (const char *name)
 struct interface *
 if_lookup_by_name (const char *name)
 {
-  struct listnode *node;
-  struct interface *ifp;
-  
-  if (name)
-    for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
-      {
-        if (strcmp(name, ifp->name) == 0)
-          return ifp;
-      }
-  return NULL;
+  if (! name)
+    return NULL;
+  return if_lookup_by_name_len (name, strnlen (name, INTERFACE_NAMSIZ + 1));
 }
 
 struct interface *
 if_lookup_by_name_len(const char *name, size_t namelen)
 {
-  struct listnode *node;
-  struct interface *ifp;
+  struct interface key;
 
   if (namelen > INTERFACE_NAMSIZ)
     return NULL;
 
-  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
-    {
-      if (!memcmp(name, ifp->name, namelen) && (ifp->name[namelen] == '\0'))
-	return ifp;
-    }
-  return NULL;
+  memcpy (key.name, name, namelen);
+  key.name[namelen] = '\0';
+  return hash_lookup (if_name_hash, &key);
 }
 
 /* Lookup interface by IPv4 address. */
@@ -268,15 +350,14 @@ if_lookup_exact_address (struct in_addr src)
   return NULL;
 }
 
-/* Lookup interface by IPv4 address. */
+/* Lookup interface by IPv4 address: the interface with the most specific
+   connected prefix covering it, the first in iflist order on a tie. */
 struct interface *
 if_lookup_address (struct in_addr src)
 {
-  struct listnode *node;
   struct prefix addr;
-  int bestlen = 0;
+  struct route_node *rn;
   struct listnode *cnode;
-  struct interface *ifp;
   struct connected *c;
   struct interface *match;
 
@@ -286,19 +367,16 @@ if_lookup_address (struct in_addr src)
 
   match = NULL;
 
-  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
-    {
-      for (ALL_LIST_ELEMENTS_RO (ifp->connected, cnode, c))
-	{
-	  if (c->address && (c->address->family == AF_INET) &&
-	      prefix_match(CONNECTED_PREFIX(c), &addr) &&
-	      (c->address->prefixlen > bestlen))
-	    {
-	      bestlen = c->address->prefixlen;
-	      match = ifp;
-	    }
-	}
-    }
+  rn = route_node_match (if_connected_table, &addr);
+  if (! rn)
+    return NULL;
+
+  if (rn->p.prefixlen > 0)
+    for (ALL_LIST_ELEMENTS_RO ((struct list *) rn->info, cnode, c))
+      if (! match || if_cmp_func (c->ifp, match) < 0)
+	match = c->ifp;
+
+  route_unlock_node (rn);
   return match;
 }
 
@@ -619,10 +697,69 @@ connected_new (void)
   return XCALLOC (MTYPE_CONNECTED, sizeof (struct connected));
 }
 
+/* Index an IPv4 connected address by its prefix. */
+static void
+connected_index_add (struct connected *ifc)
+{
+  struct prefix p;
+  struct route_node *rn;
+
+  if (ifc->node || ! ifc->address || ifc->address->family != AF_INET
+      || ! CONNECTED_PREFIX (ifc))
+    return;
+
+  prefix_copy (&p, CONNECTED_PREFIX (ifc));
+  apply_mask (&p);
+  rn = route_node_get (if_connected_table, &p);
+  if (! rn->info)
+    rn->info = list_new ();
+  listnode_add (rn->info, ifc);
+
+  /* The address holds the lock taken by route_node_get(). */
+  ifc->node = rn;
+}
+
+static void
+connected_index_delete (struct connected *ifc)
+{
+  struct route_node *rn = ifc->node;
+
+  if (! rn)
+    return;
+
+  listnode_delete (rn->info, ifc);
+  if (! listcount ((struct list *) rn->info))
+    {
+      list_delete (rn->info);
+      rn->info = NULL;
+    }
+  ifc->node = NULL;
+  route_unlock_node (rn);
+}
+
+/* Add a connected address to the addresses of an interface.  The address
+   is complete: its prefix is not to change until connected_delete(). */
+void
+connected_add (struct interface *ifp, struct connected *ifc)
+{
+  listnode_add (ifp->connected, ifc);
+  connected_index_add (ifc);
+}
+
+/* Remove a connected address from the addresses of an interface. */
+void
+connected_delete (struct interface *ifp, struct connected *ifc)
+{
+  listnode_delete (ifp->connected, ifc);
+  connected_index_delete (ifc);
+}
+
 /* Free connected structure. */
 void
 connected_free (struct connected *connected)
 {
+  connected_index_delete (connected);
+
   if (connected->address)
     prefix_free (connected->address);
 
@@ -694,7 +831,7 @@ connected_delete_by_prefix (struct interface *ifp, struct prefix *p)
 
       if (connected_same_prefix (ifc->address, p))
 	{
-	  listnode_delete (ifp->connected, ifc);
+	  connected_delete (ifp, ifc);
 	  return ifc;
 	}
     }
@@ -749,7 +886,7 @@ connected_add_by_prefix (struct interface *ifp, struct prefix *p,
     }
 
   /* Add connected address to the interface. */
-  listnode_add (ifp->connected, ifc);
+  connected_add (ifp, ifc);
   return ifc;
 }
 
@@ -861,6 +998,9 @@ void
 if_init (void)
 {
   iflist = list_new ();
+  if_name_hash = hash_create (if_name_hash_key, if_name_hash_cmp);
+  if_index_hash = hash_create (if_index_hash_key, if_index_hash_cmp);
+  if_connected_table = route_table_init ();
 #if 0
   ifaddr_ipv4_table = route_table_init ();
 #endif /* ifaddr_ipv4_table */
@@ -889,4 +1029,11 @@ if_terminate (void)
 
   list_delete (iflist);
   iflist = NULL;
+
+  hash_free (if_name_hash);
+  if_name_hash = NULL;
+  hash_free (if_index_hash);
+  if_index_hash = NULL;
+  route_table_finish (if_connected_table);
+  if_connected_table = NULL;
 }
@@ -172,6 +172,9 @@ struct connected
 
   /* Label for Linux 2.2.X and upper. */
   char *label;
+
+  /* Node of the IPv4 address in the index of if_lookup_address(). */
+  struct route_node *node;
 };
 
 /* Does the destination field contain a peer address? */
@@ -231,6 +234,7 @@ struct connected
 /* Prototypes. */
 extern int if_cmp_func (struct interface *, struct interface *);
 extern struct interface *if_create (const char *name, int namelen);
+extern void if_set_index (struct interface *, unsigned int);
 extern struct interface *if_lookup_by_index (unsigned int);
 extern struct interface *if_lookup_exact_address (struct in_addr);
 extern struct interface *if_lookup_address (struct in_addr);
@@ -284,6 +288,7 @@ extern unsigned int ifname2ifindex(const char *ifname);
 extern struct connected *connected_new (void);
 extern void connected_free (struct connected *);
 extern void connected_add (struct interface *, struct connected *);
+extern void connected_delete (struct interface *, struct connected *);
 extern struct connected  *connected_add_by_prefix (struct interface *,
                                             struct prefix *,
                                             struct prefix *);
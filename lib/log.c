@@ -846,6 +846,16 @@ static const struct zebra_desc_table command_types[] = {
   DESC_ENTRY	(ZEBRA_ROUTER_ID_UPDATE),
   DESC_ENTRY	(ZEBRA_HELLO),
   DESC_ENTRY	(ZEBRA_BGP_IPV4_RGATE_VERIFY),
+  DESC_ENTRY	(ZEBRA_NEXTHOP_GROUP_ADD),
+  DESC_ENTRY	(ZEBRA_NEXTHOP_GROUP_DELETE),
+  DESC_ENTRY	(ZEBRA_IPV4_ROUTE_ADD_BULK),
+  DESC_ENTRY	(ZEBRA_IPV4_ROUTE_DELETE_BULK),
+  DESC_ENTRY	(ZEBRA_IPV6_ROUTE_ADD_BULK),
+  DESC_ENTRY	(ZEBRA_IPV6_ROUTE_DELETE_BULK),
+  DESC_ENTRY	(ZEBRA_INTERFACE_HOLD),
+  DESC_ENTRY	(ZEBRA_INTERFACE_BULK),
+  DESC_ENTRY	(ZEBRA_REDISTRIBUTE_FILTER),
+  DESC_ENTRY	(ZEBRA_RING),
 };
 #undef DESC_ENTRY
 
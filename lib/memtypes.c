@@ -64,6 +64,7 @@ struct memory_list memory_list_lib[] =
   { MTYPE_PRIVS,		"Privilege information"		},
   { MTYPE_ZLOG,			"Logging"			},
   { MTYPE_ZCLIENT,		"Zclient"			},
+  { MTYPE_ZRING,		"Zclient ring"			},
   { MTYPE_WORK_QUEUE,		"Work queue"			},
   { MTYPE_WORK_QUEUE_ITEM,	"Work queue item"		},
   { MTYPE_WORK_QUEUE_NAME,	"Work queue name string"	},
@@ -77,11 +78,21 @@ struct memory_list memory_list_zebra[] =
 {
   { MTYPE_RTADV,		"Router Advertisement"		},
   { MTYPE_RTADV_PREFIX,		"Router Advertisement Prefix"	},
+  { MTYPE_RTADV_PACKET,		"Router Advertisement packet"	},
   { MTYPE_VRF,			"VRF"				},
   { MTYPE_VRF_NAME,		"VRF name"			},
   { MTYPE_NEXTHOP,		"Nexthop"			},
   { MTYPE_RIB,			"RIB"				},
   { MTYPE_RIB_QUEUE,		"RIB process work queue"	},
+  { MTYPE_NHG,			"Nexthop group"			},
+  { MTYPE_NHG_REF,		"Nexthop group reference"	},
+  { MTYPE_NHE,			"Nexthop set"			},
+  { MTYPE_NHE_IFDEP,		"Nexthop set interface"		},
+  { MTYPE_LPM_TABLE,		"Nexthop lookup table"		},
+  { MTYPE_DPLANE_CTX,		"Kernel route update"		},
+  { MTYPE_NETLINK_BUF,		"Netlink receive buffer"	},
+  { MTYPE_ZSERV_IF_EVENT,	"Held interface event"		},
+  { MTYPE_ZEBRA_SHOW_CURSOR,	"Route table show cursor"	},
   { MTYPE_STATIC_IPV4,		"Static IPv4 route"		},
   { MTYPE_STATIC_IPV6,		"Static IPv6 route"		},
   { -1, NULL },
@@ -138,6 +149,10 @@ struct memory_list memory_list_bgp[] =
   { 0, NULL },
   { MTYPE_BGP_PROCESS_QUEUE,	"BGP Process queue"		},
   { MTYPE_BGP_CLEAR_NODE_QUEUE, "BGP node clear queue"		},
+  { MTYPE_BGP_SHOW_CURSOR,	"BGP show cursor"		},
+  { MTYPE_BGP_STALE_SWEEP,	"BGP stale path sweep"		},
+  { MTYPE_BGP_BMP,		"BGP BMP exporter"		},
+  { MTYPE_BGP_NHG,		"BGP zebra nexthop group"	},
   { 0, NULL },
   { MTYPE_TRANSIT,		"BGP transit attr"		},
   { MTYPE_TRANSIT_VAL,		"BGP transit val"		},
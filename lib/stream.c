@@ -889,6 +889,22 @@ stream_reset (struct stream *s)
   s->getp = s->endp = 0;
 }
 
+/* Move the unread data of the stream to its start, so that more data
+   can be read after it. */
+void
+stream_pulldown (struct stream *s)
+{
+  size_t rlen;
+
+  STREAM_VERIFY_SANE (s);
+
+  rlen = STREAM_READABLE (s);
+  if (s->getp)
+    memmove (s->data, s->data + s->getp, rlen);
+  s->getp = 0;
+  s->endp = rlen;
+}
+
 /* Write stream contens to the file discriptor. */
 int
 stream_flush (struct stream *s, int fd)
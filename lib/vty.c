@@ -394,6 +394,89 @@ vty_auth (struct vty *vty, char *buf)
     }
 }
 
+/* Release the state of a resumable command output. */
+static void
+vty_output_cancel (struct vty *vty)
+{
+  if (vty->output_func == NULL)
+    return;
+
+  if (vty->output_del)
+    (*vty->output_del) (vty->output_arg);
+  vty->output_func = NULL;
+  vty->output_del = NULL;
+  vty->output_arg = NULL;
+}
+
+/* Resumable output is complete: finish the command as vty_execute()
+   would have done. */
+static void
+vty_output_done (struct vty *vty)
+{
+  vty_output_cancel (vty);
+
+  if (vty->type == VTY_TERM)
+    vty_prompt (vty);
+#ifdef VTYSH
+  else if (vty->type == VTY_SHELL_SERV)
+    {
+      u_char header[4] = {0, 0, 0, 0};
+
+      header[3] = vty->output_ret;
+      buffer_put (vty->obuf, header, 4);
+    }
+#endif /* VTYSH */
+}
+
+/* Generate the next chunk of resumable output, unless there is already
+   enough waiting to be written. */
+static void
+vty_output_fill (struct vty *vty)
+{
+  if (vty->output_func == NULL
+      || buffer_pending (vty->obuf) > VTY_OUTPUT_HIWAT)
+    return;
+
+  if ((*vty->output_func) (vty, vty->output_arg) == 0)
+    vty_output_done (vty);
+}
+
+/* Generate all remaining resumable output at once. */
+static void
+vty_output_drain (struct vty *vty)
+{
+  while ((*vty->output_func) (vty, vty->output_arg))
+    ;
+}
+
+/* Let a command produce its output incrementally.  func is called
+   repeatedly, each call emitting a bounded chunk of output, and returns
+   non-zero while there is more to come.  del releases arg once output is
+   complete or the vty is closed.  Terminal and vtysh connections are
+   resumed from the write thread as the output buffer drains; any other
+   vty gets all of the output straight away. */
+void
+vty_output_start (struct vty *vty, int (*func) (struct vty *, void *),
+		  void (*del) (void *), void *arg)
+{
+  /* Commands displaying several tables keep their output in order. */
+  if (vty->output_func)
+    {
+      vty_output_drain (vty);
+      vty_output_cancel (vty);
+    }
+
+  vty->output_func = func;
+  vty->output_del = del;
+  vty->output_arg = arg;
+
+  if (vty->type != VTY_TERM && vty->type != VTY_SHELL_SERV)
+    {
+      vty_output_drain (vty);
+      vty_output_cancel (vty);
+    }
+}
+
 /* Command execution over the vty interface. */
 static int
 vty_command (struct vty *vty, char *buf)
@@ -1274,6 +1357,13 @@ vty_execute (struct vty *vty)
 
   ret = CMD_SUCCESS;
 
+  /* Output of the previous command must not interleave with this one. */
+  if (vty->output_func)
+    {
+      vty_output_drain (vty);
+      vty_output_done (vty);
+    }
+
   switch (vty->node)
     {
     case AUTH_NODE:
@@ -1291,7 +1381,7 @@ vty_execute (struct vty *vty)
   vty->cp = vty->length = 0;
   vty_clear_buf (vty);
 
-  if (vty->status != VTY_CLOSE )
+  if (vty->status != VTY_CLOSE && ! vty->output_func)
     vty_prompt (vty);
 
   return ret;
@@ -1333,6 +1423,7 @@ static void
 vty_buffer_reset (struct vty *vty)
 {
   buffer_reset (vty->obuf);
+  vty_output_cancel (vty);
   vty_prompt (vty);
   vty_redraw_line (vty);
 }
@@ -1568,6 +1659,10 @@ vty_flush (struct thread *thread)
   /* Function execution continue. */
   erase = ((vty->status == VTY_MORE || vty->status == VTY_MORELINE));
 
+  /* Refill from a long-running command before flushing, so that a paged
+     terminal still sees whole windows. */
+  vty_output_fill (vty);
+
   /* N.B. if width is 0, that means we don't know the window size. */
   if ((vty->lines == 0) || (vty->width == 0))
     flushrc = buffer_flush_available(vty->obuf, vty->fd);
@@ -1594,7 +1689,9 @@ vty_flush (struct thread *thread)
       else
 	{
 	  vty->status = VTY_NORMAL;
-	  if (vty->lines == 0)
+	  if (vty->output_func)
+	    vty_event (VTY_WRITE, vty_sock, vty);
+	  else if (vty->lines == 0)
 	    vty_event (VTY_READ, vty_sock, vty);
 	}
       break;
@@ -2027,6 +2124,8 @@ vtysh_accept (struct thread *thread)
 static int
 vtysh_flush(struct vty *vty)
 {
+  vty_output_fill (vty);
+
   switch (buffer_flush_available(vty->obuf, vty->fd))
     {
     case BUFFER_PENDING:
@@ -2040,6 +2139,8 @@ vtysh_flush(struct vty *vty)
       return -1;
       break;
     case BUFFER_EMPTY:
+      if (vty->output_func)
+	vty_event(VTYSH_WRITE, vty->fd, vty);
       break;
     }
   return 0;
@@ -2102,8 +2203,14 @@ vtysh_read (struct thread *thread)
 	  printf ("vtysh node: %d\n", vty->node);
 #endif /* VTYSH_DEBUG */
 
-	  header[3] = ret;
-	  buffer_put(vty->obuf, header, 4);
+	  /* Command output still to come: the header follows it. */
+	  if (vty->output_func)
+	    vty->output_ret = ret;
+	  else
+	    {
+	      header[3] = ret;
+	      buffer_put(vty->obuf, header, 4);
+	    }
 
 	  if (!vty->t_write && (vtysh_flush(vty) < 0))
 	    /* Try to flush results; exit if a write error occurs. */
@@ -2162,6 +2269,9 @@ vty_close (struct vty *vty)
 {
   int i;
 
+  /* Abandon any output still being generated. */
+  vty_output_cancel (vty);
+
   /* Cancel threads.*/
   if (vty->t_read)
     thread_cancel (vty->t_read);
@@ -118,6 +118,16 @@ struct vty
   /* Timeout seconds and thread. */
   unsigned long v_timeout;
   struct thread *t_timeout;
+
+  /* Resumable output of a long "show" command.  output_func is called
+     again from the write thread each time obuf drains below
+     VTY_OUTPUT_HIWAT, until it returns 0. */
+  int (*output_func) (struct vty *, void *);
+  void (*output_del) (void *);
+  void *output_arg;
+
+  /* Command return code held back until output_func is done (vtysh). */
+  int output_ret;
 };
 
 /* Integrated configuration file. */
@@ -132,6 +142,10 @@ struct vty
 /* Vty read buffer size. */
 #define VTY_READ_BUFSIZ 512
 
+/* Resumable output is not generated while more than this many bytes
+   are waiting in the vty output buffer. */
+#define VTY_OUTPUT_HIWAT 65536
+
 /* Directory separator. */
 #ifndef DIRECTORY_SEP
 #define DIRECTORY_SEP '/'
@@ -224,6 +238,8 @@ extern int vty_config_unlock (struct vty *);
 extern int vty_shell (struct vty *);
 extern int vty_shell_serv (struct vty *);
 extern void vty_hello (struct vty *);
+extern void vty_output_start (struct vty *, int (*) (struct vty *, void *),
+                              void (*) (void *), void *);
 
 /* Send a fixed-size message to all vty terminal monitors; this should be
    an async-signal-safe function. */
@@ -27,6 +27,8 @@
 /* Hold time for the initial schedule of a queue run, in  millisec */
 #define WORK_QUEUE_DEFAULT_HOLD  50 
 
+struct vty;
+
 /* action value, for use by item processor and item error handlers */
 typedef enum
 {
@@ -79,6 +81,9 @@ struct work_queue
     
     /* completion callback, called when queue is emptied, optional */
     void (*completion_func) (struct work_queue *);
+
+    /* callback to show details of the queue in "show work-queues", optional */
+    void (*show_func) (struct vty *, struct work_queue *);
     
     /* max number of retries to make for item that errors */
     unsigned int max_retries;	
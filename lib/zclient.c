@@ -32,9 +32,14 @@
 #include "zclient.h"
 #include "memory.h"
 #include "table.h"
+#include "linklist.h"
+#include "vty.h"
+#include "plist.h"
+#include "filter.h"
+#include "zring.h"
 
 /* Zebra client events. */
-enum event {ZCLIENT_SCHEDULE, ZCLIENT_READ, ZCLIENT_CONNECT};
+enum event {ZCLIENT_SCHEDULE, ZCLIENT_READ, ZCLIENT_CONNECT, ZCLIENT_DISPATCH};
 
 /* Prototype for event manager. */
 static void zclient_event (enum event, struct zclient *);
@@ -45,6 +50,26 @@ char *zclient_serv_path = NULL;
 
 /* This file local debug flag. */
 int zclient_debug = 0;
+
+/* Clients, so that the route messages they hold back are sent when the
+   daemon exits. */
+static struct list *zclient_list;
+
+/* Route message extracted from a bulk message from zebra. */
+static struct stream *zclient_bulk_buf;
+
+static int zclient_send_bulk (struct zclient *);
+
+static void
+zclient_exit_flush (void)
+{
+  struct listnode *node;
+  struct zclient *zclient;
+
+  for (ALL_LIST_ELEMENTS_RO (zclient_list, node, zclient))
+    if (zclient->sock >= 0)
+      zclient_send_bulk (zclient);
+}
 
 /* Allocate zclient structure. */
 struct zclient *
@@ -54,8 +79,17 @@ zclient_new ()
   zclient = XCALLOC (MTYPE_ZCLIENT, sizeof (struct zclient));
 
   zclient->ibuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  zclient->rbuf = stream_new (ZEBRA_READ_BUFSIZ);
   zclient->obuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   zclient->wb = buffer_new(0);
+  zapi_bulk_init (&zclient->bulk, ZAPI_ROUTE_LEAD_CLIENT);
+
+  if (! zclient_list)
+    {
+      zclient_list = list_new ();
+      atexit (zclient_exit_flush);
+    }
+  listnode_add (zclient_list, zclient);
 
   return zclient;
 }
@@ -68,13 +102,24 @@ zclient_new ()
 void
 zclient_free (struct zclient *zclient)
 {
+  /* Send the route messages held back while the streams are still
+     there: a failed write stops the client, which resets them.  Stopping
+     it also cancels the threads the failure may have scheduled. */
+  if (zclient->sock >= 0)
+    zclient_send_bulk (zclient);
+  zclient_stop (zclient);
+
   if (zclient->ibuf)
     stream_free(zclient->ibuf);
+  if (zclient->rbuf)
+    stream_free(zclient->rbuf);
   if (zclient->obuf)
     stream_free(zclient->obuf);
   if (zclient->wb)
     buffer_free(zclient->wb);
+  zapi_bulk_finish (&zclient->bulk);
 
+  listnode_delete (zclient_list, zclient);
   XFREE (MTYPE_ZCLIENT, zclient);
 }
 
@@ -121,9 +166,28 @@ zclient_stop (struct zclient *zclient)
   THREAD_OFF(zclient->t_read);
   THREAD_OFF(zclient->t_connect);
   THREAD_OFF(zclient->t_write);
+  THREAD_OFF(zclient->t_bulk);
+
+  /* Drop the route messages held back.  When a write of
+     zclient_send_bulk() fails, they are already taken and the bulk
+     message is left alone. */
+  zapi_bulk_take (&zclient->bulk);
+  zclient->bulk_agreed = 0;
+
+#ifdef ZSERV_RING
+  /* Drop the ring, zebra does the same with its end of it. */
+  THREAD_OFF(zclient->t_ring);
+  if (zclient->ring)
+    {
+      zring_free (zclient->ring);
+      zclient->ring = NULL;
+    }
+  zclient->ring_active = 0;
+#endif /* ZSERV_RING */
 
   /* Reset streams. */
   stream_reset(zclient->ibuf);
+  stream_reset(zclient->rbuf);
   stream_reset(zclient->obuf);
 
   /* Empty the write buffer. */
@@ -268,13 +332,103 @@ zclient_flush_data(struct thread *thread)
   return 0;
 }
 
-int
-zclient_send_message(struct zclient *zclient)
+#ifdef ZSERV_RING
+/* Put the messages which did not fit into the ring as zebra makes room. */
+static int
+zclient_ring_flush (struct thread *thread)
 {
-  if (zclient->sock < 0)
-    return -1;
-  switch (buffer_write(zclient->wb, zclient->sock, STREAM_DATA(zclient->obuf),
-		       stream_get_endp(zclient->obuf)))
+  struct zclient *zclient = THREAD_ARG (thread);
+
+  zclient->t_ring = NULL;
+  zring_ack (zclient->ring, ZRING_FD_SPACE);
+  if (zring_flush (zclient->ring))
+    zclient->t_ring = thread_add_read (master, zclient_ring_flush, zclient,
+				       zclient->ring->fd[ZRING_FD_SPACE]);
+  return 0;
+}
+
+static int
+zclient_ring_write (struct zclient *zclient, struct stream *s)
+{
+  switch (zring_write (zclient->ring, STREAM_DATA (s), stream_get_endp (s)))
+    {
+    case -1:
+      zlog_warn ("%s: message of %lu bytes does not fit in the ring",
+		 __func__, (u_long) stream_get_endp (s));
+      return zclient_failed (zclient);
+    case 1:
+      if (! zclient->t_ring)
+	zclient->t_ring = thread_add_read (master, zclient_ring_flush, zclient,
+					   zclient->ring->fd[ZRING_FD_SPACE]);
+      break;
+    }
+  return 0;
+}
+
+/* Send the hello offering the ring, with the file descriptors zebra
+   needs to map it.  This is the first message on the connection. */
+static int
+zclient_ring_offer (struct zclient *zclient, struct stream *s)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE (sizeof (int) * ZRING_FDS)];
+  } control;
+  size_t len = stream_get_endp (s);
+  ssize_t n;
+
+  memset (&msg, 0, sizeof (msg));
+  iov.iov_base = STREAM_DATA (s);
+  iov.iov_len = len;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof (control.buf);
+
+  cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (sizeof (int) * ZRING_FDS);
+  memcpy (CMSG_DATA (cmsg), zclient->ring->fd, sizeof (int) * ZRING_FDS);
+
+  if ((n = sendmsg (zclient->sock, &msg, 0)) < 0)
+    {
+      zlog_warn ("%s: can't hand the ring over to zebra: %s",
+		 __func__, safe_strerror (errno));
+      zring_free (zclient->ring);
+      zclient->ring = NULL;
+      if (! ERRNO_IO_RETRY (errno))
+	return zclient_failed (zclient);
+      n = 0;
+    }
+
+  /* The file descriptors went with the first byte, zebra refuses the
+     ring if they did not. */
+  if ((size_t) n < len)
+    {
+      buffer_put (zclient->wb, STREAM_DATA (s) + n, len - n);
+      THREAD_WRITE_ON(master, zclient->t_write,
+		      zclient_flush_data, zclient, zclient->sock);
+    }
+  return 0;
+}
+#endif /* ZSERV_RING */
+
+/* Write a message to zebra, or enqueue it. */
+static int
+zclient_write (struct zclient *zclient, struct stream *s)
+{
+#ifdef ZSERV_RING
+  if (zclient->ring_active)
+    return zclient_ring_write (zclient, s);
+#endif /* ZSERV_RING */
+
+  switch (buffer_write(zclient->wb, zclient->sock, STREAM_DATA(s),
+		       stream_get_endp(s)))
     {
     case BUFFER_ERROR:
       zlog_warn("%s: buffer_write failed to zclient fd %d, closing",
@@ -292,6 +446,59 @@ zclient_send_message(struct zclient *zclient)
   return 0;
 }
 
+/* Send the route messages held back, if any. */
+static int
+zclient_send_bulk (struct zclient *zclient)
+{
+  struct stream *s;
+
+  THREAD_OFF (zclient->t_bulk);
+  if ((s = zapi_bulk_take (&zclient->bulk)) == NULL)
+    return 0;
+  return zclient_write (zclient, s);
+}
+
+static int
+zclient_bulk_flush (struct thread *thread)
+{
+  struct zclient *zclient = THREAD_ARG (thread);
+
+  zclient->t_bulk = NULL;
+  return zclient_send_bulk (zclient);
+}
+
+int
+zclient_send_message(struct zclient *zclient)
+{
+  int ret;
+
+  if (zclient->sock < 0)
+    return -1;
+
+  /* Route messages are held back for a moment, to be sent in bulk with
+     the ones following them, once zebra agreed to it.  Other messages go
+     out after them. */
+  ret = zclient->bulk_agreed ? zapi_bulk_add (&zclient->bulk, zclient->obuf)
+			     : -1;
+  if (ret > 0)
+    {
+      if (zclient_send_bulk (zclient) < 0)
+	return -1;
+      ret = zapi_bulk_add (&zclient->bulk, zclient->obuf);
+    }
+  if (ret == 0)
+    {
+      if (! zclient->t_bulk)
+	zclient->t_bulk = thread_add_timer_msec (master, zclient_bulk_flush,
+						 zclient, ZAPI_BULK_HOLD);
+      return 0;
+    }
+
+  if (zclient_send_bulk (zclient) < 0)
+    return -1;
+  return zclient_write (zclient, zclient->obuf);
+}
+
 void
 zclient_create_header (struct stream *s, uint16_t command)
 {
@@ -322,26 +529,69 @@ static int
 zebra_hello_send (struct zclient *zclient)
 {
   struct stream *s;
+  u_char flags = 0;
+
+  if (! zclient->no_bulk)
+    flags |= ZEBRA_HELLO_BULK;
 
-  if (zclient->redist_default)
+  if (zclient->redist_default || zclient->ring_size || flags)
     {
+#ifdef ZSERV_RING
+      if (zclient->ring_size
+	  && (zclient->ring = zring_new (zclient->ring_size)) != NULL)
+	flags |= ZEBRA_HELLO_RING;
+#endif /* ZSERV_RING */
+
       s = zclient->obuf;
       stream_reset (s);
 
       zclient_create_header (s, ZEBRA_HELLO);
       stream_putc (s, zclient->redist_default);
+      stream_putc (s, flags);
       stream_putw_at (s, 0, stream_get_endp (s));
+
+#ifdef ZSERV_RING
+      if (zclient->ring)
+	return zclient_ring_offer (zclient, s);
+#endif /* ZSERV_RING */
       return zclient_send_message(zclient);
     }
 
   return 0;
 }
 
+/* Send the hello, offering zebra a ring and bulk route messages, on a
+   connection made by the caller.  Zebra answers on the socket. */
+void
+zclient_hello_start (struct zclient *zclient)
+{
+  zebra_hello_send (zclient);
+  if (! zclient->t_read)
+    zclient_event (ZCLIENT_READ, zclient);
+}
+
+/* Ask zebra to hold interface events back for interface_hold
+   milliseconds, to send them coalesced. */
+static int
+zebra_interface_hold_send (struct zclient *zclient)
+{
+  struct stream *s;
+
+  s = zclient->obuf;
+  stream_reset (s);
+
+  zclient_create_header (s, ZEBRA_INTERFACE_HOLD);
+  stream_putw (s, zclient->interface_hold);
+  stream_putw_at (s, 0, stream_get_endp (s));
+  return zclient_send_message(zclient);
+}
+
 /* Make connection to zebra daemon. */
 int
 zclient_start (struct zclient *zclient)
 {
   int i;
+  afi_t afi;
 
   if (zclient_debug)
     zlog_debug ("zclient_start is called");
@@ -372,6 +622,7 @@ zclient_start (struct zclient *zclient)
 
   /* Clear fail count. */
   zclient->fail = 0;
+  zclient->connects++;
   if (zclient_debug)
     zlog_debug ("zclient connect success with socket [%d]", zclient->sock);
       
@@ -383,9 +634,19 @@ zclient_start (struct zclient *zclient)
   /* We need router-id information. */
   zebra_message_send (zclient, ZEBRA_ROUTER_ID_ADD);
 
+  /* Interface events may be coalesced. */
+  if (zclient->interface_hold)
+    zebra_interface_hold_send (zclient);
+
   /* We need interface information. */
   zebra_message_send (zclient, ZEBRA_INTERFACE_ADD);
 
+  /* Redistribution filters go before the requests they apply to. */
+  for (i = 0; i < ZEBRA_ROUTE_MAX; i++)
+    for (afi = AFI_IP; afi < AFI_MAX; afi++)
+      if (zclient->redist_filter[afi][i])
+	zclient_write (zclient, zclient->redist_filter[afi][i]);
+
   /* Flush all redistribute request. */
   for (i = 0; i < ZEBRA_ROUTE_MAX; i++)
     if (i != zclient->redist_default && zclient->redist[i])
@@ -465,6 +726,11 @@ zclient_connect (struct thread *t)
   * interleaved 64-bit nexthop. On the zserv side of the socket it will be
   * mapped to a singlle NEXTHOP_TYPE_IPV4_IFINDEX_OL RIB nexthop structure.
   *
+  * If ZAPI_MESSAGE_NEXTHOP_GROUP is set, the id of a nexthop group
+  * previously sent with zapi_nhg_send() is written as a 4 byte value.
+  * The route then takes its nexthops from that group and normally
+  * carries none of its own.
+  *
   * If ZAPI_MESSAGE_DISTANCE is set, the distance value is written as a 1
   * byte value.
   * 
@@ -540,6 +806,8 @@ zapi_ipv4_route (u_char cmd, struct zclient *zclient, struct prefix_ipv4 *p,
         }
     }
 
+  if (CHECK_FLAG (api->message, ZAPI_MESSAGE_NEXTHOP_GROUP))
+    stream_putl (s, api->nhg_id);
   if (CHECK_FLAG (api->message, ZAPI_MESSAGE_DISTANCE))
     stream_putc (s, api->distance);
   if (CHECK_FLAG (api->message, ZAPI_MESSAGE_METRIC))
@@ -551,6 +819,45 @@ zapi_ipv4_route (u_char cmd, struct zclient *zclient, struct prefix_ipv4 *p,
   return zclient_send_message(zclient);
 }
 
+/* 
+ * Nexthop group add/delete message.
+ *
+ * ZEBRA_NEXTHOP_GROUP_ADD carries the group id (4 bytes), the flags (1
+ * byte) used to resolve the nexthops, the nexthop count (1 byte) and
+ * then one ZEBRA_NEXTHOP_IPV4 data unit per nexthop.  Sending it for an
+ * id zebra already knows replaces the nexthops of the group, and thereby
+ * of every route referring to it.
+ *
+ * ZEBRA_NEXTHOP_GROUP_DELETE carries the group id only.
+ */
+int
+zapi_nhg_send (u_char cmd, struct zclient *zclient, struct zapi_nhg *api)
+{
+  int i;
+  struct stream *s;
+
+  s = zclient->obuf;
+  stream_reset (s);
+
+  zclient_create_header (s, cmd);
+
+  stream_putl (s, api->id);
+  if (cmd == ZEBRA_NEXTHOP_GROUP_ADD)
+    {
+      stream_putc (s, api->flags);
+      stream_putc (s, api->nexthop_num);
+      for (i = 0; i < api->nexthop_num; i++)
+        {
+          stream_putc (s, ZEBRA_NEXTHOP_IPV4);
+          stream_put_in_addr (s, api->nexthop[i]);
+        }
+    }
+
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  return zclient_send_message(zclient);
+}
+
 #ifdef HAVE_IPV6
 /* Route add/delete IPv6 message is similar to that of IPv4 with a difference
  * in blackhole/reject route encoding. Namely, there are no nexthop data units
@@ -617,6 +924,225 @@ zapi_ipv6_route (u_char cmd, struct zclient *zclient, struct prefix_ipv6 *p,
 }
 #endif /* HAVE_IPV6 */
 
+/* Command of the bulk message standing for route messages of command
+   cmd, 0 if they are not sent in bulk. */
+static uint16_t
+zapi_bulk_command (uint16_t cmd)
+{
+  switch (cmd)
+    {
+    case ZEBRA_IPV4_ROUTE_ADD:
+      return ZEBRA_IPV4_ROUTE_ADD_BULK;
+    case ZEBRA_IPV4_ROUTE_DELETE:
+      return ZEBRA_IPV4_ROUTE_DELETE_BULK;
+    case ZEBRA_IPV6_ROUTE_ADD:
+      return ZEBRA_IPV6_ROUTE_ADD_BULK;
+    case ZEBRA_IPV6_ROUTE_DELETE:
+      return ZEBRA_IPV6_ROUTE_DELETE_BULK;
+    }
+  return 0;
+}
+
+/* Command of the route messages a bulk message of command cmd stands
+   for, 0 if cmd is not a bulk message. */
+uint16_t
+zapi_bulk_single (uint16_t cmd)
+{
+  switch (cmd)
+    {
+    case ZEBRA_IPV4_ROUTE_ADD_BULK:
+      return ZEBRA_IPV4_ROUTE_ADD;
+    case ZEBRA_IPV4_ROUTE_DELETE_BULK:
+      return ZEBRA_IPV4_ROUTE_DELETE;
+    case ZEBRA_IPV6_ROUTE_ADD_BULK:
+      return ZEBRA_IPV6_ROUTE_ADD;
+    case ZEBRA_IPV6_ROUTE_DELETE_BULK:
+      return ZEBRA_IPV6_ROUTE_DELETE;
+    }
+  return 0;
+}
+
+void
+zapi_bulk_init (struct zapi_bulk *b, size_t lead)
+{
+  memset (b, 0, sizeof (struct zapi_bulk));
+  b->lead = lead;
+  b->s = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  b->first = stream_new (ZEBRA_MAX_PACKET_SIZ);
+}
+
+void
+zapi_bulk_finish (struct zapi_bulk *b)
+{
+  if (b->s)
+    stream_free (b->s);
+  if (b->first)
+    stream_free (b->first);
+  b->s = b->first = NULL;
+  b->count = 0;
+}
+
+/* Put the route message in msg into the bulk message.  Returns 0 if it
+   was, 1 if it does not go with the routes already in the bulk message,
+   which must then be sent first, and -1 if it cannot be sent in bulk. */
+int
+zapi_bulk_add (struct zapi_bulk *b, struct stream *msg)
+{
+  size_t len = stream_get_endp (msg);
+  size_t prefixp = ZEBRA_HEADER_SIZE + b->lead;
+  size_t attrp, attrlen;
+  uint16_t cmd;
+  u_char plen;
+  int psize;
+
+  if (len < prefixp + 1
+      || (cmd = zapi_bulk_command (stream_getw_from (msg, 4))) == 0)
+    return -1;
+
+  plen = stream_getc_from (msg, prefixp);
+  psize = PSIZE (plen);
+  attrp = prefixp + 1 + psize;
+  if (attrp > len)
+    return -1;
+  attrlen = len - attrp;
+
+  if (b->count)
+    {
+      u_char *data = STREAM_DATA (b->s);
+
+      if (stream_getw_from (b->s, 4) != cmd
+	  || memcmp (data + ZEBRA_HEADER_SIZE,
+		     STREAM_DATA (msg) + ZEBRA_HEADER_SIZE, b->lead)
+	  || stream_getw_from (b->s, prefixp) != attrlen
+	  || memcmp (data + prefixp + 2, STREAM_DATA (msg) + attrp, attrlen)
+	  || STREAM_WRITEABLE (b->s) < (size_t) 1 + psize)
+	return 1;
+    }
+  else
+    {
+      if (prefixp + 2 + attrlen + 2 + 1 + psize > STREAM_SIZE (b->s))
+	return -1;
+
+      stream_reset (b->s);
+      zclient_create_header (b->s, cmd);
+      stream_put (b->s, STREAM_DATA (msg) + ZEBRA_HEADER_SIZE, b->lead);
+      stream_putw (b->s, attrlen);
+      stream_put (b->s, STREAM_DATA (msg) + attrp, attrlen);
+      b->countp = stream_get_endp (b->s);
+      stream_putw (b->s, 0);
+
+      stream_reset (b->first);
+      stream_put (b->first, STREAM_DATA (msg), len);
+    }
+
+  stream_putc (b->s, plen);
+  stream_put (b->s, STREAM_DATA (msg) + prefixp + 1, psize);
+  stream_putw_at (b->s, b->countp, ++b->count);
+  stream_putw_at (b->s, 0, stream_get_endp (b->s));
+  return 0;
+}
+
+/* Return the message to send for the routes put into the bulk message,
+   NULL if there are none, and start over. */
+struct stream *
+zapi_bulk_take (struct zapi_bulk *b)
+{
+  u_int16_t count = b->count;
+
+  if (count == 0)
+    return NULL;
+
+  b->count = 0;
+  if (count == 1)
+    return b->first;
+
+  b->msgs++;
+  b->routes += count;
+  return b->s;
+}
+
+/* Extract the next route message of the bulk message in bulk, whose
+   fields before the prefix are lead bytes long, into out.  The bulk
+   message is read from its current position, which is just past its
+   header at first.  Returns 1 if a message was extracted, 0 if there are
+   no more and -1 if the bulk message is malformed. */
+int
+zapi_bulk_next (struct stream *bulk, size_t lead, struct stream *out)
+{
+  size_t prefixp = ZEBRA_HEADER_SIZE + lead;
+  size_t endp = stream_get_endp (bulk);
+  size_t getp = stream_get_getp (bulk);
+  uint16_t attrlen;
+  u_char plen;
+  int psize;
+
+  if (endp < prefixp + 2)
+    return -1;
+  attrlen = stream_getw_from (bulk, prefixp);
+  if (endp < prefixp + 2 + attrlen + 2)
+    return -1;
+
+  /* Skip to the first prefix. */
+  if (getp <= prefixp)
+    getp = prefixp + 2 + attrlen + 2;
+  if (getp == endp)
+    return 0;
+
+  plen = stream_getc_from (bulk, getp);
+  psize = PSIZE (plen);
+  if (getp + 1 + psize > endp
+      || prefixp + 1 + psize + attrlen > STREAM_SIZE (out))
+    return -1;
+
+  stream_reset (out);
+  zclient_create_header (out, zapi_bulk_single (stream_getw_from (bulk, 4)));
+  stream_put (out, STREAM_DATA (bulk) + ZEBRA_HEADER_SIZE, lead);
+  stream_put (out, STREAM_DATA (bulk) + getp, 1 + psize);
+  stream_put (out, STREAM_DATA (bulk) + prefixp + 2, attrlen);
+  stream_putw_at (out, 0, stream_get_endp (out));
+  stream_set_getp (out, ZEBRA_HEADER_SIZE);
+
+  stream_set_getp (bulk, getp + 1 + psize);
+  return 1;
+}
+
+/* Check the header of the next message in s, data read from the zserv
+   connection on socket sock, from its current position on.  Returns the
+   length of the message once it has been read entirely, 0 if more data
+   is needed and -1 if the header is invalid.  Zebra and its clients
+   frame the messages they read with it. */
+int
+zapi_frame (struct stream *s, int sock)
+{
+  size_t getp = stream_get_getp (s);
+  uint16_t length;
+  uint8_t marker, version;
+
+  if (STREAM_READABLE (s) < ZEBRA_HEADER_SIZE)
+    return 0;
+
+  length = stream_getw_from (s, getp);
+  marker = stream_getc_from (s, getp + 2);
+  version = stream_getc_from (s, getp + 3);
+
+  if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
+    {
+      zlog_err("%s: socket %d version mismatch, marker %d, version %d",
+               __func__, sock, marker, version);
+      return -1;
+    }
+  if (length < ZEBRA_HEADER_SIZE)
+    {
+      zlog_err("%s: socket %d message length %u is less than header size %d",
+	       __func__, sock, length, ZEBRA_HEADER_SIZE);
+      return -1;
+    }
+
+  if (STREAM_READABLE (s) < length)
+    return 0;
+  return length;
+}
+
 /* 
  * send a ZEBRA_REDISTRIBUTE_ADD or ZEBRA_REDISTRIBUTE_DELETE
  * for the route type (ZEBRA_ROUTE_KERNEL etc.). The zebra server will
@@ -698,7 +1224,7 @@ zebra_interface_add_read (struct stream *s)
   ifp = if_get_by_name_len (ifname_tmp, strnlen(ifname_tmp, INTERFACE_NAMSIZ));
 
   /* Read interface's index. */
-  ifp->ifindex = stream_getl (s);
+  if_set_index (ifp, stream_getl (s));
 
   /* Read interface's value. */
   ifp->status = stream_getc (s);
@@ -743,7 +1269,7 @@ zebra_interface_state_read (struct stream *s)
      return NULL;
 
   /* Read interface's index. */
-  ifp->ifindex = stream_getl (s);
+  if_set_index (ifp, stream_getl (s));
 
   /* Read interface's value. */
   ifp->status = stream_getc (s);
@@ -792,7 +1318,7 @@ void
 zebra_interface_if_set_value (struct stream *s, struct interface *ifp)
 {
   /* Read interface's index. */
-  ifp->ifindex = stream_getl (s);
+  if_set_index (ifp, stream_getl (s));
   ifp->status = stream_getc (s);
 
   /* Read interface's value. */
@@ -866,6 +1392,9 @@ zebra_interface_address_read (int type, struct stream *s)
 	   ifc->flags = ifc_flags;
 	   if (ifc->destination)
 	     ifc->destination->prefixlen = ifc->address->prefixlen;
+	   /* Index the address again, by its peer prefix if any. */
+	   connected_delete (ifp, ifc);
+	   connected_add (ifp, ifc);
 	 }
     }
   else
@@ -878,97 +1407,15 @@ zebra_interface_address_read (int type, struct stream *s)
 }
 
 
-/* Zebra client message read function. */
-static int
-zclient_read (struct thread *thread)
-{
-  size_t already;
-  uint16_t length, command;
-  uint8_t marker, version;
-  struct zclient *zclient;
-
-  /* Get socket to zebra. */
-  zclient = THREAD_ARG (thread);
-  zclient->t_read = NULL;
-
-  /* Read zebra header (if we don't have it already). */
-  if ((already = stream_get_endp(zclient->ibuf)) < ZEBRA_HEADER_SIZE)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try(zclient->ibuf, zclient->sock,
-				     ZEBRA_HEADER_SIZE-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (zclient_debug)
-	   zlog_debug ("zclient connection closed socket [%d].", zclient->sock);
-	  return zclient_failed(zclient);
-	}
-      if (nbyte != (ssize_t)(ZEBRA_HEADER_SIZE-already))
-	{
-	  /* Try again later. */
-	  zclient_event (ZCLIENT_READ, zclient);
-	  return 0;
-	}
-      already = ZEBRA_HEADER_SIZE;
-    }
-
-  /* Reset to read from the beginning of the incoming packet. */
-  stream_set_getp(zclient->ibuf, 0);
-
-  /* Fetch header values. */
-  length = stream_getw (zclient->ibuf);
-  marker = stream_getc (zclient->ibuf);
-  version = stream_getc (zclient->ibuf);
-  command = stream_getw (zclient->ibuf);
-  
-  if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
-    {
-      zlog_err("%s: socket %d version mismatch, marker %d, version %d",
-               __func__, zclient->sock, marker, version);
-      return zclient_failed(zclient);
-    }
-  
-  if (length < ZEBRA_HEADER_SIZE) 
-    {
-      zlog_err("%s: socket %d message length %u is less than %d ",
-	       __func__, zclient->sock, length, ZEBRA_HEADER_SIZE);
-      return zclient_failed(zclient);
-    }
-
-  /* Length check. */
-  if (length > STREAM_SIZE(zclient->ibuf))
-    {
-      struct stream *ns;
-      zlog_warn("%s: message size %u exceeds buffer size %lu, expanding...",
-	        __func__, length, (u_long)STREAM_SIZE(zclient->ibuf));
-      ns = stream_new(length);
-      stream_copy(ns, zclient->ibuf);
-      stream_free (zclient->ibuf);
-      zclient->ibuf = ns;
-    }
-
-  /* Read rest of zebra packet. */
-  if (already < length)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try(zclient->ibuf, zclient->sock,
-				     length-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (zclient_debug)
-	    zlog_debug("zclient connection closed socket [%d].", zclient->sock);
-	  return zclient_failed(zclient);
-	}
-      if (nbyte != (ssize_t)(length-already))
-	{
-	  /* Try again later. */
-	  zclient_event (ZCLIENT_READ, zclient);
-	  return 0;
-	}
-    }
-
-  length -= ZEBRA_HEADER_SIZE;
+static void zclient_read_bulk (struct zclient *);
+static void zclient_read_interface_bulk (struct zclient *);
+static void zclient_read_ring (struct zclient *);
+static void zclient_read_hello (struct zclient *);
 
+/* Handle a message from zebra, its body is in zclient->ibuf. */
+static void
+zclient_dispatch (struct zclient *zclient, uint16_t command, uint16_t length)
+{
   if (zclient_debug)
     zlog_debug("zclient 0x%p command 0x%x \n", zclient, command);
 
@@ -1018,16 +1465,230 @@ zclient_read (struct thread *thread)
       if (zclient->ipv6_route_delete)
 	(*zclient->ipv6_route_delete) (command, zclient, length);
       break;
+    case ZEBRA_IPV4_ROUTE_ADD_BULK:
+    case ZEBRA_IPV4_ROUTE_DELETE_BULK:
+    case ZEBRA_IPV6_ROUTE_ADD_BULK:
+    case ZEBRA_IPV6_ROUTE_DELETE_BULK:
+      zclient_read_bulk (zclient);
+      break;
+    case ZEBRA_INTERFACE_BULK:
+      zclient_read_interface_bulk (zclient);
+      break;
+    case ZEBRA_RING:
+      zclient_read_ring (zclient);
+      break;
+    case ZEBRA_HELLO:
+      zclient_read_hello (zclient);
+      break;
     default:
       break;
     }
+}
 
-  if (zclient->sock < 0)
-    /* Connection was closed during packet processing. */
-    return -1;
+/* Hand the routes of a bulk message from zebra to the callbacks, as the
+   route messages it stands for. */
+static void
+zclient_read_bulk (struct zclient *zclient)
+{
+  struct stream *bulk = zclient->ibuf;
+  int ret;
+
+  if (! zclient_bulk_buf)
+    zclient_bulk_buf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+
+  zclient->ibuf = zclient_bulk_buf;
+  while ((ret = zapi_bulk_next (bulk, ZAPI_ROUTE_LEAD_ZEBRA,
+				zclient->ibuf)) > 0)
+    {
+      zclient_dispatch (zclient, stream_getw_from (zclient->ibuf, 4),
+			stream_get_endp (zclient->ibuf) - ZEBRA_HEADER_SIZE);
+      if (zclient->sock < 0)
+	break;
+    }
+  zclient->ibuf = bulk;
+
+  if (ret < 0)
+    zlog_warn ("%s: malformed bulk route message", __func__);
+}
+
+/* Hand the interface events of a bulk message from zebra to the
+   callbacks, then let the client finish the work they left to it.  On the
+   wire, the bulk message is made of the number of events and, for each
+   one, the message zebra would have sent for it alone. */
+static void
+zclient_read_interface_bulk (struct zclient *zclient)
+{
+  struct stream *bulk = zclient->ibuf;
+  size_t endp = stream_get_endp (bulk);
+  size_t getp;
+  uint16_t count;
+  uint16_t length;
+  uint16_t command;
+
+  if (! zclient_bulk_buf)
+    zclient_bulk_buf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+
+  if (STREAM_READABLE (bulk) < 2)
+    goto malformed;
+  count = stream_getw (bulk);
+
+  zclient->ibuf = zclient_bulk_buf;
+  zclient->interface_bulk = 1;
+  while (count--)
+    {
+      getp = stream_get_getp (bulk);
+      if (endp - getp < ZEBRA_HEADER_SIZE)
+	break;
+      length = stream_getw_from (bulk, getp);
+      command = stream_getw_from (bulk, getp + 4);
+      if (length < ZEBRA_HEADER_SIZE || length > endp - getp
+	  || length > STREAM_SIZE (zclient->ibuf)
+	  || command == ZEBRA_INTERFACE_BULK)
+	break;
+
+      stream_reset (zclient->ibuf);
+      stream_put (zclient->ibuf, STREAM_DATA (bulk) + getp, length);
+      stream_set_getp (zclient->ibuf, ZEBRA_HEADER_SIZE);
+      stream_set_getp (bulk, getp + length);
+
+      zclient_dispatch (zclient, command, length - ZEBRA_HEADER_SIZE);
+      if (zclient->sock < 0)
+	break;
+    }
+  zclient->interface_bulk = 0;
+  zclient->ibuf = bulk;
+
+  if (zclient->interface_bulk_end)
+    (*zclient->interface_bulk_end) (zclient);
+
+  if (count == (uint16_t) -1 || zclient->sock < 0)
+    return;
+
+ malformed:
+  zlog_warn ("%s: malformed bulk interface message", __func__);
+}
+
+/* Zebra's answer to the bulk route messages offered with the hello. */
+static void
+zclient_read_hello (struct zclient *zclient)
+{
+  u_char flags;
+
+  flags = stream_getc (zclient->ibuf);
+  if (CHECK_FLAG (flags, ZEBRA_HELLO_BULK) && ! zclient->no_bulk)
+    zclient->bulk_agreed = 1;
+}
+
+/* Zebra's answer to the ring offered with the hello.  Once accepted, the
+   messages go through it after a last ZEBRA_RING message on the socket,
+   from which on zebra reads them there. */
+static void
+zclient_read_ring (struct zclient *zclient)
+{
+#ifdef ZSERV_RING
+  u_char accepted;
+
+  accepted = stream_getc (zclient->ibuf);
+  if (! zclient->ring || zclient->ring_active)
+    return;
+
+  if (! accepted)
+    {
+      zlog_warn ("zebra refused the ring, using the socket");
+      zring_free (zclient->ring);
+      zclient->ring = NULL;
+      return;
+    }
+
+  if (zebra_message_send (zclient, ZEBRA_RING) < 0)
+    return;
+  zclient->ring_active = 1;
+#endif /* ZSERV_RING */
+}
+
+/* Check the header of the next message read from zebra.  Returns the
+   length of the message once it has been read entirely, 0 if more data
+   is needed and -1 if the header is invalid. */
+static int
+zclient_frame (struct zclient *zclient)
+{
+  int length;
+
+  if ((length = zapi_frame (zclient->rbuf, zclient->sock)) <= 0)
+    return length;
+
+  /* Length check. */
+  if ((size_t) length > STREAM_SIZE(zclient->ibuf))
+    {
+      zlog_warn("%s: message size %u exceeds buffer size %lu, expanding...",
+	        __func__, length, (u_long)STREAM_SIZE(zclient->ibuf));
+      stream_free (zclient->ibuf);
+      zclient->ibuf = stream_new(length);
+    }
+
+  return length;
+}
+
+/* Zebra client message read function.  Reads as much as the socket has
+   and handles the complete messages, up to ZEBRA_READ_BUDGET of them
+   before letting other threads run. */
+static int
+zclient_read (struct thread *thread)
+{
+  int length;
+  int budget;
+  uint16_t command;
+  struct zclient *zclient;
+
+  /* Get socket to zebra. */
+  zclient = THREAD_ARG (thread);
+  zclient->t_read = NULL;
+
+  /* Read from the socket, unless messages were left from the last run. */
+  if ((length = zclient_frame (zclient)) == 0)
+    {
+      ssize_t nbyte;
+
+      stream_pulldown (zclient->rbuf);
+      if (((nbyte = stream_read_try(zclient->rbuf, zclient->sock,
+				     STREAM_WRITEABLE (zclient->rbuf))) == 0) ||
+	  (nbyte == -1))
+	{
+	  if (zclient_debug)
+	   zlog_debug ("zclient connection closed socket [%d].", zclient->sock);
+	  return zclient_failed(zclient);
+	}
+      length = zclient_frame (zclient);
+    }
+
+  for (budget = ZEBRA_READ_BUDGET; length > 0;
+       length = zclient_frame (zclient))
+    {
+      if (budget-- == 0)
+	{
+	  /* Come back to the messages already read after other threads. */
+	  zclient_event (ZCLIENT_DISPATCH, zclient);
+	  return 0;
+	}
+
+      /* Callbacks read the message from the input buffer. */
+      stream_reset (zclient->ibuf);
+      stream_put (zclient->ibuf, STREAM_PNT (zclient->rbuf), length);
+      stream_forward_getp (zclient->rbuf, length);
+      stream_set_getp (zclient->ibuf, ZEBRA_HEADER_SIZE - 2);
+      command = stream_getw (zclient->ibuf);
+
+      zclient_dispatch (zclient, command, length - ZEBRA_HEADER_SIZE);
+
+      if (zclient->sock < 0)
+	/* Connection was closed during packet processing. */
+	return -1;
+    }
+
+  if (length < 0)
+    return zclient_failed(zclient);
 
   /* Register read thread. */
-  stream_reset(zclient->ibuf);
   zclient_event (ZCLIENT_READ, zclient);
 
   return 0;
@@ -1076,6 +1737,97 @@ zclient_redistribute_default (int command, struct zclient *zclient)
     zebra_message_send (zclient, command);
 }
 
+/* Send the redistribution filter built in the output buffer of the
+   client, unless it is the one zebra has already, and keep it to be sent
+   again on reconnection.  One without entries removes the filter. */
+static int
+zebra_redistribute_filter_finish (struct zclient *zclient, int type,
+				  afi_t afi, int count)
+{
+  struct stream *s = zclient->obuf;
+  struct stream *last = zclient->redist_filter[afi][type];
+
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  if (count <= 0)
+    {
+      if (! last)
+	return 0;
+      stream_free (last);
+      zclient->redist_filter[afi][type] = NULL;
+    }
+  else
+    {
+      if (last && stream_get_endp (last) == stream_get_endp (s)
+	  && ! memcmp (STREAM_DATA (last), STREAM_DATA (s),
+		       stream_get_endp (s)))
+	return 0;
+      if (last)
+	stream_free (last);
+      zclient->redist_filter[afi][type] = stream_dup (s);
+    }
+
+  if (zclient->sock < 0)
+    return 0;
+  return zclient_send_message (zclient);
+}
+
+static void
+zebra_redistribute_filter_header (struct zclient *zclient, int type,
+				  afi_t afi)
+{
+  struct stream *s = zclient->obuf;
+
+  stream_reset (s);
+  zclient_create_header (s, ZEBRA_REDISTRIBUTE_FILTER);
+  stream_putc (s, type);
+  stream_putw (s, afi);
+}
+
+/* Have zebra redistribute only the routes of the type the prefix-list
+   permits, or all of them again if plist is NULL or too long to be
+   sent. */
+int
+zebra_redistribute_filter_send (struct zclient *zclient, int type,
+				afi_t afi, struct prefix_list *plist)
+{
+  struct stream *s = zclient->obuf;
+  int count = 0;
+
+  if (type <= 0 || type >= ZEBRA_ROUTE_MAX
+      || (afi != AFI_IP && afi != AFI_IP6))
+    return -1;
+
+  zebra_redistribute_filter_header (zclient, type, afi);
+  if (plist && plist->count
+      && (size_t) plist->count * (8 + sizeof (struct in6_addr))
+	 <= STREAM_WRITEABLE (s))
+    {
+      prefix_bgp_orf_entry (s, plist, 0, ZAPI_FILTER_PERMIT, 0);
+      count = plist->count;
+    }
+
+  return zebra_redistribute_filter_finish (zclient, type, afi, count);
+}
+
+/* Same with an access-list, which zebra can apply only if its entries are
+   all zebra-style ones. */
+int
+zebra_redistribute_filter_access_send (struct zclient *zclient, int type,
+				       afi_t afi, struct access_list *access)
+{
+  int count;
+
+  if (type <= 0 || type >= ZEBRA_ROUTE_MAX
+      || (afi != AFI_IP && afi != AFI_IP6))
+    return -1;
+
+  zebra_redistribute_filter_header (zclient, type, afi);
+  count = access_list_orf_entry (zclient->obuf, access, ZAPI_FILTER_PERMIT, 0);
+
+  return zebra_redistribute_filter_finish (zclient, type, afi, count);
+}
+
 static void
 zclient_event (enum event event, struct zclient *zclient)
 {
@@ -1101,6 +1853,10 @@ zclient_event (enum event event, struct zclient *zclient)
       zclient->t_read = 
 	thread_add_read (master, zclient_read, zclient, zclient->sock);
       break;
+    case ZCLIENT_DISPATCH:
+      zclient->t_read =
+	thread_add_event (master, zclient_read, zclient, 0);
+      break;
     }
 }
 
@@ -34,6 +34,47 @@
 /* Zebra header size. */
 #define ZEBRA_HEADER_SIZE             6
 
+/* Messages are read from the socket in chunks of up to this size, and
+   at most ZEBRA_READ_BUDGET of them are processed per read event. */
+#define ZEBRA_READ_BUFSIZ             (16 * ZEBRA_MAX_PACKET_SIZ)
+#define ZEBRA_READ_BUDGET             256
+
+/* Route messages are held back for up to ZAPI_BULK_HOLD milliseconds to
+   be sent together in a bulk message. */
+#define ZAPI_BULK_HOLD                1
+
+/* Window clients asking zebra to coalesce interface events usually give
+   it, in milliseconds: the last state of an interface or address within
+   the window is all that is sent, in a bulk message.  */
+#define ZAPI_INTERFACE_HOLD           50
+
+/* Length of the fields before the prefix in the route messages sent by
+   clients, and in those sent by zebra. */
+#define ZAPI_ROUTE_LEAD_CLIENT        5
+#define ZAPI_ROUTE_LEAD_ZEBRA         3
+
+/* Bulk route message being built out of consecutive route messages of
+   the same command, which differ only in their prefix.  On the wire, a
+   bulk message is made of the fields before the prefix, the length of
+   the fields after it, those fields, the number of prefixes and, for
+   each prefix, its length and significant bytes.  */
+struct zapi_bulk
+{
+  /* Length of the fields before the prefix. */
+  size_t lead;
+
+  /* The bulk message, and the first route message put into it, sent
+     instead when no other one joined it. */
+  struct stream *s;
+  struct stream *first;
+  size_t countp;
+  u_int16_t count;
+
+  /* Bulk messages sent and the routes they carried. */
+  unsigned long msgs;
+  unsigned long routes;
+};
+
 /* Structure for the zebra client. */
 struct zclient
 {
@@ -47,9 +88,15 @@ struct zclient
   /* Connection failure count. */
   int fail;
 
+  /* Successful connection count, lets clients notice a reconnect.  */
+  unsigned long connects;
+
   /* Input buffer for zebra message. */
   struct stream *ibuf;
 
+  /* Data read from zebra, possibly several messages and a partial one. */
+  struct stream *rbuf;
+
   /* Output buffer for zebra message. */
   struct stream *obuf;
 
@@ -63,6 +110,32 @@ struct zclient
   /* Thread to write buffered data to zebra. */
   struct thread *t_write;
 
+  /* Route messages held back to be sent in bulk.  Bulk messages are
+     offered to zebra with the hello unless no_bulk is set, and only sent
+     once zebra has agreed to them in its answer. */
+  struct zapi_bulk bulk;
+  struct thread *t_bulk;
+  u_char no_bulk;
+  u_char bulk_agreed;
+
+  /* Size of the shared memory ring offered to zebra on connection, for
+     the messages to zebra to go through instead of the socket, 0 for
+     none.  The ring is in use once zebra has accepted it; the thread
+     waits for room in it for the messages which did not fit. */
+  u_int32_t ring_size;
+  struct zring *ring;
+  u_char ring_active;
+  struct thread *t_ring;
+
+  /* Window for zebra to coalesce interface events in, 0 for it to send
+     them as they happen. */
+  u_int16_t interface_hold;
+
+  /* Set while the events of a bulk interface message are handed to the
+     callbacks, which may leave the work they have in common to
+     interface_bulk_end. */
+  u_char interface_bulk;
+
   /* Redistribute information. */
   u_char redist_default;
   u_char redist[ZEBRA_ROUTE_MAX];
@@ -70,6 +143,10 @@ struct zclient
   /* Redistribute defauilt. */
   u_char default_information;
 
+  /* Last filter given to zebra for the routes redistributed, per address
+     family and route type, sent again on reconnection. */
+  struct stream *redist_filter[AFI_MAX][ZEBRA_ROUTE_MAX];
+
   /* Pointer to the callback functions. */
   int (*router_id_update) (int, struct zclient *, uint16_t);
   int (*interface_add) (int, struct zclient *, uint16_t);
@@ -82,14 +159,29 @@ struct zclient
   int (*ipv4_route_delete) (int, struct zclient *, uint16_t);
   int (*ipv6_route_add) (int, struct zclient *, uint16_t);
   int (*ipv6_route_delete) (int, struct zclient *, uint16_t);
+  void (*interface_bulk_end) (struct zclient *);
 };
 
+/* Flag of ZEBRA_HELLO offering zebra a shared memory ring, whose file
+   descriptors come along with the message. */
+#define ZEBRA_HELLO_RING      0x01
+
+/* Flag of ZEBRA_HELLO saying bulk route messages may be sent to the
+   sender, which zebra answers with a ZEBRA_HELLO of its own if it agrees
+   to send and receive them. */
+#define ZEBRA_HELLO_BULK      0x02
+
+/* Flag of the entries of a redistribution filter permitting the prefixes
+   they match, as opposed to denying them. */
+#define ZAPI_FILTER_PERMIT    0x01
+
 /* Zebra API message flag. */
 #define ZAPI_MESSAGE_NEXTHOP  0x01
 #define ZAPI_MESSAGE_IFINDEX  0x02
 #define ZAPI_MESSAGE_DISTANCE 0x04
 #define ZAPI_MESSAGE_METRIC   0x08
 #define ZAPI_MESSAGE_ONLINK   0x10
+#define ZAPI_MESSAGE_NEXTHOP_GROUP 0x20
 
 /* Zserv protocol message header */
 struct zserv_header
@@ -120,17 +212,35 @@ struct zapi_ipv4
   u_char ifindex_num;
   unsigned int *ifindex;
 
+  /* Shared nexthop group, instead of nexthops.  */
+  u_int32_t nhg_id;
+
   u_char distance;
 
   u_int32_t metric;
 };
 
+/* Zebra nexthop group message API.  Routes refer to a group by its id
+   rather than carrying the nexthops themselves, so that the nexthops of
+   all of them can be changed with a single message.  */
+struct zapi_nhg
+{
+  u_int32_t id;
+
+  /* ZEBRA_FLAG_INTERNAL and the like, as used to resolve the nexthops.  */
+  u_char flags;
+
+  u_char nexthop_num;
+  struct in_addr **nexthop;
+};
+
 /* Prototypes of zebra client service functions. */
 extern struct zclient *zclient_new (void);
 extern void zclient_init (struct zclient *, int);
 extern int zclient_start (struct zclient *);
 extern void zclient_stop (struct zclient *);
 extern void zclient_reset (struct zclient *);
+extern void zclient_hello_start (struct zclient *);
 extern void zclient_free (struct zclient *);
 
 extern int  zclient_socket_connect (struct zclient *);
@@ -145,6 +255,16 @@ extern void zclient_redistribute (int command, struct zclient *, int type);
 /* If state has changed, update state and send the command to zebra. */
 extern void zclient_redistribute_default (int command, struct zclient *);
 
+/* Filter the routes of a type zebra redistributes to the client with a
+   prefix-list, or a zebra-style access-list.  NULL for none. */
+struct prefix_list;
+struct access_list;
+extern int zebra_redistribute_filter_send (struct zclient *, int, afi_t,
+					   struct prefix_list *);
+extern int zebra_redistribute_filter_access_send (struct zclient *, int,
+						  afi_t,
+						  struct access_list *);
+
 /* Send the message in zclient->obuf to the zebra daemon (or enqueue it).
    Returns 0 for success or -1 on an I/O error. */
 extern int zclient_send_message(struct zclient *);
@@ -159,6 +279,15 @@ extern void zebra_interface_if_set_value (struct stream *, struct interface *);
 extern void zebra_router_id_update_read (struct stream *s, struct prefix *rid);
 extern int zapi_ipv4_route (u_char, struct zclient *, struct prefix_ipv4 *, 
                             struct zapi_ipv4 *);
+extern int zapi_nhg_send (u_char, struct zclient *, struct zapi_nhg *);
+
+extern void zapi_bulk_init (struct zapi_bulk *, size_t);
+extern void zapi_bulk_finish (struct zapi_bulk *);
+extern int zapi_bulk_add (struct zapi_bulk *, struct stream *);
+extern struct stream *zapi_bulk_take (struct zapi_bulk *);
+extern uint16_t zapi_bulk_single (uint16_t);
+extern int zapi_bulk_next (struct stream *, size_t, struct stream *);
+extern int zapi_frame (struct stream *, int);
 
 #ifdef HAVE_IPV6
 /* IPv6 prefix add and delete function prototype. */
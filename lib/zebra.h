@@ -419,7 +419,17 @@ struct in_pktinfo
 #define ZEBRA_ROUTER_ID_UPDATE            22
 #define ZEBRA_HELLO                       23
 #define ZEBRA_BGP_IPV4_RGATE_VERIFY       24
-#define ZEBRA_MESSAGE_MAX                 25
+#define ZEBRA_NEXTHOP_GROUP_ADD           25
+#define ZEBRA_NEXTHOP_GROUP_DELETE        26
+#define ZEBRA_IPV4_ROUTE_ADD_BULK         27
+#define ZEBRA_IPV4_ROUTE_DELETE_BULK      28
+#define ZEBRA_IPV6_ROUTE_ADD_BULK         29
+#define ZEBRA_IPV6_ROUTE_DELETE_BULK      30
+#define ZEBRA_INTERFACE_HOLD              31
+#define ZEBRA_INTERFACE_BULK              32
+#define ZEBRA_REDISTRIBUTE_FILTER         33
+#define ZEBRA_RING                        34
+#define ZEBRA_MESSAGE_MAX                 35
 
 /* Marker value used in new Zserv, in the byte location corresponding
  * the command value in the old zserv header. To allow old and new
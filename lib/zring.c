@@ -0,0 +1,353 @@
+/*
+ * Shared memory ring carrying zserv messages from a client to zebra.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "memory.h"
+#include "stream.h"
+#include "log.h"
+#include "zring.h"
+
+#ifdef ZSERV_RING
+
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+#define ZRING_MAGIC             0x7a72696e
+
+/* Seals of the memory of a ring: its size can't change once zebra maps
+   it, lest a client shrinking it makes zebra fault on reading it. */
+#define ZRING_SEALS             (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+
+/* Data starts this far into the shared memory. */
+#define ZRING_HEADER            256
+
+/* Start of the shared memory.  Offsets run freely and are masked with
+   the size of the ring to index its data.  The reader moves head and the
+   writer tail; each side sets the flag the other one clears on waking it
+   up, and they are kept on separate cache lines. */
+struct zring_shm
+{
+  u_int32_t magic;
+  u_int32_t size;
+  u_char pad1[56];
+
+  volatile u_int32_t head;
+  volatile u_int32_t reader_idle;
+  u_char pad2[56];
+
+  volatile u_int32_t tail;
+  volatile u_int32_t writer_blocked;
+};
+
+#define ZRING_DATA(R)  ((u_char *) (R)->shm + ZRING_HEADER)
+
+static struct zring *
+zring_map (int *fds, size_t mapped)
+{
+  struct zring *ring;
+  void *mem;
+  int i;
+
+  mem = mmap (NULL, mapped, PROT_READ | PROT_WRITE, MAP_SHARED,
+	      fds[ZRING_FD_MEM], 0);
+  if (mem == MAP_FAILED)
+    {
+      zlog_warn ("%s: mmap failed: %s", __func__, safe_strerror (errno));
+      return NULL;
+    }
+
+  ring = XCALLOC (MTYPE_ZRING, sizeof (struct zring));
+  ring->shm = mem;
+  ring->mapped = mapped;
+  for (i = 0; i < ZRING_FDS; i++)
+    {
+      ring->fd[i] = fds[i];
+      fds[i] = -1;
+    }
+  ring->overflow = stream_fifo_new ();
+
+  return ring;
+}
+
+static void
+zring_close_fds (int *fds)
+{
+  int i;
+
+  for (i = 0; i < ZRING_FDS; i++)
+    if (fds[i] >= 0)
+      {
+	close (fds[i]);
+	fds[i] = -1;
+      }
+}
+
+/* Make a ring of size bytes for a client to write to. */
+struct zring *
+zring_new (u_int32_t size)
+{
+  struct zring *ring;
+  int fds[ZRING_FDS];
+  size_t mapped = ZRING_HEADER + size;
+
+  fds[ZRING_FD_MEM] = memfd_create ("zserv-ring",
+				    MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  fds[ZRING_FD_DATA] = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  fds[ZRING_FD_SPACE] = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  if (fds[ZRING_FD_MEM] < 0 || fds[ZRING_FD_DATA] < 0
+      || fds[ZRING_FD_SPACE] < 0
+      || ftruncate (fds[ZRING_FD_MEM], mapped) < 0
+      || fcntl (fds[ZRING_FD_MEM], F_ADD_SEALS, ZRING_SEALS) < 0)
+    {
+      zlog_warn ("%s: can't make ring: %s", __func__, safe_strerror (errno));
+      zring_close_fds (fds);
+      return NULL;
+    }
+
+  if ((ring = zring_map (fds, mapped)) == NULL)
+    {
+      zring_close_fds (fds);
+      return NULL;
+    }
+
+  ring->size = size;
+  ring->shm->magic = ZRING_MAGIC;
+  ring->shm->size = size;
+  ring->shm->reader_idle = 1;
+
+  return ring;
+}
+
+/* Map the ring whose file descriptors a client handed over.  They belong
+   to the ring, or are closed if it is not valid. */
+struct zring *
+zring_attach (int *fds)
+{
+  struct zring *ring;
+  struct stat st;
+  u_int32_t size;
+  int seals;
+
+  seals = fcntl (fds[ZRING_FD_MEM], F_GET_SEALS);
+  if (seals < 0 || ! (seals & F_SEAL_SHRINK))
+    {
+      zlog_warn ("%s: ring memory can shrink", __func__);
+      zring_close_fds (fds);
+      return NULL;
+    }
+
+  if (fstat (fds[ZRING_FD_MEM], &st) < 0
+      || st.st_size < ZRING_HEADER + ZRING_SIZE_MIN
+      || st.st_size > ZRING_HEADER + ZRING_SIZE_MAX
+      || (ring = zring_map (fds, st.st_size)) == NULL)
+    {
+      zring_close_fds (fds);
+      return NULL;
+    }
+
+  size = ring->shm->size;
+  if (ring->shm->magic != ZRING_MAGIC || (size & (size - 1))
+      || size < ZRING_SIZE_MIN || ZRING_HEADER + size > ring->mapped)
+    {
+      zlog_warn ("%s: invalid ring", __func__);
+      zring_free (ring);
+      return NULL;
+    }
+
+  ring->size = size;
+  ring->offset = ring->shm->head;
+  return ring;
+}
+
+void
+zring_free (struct zring *ring)
+{
+  munmap (ring->shm, ring->mapped);
+  zring_close_fds (ring->fd);
+  stream_fifo_free (ring->overflow);
+  XFREE (MTYPE_ZRING, ring);
+}
+
+static void
+zring_wake (struct zring *ring, int which)
+{
+  eventfd_write (ring->fd[which], 1);
+  ring->wakeups++;
+}
+
+/* Put a message into the ring, if there is room for it. */
+static int
+zring_put (struct zring *ring, const u_char *buf, size_t len)
+{
+  struct zring_shm *shm = ring->shm;
+  u_int32_t tail = ring->offset;
+  u_int32_t head, at;
+  size_t first;
+
+  head = shm->head;
+  __sync_synchronize ();
+  if (ring->size - (tail - head) < len)
+    return -1;
+
+  at = tail & (ring->size - 1);
+  first = MIN (len, ring->size - at);
+  memcpy (ZRING_DATA (ring) + at, buf, first);
+  memcpy (ZRING_DATA (ring), buf + first, len - first);
+
+  __sync_synchronize ();
+  shm->tail = ring->offset = tail + len;
+  ring->bytes += len;
+
+  __sync_synchronize ();
+  if (shm->reader_idle
+      && __sync_bool_compare_and_swap (&shm->reader_idle, 1, 0))
+    zring_wake (ring, ZRING_FD_DATA);
+
+  return 0;
+}
+
+/* Put a message into the ring or, when it is full, ask zebra to wake the
+   writer up as it makes room and try again in case it just did. */
+static int
+zring_put_wait (struct zring *ring, const u_char *buf, size_t len)
+{
+  if (zring_put (ring, buf, len) == 0)
+    return 0;
+
+  ring->full++;
+  ring->shm->writer_blocked = 1;
+  __sync_synchronize ();
+  return zring_put (ring, buf, len);
+}
+
+/* Put into the ring what could not go in before.  Returns 1 if the ring
+   is full again, with messages left to put, 0 otherwise. */
+int
+zring_flush (struct zring *ring)
+{
+  struct stream *s;
+
+  while ((s = stream_fifo_head (ring->overflow)) != NULL)
+    {
+      if (zring_put_wait (ring, STREAM_DATA (s), stream_get_endp (s)) < 0)
+	return 1;
+      stream_free (stream_fifo_pop (ring->overflow));
+    }
+  return 0;
+}
+
+/* Write a message to the ring, or keep it for zring_flush() to put it
+   there when the ring is full.  Returns 1 in that case, 0 if the message
+   is in the ring and -1 if it can never be. */
+int
+zring_write (struct zring *ring, const u_char *buf, size_t len)
+{
+  struct stream *s;
+
+  if (len > ring->size)
+    return -1;
+
+  if (! zring_flush (ring) && zring_put_wait (ring, buf, len) == 0)
+    return 0;
+
+  s = stream_new (len);
+  stream_put (s, buf, len);
+  stream_fifo_push (ring->overflow, s);
+  return 1;
+}
+
+/* Number of bytes written which zebra has not read yet. */
+size_t
+zring_pending (struct zring *ring)
+{
+  struct stream *s;
+  size_t pending;
+
+  pending = ring->offset - ring->shm->head;
+  for (s = stream_fifo_head (ring->overflow); s; s = s->next)
+    pending += stream_get_endp (s);
+  return pending;
+}
+
+/* Read as much of the ring as the stream has room for.  Returns the
+   number of bytes read, or -1 if the ring is corrupted. */
+ssize_t
+zring_read (struct zring *ring, struct stream *s)
+{
+  struct zring_shm *shm = ring->shm;
+  u_int32_t head = ring->offset;
+  u_int32_t tail, at;
+  size_t len, first;
+
+  tail = shm->tail;
+  __sync_synchronize ();
+  if (tail - head > ring->size)
+    return -1;
+
+  len = MIN (tail - head, STREAM_WRITEABLE (s));
+  if (len == 0)
+    return 0;
+
+  at = head & (ring->size - 1);
+  first = MIN (len, ring->size - at);
+  stream_put (s, ZRING_DATA (ring) + at, first);
+  stream_put (s, ZRING_DATA (ring), len - first);
+
+  __sync_synchronize ();
+  shm->head = ring->offset = head + len;
+  ring->bytes += len;
+
+  __sync_synchronize ();
+  if (shm->writer_blocked
+      && __sync_bool_compare_and_swap (&shm->writer_blocked, 1, 0))
+    zring_wake (ring, ZRING_FD_SPACE);
+
+  return len;
+}
+
+/* Tell the writer the reader is going to wait for data.  Returns 0 if
+   data came in meanwhile, for the reader to read it instead. */
+int
+zring_idle (struct zring *ring)
+{
+  struct zring_shm *shm = ring->shm;
+
+  shm->reader_idle = 1;
+  __sync_synchronize ();
+  if (shm->tail == ring->offset)
+    return 1;
+
+  __sync_bool_compare_and_swap (&shm->reader_idle, 1, 0);
+  return 0;
+}
+
+/* Clear the wakeups pending on one of the eventfds of the ring. */
+void
+zring_ack (struct zring *ring, int which)
+{
+  eventfd_t count;
+
+  eventfd_read (ring->fd[which], &count);
+}
+
+#endif /* ZSERV_RING */
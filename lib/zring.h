@@ -0,0 +1,83 @@
+/*
+ * Shared memory ring carrying zserv messages from a client to zebra.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_ZRING_H
+#define _ZEBRA_ZRING_H
+
+#include "stream.h"
+
+/* The ring needs anonymous shared memory which can be handed over a
+   UNIX socket and sealed to a fixed size, and eventfds to wake up both
+   ends. */
+#if defined (HAVE_EVENTFD) && defined (HAVE_MEMFD_CREATE) \
+    && defined (F_ADD_SEALS) && ! defined (HAVE_TCP_ZEBRA)
+#define ZSERV_RING
+#endif
+
+/* Bounds of the size of a ring, in bytes, which is a power of 2. */
+#define ZRING_SIZE_MIN          (1 << 16)
+#define ZRING_SIZE_MAX          (1 << 28)
+#define ZRING_SIZE_DEFAULT      (1 << 22)
+
+/* File descriptors of a ring, handed over to zebra in that order: its
+   memory, the eventfd waking up the reader when there is data, and the
+   one waking up the writer when there is room again. */
+#define ZRING_FD_MEM            0
+#define ZRING_FD_DATA           1
+#define ZRING_FD_SPACE          2
+#define ZRING_FDS               3
+
+/* A client writes its messages into the ring as it would to the socket,
+   zebra reads them out as it would from the socket.  Each end only wakes
+   the other one up with an eventfd when that one has said it is going to
+   sleep, so that a steady flow of messages costs no system call.  */
+struct zring
+{
+  struct zring_shm *shm;
+  size_t mapped;
+  u_int32_t size;
+
+  /* Local copy of the offset this end moves forward. */
+  u_int32_t offset;
+
+  int fd[ZRING_FDS];
+
+  /* Messages written while the ring was full, put into it in order as
+     room is made. */
+  struct stream_fifo *overflow;
+
+  /* Statistics. */
+  unsigned long bytes;
+  unsigned long wakeups;
+  unsigned long full;
+};
+
+extern struct zring *zring_new (u_int32_t);
+extern struct zring *zring_attach (int *);
+extern void zring_free (struct zring *);
+extern int zring_write (struct zring *, const u_char *, size_t);
+extern int zring_flush (struct zring *);
+extern size_t zring_pending (struct zring *);
+extern ssize_t zring_read (struct zring *, struct stream *);
+extern int zring_idle (struct zring *);
+extern void zring_ack (struct zring *, int);
+
+#endif /* _ZEBRA_ZRING_H */
@@ -105,6 +105,9 @@ struct ospf6_interface
 
   /* prefix-list name to filter connected prefix */
   char *plist_name;
+
+  /* connected route update left to the end of a bulk interface message */
+  u_char connected_update_pending;
 };
 
 /* interface state */
@@ -28,6 +28,7 @@
 #include "stream.h"
 #include "zclient.h"
 #include "memory.h"
+#include "linklist.h"
 
 #include "ospf6_proto.h"
 #include "ospf6_top.h"
@@ -46,6 +47,51 @@ struct zclient *zclient = NULL;
 
 struct in_addr router_id_zebra;
 
+/* Interfaces whose addresses changed in a bulk interface message,
+   their connected routes rebuilt once when it has been handled. */
+static struct list *ospf6_connected_update_list;
+
+static void
+ospf6_zebra_connected_route_update (struct zclient *zclient,
+                                    struct interface *ifp)
+{
+  struct ospf6_interface *oi = ifp->info;
+
+  if (! zclient->interface_bulk || oi == NULL)
+    {
+      ospf6_interface_connected_route_update (ifp);
+      return;
+    }
+
+  if (oi->connected_update_pending)
+    return;
+
+  if (! ospf6_connected_update_list)
+    ospf6_connected_update_list = list_new ();
+  listnode_add (ospf6_connected_update_list, ifp);
+  oi->connected_update_pending = 1;
+}
+
+static void
+ospf6_zebra_interface_bulk_end (struct zclient *zclient)
+{
+  struct interface *ifp;
+  struct listnode *node, *nnode;
+  struct ospf6_interface *oi;
+
+  if (! ospf6_connected_update_list)
+    return;
+
+  for (ALL_LIST_ELEMENTS (ospf6_connected_update_list, node, nnode, ifp))
+    {
+      if ((oi = ifp->info) == NULL)
+        continue;
+      oi->connected_update_pending = 0;
+      ospf6_interface_connected_route_update (ifp);
+    }
+  list_delete_all_node (ospf6_connected_update_list);
+}
+
 /* Router-id update message from zebra. */
 static int
 ospf6_router_id_update_zebra (int command, struct zclient *zclient,
@@ -121,7 +167,7 @@ ospf6_zebra_if_del (int command, struct zclient *zclient, zebra_size_t length)
   ospf6_interface_if_del (ifp);
 #endif /*0*/
 
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
   return 0;
 }
 
@@ -159,7 +205,7 @@ ospf6_zebra_if_address_update_add (int command, struct zclient *zclient,
 			   buf, sizeof (buf)), c->address->prefixlen);
 
   if (c->address->family == AF_INET6)
-    ospf6_interface_connected_route_update (c->ifp);
+    ospf6_zebra_connected_route_update (zclient, c->ifp);
 
   return 0;
 }
@@ -182,7 +228,7 @@ ospf6_zebra_if_address_update_delete (int command, struct zclient *zclient,
 			   buf, sizeof (buf)), c->address->prefixlen);
 
   if (c->address->family == AF_INET6)
-    ospf6_interface_connected_route_update (c->ifp);
+    ospf6_zebra_connected_route_update (zclient, c->ifp);
 
   return 0;
 }
@@ -566,6 +612,8 @@ ospf6_zebra_init (void)
   zclient->interface_down = ospf6_zebra_if_state_update;
   zclient->interface_address_add = ospf6_zebra_if_address_update_add;
   zclient->interface_address_delete = ospf6_zebra_if_address_update_delete;
+  zclient->interface_bulk_end = ospf6_zebra_interface_bulk_end;
+  zclient->interface_hold = ZAPI_INTERFACE_HOLD;
   zclient->ipv4_route_add = NULL;
   zclient->ipv4_route_delete = NULL;
   zclient->ipv6_route_add = ospf6_zebra_read_ipv6;
@@ -860,7 +860,7 @@ ospf_vl_new (struct ospf *ospf, struct ospf_vl_data *vl_data)
   vi = if_create (ifname, strnlen(ifname, sizeof(ifname)));
   co = connected_new ();
   co->ifp = vi;
-  listnode_add (vi->connected, co);
+  connected_add (vi, co);
 
   p = prefix_ipv4_new ();
   p->family = AF_INET;
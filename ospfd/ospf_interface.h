@@ -91,6 +91,7 @@ struct ospf_if_info
   struct route_table *params;
   struct route_table *oifs;
   unsigned int membership_counts[MEMBER_MAX];	/* multicast group refcnts */
+  u_char update_pending;	/* ospf_if_update() left to end of bulk */
 };
 
 struct ospf_interface;
@@ -143,7 +143,7 @@ ospf_interface_delete (int command, struct zclient *zclient,
     if (rn->info)
       ospf_if_free ((struct ospf_interface *) rn->info);
 
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
   return 0;
 }
 
@@ -248,6 +248,39 @@ ospf_interface_state_down (int command, struct zclient *zclient,
   return 0;
 }
 
+/* Interfaces with addresses added by a bulk interface message, updated
+   once for all of them when it has been handled. */
+static struct list *ospf_if_update_list;
+
+static void
+ospf_if_update_defer (struct interface *ifp)
+{
+  if (IF_OSPF_IF_INFO (ifp)->update_pending)
+    return;
+
+  if (! ospf_if_update_list)
+    ospf_if_update_list = list_new ();
+  listnode_add (ospf_if_update_list, ifp);
+  IF_OSPF_IF_INFO (ifp)->update_pending = 1;
+}
+
+static void
+ospf_interface_bulk_end (struct zclient *zclient)
+{
+  struct listnode *node, *nnode;
+  struct interface *ifp;
+
+  if (! ospf_if_update_list)
+    return;
+
+  for (ALL_LIST_ELEMENTS (ospf_if_update_list, node, nnode, ifp))
+    {
+      IF_OSPF_IF_INFO (ifp)->update_pending = 0;
+      ospf_if_update (NULL, ifp);
+    }
+  list_delete_all_node (ospf_if_update_list);
+}
+
 static int
 ospf_interface_address_add (int command, struct zclient *zclient,
                             zebra_size_t length)
@@ -266,7 +299,10 @@ ospf_interface_address_add (int command, struct zclient *zclient,
       zlog_debug("Zebra: interface %s address add %s", c->ifp->name, buf);
     }
 
-  ospf_if_update (NULL, c->ifp);
+  if (zclient->interface_bulk)
+    ospf_if_update_defer (c->ifp);
+  else
+    ospf_if_update (NULL, c->ifp);
 
 #ifdef HAVE_SNMP
   ospf_snmp_if_update (c->ifp);
@@ -521,6 +557,18 @@ ospf_zebra_delete_discard (struct prefix_ipv4 *p)
     }
 }
 
+/* Have zebra apply the distribute-list of the type itself, not to send
+   the routes it denies at all. */
+static void
+ospf_distribute_list_zebra (struct ospf *ospf, int type)
+{
+  struct access_list *access = NULL;
+
+  if (DISTRIBUTE_NAME (ospf, type))
+    access = access_list_lookup (AFI_IP, DISTRIBUTE_NAME (ospf, type));
+  zebra_redistribute_filter_access_send (zclient, type, AFI_IP, access);
+}
+
 int
 ospf_is_type_redistributed (int type)
 {
@@ -559,6 +607,7 @@ ospf_redistribute_set (struct ospf *ospf, int type, int mtype, int mvalue)
   ospf->dmetric[type].type = mtype;
   ospf->dmetric[type].value = mvalue;
 
+  ospf_distribute_list_zebra (ospf, type);
   zclient_redistribute (ZEBRA_REDISTRIBUTE_ADD, zclient, type);
 
   if (IS_DEBUG_OSPF (zebra, ZEBRA_REDISTRIBUTE))
@@ -897,6 +946,7 @@ ospf_distribute_list_out_set (struct ospf *ospf, int type, const char *name)
 
   /* Set distribute-name. */
   DISTRIBUTE_NAME (ospf, type) = strdup (name);
+  ospf_distribute_list_zebra (ospf, type);
 
   /* If access-list have been set, schedule update timer. */
   if (DISTRIBUTE_LIST (ospf, type))
@@ -920,6 +970,7 @@ ospf_distribute_list_out_unset (struct ospf *ospf, int type, const char *name)
     free (DISTRIBUTE_NAME (ospf, type));
 
   DISTRIBUTE_NAME (ospf, type) = NULL;
+  ospf_distribute_list_zebra (ospf, type);
 
   return CMD_SUCCESS;
 }
@@ -946,6 +997,9 @@ ospf_distribute_list_update_timer (struct thread *thread)
   /* foreach all external info. */
   for (type = 0; type <= ZEBRA_ROUTE_MAX; type++)
     {
+      if (type < ZEBRA_ROUTE_MAX && DISTRIBUTE_NAME (ospf, type))
+	ospf_distribute_list_zebra (ospf, type);
+
       rt = EXTERNAL_INFO (type);
       if (!rt)
 	continue;
@@ -973,8 +1027,8 @@ ospf_distribute_list_update (struct ospf *ospf, int type)
 {
   struct route_table *rt;
 
-  /* External info does not exist. */
-  if (!(rt = EXTERNAL_INFO (type)))
+  /* External info does not exist, unless zebra filtered it all out. */
+  if (!(rt = EXTERNAL_INFO (type)) && !ospf_is_type_redistributed (type))
     return;
 
   /* If exists previously invoked thread, then let it continue. */
@@ -1275,6 +1329,8 @@ ospf_zebra_init ()
   zclient->interface_address_delete = ospf_interface_address_delete;
   zclient->ipv4_route_add = ospf_zebra_read_ipv4;
   zclient->ipv4_route_delete = ospf_zebra_read_ipv4;
+  zclient->interface_bulk_end = ospf_interface_bulk_end;
+  zclient->interface_hold = ZAPI_INTERFACE_HOLD;
 
   access_list_add_hook (ospf_filter_update);
   access_list_delete_hook (ospf_filter_update);
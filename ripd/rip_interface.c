@@ -54,6 +54,7 @@ static int rip_if_down(struct interface *ifp);
 static int rip_enable_if_lookup (const char *ifname);
 static int rip_enable_network_lookup2 (struct connected *connected);
 static void rip_enable_apply_all (void);
+static void rip_enable_defer (struct zclient *, struct interface *);
 
 const struct message ri_version_msg[] =
 {
@@ -371,7 +372,7 @@ rip_interface_up (int command, struct zclient *zclient, zebra_size_t length)
 	       ifp->name, ifp->ifindex, ifp->flags, ifp->metric, ifp->mtu);
 
   /* Check if this interface is RIP enabled or not.*/
-  rip_enable_apply (ifp);
+  rip_enable_defer (zclient, ifp);
  
   /* Check for a passive interface */
   rip_passive_interface_apply (ifp);
@@ -435,7 +436,7 @@ rip_interface_delete (int command, struct zclient *zclient,
   
   /* To support pseudo interface do not free interface structure.  */
   /* if_delete(ifp); */
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 
   return 0;
 }
@@ -625,7 +626,7 @@ rip_interface_address_add (int command, struct zclient *zclient,
 	zlog_debug ("connected address %s/%d is added", 
 		   inet_ntoa (p->u.prefix4), p->prefixlen);
 
-      rip_enable_apply(ifc->ifp);
+      rip_enable_defer (zclient, ifc->ifp);
       /* Check if this prefix needs to be redistributed */
       rip_apply_address_add(ifc);
 
@@ -1000,6 +1001,47 @@ rip_enable_apply_all ()
     rip_enable_apply (ifp);
 }
 
+/* Interfaces brought up or given addresses by a bulk interface message,
+   checked once for all of them when it has been handled. */
+static struct list *rip_enable_list;
+
+static void
+rip_enable_defer (struct zclient *zclient, struct interface *ifp)
+{
+  struct rip_interface *ri = ifp->info;
+
+  if (! zclient->interface_bulk)
+    {
+      rip_enable_apply (ifp);
+      return;
+    }
+
+  if (ri->enable_pending)
+    return;
+
+  if (! rip_enable_list)
+    rip_enable_list = list_new ();
+  listnode_add (rip_enable_list, ifp);
+  ri->enable_pending = 1;
+}
+
+void
+rip_interface_bulk_end (struct zclient *zclient)
+{
+  struct interface *ifp;
+  struct listnode *node, *nnode;
+
+  if (! rip_enable_list)
+    return;
+
+  for (ALL_LIST_ELEMENTS (rip_enable_list, node, nnode, ifp))
+    {
+      ((struct rip_interface *) ifp->info)->enable_pending = 0;
+      rip_enable_apply (ifp);
+    }
+  list_delete_all_node (rip_enable_list);
+}
+
 int
 rip_neighbor_lookup (struct sockaddr_in *from)
 {
@@ -80,6 +80,9 @@ struct rip_interface
 
   /* Passive interface. */
   int passive;
+
+  /* rip_enable_apply() left to the end of a bulk interface message. */
+  int enable_pending;
 };
 
 extern int rip_interface_down (int , struct zclient *, zebra_size_t);
@@ -88,6 +91,7 @@ extern int rip_interface_add (int , struct zclient *, zebra_size_t);
 extern int rip_interface_delete (int , struct zclient *, zebra_size_t);
 extern int rip_interface_address_add (int , struct zclient *, zebra_size_t);
 extern int rip_interface_address_delete (int , struct zclient *, zebra_size_t);
+extern void rip_interface_bulk_end (struct zclient *);
 extern void rip_interface_multicast_set (int, struct connected *);
 extern void rip_interface_clean (void);
 extern void rip_interface_reset (void);
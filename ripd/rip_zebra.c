@@ -675,6 +675,8 @@ rip_zclient_init ()
   zclient->ipv4_route_delete = rip_zebra_read_ipv4;
   zclient->interface_up = rip_interface_up;
   zclient->interface_down = rip_interface_down;
+  zclient->interface_bulk_end = rip_interface_bulk_end;
+  zclient->interface_hold = ZAPI_INTERFACE_HOLD;
   
   /* Install zebra node. */
   install_node (&zebra_node, config_write_zebra);
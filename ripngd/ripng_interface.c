@@ -55,6 +55,7 @@ static void ripng_passive_interface_apply (struct interface *);
 static int ripng_enable_if_lookup (const char *);
 static int ripng_enable_network_lookup2 (struct connected *);
 static void ripng_enable_apply_all (void);
+static void ripng_enable_defer (struct zclient *, struct interface *);
 
 /* Join to the all rip routers multicast group. */
 static int
@@ -231,7 +232,7 @@ ripng_interface_up (int command, struct zclient *zclient, zebra_size_t length)
 	       ifp->name, ifp->ifindex, ifp->flags, ifp->metric, ifp->mtu6);
 
   /* Check if this interface is RIPng enabled or not. */
-  ripng_enable_apply (ifp);
+  ripng_enable_defer (zclient, ifp);
 
   /* Check for a passive interface. */
   ripng_passive_interface_apply (ifp);
@@ -313,7 +314,7 @@ ripng_interface_delete (int command, struct zclient *zclient,
 
   /* To support pseudo interface do not free interface structure.  */
   /* if_delete(ifp); */
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 
   return 0;
 }
@@ -433,7 +434,7 @@ ripng_interface_address_add (int command, struct zclient *zclient,
       /* Let's try once again whether the interface could be activated */
       if (!ri->running) {
         /* Check if this interface is RIP enabled or not.*/
-        ripng_enable_apply (c->ifp);
+        ripng_enable_defer (zclient, c->ifp);
 
         /* Apply distribute list to the interface. */
         ripng_distribute_update_interface (c->ifp);
@@ -808,6 +809,47 @@ ripng_enable_apply_all (void)
   for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
     ripng_enable_apply (ifp);
 }
+
+/* Interfaces brought up or given addresses by a bulk interface message,
+   checked once for all of them when it has been handled. */
+static struct list *ripng_enable_list;
+
+static void
+ripng_enable_defer (struct zclient *zclient, struct interface *ifp)
+{
+  struct ripng_interface *ri = ifp->info;
+
+  if (! zclient->interface_bulk)
+    {
+      ripng_enable_apply (ifp);
+      return;
+    }
+
+  if (ri->enable_pending)
+    return;
+
+  if (! ripng_enable_list)
+    ripng_enable_list = list_new ();
+  listnode_add (ripng_enable_list, ifp);
+  ri->enable_pending = 1;
+}
+
+void
+ripng_interface_bulk_end (struct zclient *zclient)
+{
+  struct interface *ifp;
+  struct listnode *node, *nnode;
+
+  if (! ripng_enable_list)
+    return;
+
+  for (ALL_LIST_ELEMENTS (ripng_enable_list, node, nnode, ifp))
+    {
+      ((struct ripng_interface *) ifp->info)->enable_pending = 0;
+      ripng_enable_apply (ifp);
+    }
+  list_delete_all_node (ripng_enable_list);
+}
 
 /* Clear all network and neighbor configuration */
 void
@@ -1196,7 +1238,7 @@ void
 ripng_if_init ()
 {
   /* Interface initialize. */
-  iflist = list_new ();
+  if_init ();
   if_add_hook (IF_NEW_HOOK, ripng_if_new_hook);
   if_add_hook (IF_DELETE_HOOK, ripng_if_delete_hook);
 
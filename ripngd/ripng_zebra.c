@@ -510,6 +510,8 @@ zebra_init ()
   zclient->interface_delete = ripng_interface_delete;
   zclient->interface_address_add = ripng_interface_address_add;
   zclient->interface_address_delete = ripng_interface_address_delete;
+  zclient->interface_bulk_end = ripng_interface_bulk_end;
+  zclient->interface_hold = ZAPI_INTERFACE_HOLD;
   zclient->ipv6_route_add = ripng_zebra_read_ipv6;
   zclient->ipv6_route_delete = ripng_zebra_read_ipv6;
   
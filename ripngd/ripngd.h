@@ -283,6 +283,9 @@ struct ripng_interface
 
   /* Passive interface. */
   int passive;
+
+  /* ripng_enable_apply() left to the end of a bulk interface message. */
+  int enable_pending;
 };
 
 /* RIPng peer information. */
@@ -415,6 +418,7 @@ extern int ripng_interface_add (int command, struct zclient *, zebra_size_t);
 extern int ripng_interface_delete (int command, struct zclient *, zebra_size_t);
 extern int ripng_interface_address_add (int command, struct zclient *, zebra_size_t);
 extern int ripng_interface_address_delete (int command, struct zclient *, zebra_size_t);
+extern void ripng_interface_bulk_end (struct zclient *);
 
 extern int ripng_network_write (struct vty *, int);
 
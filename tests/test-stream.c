@@ -1,6 +1,7 @@
 #include <zebra.h>
 #include <stream.h>
 #include <thread.h>
+#include <zclient.h>
 
 static long int ham = 0xdeadbeefdeadbeef;
 struct thread_master *master;
@@ -27,10 +28,106 @@ print_stream (struct stream *s)
   stream_set_getp (s, getp);
 }
 
+/* Read zserv messages of TEST_MSG_LEN bytes from a socket as zserv.c and
+   zclient.c do: as many as there are at once, framing them with the
+   zapi_frame() they share, handling the complete ones and keeping a
+   partial one at the start of the stream for the next read to complete. */
+#define TEST_MSGS     5
+#define TEST_MSG_LEN  (ZEBRA_HEADER_SIZE + 4)
+
+static int
+read_messages (struct stream *s, int fd, int next)
+{
+  ssize_t nbyte;
+  int length;
+
+  stream_pulldown (s);
+  assert (stream_get_getp (s) == 0);
+  nbyte = stream_read_try (s, fd, STREAM_WRITEABLE (s));
+  assert (nbyte > 0);
+
+  while ((length = zapi_frame (s, fd)) > 0)
+    {
+      assert (length == TEST_MSG_LEN);
+      assert (stream_getw (s) == TEST_MSG_LEN);
+      assert (stream_getc (s) == ZEBRA_HEADER_MARKER);
+      assert (stream_getc (s) == ZSERV_VERSION);
+      assert (stream_getw (s) == ZEBRA_HELLO);
+      assert (stream_getw (s) == next);
+      assert (stream_getw (s) == (next ^ 0xa5a5));
+      next++;
+    }
+  assert (length == 0);
+  return next;
+}
+
+static void
+test_read_messages (void)
+{
+  struct stream *s, *out;
+  int fds[2];
+  int i;
+  int next;
+  ssize_t nbyte;
+
+  i = socketpair (AF_UNIX, SOCK_STREAM, 0, fds);
+  assert (i == 0);
+
+  out = stream_new (TEST_MSGS * TEST_MSG_LEN);
+  for (i = 0; i < TEST_MSGS; i++)
+    {
+      size_t start = stream_get_endp (out);
+
+      zclient_create_header (out, ZEBRA_HELLO);
+      stream_putw (out, i);
+      stream_putw (out, i ^ 0xa5a5);
+      stream_putw_at (out, start, stream_get_endp (out) - start);
+    }
+  assert (stream_get_endp (out) == TEST_MSGS * TEST_MSG_LEN);
+
+  /* Two messages and a half in one read, the rest in the next. */
+  s = stream_new (64);
+  nbyte = write (fds[1], STREAM_DATA (out), 25);
+  assert (nbyte == 25);
+  next = read_messages (s, fds[0], 0);
+  assert (next == 2);
+  assert (STREAM_READABLE (s) == 5);
+
+  nbyte = write (fds[1], STREAM_DATA (out) + 25, 25);
+  assert (nbyte == 25);
+  next = read_messages (s, fds[0], next);
+  assert (next == TEST_MSGS);
+  assert (STREAM_READABLE (s) == 0);
+
+  /* The partial message was moved to the start of the stream before the
+     rest of it was read after it. */
+  assert (stream_get_endp (s) == 5 + 25);
+
+  /* Neither a header too short for itself nor one with the wrong marker
+     is framed. */
+  stream_reset (s);
+  stream_putw (s, ZEBRA_HEADER_SIZE - 1);
+  stream_putc (s, ZEBRA_HEADER_MARKER);
+  stream_putc (s, ZSERV_VERSION);
+  stream_putw (s, ZEBRA_HELLO);
+  assert (zapi_frame (s, fds[0]) == -1);
+  stream_putw_at (s, 0, ZEBRA_HEADER_SIZE);
+  stream_putc_at (s, 2, 0);
+  assert (zapi_frame (s, fds[0]) == -1);
+
+  printf ("read %d messages\n", next);
+
+  stream_free (s);
+  stream_free (out);
+  close (fds[0]);
+  close (fds[1]);
+}
+
 int
 main (void)
 {
   struct stream *s;
+  size_t endp;
   
   s = stream_new (1024);
   
@@ -50,5 +147,21 @@ main (void)
   printf ("l: 0x%x\n", stream_getl (s));
   printf ("q: 0x%lx\n", stream_getq (s));
   
+  /* The unread bytes move to the start of the stream. */
+  endp = stream_get_endp (s);
+  stream_set_getp (s, 7);
+  stream_pulldown (s);
+  
+  print_stream (s);
+  
+  assert (stream_get_getp (s) == 0);
+  assert (stream_get_endp (s) == endp - 7);
+  assert (stream_getq (s) == (uint64_t) ham);
+  assert (STREAM_READABLE (s) == 0);
+  
+  stream_free (s);
+  
+  test_read_messages ();
+  
   return 0;
 }
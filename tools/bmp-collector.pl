@@ -0,0 +1,87 @@
+#! /usr/bin/perl
+##
+## Minimal BMP (RFC 7854) collector for testing bgpd's exporter.
+## Accepts connections and prints one line per message received.
+##
+## usage: bmp-collector.pl [port]
+##
+use strict;
+use Socket;
+use IO::Socket::INET;
+
+$| = 1;
+
+my $port = shift || 5000;
+my @types = ("route-monitoring", "statistics", "peer-down", "peer-up",
+	     "initiation", "termination");
+
+my $server = IO::Socket::INET->new (LocalPort => $port, Listen => 5,
+				    Proto => 'tcp', ReuseAddr => 1)
+  or die "can't listen on port $port: $!";
+
+## Read exactly $len bytes, undef on EOF.
+sub readn {
+    my ($sock, $len) = @_;
+    my $buf = '';
+    while (length ($buf) < $len) {
+	my $n = sysread ($sock, $buf, $len - length ($buf), length ($buf));
+	return undef if (!$n);
+    }
+    return $buf;
+}
+
+sub peer_str {
+    my ($flags, $addr) = @_;
+    return ($flags & 0x80) ? join (":", unpack ("(H4)8", $addr))
+			   : inet_ntoa (substr ($addr, 12, 4));
+}
+
+## Print the IPv4 prefixes of a length-delimited NLRI field.
+sub prefixes {
+    my ($data) = @_;
+    my @list;
+    while (length ($data)) {
+	my $plen = unpack ("C", $data);
+	my $bytes = int (($plen + 7) / 8);
+	my $addr = substr ($data, 1, $bytes) . "\0" x (4 - $bytes);
+	push (@list, inet_ntoa ($addr) . "/$plen");
+	$data = substr ($data, 1 + $bytes);
+    }
+    return join (" ", @list);
+}
+
+while (my $client = $server->accept ()) {
+    printf ("connection from %s\n", $client->peerhost ());
+    while (defined (my $hdr = readn ($client, 6))) {
+	my ($version, $len, $type) = unpack ("CNC", $hdr);
+	die "bad BMP version $version" if ($version != 3);
+	my $msg = readn ($client, $len - 6);
+	last if (!defined ($msg));
+
+	my $line = $types[$type] || "type-$type";
+	if ($type <= 3) {
+	    my ($ptype, $flags, $dist, $addr, $as, $id, $sec) =
+	      unpack ("CCa8a16Na4N", $msg);
+	    $line .= sprintf (" peer %s AS%u%s", peer_str ($flags, $addr), $as,
+			      ($flags & 0x40) ? " post-policy" : "");
+	    my $body = substr ($msg, 42);
+	    if ($type == 0) {
+		my $update = substr ($body, 19);
+		my $wlen = unpack ("n", $update);
+		my $withdrawn = substr ($update, 2, $wlen);
+		my $alen = unpack ("n", substr ($update, 2 + $wlen));
+		my $nlri = substr ($update, 4 + $wlen + $alen);
+		$line .= " withdraw " . prefixes ($withdrawn) if ($wlen);
+		$line .= " announce " . prefixes ($nlri) if (length ($nlri));
+		$line .= " (mp)" if (!$wlen && !length ($nlri));
+	    } elsif ($type == 1) {
+		$line .= sprintf (" %u counters", unpack ("N", $body));
+	    } elsif ($type == 2) {
+		$line .= sprintf (" reason %u", unpack ("C", $body));
+	    }
+	}
+	print "$line\n";
+    }
+    print "connection closed\n";
+    close ($client);
+}
@@ -63,7 +63,7 @@ connected_withdraw (struct connected *ifc)
 
   if (!CHECK_FLAG (ifc->conf, ZEBRA_IFC_CONFIGURED))
     {
-      listnode_delete (ifc->ifp->connected, ifc);
+      connected_delete (ifc->ifp, ifc);
 #ifdef RTADV
       rtadv_refresh_connected (ifc->ifp);
 #endif /* RTADV */
@@ -77,7 +77,7 @@ connected_announce (struct interface *ifp, struct connected *ifc)
   if (!ifc)
     return;
   
-  listnode_add (ifp->connected, ifc);
+  connected_add (ifp, ifc);
 #ifdef RTADV
   rtadv_refresh_connected (ifp);
 #endif /* RTADV */
@@ -199,8 +199,6 @@ connected_up_ipv4 (struct interface *ifp, struct connected *ifc)
 
   rib_add_ipv4 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, NULL, ifp->ifindex,
 	RT_TABLE_MAIN, ifp->metric, 0, SAFI_MULTICAST);
-
-  rib_update ();
 }
 
 /* Add connected IPv4 route to the interface. */
@@ -307,8 +305,6 @@ connected_down_ipv4 (struct interface *ifp, struct connected *ifc)
   rib_delete_ipv4 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, 0, SAFI_UNICAST);
 
   rib_delete_ipv4 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, 0, SAFI_MULTICAST);
-
-  rib_update ();
 }
 
 /* Delete connected IPv4 route to the interface. */
@@ -329,8 +325,6 @@ connected_delete_ipv4 (struct interface *ifp, int flags, struct in_addr *addr,
     return;
     
   connected_withdraw (ifc);
-
-  rib_update();
 }
 
 #ifdef HAVE_IPV6
@@ -355,8 +349,6 @@ connected_up_ipv6 (struct interface *ifp, struct connected *ifc)
 
   rib_add_ipv6 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, RT_TABLE_MAIN,
                 ifp->metric, 0, SAFI_UNICAST);
-
-  rib_update ();
 }
 
 /* Add connected IPv6 route to the interface. */
@@ -429,8 +421,6 @@ connected_down_ipv6 (struct interface *ifp, struct connected *ifc)
     return;
 
   rib_delete_ipv6 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, 0, SAFI_UNICAST);
-
-  rib_update ();
 }
 
 void
@@ -450,7 +440,5 @@ connected_delete_ipv6 (struct interface *ifp, struct in6_addr *address,
     return;
 
   connected_withdraw (ifc);
-
-  rib_update();
 }
 #endif /* HAVE_IPV6 */
@@ -74,6 +74,10 @@ if_zebra_delete_hook (struct interface *ifp)
       if (zebra_if->ipv4_subnets)
 	route_table_finish (zebra_if->ipv4_subnets);
 
+#ifdef RTADV
+      rtadv_if_delete_hook (ifp);
+#endif /* RTADV */
+
       XFREE (MTYPE_TMP, zebra_if);
     }
 
@@ -414,7 +418,7 @@ if_delete_update (struct interface *ifp)
 		  /* Remove from interface address list (unconditionally). */
 		  if (!CHECK_FLAG (ifc->conf, ZEBRA_IFC_CONFIGURED))
 		    {
-		      listnode_delete (ifp->connected, ifc);
+		      connected_delete (ifp, ifc);
 		      connected_free (ifc);
                     }
                   else
@@ -439,7 +443,7 @@ if_delete_update (struct interface *ifp)
 		last = node;
 	      else
 		{
-		  listnode_delete (ifp->connected, ifc);
+		  connected_delete (ifp, ifc);
 		  connected_free (ifc);
 #ifdef RTADV
 		  rtadv_refresh_connected (ifp);
@@ -460,7 +464,7 @@ if_delete_update (struct interface *ifp)
      while processing the deletion.  Each client daemon is responsible
      for setting ifindex to IFINDEX_INTERNAL after processing the
      interface deletion message. */
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 }
 
 /* Interface is up. */
@@ -492,7 +496,7 @@ if_up (struct interface *ifp)
     }
 
   /* Examine all static routes. */
-  rib_update ();
+  rib_update_interface (ifp);
 }
 
 /* Interface goes down.  We have to manage different behavior of based
@@ -525,7 +529,7 @@ if_down (struct interface *ifp)
     }
 
   /* Examine all static routes which direct to the interface. */
-  rib_update ();
+  rib_update_interface (ifp);
 }
 
 void
@@ -1113,7 +1117,7 @@ ip_address_install (struct vty *vty, struct interface *ifp,
 	ifc->label = XSTRDUP (MTYPE_CONNECTED_LABEL, label);
 
       /* Add to linked list. */
-      listnode_add (ifp->connected, ifc);
+      connected_add (ifp, ifc);
     }
 
   /* This address is configured from zebra. */
@@ -1191,7 +1195,7 @@ ip_address_uninstall (struct vty *vty, struct interface *ifp,
   if (! CHECK_FLAG (ifc->conf, ZEBRA_IFC_REAL)
       || ! CHECK_FLAG (ifp->status, ZEBRA_INTERFACE_ACTIVE))
     {
-      listnode_delete (ifp->connected, ifc);
+      connected_delete (ifp, ifc);
       connected_free (ifc);
       return CMD_WARNING;
     }
@@ -1213,7 +1217,7 @@ ip_address_uninstall (struct vty *vty, struct interface *ifp,
   connected_down_ipv4 (ifp, ifc);
 
   /* Free address information. */
-  listnode_delete (ifp->connected, ifc);
+  connected_delete (ifp, ifc);
   connected_free (ifc);
 #endif
 
@@ -1306,7 +1310,7 @@ ipv6_address_install (struct vty *vty, struct interface *ifp,
 	ifc->label = XSTRDUP (MTYPE_CONNECTED_LABEL, label);
 
       /* Add to linked list. */
-      listnode_add (ifp->connected, ifc);
+      connected_add (ifp, ifc);
 #ifdef RTADV
       rtadv_refresh_connected (ifp);
 #endif /* RTADV */
@@ -1383,7 +1387,7 @@ ipv6_address_uninstall (struct vty *vty, struct interface *ifp,
   if (! CHECK_FLAG (ifc->conf, ZEBRA_IFC_REAL)
       || ! CHECK_FLAG (ifp->status, ZEBRA_INTERFACE_ACTIVE))
     {
-      listnode_delete (ifp->connected, ifc);
+      connected_delete (ifp, ifc);
       connected_free (ifc);
 #ifdef RTADV
       rtadv_refresh_connected (ifp);
@@ -1407,7 +1411,7 @@ ipv6_address_uninstall (struct vty *vty, struct interface *ifp,
   connected_down_ipv6 (ifp, ifc);
 
   /* Free address information. */
-  listnode_delete (ifp->connected, ifc);
+  connected_delete (ifp, ifc);
   connected_free (ifc);
 #ifdef RTADV
   rtadv_refresh_connected (ifp);
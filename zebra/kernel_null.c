@@ -12,6 +12,9 @@ int kernel_add_ipv4 (struct prefix *a, struct rib *b) { return 0; }
 #pragma weak kernel_delete_ipv4 = kernel_add_ipv4
 int kernel_add_ipv6 (struct prefix *a, struct rib *b) { return 0; }
 #pragma weak kernel_delete_ipv6 = kernel_add_ipv6
+int kernel_replace_ipv4 (struct prefix *a, struct rib *b, struct rib *c)
+{ return 0; }
+#pragma weak kernel_replace_ipv6 = kernel_replace_ipv4
 int kernel_delete_ipv6_old (struct prefix_ipv6 *dest, struct in6_addr *gate,
                             unsigned int index, int flags, int table)
 { return 0; }
@@ -19,6 +22,13 @@ int kernel_delete_ipv6_old (struct prefix_ipv6 *dest, struct in6_addr *gate,
 int kernel_add_route (struct prefix_ipv4 *a, struct in_addr *b, int c, int d)
 { return 0; }
 
+int kernel_nhg_add (struct nhg *a) { return -1; }
+#pragma weak kernel_nhg_delete = kernel_nhg_add
+
+void kernel_flush (void) { return; }
+void kernel_dplane_show (struct vty *a) { return; }
+#pragma weak kernel_netlink_show = kernel_dplane_show
+
 int kernel_address_add_ipv4 (struct interface *a, struct connected *b)
 {
   zlog_debug ("%s", __func__);
@@ -278,7 +278,7 @@ ifan_read (struct if_announcemsghdr *ifan)
       ifp = if_get_by_name_len(ifan->ifan_name,
 			       strnlen(ifan->ifan_name,
 				       sizeof(ifan->ifan_name)));
-      ifp->ifindex = ifan->ifan_index;
+      if_set_index (ifp, ifan->ifan_index);
 
       if_add_update (ifp);
     }
@@ -442,7 +442,7 @@ ifm_read (struct if_msghdr *ifm)
        * Fill in newly created interface structure, or larval
        * structure with ifindex IFINDEX_INTERNAL.
        */
-      ifp->ifindex = ifm->ifm_index;
+      if_set_index (ifp, ifm->ifm_index);
       
 #ifdef HAVE_BSD_LINK_DETECT /* translate BSD kernel msg for link-state */
       bsd_linkdetect_translate(ifm);
@@ -58,6 +58,10 @@ int retain_mode = 0;
 /* Don't delete kernel route. */
 int keep_kernel_mode = 0;
 
+/* Seconds the routes left in the kernel by a previous run are given to
+   be installed again, 0 to delete them at startup. */
+int graceful_restart_time = 0;
+
 #ifdef HAVE_NETLINK
 /* Receive buffer size for netlink socket */
 u_int32_t nl_rcvbufsize = 0;
@@ -76,6 +80,7 @@ struct option longopts[] =
   { "vty_addr",    required_argument, NULL, 'A'},
   { "vty_port",    required_argument, NULL, 'P'},
   { "retain",      no_argument,       NULL, 'r'},
+  { "graceful_restart", required_argument, NULL, 'K'},
   { "dryrun",      no_argument,       NULL, 'C'},
 #ifdef HAVE_NETLINK
   { "nl-bufsize",  required_argument, NULL, 's'},
@@ -132,6 +137,12 @@ usage (char *progname, int status)
 	      "-z, --socket       Set path of zebra socket\n"\
 	      "-k, --keep_kernel  Don't delete old routes which installed by "\
 				  "zebra.\n"\
+	      "-K, --graceful_restart\n"\
+	      "                   Keep old routes installed by zebra for the "\
+				  "given\n"\
+	      "                   seconds and only update those installed "\
+				  "again\n"\
+	      "                   differently.\n"\
 	      "-C, --dryrun       Check configuration for validity and exit\n"\
 	      "-A, --vty_addr     Set vty's bind address\n"\
 	      "-P, --vty_port     Set vty's port number\n"\
@@ -232,9 +243,9 @@ main (int argc, char **argv)
       int opt;
   
 #ifdef HAVE_NETLINK  
-      opt = getopt_long (argc, argv, "bdkf:i:z:hA:P:ru:g:vs:C", longopts, 0);
+      opt = getopt_long (argc, argv, "bdkK:f:i:z:hA:P:ru:g:vs:C", longopts, 0);
 #else
-      opt = getopt_long (argc, argv, "bdkf:i:z:hA:P:ru:g:vC", longopts, 0);
+      opt = getopt_long (argc, argv, "bdkK:f:i:z:hA:P:ru:g:vC", longopts, 0);
 #endif /* HAVE_NETLINK */
 
       if (opt == EOF)
@@ -252,6 +263,11 @@ main (int argc, char **argv)
 	case 'k':
 	  keep_kernel_mode = 1;
 	  break;
+	case 'K':
+	  graceful_restart_time = atoi (optarg);
+	  if (graceful_restart_time < 0)
+	    graceful_restart_time = 0;
+	  break;
 	case 'C':
 	  dryrun = 1;
 	  break;
@@ -387,7 +403,9 @@ main (int argc, char **argv)
   *  will be equal to the current getpid(). To know about such routes,
   * we have to have route_read() called before.
   */
-  if (! keep_kernel_mode)
+  if (! keep_kernel_mode && graceful_restart_time)
+    rib_retain_route (graceful_restart_time);
+  else if (! keep_kernel_mode)
     rib_sweep_route ();
 
   /* Needed for BSD routing socket. */
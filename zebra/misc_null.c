@@ -4,7 +4,15 @@
 #include "zebra/rtadv.h"
 #include "zebra/irdp.h"
 #include "zebra/interface.h"
+#include "zebra/ipforward.h"
 
 void ifstat_update_proc (void) { return; }
 #pragma weak irdp_config_write = ifstat_update_proc
 #pragma weak ifstat_update_sysctl = ifstat_update_proc
+
+int ipforward (void) { return 0; }
+#pragma weak ipforward_on = ipforward
+#pragma weak ipforward_off = ipforward
+#pragma weak ipforward_ipv6 = ipforward
+#pragma weak ipforward_ipv6_on = ipforward
+#pragma weak ipforward_ipv6_off = ipforward
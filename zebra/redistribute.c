@@ -30,6 +30,7 @@
 #include "zclient.h"
 #include "linklist.h"
 #include "log.h"
+#include "plist.h"
 
 #include "zebra/rib.h"
 #include "zebra/zserv.h"
@@ -84,6 +85,22 @@ is_default (struct prefix *p)
   return 0;
 }
 
+/* Whether the client wants route p of rib->type, as its redistribution
+   filter for them says.  The default route is never filtered. */
+static int
+zebra_redistribute_permit (struct zserv *client, struct prefix *p,
+			   struct rib *rib)
+{
+  struct prefix_list *plist;
+
+  plist = client->redist_filter[family2afi (p->family)][rib->type];
+  if (! plist || prefix_list_apply (plist, p) == PREFIX_PERMIT)
+    return 1;
+
+  client->redist_filtered++;
+  return 0;
+}
+
 static void
 zebra_redistribute_default (struct zserv *client)
 {
@@ -152,7 +169,9 @@ zebra_redistribute (struct zserv *client, int type)
 	if (CHECK_FLAG (newrib->flags, ZEBRA_FLAG_SELECTED) 
 	    && newrib->type == type 
 	    && newrib->distance != DISTANCE_INFINITY
-	    && zebra_check_addr (&rn->p))
+	    && zebra_check_addr (&rn->p)
+	    && (is_default (&rn->p)
+		|| zebra_redistribute_permit (client, &rn->p, newrib)))
 	  zsend_route_multipath (ZEBRA_IPV4_ROUTE_ADD, client, &rn->p, newrib);
   
 #ifdef HAVE_IPV6
@@ -163,7 +182,9 @@ zebra_redistribute (struct zserv *client, int type)
 	if (CHECK_FLAG (newrib->flags, ZEBRA_FLAG_SELECTED)
 	    && newrib->type == type 
 	    && newrib->distance != DISTANCE_INFINITY
-	    && zebra_check_addr (&rn->p))
+	    && zebra_check_addr (&rn->p)
+	    && (is_default (&rn->p)
+		|| zebra_redistribute_permit (client, &rn->p, newrib)))
 	  zsend_route_multipath (ZEBRA_IPV6_ROUTE_ADD, client, &rn->p, newrib);
 #endif /* HAVE_IPV6 */
 }
@@ -188,7 +209,8 @@ redistribute_add (struct prefix *p, struct rib *rib)
 #endif /* HAVE_IPV6 */	  
 	    }
         }
-      else if (client->redist[rib->type])
+      else if (client->redist[rib->type]
+	       && zebra_redistribute_permit (client, p, rib))
         {
           if (p->family == AF_INET)
             zsend_route_multipath (ZEBRA_IPV4_ROUTE_ADD, client, p, rib);
@@ -226,7 +248,8 @@ redistribute_delete (struct prefix *p, struct rib *rib)
 #endif /* HAVE_IPV6 */
 	    }
 	}
-      else if (client->redist[rib->type])
+      else if (client->redist[rib->type]
+	       && zebra_redistribute_permit (client, p, rib))
 	{
 	  if (p->family == AF_INET)
 	    zsend_route_multipath (ZEBRA_IPV4_ROUTE_DELETE, client, p, rib);
@@ -282,6 +305,133 @@ zebra_redistribute_default_delete (int command, struct zserv *client,
   client->redist_default = 0;;
 }     
 
+/* Send the client the routes of the type which the new filter of the
+   address family permits and the old one did not, and withdraw those it
+   no longer does. */
+static void
+zebra_redistribute_refilter (struct zserv *client, int type, afi_t afi,
+			     struct prefix_list *old, struct prefix_list *new)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  struct rib *rib;
+  int before, after;
+
+  table = vrf_table (afi, SAFI_UNICAST, 0);
+  if (! table)
+    return;
+
+  for (rn = route_top (table); rn; rn = route_next (rn))
+    for (rib = rn->info; rib; rib = rib->next)
+      {
+	if (! CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED)
+	    || rib->type != type
+	    || rib->distance == DISTANCE_INFINITY
+	    || ! zebra_check_addr (&rn->p)
+	    || is_default (&rn->p))
+	  continue;
+
+	before = ! old || prefix_list_apply (old, &rn->p) == PREFIX_PERMIT;
+	after = ! new || prefix_list_apply (new, &rn->p) == PREFIX_PERMIT;
+	if (before == after)
+	  continue;
+
+	if (afi == AFI_IP)
+	  zsend_route_multipath (after ? ZEBRA_IPV4_ROUTE_ADD
+				 : ZEBRA_IPV4_ROUTE_DELETE, client, &rn->p, rib);
+#ifdef HAVE_IPV6
+	else
+	  zsend_route_multipath (after ? ZEBRA_IPV6_ROUTE_ADD
+				 : ZEBRA_IPV6_ROUTE_DELETE, client, &rn->p, rib);
+#endif /* HAVE_IPV6 */
+      }
+}
+
+/* The client gives the prefix-list the routes of a type redistributed to
+   it are to be filtered with, in the format of the BGP ORF entries, or
+   none for the filter to be removed.  It is kept in the prefix-lists of
+   the ORF, under a name of its own. */
+void
+zebra_redistribute_filter (int command, struct zserv *client, int length)
+{
+  struct stream *s = client->ibuf;
+  struct prefix_list *old, *new;
+  struct orf_prefix orfp;
+  char name[64];
+  int type;
+  afi_t afi;
+  u_char flag;
+  int psize;
+
+  if (STREAM_READABLE (s) < 3)
+    return;
+  type = stream_getc (s);
+  afi = stream_getw (s);
+  if (type == 0 || type >= ZEBRA_ROUTE_MAX
+      || (afi != AFI_IP && afi != AFI_IP6))
+    return;
+
+  snprintf (name, sizeof (name), "zserv %d %s %u", client->sock,
+	    zebra_route_string (type), ++client->redist_filter_gen);
+
+  while (STREAM_READABLE (s))
+    {
+      memset (&orfp, 0, sizeof (struct orf_prefix));
+      if (STREAM_READABLE (s) < 8)
+	goto malformed;
+      flag = stream_getc (s);
+      orfp.seq = stream_getl (s);
+      orfp.ge = stream_getc (s);
+      orfp.le = stream_getc (s);
+      orfp.p.family = afi2family (afi);
+      orfp.p.prefixlen = stream_getc (s);
+      psize = PSIZE (orfp.p.prefixlen);
+      if (psize > prefix_blen (&orfp.p) || STREAM_READABLE (s) < (size_t) psize)
+	goto malformed;
+      stream_get (&orfp.p.u.prefix, s, psize);
+
+      if (prefix_bgp_orf_set (name, afi, &orfp,
+			      CHECK_FLAG (flag, ZAPI_FILTER_PERMIT), 1)
+	  != CMD_SUCCESS)
+	goto malformed;
+    }
+
+  old = client->redist_filter[afi][type];
+  new = prefix_list_lookup (AFI_ORF_PREFIX, name);
+  client->redist_filter[afi][type] = new;
+
+  if (IS_ZEBRA_DEBUG_EVENT)
+    zlog_debug ("client %d %s %s redistribution filter", client->sock,
+		new ? "sets" : "removes", zebra_route_string (type));
+
+  if (client->redist[type])
+    zebra_redistribute_refilter (client, type, afi, old, new);
+  if (old)
+    prefix_bgp_orf_remove_all (old->name);
+  return;
+
+ malformed:
+  zlog_warn ("%s: client %d malformed redistribution filter", __func__,
+	     client->sock);
+  prefix_bgp_orf_remove_all (name);
+}
+
+/* Free the redistribution filters of the client. */
+void
+zebra_redistribute_filter_free (struct zserv *client)
+{
+  afi_t afi;
+  int type;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (type = 0; type < ZEBRA_ROUTE_MAX; type++)
+      if (client->redist_filter[afi][type])
+	{
+	  prefix_bgp_orf_remove_all (client->redist_filter[afi][type]->name);
+	  client->redist_filter[afi][type] = NULL;
+	}
+}
+
 /* Interface up information. */
 void
 zebra_interface_up_update (struct interface *ifp)
@@ -31,6 +31,8 @@ extern void zebra_redistribute_delete (int, struct zserv *, int);
 
 extern void zebra_redistribute_default_add (int, struct zserv *, int);
 extern void zebra_redistribute_default_delete (int, struct zserv *, int);
+extern void zebra_redistribute_filter (int, struct zserv *, int);
+extern void zebra_redistribute_filter_free (struct zserv *);
 
 extern void redistribute_add (struct prefix *, struct rib *);
 extern void redistribute_delete (struct prefix *, struct rib *);
@@ -24,6 +24,7 @@
 #define _ZEBRA_RIB_H
 
 #include "prefix.h"
+#include "table.h"
 #include "log.h"
 
 #define DISTANCE_INFINITY  255
@@ -37,34 +38,105 @@ union g_addr {
 #endif /* HAVE_IPV6 */
 };
 
-struct rib
+enum nexthop_types_t
 {
-  /* Status Flags for the *route_node*, but kept in the head RIB.. */
-  u_char rn_status;
-#define RIB_ROUTE_QUEUED(x)	(1 << (x))
+  NEXTHOP_TYPE_IFINDEX = 1,      /* Directly connected.  */
+  NEXTHOP_TYPE_IFNAME,           /* Interface route.  */
+  NEXTHOP_TYPE_IPV4,             /* IPv4 nexthop.  */
+  NEXTHOP_TYPE_IPV4_IFINDEX,     /* IPv4 nexthop with ifindex.  */
+  NEXTHOP_TYPE_IPV4_IFNAME,      /* IPv4 nexthop with ifname.  */
+  NEXTHOP_TYPE_IPV6,             /* IPv6 nexthop.  */
+  NEXTHOP_TYPE_IPV6_IFINDEX,     /* IPv6 nexthop with ifindex.  */
+  NEXTHOP_TYPE_IPV6_IFNAME,      /* IPv6 nexthop with ifname.  */
+  NEXTHOP_TYPE_BLACKHOLE,
+  /* Null0 nexthop is typically seen in a RIB structure flagged
+   * ZEBRA_FLAG_REJECT or ZEBRA_FLAG_BLACKHOLE */
+  NEXTHOP_TYPE_IPV4_IFINDEX_OL,
+  /* IPv4 nexthop with ifindex, which does not require the gate address
+   * to belong to a connected network of the given interface. Used for
+   * mesh routing. */
+};
+extern const struct message nexthop_types_desc[];
+extern const size_t nexthop_types_desc_max;
 
+/* Nexthop structure. */
+struct nexthop
+{
+  struct nexthop *next;
+  struct nexthop *prev;
+
+  /* Interface index. */
+  char *ifname;
+  unsigned int ifindex;
+  
+  enum nexthop_types_t type;
+
+  u_char flags;
+#define NEXTHOP_FLAG_ACTIVE     (1 << 0) /* This nexthop is alive. */
+#define NEXTHOP_FLAG_FIB        (1 << 1) /* FIB nexthop. */
+#define NEXTHOP_FLAG_RECURSIVE  (1 << 2) /* Recursive nexthop. */
+
+  /* Recursive lookup nexthop, whose address is rgate below: the small
+     fields come first so as to pack together. */
+  u_char rtype;
+  unsigned int rifindex;
+
+  /* Nexthop address or interface name. */
+  union g_addr gate;
+
+  union g_addr rgate;
+  union g_addr src;
+};
+
+/* Link of a RIB entry into the reference list of the interned nexthop
+ * set sharing the resolution of its nexthops, held in the entry itself.
+ */
+struct nhe_ref
+{
+  struct nhe_ref *next;
+  struct nhe_ref *prev;
+
+  /* The set, NULL if the entry is in none. */
+  struct nhe *nhe;
+  struct route_node *rn;
+};
+
+/* A route.  The fields are laid out for the entry to stay small, as there
+ * is one for every route of every protocol: the first nexthop and the link
+ * to the interned nexthop set are held in the entry, so that the common
+ * route with a single nexthop takes a single allocation.
+ */
+struct rib
+{
   /* Link list. */
   struct rib *next;
   struct rib *prev;
   
-  /* Nexthop structure */
+  /* Nexthop structure, the first one being nexthop_first unless it was
+   * deleted while other nexthops remained. */
   struct nexthop *nexthop;
-  
-  /* Reference count. */
-  unsigned long refcnt;
-  
+
+  /* Shared nexthop group the nexthops were copied from, if any. */
+  struct nhg_ref *nhg_ref;
+
   /* Uptime. */
   time_t uptime;
 
-  /* Type fo this route. */
-  int type;
-
   /* Which routing table */
   int table;			
 
   /* Metric */
   u_int32_t metric;
 
+  /* Sequence number of the last kernel update queued for the entry. */
+  u_int32_t kernel_seq;
+
+  /* Reference count. */
+  u_int32_t refcnt;
+
+  /* Type fo this route. */
+  u_char type;
+
   /* Distance. */
   u_char distance;
 
@@ -77,25 +149,73 @@ struct rib
   /* RIB internal status */
   u_char status;
 #define RIB_ENTRY_REMOVED	(1 << 0)
+#define RIB_ENTRY_NHG_CHANGED	(1 << 1)
+#define RIB_ENTRY_NHG_FIB	(1 << 2)
+#define RIB_ENTRY_RETAINED	(1 << 3)
+#define RIB_ENTRY_RESYNC	(1 << 4)
+#define RIB_ENTRY_FIB_SUPPRESSED (1 << 5)
+#define RIB_ENTRY_NHE_OWN	(1 << 6) /* Resolves its nexthop set itself. */
+
+  /* Status Flags for the *route_node*, but kept in the head RIB.. */
+  u_char rn_status;
+#define RIB_ROUTE_QUEUED(x)	(1 << (x))
+#define RIB_ROUTE_LPM		(1 << 7) /* In the lookup table. */
 
   /* Nexthop information. */
   u_char nexthop_num;
   u_char nexthop_active_num;
   u_char nexthop_fib_num;
+
+  /* Interned nexthop set sharing the resolution of the nexthops. */
+  struct nhe_ref nhe_ref;
+
+  /* Storage for the first nexthop, unused when its type is 0. */
+  struct nexthop nexthop_first;
 };
 
+#define RIB_SYSTEM_ROUTE(R) \
+        ((R)->type == ZEBRA_ROUTE_KERNEL || (R)->type == ZEBRA_ROUTE_CONNECT)
+
 /* meta-queue structure:
  * sub-queue 0: connected, kernel
  * sub-queue 1: static
  * sub-queue 2: RIP, RIPng, OSPF, OSPF6, IS-IS
  * sub-queue 3: iBGP, eBGP
  * sub-queue 4: any other origin (if any)
+ *
+ * The sub-queues are served in weighted round-robin, so that a backlog
+ * in one of them delays the others by a bounded number of nodes only.
+ * The first MQ_DEADLINE_SIZE of them also have a deadline: once their
+ * oldest node has waited for longer, it is processed before any other.
  */
 #define MQ_SIZE 5
+#define MQ_DEADLINE_SIZE 3
 struct meta_queue
 {
-  struct list *subq[MQ_SIZE];
+  struct list *subq[MQ_SIZE]; /* of struct meta_queue_item */
   u_int32_t size; /* sum of lengths of all subqueues */
+
+  /* Round-robin state: sub-queue being served and the number of nodes
+   * it may still have processed in its turn. */
+  u_char current;
+  u_int32_t credit;
+
+  /* Per sub-queue statistics, latencies in milliseconds. */
+  struct
+  {
+    unsigned long queued;
+    unsigned long processed;
+    unsigned long deadline;
+    u_int32_t max_backlog;
+    unsigned long long latency_total;
+    unsigned long latency_max;
+  } stats[MQ_SIZE];
+};
+
+struct meta_queue_item
+{
+  struct route_node *rn;
+  struct timeval queued;
 };
 
 /* Static route information. */
@@ -159,54 +279,6 @@ struct static_ipv6
 };
 #endif /* HAVE_IPV6 */
 
-enum nexthop_types_t
-{
-  NEXTHOP_TYPE_IFINDEX = 1,      /* Directly connected.  */
-  NEXTHOP_TYPE_IFNAME,           /* Interface route.  */
-  NEXTHOP_TYPE_IPV4,             /* IPv4 nexthop.  */
-  NEXTHOP_TYPE_IPV4_IFINDEX,     /* IPv4 nexthop with ifindex.  */
-  NEXTHOP_TYPE_IPV4_IFNAME,      /* IPv4 nexthop with ifname.  */
-  NEXTHOP_TYPE_IPV6,             /* IPv6 nexthop.  */
-  NEXTHOP_TYPE_IPV6_IFINDEX,     /* IPv6 nexthop with ifindex.  */
-  NEXTHOP_TYPE_IPV6_IFNAME,      /* IPv6 nexthop with ifname.  */
-  NEXTHOP_TYPE_BLACKHOLE,
-  /* Null0 nexthop is typically seen in a RIB structure flagged
-   * ZEBRA_FLAG_REJECT or ZEBRA_FLAG_BLACKHOLE */
-  NEXTHOP_TYPE_IPV4_IFINDEX_OL,
-  /* IPv4 nexthop with ifindex, which does not require the gate address
-   * to belong to a connected network of the given interface. Used for
-   * mesh routing. */
-};
-extern const struct message nexthop_types_desc[];
-extern const size_t nexthop_types_desc_max;
-
-/* Nexthop structure. */
-struct nexthop
-{
-  struct nexthop *next;
-  struct nexthop *prev;
-
-  /* Interface index. */
-  char *ifname;
-  unsigned int ifindex;
-  
-  enum nexthop_types_t type;
-
-  u_char flags;
-#define NEXTHOP_FLAG_ACTIVE     (1 << 0) /* This nexthop is alive. */
-#define NEXTHOP_FLAG_FIB        (1 << 1) /* FIB nexthop. */
-#define NEXTHOP_FLAG_RECURSIVE  (1 << 2) /* Recursive nexthop. */
-
-  /* Nexthop address or interface name. */
-  union g_addr gate;
-
-  /* Recursive lookup nexthop. */
-  u_char rtype;
-  unsigned int rifindex;
-  union g_addr rgate;
-  union g_addr src;
-};
-
 /* Routing table instance.  */
 struct vrf
 {
@@ -273,8 +345,31 @@ extern struct rib *rib_match_ipv4 (struct in_addr);
 extern struct rib *rib_lookup_ipv4 (struct prefix_ipv4 *);
 
 extern void rib_update (void);
+struct interface;
+extern void rib_update_interface (struct interface *);
+extern int rib_nhg_resolve (struct rib *);
+extern void rib_nhg_copy_nexthops (struct rib *, struct rib *);
+extern void rib_nhg_sync (struct route_node *, struct rib *, struct rib *);
+extern void rib_nhg_requeue (struct route_node *, struct rib *, struct rib *);
+extern void rib_nhe_resolve (struct rib *);
+extern void rib_nhe_requeue (struct route_node *);
+extern void rib_kernel_failed (struct prefix *, struct rib *, u_int32_t);
+extern void rib_fibc_refresh (struct route_node *, struct rib *);
 extern void rib_weed_tables (void);
 extern void rib_sweep_route (void);
+
+/* Routes left in the kernel by a previous run may be retained for a
+ * while instead of swept: daemons installing the same routes again then
+ * cause no kernel update.  "show zebra kernel-sync" calls
+ * rib_retain_show(). */
+struct vty;
+extern void rib_retain_route (int);
+extern void rib_retain_show (struct vty *);
+
+/* Kernel routes are marked before the kernel table is read again after
+ * route messages were lost, and those still marked after swept. */
+extern void rib_resync_mark (void);
+extern void rib_resync_sweep (void);
 extern void rib_close (void);
 extern void rib_init (void);
 extern unsigned long rib_score_proto (u_char proto);
@@ -41,13 +41,35 @@
 #include "zebra/router-id.h"
 #include "zebra/redistribute.h"
 
-static struct list rid_all_sorted_list;
-static struct list rid_lo_sorted_list;
+/* Candidate addresses, as /32 routes whose info is the list of the
+ * connected addresses with that address, so that the highest one is found
+ * without looking at the others. */
+static struct route_table *rid_all_table;
+static struct route_table *rid_lo_table;
 static struct prefix rid_user_assigned;
 
 /* master zebra server structure */
 extern struct zebra_t zebrad;
 
+static struct route_table *
+router_id_table (struct connected *ifc)
+{
+  if (!strncmp (ifc->ifp->name, "lo", 2)
+      || !strncmp (ifc->ifp->name, "dummy", 5))
+    return rid_lo_table;
+  else
+    return rid_all_table;
+}
+
+static void
+router_id_key (struct connected *ifc, struct prefix *p)
+{
+  memset (p, 0, sizeof (struct prefix));
+  p->family = AF_INET;
+  p->prefixlen = IPV4_MAX_BITLEN;
+  p->u.prefix4 = ifc->address->u.prefix4;
+}
+
 static struct connected *
 router_id_find_node (struct list *l, struct connected *ifc)
 {
@@ -61,6 +83,18 @@ router_id_find_node (struct list *l, struct connected *ifc)
   return NULL;
 }
 
+/* Highest address in the table: all of them are leaves of its tree, so
+ * it is the one reached going down from the top, right first. */
+static struct route_node *
+router_id_highest (struct route_table *table)
+{
+  struct route_node *rn = table->top;
+
+  while (rn && ! rn->info)
+    rn = rn->l_right ? rn->l_right : rn->l_left;
+  return rn;
+}
+
 static int
 router_id_bad_address (struct connected *ifc)
 {
@@ -77,8 +111,7 @@ router_id_bad_address (struct connected *ifc)
 void
 router_id_get (struct prefix *p)
 {
-  struct listnode *node;
-  struct connected *c;
+  struct route_node *rn;
 
   p->u.prefix4.s_addr = 0;
   p->family = AF_INET;
@@ -86,18 +119,10 @@ router_id_get (struct prefix *p)
 
   if (rid_user_assigned.u.prefix4.s_addr)
     p->u.prefix4.s_addr = rid_user_assigned.u.prefix4.s_addr;
-  else if (!list_isempty (&rid_lo_sorted_list))
-    {
-      node = listtail (&rid_lo_sorted_list);
-      c = listgetdata (node);
-      p->u.prefix4.s_addr = c->address->u.prefix4.s_addr;
-    }
-  else if (!list_isempty (&rid_all_sorted_list))
-    {
-      node = listtail (&rid_all_sorted_list);
-      c = listgetdata (node);
-      p->u.prefix4.s_addr = c->address->u.prefix4.s_addr;
-    }
+  else if ((rn = router_id_highest (rid_lo_table)) != NULL)
+    p->u.prefix4.s_addr = rn->p.u.prefix4.s_addr;
+  else if ((rn = router_id_highest (rid_all_table)) != NULL)
+    p->u.prefix4.s_addr = rn->p.u.prefix4.s_addr;
 }
 
 static void
@@ -118,8 +143,9 @@ router_id_set (struct prefix *p)
 void
 router_id_add_address (struct connected *ifc)
 {
-  struct list *l = NULL;
+  struct route_node *rn;
   struct listnode *node;
+  struct prefix p;
   struct prefix before;
   struct prefix after;
   struct zserv *client;
@@ -129,14 +155,15 @@ router_id_add_address (struct connected *ifc)
 
   router_id_get (&before);
 
-  if (!strncmp (ifc->ifp->name, "lo", 2)
-      || !strncmp (ifc->ifp->name, "dummy", 5))
-    l = &rid_lo_sorted_list;
+  router_id_key (ifc, &p);
+  rn = route_node_get (router_id_table (ifc), &p);
+  if (rn->info)
+    route_unlock_node (rn);
   else
-    l = &rid_all_sorted_list;
-  
-  if (!router_id_find_node (l, ifc))
-    listnode_add_sort (l, ifc);
+    rn->info = list_new ();
+
+  if (!router_id_find_node (rn->info, ifc))
+    listnode_add (rn->info, ifc);
 
   router_id_get (&after);
 
@@ -151,7 +178,8 @@ void
 router_id_del_address (struct connected *ifc)
 {
   struct connected *c;
-  struct list *l;
+  struct route_node *rn;
+  struct prefix p;
   struct prefix after;
   struct prefix before;
   struct listnode *node;
@@ -162,14 +190,19 @@ router_id_del_address (struct connected *ifc)
 
   router_id_get (&before);
 
-  if (!strncmp (ifc->ifp->name, "lo", 2)
-      || !strncmp (ifc->ifp->name, "dummy", 5))
-    l = &rid_lo_sorted_list;
-  else
-    l = &rid_all_sorted_list;
-
-  if ((c = router_id_find_node (l, ifc)))
-    listnode_delete (l, c);
+  router_id_key (ifc, &p);
+  if ((rn = route_node_lookup (router_id_table (ifc), &p)) != NULL)
+    {
+      if ((c = router_id_find_node (rn->info, ifc)))
+        listnode_delete (rn->info, c);
+      if (list_isempty ((struct list *) rn->info))
+        {
+          list_delete (rn->info);
+          rn->info = NULL;
+          route_unlock_node (rn);
+        }
+      route_unlock_node (rn);
+    }
 
   router_id_get (&after);
 
@@ -225,30 +258,16 @@ DEFUN (no_router_id,
   return CMD_SUCCESS;
 }
 
-static int
-router_id_cmp (void *a, void *b)
-{
-  const struct connected *ifa = (const struct connected *)a;
-  const struct connected *ifb = (const struct connected *)b;
-  unsigned int A = ntohl(ifa->address->u.prefix4.s_addr);
-  unsigned int B = ntohl(ifb->address->u.prefix4.s_addr);
-
-  return (int) (A - B);
-}
-
 void
 router_id_init (void)
 {
   install_element (CONFIG_NODE, &router_id_cmd);
   install_element (CONFIG_NODE, &no_router_id_cmd);
 
-  memset (&rid_all_sorted_list, 0, sizeof (rid_all_sorted_list));
-  memset (&rid_lo_sorted_list, 0, sizeof (rid_lo_sorted_list));
+  rid_all_table = route_table_init ();
+  rid_lo_table = route_table_init ();
   memset (&rid_user_assigned, 0, sizeof (rid_user_assigned));
 
-  rid_all_sorted_list.cmp = router_id_cmp;
-  rid_lo_sorted_list.cmp = router_id_cmp;
-
   rid_user_assigned.family = AF_INET;
   rid_user_assigned.prefixlen = 32;
 }
@@ -29,13 +29,36 @@
 
 extern int kernel_add_ipv4 (struct prefix *, struct rib *);
 extern int kernel_delete_ipv4 (struct prefix *, struct rib *);
+
+/* Install the route of the second rib in place of the one of the first,
+ * as a single change where the kernel allows it. */
+extern int kernel_replace_ipv4 (struct prefix *, struct rib *, struct rib *);
 extern int kernel_add_route (struct prefix_ipv4 *, struct in_addr *, int, int);
 extern int kernel_address_add_ipv4 (struct interface *, struct connected *);
 extern int kernel_address_delete_ipv4 (struct interface *, struct connected *);
 
+/* Kernel nexthop objects backing shared nexthop groups, where the kernel
+ * has them.  Both return -1 if it does not. */
+struct nhg;
+extern int kernel_nhg_add (struct nhg *);
+extern int kernel_nhg_delete (struct nhg *);
+
+/* Route updates may be queued for the kernel and their failure reported
+ * later through rib_kernel_failed().  kernel_flush() waits until all of
+ * them are answered; "show zebra dataplane" calls kernel_dplane_show(). */
+struct vty;
+extern void kernel_flush (void);
+extern void kernel_dplane_show (struct vty *);
+
+#ifdef HAVE_NETLINK
+/* Receive statistics of the netlink sockets, "show zebra netlink". */
+extern void kernel_netlink_show (struct vty *);
+#endif /* HAVE_NETLINK */
+
 #ifdef HAVE_IPV6
 extern int kernel_add_ipv6 (struct prefix *, struct rib *);
 extern int kernel_delete_ipv6 (struct prefix *, struct rib *);
+extern int kernel_replace_ipv6 (struct prefix *, struct rib *, struct rib *);
 extern int kernel_delete_ipv6_old (struct prefix_ipv6 *dest, struct in6_addr *gate,
 			    	  unsigned int index, int flags, int table);
 
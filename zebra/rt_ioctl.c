@@ -25,6 +25,7 @@
 #include "prefix.h"
 #include "log.h"
 #include "if.h"
+#include "vty.h"
 
 #include "zebra/zserv.h"
 #include "zebra/rib.h"
@@ -347,6 +348,38 @@ kernel_delete_ipv4 (struct prefix *p, struct rib *rib)
 {
   return kernel_ioctl_ipv4 (SIOCDELRT, p, rib, AF_INET);
 }
+
+/* The ioctls can't change a route in place. */
+int
+kernel_replace_ipv4 (struct prefix *p, struct rib *old, struct rib *rib)
+{
+  kernel_ioctl_ipv4 (SIOCDELRT, p, old, AF_INET);
+  return kernel_ioctl_ipv4 (SIOCADDRT, p, rib, AF_INET);
+}
+
+int
+kernel_nhg_add (struct nhg *nhg)
+{
+  return -1;
+}
+
+int
+kernel_nhg_delete (struct nhg *nhg)
+{
+  return -1;
+}
+
+/* Route updates are made synchronously. */
+void
+kernel_flush (void)
+{
+}
+
+void
+kernel_dplane_show (struct vty *vty)
+{
+  vty_out (vty, "Kernel dataplane: %s, synchronous%s", "ioctl", VTY_NEWLINE);
+}
 
 #ifdef HAVE_IPV6
 
@@ -550,6 +583,13 @@ kernel_delete_ipv6 (struct prefix *p, struct rib *rib)
   return kernel_ioctl_ipv6_multipath (SIOCDELRT, p, rib, AF_INET6);
 }
 
+int
+kernel_replace_ipv6 (struct prefix *p, struct rib *old, struct rib *rib)
+{
+  kernel_ioctl_ipv6_multipath (SIOCDELRT, p, old, AF_INET6);
+  return kernel_ioctl_ipv6_multipath (SIOCADDRT, p, rib, AF_INET6);
+}
+
 /* Delete IPv6 route from the kernel. */
 int
 kernel_delete_ipv6_old (struct prefix_ipv6 *dest, struct in6_addr *gate,
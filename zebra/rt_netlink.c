@@ -36,12 +36,28 @@
 #include "thread.h"
 #include "privs.h"
 #include "sockopt.h"
+#include "network.h"
+#include "memory.h"
+#include "vty.h"
 
 #include "zebra/zserv.h"
 #include "zebra/rt.h"
 #include "zebra/redistribute.h"
 #include "zebra/interface.h"
 #include "zebra/debug.h"
+#include "zebra/zebra_nhg.h"
+
+#ifdef RTM_NEWNEXTHOP
+#include <linux/nexthop.h>
+#endif /* RTM_NEWNEXTHOP */
+
+#include <pthread.h>
+#include <poll.h>
+
+/* Size of a datagram of the receive area of a socket, and the number of
+   datagrams read at once from the listening sockets. */
+#define NL_RCV_PKT_SIZE		32768
+#define NL_RCV_BATCH		16
 
 /* Socket interface to kernel */
 struct nlsock
@@ -50,8 +66,26 @@ struct nlsock
   int seq;
   struct sockaddr_nl snl;
   const char *name;
-} netlink      = { -1, 0, {0}, "netlink-listen"},     /* kernel messages */
-  netlink_cmd  = { -1, 0, {0}, "netlink-cmd"};        /* command channel */
+
+  /* Datagrams read at once and the area they are read into, allocated on
+     first use and kept. */
+  int batch;
+  char *rcvbuf;
+
+  /* Receive statistics. */
+  unsigned long reads;
+  unsigned long datagrams;
+  unsigned long overruns;
+  unsigned long truncated;
+  unsigned long resyncs;
+
+  /* Read again the state the lost messages were about. */
+  struct thread *t_resync;
+} netlink      = { -1, 0, {0}, "netlink-listen"},     /* link, address events */
+  netlink_route_listen = { -1, 0, {0}, "netlink-listen-route"}, /* routes */
+  netlink_cmd  = { -1, 0, {0}, "netlink-cmd"},        /* command channel */
+  netlink_dplane = { -1, 0, {0}, "netlink-dplane"},   /* route updates */
+  netlink_dump = { -1, 0, {0}, "netlink-dump"};       /* resync dumps */
 
 static const struct message nlmsg_str[] = {
   {RTM_NEWROUTE, "RTM_NEWROUTE"},
@@ -63,9 +97,21 @@ static const struct message nlmsg_str[] = {
   {RTM_NEWADDR,  "RTM_NEWADDR"},
   {RTM_DELADDR,  "RTM_DELADDR"},
   {RTM_GETADDR,  "RTM_GETADDR"},
+#ifdef RTM_NEWNEXTHOP
+  {RTM_NEWNEXTHOP, "RTM_NEWNEXTHOP"},
+  {RTM_DELNEXTHOP, "RTM_DELNEXTHOP"},
+  {RTM_GETNEXTHOP, "RTM_GETNEXTHOP"},
+#endif /* RTM_NEWNEXTHOP */
   {0, NULL}
 };
 
+#ifdef RTM_NEWNEXTHOP
+/* Set once the kernel is known to support nexthop objects. */
+static int netlink_nhg_supported;
+#endif /* RTM_NEWNEXTHOP */
+
+static void netlink_dplane_sync (void);
+
 extern struct zebra_t zebrad;
 
 extern struct zebra_privs_t zserv_privs;
@@ -96,7 +142,7 @@ set_ifindex(struct interface *ifp, unsigned int ifi_index)
 	  if_delete_update(oifp);
         }
     }
-  ifp->ifindex = ifi_index;
+  if_set_index (ifp, ifi_index);
 }
 
 static int
@@ -199,6 +245,10 @@ netlink_request (int family, int type, struct nlsock *nl)
       return -1;
     }
 
+  /* The dump must not be mixed up with pending route acknowledgements. */
+  if (nl == &netlink_cmd)
+    netlink_dplane_sync ();
+
   memset (&snl, 0, sizeof snl);
   snl.nl_family = AF_NETLINK;
 
@@ -236,6 +286,67 @@ netlink_request (int family, int type, struct nlsock *nl)
   return 0;
 }
 
+static int netlink_resync (struct thread *);
+
+/* Read up to the batch size of the socket of datagrams into its receive
+   area, with recvmmsg() where available.  Returns the number of datagrams
+   described by msg[] and len[], or -1 with errno set. */
+static int
+netlink_recv (struct nlsock *nl, struct msghdr *msg, struct iovec *iov,
+              struct sockaddr_nl *snl, int *len)
+{
+  int i;
+
+  if (! nl->rcvbuf)
+    {
+      if (nl->batch < 1)
+        nl->batch = 1;
+      nl->rcvbuf = XMALLOC (MTYPE_NETLINK_BUF, nl->batch * NL_RCV_PKT_SIZE);
+    }
+
+  for (i = 0; i < nl->batch; i++)
+    {
+      iov[i].iov_base = nl->rcvbuf + i * NL_RCV_PKT_SIZE;
+      iov[i].iov_len = NL_RCV_PKT_SIZE;
+      memset (&msg[i], 0, sizeof msg[i]);
+      msg[i].msg_name = &snl[i];
+      msg[i].msg_namelen = sizeof snl[i];
+      msg[i].msg_iov = &iov[i];
+      msg[i].msg_iovlen = 1;
+    }
+
+#ifdef HAVE_RECVMMSG
+  if (nl->batch > 1)
+    {
+      struct mmsghdr mmsg[NL_RCV_BATCH];
+      int count;
+
+      for (i = 0; i < nl->batch; i++)
+        mmsg[i].msg_hdr = msg[i];
+
+      count = recvmmsg (nl->sock, mmsg, nl->batch, 0, NULL);
+      for (i = 0; i < count; i++)
+        {
+          msg[i] = mmsg[i].msg_hdr;
+          len[i] = mmsg[i].msg_len;
+        }
+      if (count > 0)
+        {
+          nl->reads++;
+          nl->datagrams += count;
+        }
+      return count;
+    }
+#endif /* HAVE_RECVMMSG */
+
+  len[0] = recvmsg (nl->sock, &msg[0], 0);
+  if (len[0] < 0)
+    return -1;
+  nl->reads++;
+  nl->datagrams++;
+  return 1;
+}
+
 /* Receive message from netlink interface and pass those information
    to the given function. */
 static int
@@ -245,27 +356,57 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
   int status;
   int ret = 0;
   int error;
+  struct msghdr msgs[NL_RCV_BATCH];
+  struct iovec iovs[NL_RCV_BATCH];
+  struct sockaddr_nl snls[NL_RCV_BATCH];
+  int lens[NL_RCV_BATCH];
+  int count = 0, i = 0;
+  int save_errno;
 
   while (1)
     {
-      char buf[4096];
-      struct iovec iov = { buf, sizeof buf };
+      char *buf;
       struct sockaddr_nl snl;
-      struct msghdr msg = { (void *) &snl, sizeof snl, &iov, 1, NULL, 0, 0 };
+      struct msghdr msg;
       struct nlmsghdr *h;
 
-      status = recvmsg (nl->sock, &msg, 0);
-      if (status < 0)
+      /* Datagrams are read a batch at a time into the receive area. */
+      if (i == count)
         {
-          if (errno == EINTR)
-            continue;
-          if (errno == EWOULDBLOCK || errno == EAGAIN)
+          i = 0;
+          count = netlink_recv (nl, msgs, iovs, snls, lens);
+          if (count < 0)
+            {
+              count = 0;
+              if (errno == EINTR)
+                continue;
+              if (errno == EWOULDBLOCK || errno == EAGAIN)
+                break;
+              save_errno = errno;
+              zlog (NULL, LOG_ERR, "%s recvmsg overrun: %s",
+                    nl->name, safe_strerror(save_errno));
+
+              /* Messages of a listening socket were lost: read again the
+                 state they were about once the socket is drained. */
+              if (save_errno == ENOBUFS)
+                {
+                  nl->overruns++;
+                  if ((nl == &netlink || nl == &netlink_route_listen)
+                      && ! nl->t_resync)
+                    nl->t_resync = thread_add_event (zebrad.master,
+                                                     netlink_resync, nl, 0);
+                }
+              continue;
+            }
+          if (count == 0)
             break;
-          zlog (NULL, LOG_ERR, "%s recvmsg overrun: %s",
-	  	nl->name, safe_strerror(errno));
-          continue;
         }
 
+      buf = iovs[i].iov_base;
+      snl = snls[i];
+      msg = msgs[i];
+      status = lens[i++];
+
       if (status == 0)
         {
           zlog (NULL, LOG_ERR, "%s EOF", nl->name);
@@ -348,8 +489,11 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
                        lookup (nlmsg_str, h->nlmsg_type), h->nlmsg_type,
                        h->nlmsg_seq, h->nlmsg_pid);
 
-          /* skip unsolicited messages originating from command socket */
-          if (nl != &netlink_cmd && h->nlmsg_pid == netlink_cmd.snl.nl_pid)
+          /* skip unsolicited messages originating from our own sockets */
+          if (nl != &netlink_cmd
+              && (h->nlmsg_pid == netlink_cmd.snl.nl_pid
+                  || (netlink_dplane.sock >= 0
+                      && h->nlmsg_pid == netlink_dplane.snl.nl_pid)))
             {
               if (IS_ZEBRA_DEBUG_KERNEL)
                 zlog_debug ("netlink_parse_info: %s packet comes from %s",
@@ -368,6 +512,7 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
       /* After error care. */
       if (msg.msg_flags & MSG_TRUNC)
         {
+          nl->truncated++;
           zlog (NULL, LOG_ERR, "%s error: message truncated", nl->name);
           continue;
         }
@@ -1073,6 +1218,166 @@ netlink_route_read (void)
   return 0;
 }
 
+/* State known before a resync and not read again from the kernel yet:
+   the interfaces, and the addresses of the interfaces. */
+struct netlink_resync_addr
+{
+  struct interface *ifp;
+  struct prefix p;
+};
+
+static struct list *netlink_resync_links;
+static struct list *netlink_resync_addrs;
+
+static int
+netlink_resync_link (struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+  struct ifinfomsg *ifi = NLMSG_DATA (h);
+  struct interface *ifp;
+
+  if (h->nlmsg_type == RTM_NEWLINK
+      && (ifp = if_lookup_by_index (ifi->ifi_index)))
+    listnode_delete (netlink_resync_links, ifp);
+
+  return netlink_link_change (snl, h);
+}
+
+static int
+netlink_resync_addr (struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+  struct ifaddrmsg *ifa = NLMSG_DATA (h);
+  struct rtattr *tb[IFA_MAX + 1];
+  struct rtattr *local;
+  struct netlink_resync_addr *addr;
+  struct listnode *node, *nnode;
+  int len;
+
+  len = h->nlmsg_len - NLMSG_LENGTH (sizeof (struct ifaddrmsg));
+  if (h->nlmsg_type != RTM_NEWADDR || len < 0)
+    return netlink_interface_addr (snl, h);
+
+  memset (tb, 0, sizeof tb);
+  netlink_parse_rtattr (tb, IFA_MAX, IFA_RTA (ifa), len);
+  local = tb[IFA_LOCAL] ? tb[IFA_LOCAL] : tb[IFA_ADDRESS];
+
+  if (local)
+    for (ALL_LIST_ELEMENTS (netlink_resync_addrs, node, nnode, addr))
+      if (addr->ifp->ifindex == ifa->ifa_index
+          && addr->p.family == ifa->ifa_family
+          && addr->p.prefixlen == ifa->ifa_prefixlen
+          && ! memcmp (&addr->p.u.prefix, RTA_DATA (local),
+                       RTA_PAYLOAD (local)))
+        {
+          list_delete_node (netlink_resync_addrs, node);
+          XFREE (MTYPE_TMP, addr);
+          break;
+        }
+
+  return netlink_interface_addr (snl, h);
+}
+
+/* Read the interfaces and their addresses again after link or address
+   messages were lost, and remove those which are gone. */
+static void
+netlink_resync_interfaces (void)
+{
+  struct listnode *node, *cnode;
+  struct interface *ifp;
+  struct connected *ifc;
+  struct netlink_resync_addr *addr;
+
+  netlink_resync_links = list_new ();
+  netlink_resync_addrs = list_new ();
+  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
+    {
+      if (! CHECK_FLAG (ifp->status, ZEBRA_INTERFACE_ACTIVE))
+        continue;
+      listnode_add (netlink_resync_links, ifp);
+      for (ALL_LIST_ELEMENTS_RO (ifp->connected, cnode, ifc))
+        if (CHECK_FLAG (ifc->conf, ZEBRA_IFC_REAL))
+          {
+            addr = XMALLOC (MTYPE_TMP, sizeof (struct netlink_resync_addr));
+            addr->ifp = ifp;
+            prefix_copy (&addr->p, ifc->address);
+            listnode_add (netlink_resync_addrs, addr);
+          }
+    }
+
+  if (netlink_request (AF_PACKET, RTM_GETLINK, &netlink_dump) == 0)
+    netlink_parse_info (netlink_resync_link, &netlink_dump);
+  if (netlink_request (AF_INET, RTM_GETADDR, &netlink_dump) == 0)
+    netlink_parse_info (netlink_resync_addr, &netlink_dump);
+#ifdef HAVE_IPV6
+  if (netlink_request (AF_INET6, RTM_GETADDR, &netlink_dump) == 0)
+    netlink_parse_info (netlink_resync_addr, &netlink_dump);
+#endif /* HAVE_IPV6 */
+
+  for (ALL_LIST_ELEMENTS_RO (netlink_resync_addrs, node, addr))
+    {
+      if (addr->p.family == AF_INET)
+        connected_delete_ipv4 (addr->ifp, 0, &addr->p.u.prefix4,
+                               addr->p.prefixlen, NULL);
+#ifdef HAVE_IPV6
+      else if (addr->p.family == AF_INET6)
+        connected_delete_ipv6 (addr->ifp, &addr->p.u.prefix6,
+                               addr->p.prefixlen, NULL);
+#endif /* HAVE_IPV6 */
+      XFREE (MTYPE_TMP, addr);
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (netlink_resync_links, node, ifp))
+    {
+      int operative = if_is_operative (ifp);
+
+      ifp->flags &= ~(IFF_UP | IFF_RUNNING);
+      if (operative)
+        if_down (ifp);
+      if_delete_update (ifp);
+    }
+
+  list_delete (netlink_resync_links);
+  list_delete (netlink_resync_addrs);
+  netlink_resync_links = netlink_resync_addrs = NULL;
+}
+
+/* Read the kernel routes again after route messages were lost: those
+   read again replace the RIB entries marked before, the entries still
+   marked after are gone. */
+static void
+netlink_resync_routes (void)
+{
+  rib_resync_mark ();
+  if (netlink_request (AF_INET, RTM_GETROUTE, &netlink_dump) == 0)
+    netlink_parse_info (netlink_route_change, &netlink_dump);
+#ifdef HAVE_IPV6
+  if (netlink_request (AF_INET6, RTM_GETROUTE, &netlink_dump) == 0)
+    netlink_parse_info (netlink_route_change, &netlink_dump);
+#endif /* HAVE_IPV6 */
+  rib_resync_sweep ();
+}
+
+/* The kernel dropped messages of a listening socket: read again the
+   objects of the kind the socket listens to.  The dump goes through a
+   socket and receive area of its own: the handlers may write to the
+   kernel through netlink_cmd, which must not read the answers to that
+   while the dump is being read. */
+static int
+netlink_resync (struct thread *thread)
+{
+  struct nlsock *nl = THREAD_ARG (thread);
+
+  nl->t_resync = NULL;
+  nl->resyncs++;
+  zlog_warn ("%s lost messages, reading the %s again", nl->name,
+             nl == &netlink_route_listen ? "routes" : "interfaces");
+
+  if (nl == &netlink_route_listen)
+    netlink_resync_routes ();
+  else
+    netlink_resync_interfaces ();
+  return 0;
+}
+
 /* Utility function  comes from iproute2. 
    Authors:	Alexey Kuznetsov, <kuznet@ms2.inr.ac.ru> */
 static int
@@ -1137,6 +1442,493 @@ addattr32 (struct nlmsghdr *n, int maxlen, int type, int data)
   return 0;
 }
 
+/* Route updates are not sent with netlink_talk() but handed, as ready
+   made netlink messages, to a dataplane thread which owns its own
+   netlink socket.  It sends whatever is queued in a single sendmsg() of
+   up to NL_DPLANE_WINDOW messages, collects the acknowledgements and
+   returns the updates with their result, the main thread picking them
+   up from a read thread on a pipe.  Kernel latency is thus kept out of
+   rib_process().  Both queues are single producer, single consumer
+   rings; the pipes are only written to when the other side sleeps or
+   has results to pick up.  A synchronous exchange on the command socket
+   first waits for all updates to come back.  */
+#define NL_DPLANE_WINDOW	128
+#define NL_DPLANE_RING		4096
+
+/* A route update on its way to the kernel.  Allocated and freed by the
+   main thread, it belongs to the dataplane thread between being queued
+   and coming back.  The RIB entry is only compared against, it may be
+   gone by the time the answer comes. */
+struct nl_dplane_ctx
+{
+  struct nl_dplane_ctx *next;
+  u_int32_t id;
+  int cmd;
+  int error;
+#define NL_DPLANE_LOST		-1
+  struct prefix p;
+  struct rib *rib;
+  size_t len;
+  struct nlmsghdr n[];
+};
+
+struct nl_dplane_ring
+{
+  struct nl_dplane_ctx *slot[NL_DPLANE_RING];
+  unsigned int head;		/* advanced by the consumer */
+  unsigned int tail;		/* advanced by the producer */
+};
+
+static int
+nl_dplane_ring_push (struct nl_dplane_ring *ring, struct nl_dplane_ctx *ctx)
+{
+  unsigned int tail = ring->tail;
+
+  if (tail - __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE) == NL_DPLANE_RING)
+    return -1;
+  ring->slot[tail % NL_DPLANE_RING] = ctx;
+  __atomic_store_n (&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+  return 0;
+}
+
+static struct nl_dplane_ctx *
+nl_dplane_ring_peek (struct nl_dplane_ring *ring)
+{
+  unsigned int head = ring->head;
+
+  if (head == __atomic_load_n (&ring->tail, __ATOMIC_SEQ_CST))
+    return NULL;
+  return ring->slot[head % NL_DPLANE_RING];
+}
+
+static void
+nl_dplane_ring_pop (struct nl_dplane_ring *ring)
+{
+  __atomic_store_n (&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+static struct
+{
+  /* Updates to send, and sent updates with their result. */
+  struct nl_dplane_ring req;
+  struct nl_dplane_ring res;
+
+  /* Wakeups of the dataplane thread and of the main thread. */
+  int req_pipe[2];
+  int res_pipe[2];
+  int sleeping;
+
+  /* Set if the dataplane thread is running, otherwise the main thread
+     sends the updates itself as it queues them. */
+  int threaded;
+
+  /* Main thread state. */
+  u_int32_t next_id;
+  unsigned int outstanding;
+  struct thread *t_read;
+
+  /* Failed route installs, reported to the RIB from t_fail as the
+     results may be picked up in the middle of rib_process(). */
+  struct nl_dplane_ctx *fail_head;
+  struct nl_dplane_ctx **fail_tail;
+  struct thread *t_fail;
+
+  /* Statistics kept by the main thread. */
+  unsigned long queued;
+  unsigned long acked;
+  unsigned long errors;
+  unsigned long lost;
+  unsigned long waits;
+  unsigned int outstanding_max;
+
+  /* Statistics kept by the dataplane thread. */
+  unsigned long batches;
+  unsigned int batch_max;
+
+  /* Current and last run of updates, from the first one queued while
+     idle to the last result. */
+  struct timeval burst_start;
+  unsigned long burst_count;
+  unsigned long last_count;
+  unsigned long last_msec;
+} nl_dplane = { .req_pipe = { -1, -1 }, .res_pipe = { -1, -1 },
+                .fail_tail = &nl_dplane.fail_head };
+
+static unsigned long
+netlink_dplane_msec_since (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000
+         + (now.tv_usec - start->tv_usec) / 1000;
+}
+
+/* Send one batch of updates and collect their results.  Runs in the
+   dataplane thread; nothing in here may touch the state of the main
+   thread.  Return the number of updates handled. */
+static int
+netlink_dplane_batch (void)
+{
+  struct nl_dplane_ctx *batch[NL_DPLANE_WINDOW];
+  struct iovec iov[NL_DPLANE_WINDOW];
+  struct sockaddr_nl snl;
+  struct msghdr msg = { (void *) &snl, sizeof snl, iov, 0, NULL, 0, 0 };
+  struct nl_dplane_ctx *ctx;
+  u_int32_t first;
+  int count;
+  int pending;
+  int status;
+  int i;
+
+  memset (&snl, 0, sizeof snl);
+  snl.nl_family = AF_NETLINK;
+
+  first = netlink_dplane.seq + 1;
+  for (count = 0; count < NL_DPLANE_WINDOW; count++)
+    {
+      if ((ctx = nl_dplane_ring_peek (&nl_dplane.req)) == NULL)
+        break;
+      nl_dplane_ring_pop (&nl_dplane.req);
+
+      ctx->n->nlmsg_seq = ++netlink_dplane.seq;
+      ctx->error = NL_DPLANE_LOST;
+      batch[count] = ctx;
+      iov[count].iov_base = ctx->n;
+      iov[count].iov_len = ctx->len;
+    }
+  if (count == 0)
+    return 0;
+  msg.msg_iovlen = count;
+
+  do
+    status = sendmsg (netlink_dplane.sock, &msg, 0);
+  while (status < 0 && errno == EINTR);
+
+  if (status < 0)
+    for (i = 0; i < count; i++)
+      batch[i]->error = errno;
+
+  /* rtnetlink handles the messages within sendmsg(), all the answers are
+     waiting already. */
+  pending = (status < 0) ? 0 : count;
+  while (pending)
+    {
+      char buf[4096];
+      struct iovec riov = { buf, sizeof buf };
+      struct msghdr rmsg = { (void *) &snl, sizeof snl, &riov, 1, NULL, 0, 0 };
+      struct nlmsghdr *h;
+
+      status = recvmsg (netlink_dplane.sock, &rmsg, 0);
+      if (status < 0 && errno == EINTR)
+        continue;
+      /* ENOBUFS or worse, the remaining answers are lost. */
+      if (status <= 0)
+        break;
+
+      for (h = (struct nlmsghdr *) buf; NLMSG_OK (h, (unsigned int) status);
+           h = NLMSG_NEXT (h, status))
+        {
+          struct nlmsgerr *err = (struct nlmsgerr *) NLMSG_DATA (h);
+          u_int32_t index;
+
+          if (h->nlmsg_type != NLMSG_ERROR
+              || h->nlmsg_len < NLMSG_LENGTH (sizeof (struct nlmsgerr)))
+            continue;
+          index = err->msg.nlmsg_seq - first;
+          if (index >= (u_int32_t) count
+              || batch[index]->error != NL_DPLANE_LOST)
+            continue;
+          batch[index]->error = -err->error;
+          pending--;
+        }
+    }
+
+  for (i = 0; i < count; i++)
+    nl_dplane_ring_push (&nl_dplane.res, batch[i]);
+
+  __atomic_add_fetch (&nl_dplane.batches, 1, __ATOMIC_RELAXED);
+  if ((unsigned int) count > nl_dplane.batch_max)
+    __atomic_store_n (&nl_dplane.batch_max, count, __ATOMIC_RELAXED);
+  return count;
+}
+
+/* The dataplane thread. */
+static void *
+netlink_dplane_thread (void *arg)
+{
+  char buf[64];
+
+  while (1)
+    {
+      if (netlink_dplane_batch ())
+        {
+          if (write (nl_dplane.res_pipe[1], "", 1) < 0)
+            ; /* The main thread has been woken up already. */
+          continue;
+        }
+
+      /* Nothing queued, sleep unless something came in meanwhile. */
+      __atomic_store_n (&nl_dplane.sleeping, 1, __ATOMIC_SEQ_CST);
+      if (nl_dplane_ring_peek (&nl_dplane.req) == NULL)
+        while (read (nl_dplane.req_pipe[0], buf, sizeof buf) < 0
+               && errno == EINTR)
+          ;
+      __atomic_store_n (&nl_dplane.sleeping, 0, __ATOMIC_SEQ_CST);
+    }
+  return NULL;
+}
+
+static int
+netlink_dplane_report (struct thread *thread)
+{
+  struct nl_dplane_ctx *ctx;
+
+  nl_dplane.t_fail = NULL;
+
+  while ((ctx = nl_dplane.fail_head) != NULL)
+    {
+      nl_dplane.fail_head = ctx->next;
+      rib_kernel_failed (&ctx->p, ctx->rib, ctx->id);
+      XFREE (MTYPE_DPLANE_CTX, ctx);
+    }
+  nl_dplane.fail_tail = &nl_dplane.fail_head;
+  return 0;
+}
+
+/* Account for an update which came back from the dataplane thread. */
+static void
+netlink_dplane_result (struct nl_dplane_ctx *ctx)
+{
+  char buf[INET6_ADDRSTRLEN + 4];
+  int errnum = ctx->error;
+
+  nl_dplane.outstanding--;
+  if (nl_dplane.outstanding == 0)
+    {
+      nl_dplane.last_count = nl_dplane.burst_count;
+      nl_dplane.last_msec = netlink_dplane_msec_since (&nl_dplane.burst_start);
+    }
+
+  if (errnum == 0)
+    {
+      nl_dplane.acked++;
+      XFREE (MTYPE_DPLANE_CTX, ctx);
+      return;
+    }
+  prefix2str (&ctx->p, buf, sizeof buf);
+
+  if (errnum == NL_DPLANE_LOST)
+    {
+      zlog_warn ("%s: answer lost, type=%s(%u), route %s",
+                 netlink_dplane.name, lookup (nlmsg_str, ctx->cmd), ctx->cmd,
+                 buf);
+      nl_dplane.lost++;
+      XFREE (MTYPE_DPLANE_CTX, ctx);
+      return;
+    }
+  nl_dplane.acked++;
+
+  /* Errors due to races in link handling, as in netlink_parse_info(). */
+  if ((ctx->cmd == RTM_DELROUTE && (errnum == ENODEV || errnum == ESRCH))
+      || (ctx->cmd == RTM_NEWROUTE && errnum == EEXIST))
+    {
+      if (IS_ZEBRA_DEBUG_KERNEL)
+        zlog_debug ("%s: error: %s type=%s(%u), route %s",
+                    netlink_dplane.name, safe_strerror (errnum),
+                    lookup (nlmsg_str, ctx->cmd), ctx->cmd, buf);
+      XFREE (MTYPE_DPLANE_CTX, ctx);
+      return;
+    }
+
+  zlog_err ("%s error: %s, type=%s(%u), route %s",
+            netlink_dplane.name, safe_strerror (errnum),
+            lookup (nlmsg_str, ctx->cmd), ctx->cmd, buf);
+  nl_dplane.errors++;
+
+  if (ctx->cmd != RTM_NEWROUTE)
+    {
+      XFREE (MTYPE_DPLANE_CTX, ctx);
+      return;
+    }
+
+  ctx->next = NULL;
+  *nl_dplane.fail_tail = ctx;
+  nl_dplane.fail_tail = &ctx->next;
+  if (! nl_dplane.t_fail)
+    nl_dplane.t_fail = thread_add_event (zebrad.master, netlink_dplane_report,
+                                         NULL, 0);
+}
+
+/* Pick up the updates returned by the dataplane thread. */
+static void
+netlink_dplane_results (void)
+{
+  struct nl_dplane_ctx *ctx;
+
+  while ((ctx = nl_dplane_ring_peek (&nl_dplane.res)) != NULL)
+    {
+      nl_dplane_ring_pop (&nl_dplane.res);
+      netlink_dplane_result (ctx);
+    }
+}
+
+static int
+netlink_dplane_read (struct thread *thread)
+{
+  char buf[64];
+
+  nl_dplane.t_read = NULL;
+  while (read (nl_dplane.res_pipe[0], buf, sizeof buf) > 0)
+    ;
+  netlink_dplane_results ();
+
+  nl_dplane.t_read = thread_add_read (zebrad.master, netlink_dplane_read,
+                                      NULL, nl_dplane.res_pipe[0]);
+  return 0;
+}
+
+/* Wait for the dataplane thread to return some updates. */
+static void
+netlink_dplane_wait (void)
+{
+  struct pollfd pfd;
+  char buf[64];
+
+  if (! nl_dplane.threaded)
+    {
+      if (zserv_privs.change (ZPRIVS_RAISE))
+        zlog (NULL, LOG_ERR, "Can't raise privileges");
+      netlink_dplane_batch ();
+      if (zserv_privs.change (ZPRIVS_LOWER))
+        zlog (NULL, LOG_ERR, "Can't lower privileges");
+      netlink_dplane_results ();
+      return;
+    }
+
+  pfd.fd = nl_dplane.res_pipe[0];
+  pfd.events = POLLIN;
+  if (poll (&pfd, 1, -1) < 0 && errno != EINTR)
+    zlog_err ("%s: poll failed: %s", netlink_dplane.name,
+              safe_strerror (errno));
+  while (read (nl_dplane.res_pipe[0], buf, sizeof buf) > 0)
+    ;
+  netlink_dplane_results ();
+}
+
+/* Wait until all the updates queued have come back. */
+static void
+netlink_dplane_sync (void)
+{
+  while (nl_dplane.outstanding)
+    netlink_dplane_wait ();
+}
+
+/* Queue a route update for the kernel.  Failures are reported to the RIB
+   by rib_kernel_failed() once the answer has come. */
+static int
+netlink_dplane_enqueue (struct nlmsghdr *n, struct prefix *p, struct rib *rib)
+{
+  struct nl_dplane_ctx *ctx;
+
+  if (netlink_dplane.sock < 0)
+    return -1;
+
+  if (nl_dplane.outstanding >= NL_DPLANE_RING)
+    {
+      nl_dplane.waits++;
+      while (nl_dplane.outstanding >= NL_DPLANE_RING)
+        netlink_dplane_wait ();
+    }
+
+  if (nl_dplane.outstanding == 0)
+    {
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &nl_dplane.burst_start);
+      nl_dplane.burst_count = 0;
+    }
+
+  n->nlmsg_flags |= NLM_F_ACK;
+
+  if (IS_ZEBRA_DEBUG_KERNEL)
+    zlog_debug ("%s: %s type %s(%u)", __func__, netlink_dplane.name,
+                lookup (nlmsg_str, n->nlmsg_type), n->nlmsg_type);
+
+  /* Messages are sent back to back, each is padded to its alignment. */
+  ctx = XCALLOC (MTYPE_DPLANE_CTX,
+                 sizeof (struct nl_dplane_ctx) + NLMSG_ALIGN (n->nlmsg_len));
+  ctx->id = ++nl_dplane.next_id;
+  ctx->cmd = n->nlmsg_type;
+  prefix_copy (&ctx->p, p);
+  ctx->rib = rib;
+  ctx->len = NLMSG_ALIGN (n->nlmsg_len);
+  memcpy (ctx->n, n, n->nlmsg_len);
+  rib->kernel_seq = ctx->id;
+
+  nl_dplane_ring_push (&nl_dplane.req, ctx);
+  nl_dplane.outstanding++;
+  if (nl_dplane.outstanding > nl_dplane.outstanding_max)
+    nl_dplane.outstanding_max = nl_dplane.outstanding;
+  nl_dplane.queued++;
+  nl_dplane.burst_count++;
+
+  if (! nl_dplane.threaded)
+    netlink_dplane_wait ();
+  else if (__atomic_load_n (&nl_dplane.sleeping, __ATOMIC_SEQ_CST))
+    if (write (nl_dplane.req_pipe[1], "", 1) < 0)
+      ; /* The dataplane thread has been woken up already. */
+  return 0;
+}
+
+/* Start the dataplane thread.  This is done from the main loop, once
+   zebra has daemonized, and updates are made synchronously until then.
+   The thread inherits the privileges of the main thread at the time,
+   and keeps them. */
+static int
+netlink_dplane_start (struct thread *t)
+{
+  pthread_t thread;
+  sigset_t all, old;
+  int ret;
+
+  if (pipe (nl_dplane.req_pipe) < 0 || pipe (nl_dplane.res_pipe) < 0)
+    {
+      zlog_err ("%s: can't create pipes: %s", netlink_dplane.name,
+                safe_strerror (errno));
+      return 0;
+    }
+  set_nonblocking (nl_dplane.req_pipe[1]);
+  set_nonblocking (nl_dplane.res_pipe[0]);
+  set_nonblocking (nl_dplane.res_pipe[1]);
+
+  /* Whatever was queued so far is done with. */
+  netlink_dplane_sync ();
+
+  /* Signals are for the main thread. */
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &old);
+
+  if (zserv_privs.change (ZPRIVS_RAISE))
+    zlog (NULL, LOG_ERR, "Can't raise privileges");
+  ret = pthread_create (&thread, NULL, netlink_dplane_thread, NULL);
+  if (zserv_privs.change (ZPRIVS_LOWER))
+    zlog (NULL, LOG_ERR, "Can't lower privileges");
+
+  pthread_sigmask (SIG_SETMASK, &old, NULL);
+
+  if (ret != 0)
+    {
+      zlog_err ("%s: can't start the dataplane thread, updating the kernel "
+                "synchronously: %s", netlink_dplane.name, safe_strerror (ret));
+      return 0;
+    }
+  pthread_detach (thread);
+  nl_dplane.threaded = 1;
+
+  nl_dplane.t_read = thread_add_read (zebrad.master, netlink_dplane_read,
+                                      NULL, nl_dplane.res_pipe[0]);
+  return 0;
+}
+
 static int
 netlink_talk_filter (struct sockaddr_nl *snl, struct nlmsghdr *h)
 {
@@ -1154,6 +1946,10 @@ netlink_talk (struct nlmsghdr *n, struct nlsock *nl)
   struct msghdr msg = { (void *) &snl, sizeof snl, &iov, 1, NULL, 0, 0 };
   int save_errno;
 
+  /* Route updates in flight are answered first. */
+  if (nl == &netlink_cmd)
+    netlink_dplane_sync ();
+
   memset (&snl, 0, sizeof snl);
   snl.nl_family = AF_NETLINK;
 
@@ -1264,13 +2060,13 @@ netlink_route (int cmd, int family, void *dest, int length, void *gate,
   return 0;
 }
 
-/* Routing table change via netlink interface. */
+/* Routing table change via netlink interface.  With REPLACE, a new route
+   takes the place of the one with the same metric in the table. */
 static int
-netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
-                         int family)
+netlink_route_multipath (int cmd, int replace, struct prefix *p,
+                         struct rib *rib, int family)
 {
   int bytelen;
-  struct sockaddr_nl snl;
   struct nexthop *nexthop = NULL;
   int nexthop_num = 0;
   int discard;
@@ -1288,6 +2084,8 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
 
   req.n.nlmsg_len = NLMSG_LENGTH (sizeof (struct rtmsg));
   req.n.nlmsg_flags = NLM_F_CREATE | NLM_F_REQUEST;
+  if (replace)
+    req.n.nlmsg_flags |= NLM_F_REPLACE;
   req.n.nlmsg_type = cmd;
   req.r.rtm_family = family;
   req.r.rtm_table = rib->table;
@@ -1328,6 +2126,36 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
       goto skip;
     }
 
+#ifdef RTM_NEWNEXTHOP
+  /* A route using a shared nexthop group refers to the kernel nexthop
+     object of the group instead of carrying its own nexthop.  */
+  if (family == AF_INET && rib->nhg_ref)
+    {
+      u_int32_t nhid = 0;
+
+      if (cmd == RTM_NEWROUTE)
+        nhid = nhg_kernel_bind (rib);
+      else if (CHECK_FLAG (rib->status, RIB_ENTRY_NHG_FIB))
+        nhid = rib->nhg_ref->nhg->kernel_id;
+
+      /* Should the kernel refuse the route, rib_kernel_failed() has it
+         installed with its own nexthop instead. */
+      if (nhid)
+        {
+          addattr32 (&req.n, sizeof req, RTA_NH_ID, nhid);
+
+          if (cmd == RTM_DELROUTE)
+            nhg_kernel_unbind (rib, 0);
+          else
+            for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+              if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+                SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+
+          return netlink_dplane_enqueue (&req.n, p, rib);
+        }
+    }
+#endif /* RTM_NEWNEXTHOP */
+
   /* Multipath case. */
   if (rib->nexthop_active_num == 1 || MULTIPATH_NUM == 1)
     {
@@ -1689,37 +2517,177 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
 
 skip:
 
-  /* Destination netlink address. */
+  /* Queue for the kernel. */
+  return netlink_dplane_enqueue (&req.n, p, rib);
+}
+
+#ifdef RTM_NEWNEXTHOP
+/* Nexthop object change via netlink interface. */
+static int
+netlink_nexthop (int cmd, struct nhg *nhg)
+{
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+    char buf[256];
+  } req;
+
+  if (! netlink_nhg_supported)
+    return -1;
+
+  memset (&req, 0, sizeof req);
+
+  req.n.nlmsg_len = NLMSG_LENGTH (sizeof (struct nhmsg));
+  req.n.nlmsg_flags = NLM_F_REQUEST;
+  req.n.nlmsg_type = cmd;
+
+  addattr32 (&req.n, sizeof req, NHA_ID, nhg->kernel_id);
+
+  if (cmd == RTM_NEWNEXTHOP)
+    {
+      req.n.nlmsg_flags |= NLM_F_CREATE | NLM_F_REPLACE;
+      req.nhm.nh_family = AF_INET;
+      req.nhm.nh_protocol = RTPROT_ZEBRA;
+      addattr_l (&req.n, sizeof req, NHA_GATEWAY, &nhg->kernel_gate, 4);
+      addattr32 (&req.n, sizeof req, NHA_OIF, nhg->kernel_ifindex);
+
+      if (IS_ZEBRA_DEBUG_KERNEL)
+        zlog_debug ("netlink_nexthop(): nexthop %u via %s if %u",
+                    nhg->kernel_id, inet_ntoa (nhg->kernel_gate),
+                    nhg->kernel_ifindex);
+    }
+
+  return netlink_talk (&req.n, &netlink_cmd);
+}
+
+static int
+netlink_nexthop_probe_filter (struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+  return 0;
+}
+
+/* Find out whether the kernel has nexthop objects by dumping them.  */
+static void
+netlink_nexthop_probe (void)
+{
+  int ret;
+  int save_errno;
+  struct sockaddr_nl snl;
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+  } req;
+
   memset (&snl, 0, sizeof snl);
   snl.nl_family = AF_NETLINK;
 
-  /* Talk to netlink socket. */
-  return netlink_talk (&req.n, &netlink_cmd);
+  memset (&req, 0, sizeof req);
+  req.n.nlmsg_len = sizeof req;
+  req.n.nlmsg_type = RTM_GETNEXTHOP;
+  req.n.nlmsg_flags = NLM_F_DUMP | NLM_F_REQUEST;
+  req.n.nlmsg_pid = netlink_cmd.snl.nl_pid;
+  req.n.nlmsg_seq = ++netlink_cmd.seq;
+
+  if (zserv_privs.change (ZPRIVS_RAISE))
+    zlog (NULL, LOG_ERR, "Can't raise privileges");
+  ret = sendto (netlink_cmd.sock, (void *) &req, sizeof req, 0,
+                (struct sockaddr *) &snl, sizeof snl);
+  save_errno = errno;
+  if (zserv_privs.change (ZPRIVS_LOWER))
+    zlog (NULL, LOG_ERR, "Can't lower privileges");
+
+  if (ret < 0)
+    {
+      zlog (NULL, LOG_ERR, "%s sendto failed: %s", netlink_cmd.name,
+            safe_strerror (save_errno));
+      return;
+    }
+
+  if (netlink_parse_info (netlink_nexthop_probe_filter, &netlink_cmd) == 0)
+    netlink_nhg_supported = 1;
+  else
+    zlog_info ("kernel has no nexthop objects, "
+               "nexthop groups are installed per route");
 }
 
+int
+kernel_nhg_add (struct nhg *nhg)
+{
+  return netlink_nexthop (RTM_NEWNEXTHOP, nhg);
+}
+
+int
+kernel_nhg_delete (struct nhg *nhg)
+{
+  return netlink_nexthop (RTM_DELNEXTHOP, nhg);
+}
+#else /* RTM_NEWNEXTHOP */
+int
+kernel_nhg_add (struct nhg *nhg)
+{
+  return -1;
+}
+
+int
+kernel_nhg_delete (struct nhg *nhg)
+{
+  return -1;
+}
+#endif /* RTM_NEWNEXTHOP */
+
 int
 kernel_add_ipv4 (struct prefix *p, struct rib *rib)
 {
-  return netlink_route_multipath (RTM_NEWROUTE, p, rib, AF_INET);
+  return netlink_route_multipath (RTM_NEWROUTE, 0, p, rib, AF_INET);
 }
 
 int
 kernel_delete_ipv4 (struct prefix *p, struct rib *rib)
 {
-  return netlink_route_multipath (RTM_DELROUTE, p, rib, AF_INET);
+  return netlink_route_multipath (RTM_DELROUTE, 0, p, rib, AF_INET);
+}
+
+/* Install RIB over OLD in one go, so that there is no time the kernel has
+   neither.  OLD is only deleted afterwards if RIB did not replace it. */
+static int
+netlink_route_replace (struct prefix *p, struct rib *old, struct rib *rib,
+                       int family)
+{
+  int ret;
+
+  ret = netlink_route_multipath (RTM_NEWROUTE, 1, p, rib, family);
+  if (old->metric != rib->metric
+      || (old->table ? old->table : RT_TABLE_MAIN)
+         != (rib->table ? rib->table : RT_TABLE_MAIN))
+    netlink_route_multipath (RTM_DELROUTE, 0, p, old, family);
+  return ret;
+}
+
+int
+kernel_replace_ipv4 (struct prefix *p, struct rib *old, struct rib *rib)
+{
+  return netlink_route_replace (p, old, rib, AF_INET);
 }
 
 #ifdef HAVE_IPV6
 int
 kernel_add_ipv6 (struct prefix *p, struct rib *rib)
 {
-  return netlink_route_multipath (RTM_NEWROUTE, p, rib, AF_INET6);
+  return netlink_route_multipath (RTM_NEWROUTE, 0, p, rib, AF_INET6);
 }
 
 int
 kernel_delete_ipv6 (struct prefix *p, struct rib *rib)
 {
-  return netlink_route_multipath (RTM_DELROUTE, p, rib, AF_INET6);
+  return netlink_route_multipath (RTM_DELROUTE, 0, p, rib, AF_INET6);
+}
+
+int
+kernel_replace_ipv6 (struct prefix *p, struct rib *old, struct rib *rib)
+{
+  return netlink_route_replace (p, old, rib, AF_INET6);
 }
 
 /* Delete IPv6 route from the kernel. */
@@ -1731,6 +2699,58 @@ kernel_delete_ipv6_old (struct prefix_ipv6 *dest, struct in6_addr *gate,
                         dest->prefixlen, gate, index, flags, table);
 }
 #endif /* HAVE_IPV6 */
+
+/* Wait until the kernel has answered all the route updates queued. */
+void
+kernel_flush (void)
+{
+  netlink_dplane_sync ();
+}
+
+void
+kernel_dplane_show (struct vty *vty)
+{
+  unsigned long batches = __atomic_load_n (&nl_dplane.batches,
+                                           __ATOMIC_RELAXED);
+
+  vty_out (vty, "Kernel dataplane: netlink, %s%s",
+           nl_dplane.threaded ? "dataplane thread" : "synchronous",
+           VTY_NEWLINE);
+  vty_out (vty, "  Queue %u updates, batches of up to %u messages%s",
+           NL_DPLANE_RING, NL_DPLANE_WINDOW, VTY_NEWLINE);
+  vty_out (vty, "  %lu route messages in %lu batches", nl_dplane.queued,
+           batches);
+  if (batches)
+    vty_out (vty, " (%lu per batch, max %u)", nl_dplane.queued / batches,
+             __atomic_load_n (&nl_dplane.batch_max, __ATOMIC_RELAXED));
+  vty_out (vty, "%s", VTY_NEWLINE);
+  vty_out (vty, "  %lu acknowledged, %lu errors, %lu acknowledgements lost%s",
+           nl_dplane.acked, nl_dplane.errors, nl_dplane.lost, VTY_NEWLINE);
+  vty_out (vty, "  %u outstanding (max %u), queue full %lu times%s",
+           nl_dplane.outstanding, nl_dplane.outstanding_max, nl_dplane.waits,
+           VTY_NEWLINE);
+
+  if (nl_dplane.outstanding)
+    {
+      unsigned long msec = netlink_dplane_msec_since (&nl_dplane.burst_start);
+
+      vty_out (vty, "  Current run: %lu routes in %lu ms",
+               nl_dplane.burst_count, msec);
+      if (msec)
+        vty_out (vty, " (%lu routes/s)", nl_dplane.burst_count * 1000 / msec);
+      vty_out (vty, "%s", VTY_NEWLINE);
+    }
+  if (nl_dplane.last_count)
+    {
+      vty_out (vty, "  Last run: %lu routes in %lu ms", nl_dplane.last_count,
+               nl_dplane.last_msec);
+      if (nl_dplane.last_msec)
+        vty_out (vty, " (%lu routes/s)",
+                 nl_dplane.last_count * 1000 / nl_dplane.last_msec);
+      vty_out (vty, "%s", VTY_NEWLINE);
+    }
+}
+
 
 /* Interface address modification. */
 static int
@@ -1801,31 +2821,58 @@ extern struct thread_master *master;
 static int
 kernel_read (struct thread *thread)
 {
-  netlink_parse_info (netlink_information_fetch, &netlink);
-  thread_add_read (zebrad.master, kernel_read, NULL, netlink.sock);
+  struct nlsock *nl = THREAD_ARG (thread);
+
+  netlink_parse_info (netlink_information_fetch, nl);
+  thread_add_read (zebrad.master, kernel_read, nl, nl->sock);
 
   return 0;
 }
 
+void
+kernel_netlink_show (struct vty *vty)
+{
+  struct nlsock *nls[] = { &netlink, &netlink_route_listen, &netlink_cmd,
+                           &netlink_dump };
+  unsigned int i;
+
+  vty_out (vty, "%-22s %8s %10s %10s %10s %8s %9s %8s%s",
+           "Socket", "Batch", "Rcvbuf", "Reads", "Datagrams", "Overruns",
+           "Truncated", "Resyncs", VTY_NEWLINE);
+  for (i = 0; i < sizeof nls / sizeof nls[0]; i++)
+    {
+      struct nlsock *nl = nls[i];
+
+      if (nl->sock < 0)
+        continue;
+      vty_out (vty, "%-22s %8d %10d %10lu %10lu %8lu %9lu %8lu%s",
+               nl->name, nl->batch, getsockopt_so_recvbuf (nl->sock),
+               nl->reads, nl->datagrams, nl->overruns, nl->truncated,
+               nl->resyncs, VTY_NEWLINE);
+    }
+}
+
 /* Filter out messages from self that occur on listener socket,
-   caused by our actions on the command socket
+   caused by our actions on the command and dataplane sockets
  */
-static void netlink_install_filter (int sock, __u32 pid)
+static void netlink_install_filter (int sock, __u32 pid, __u32 dplane_pid)
 {
   struct sock_filter filter[] = {
     /* 0: ldh [4]	          */
     BPF_STMT(BPF_LD|BPF_ABS|BPF_H, offsetof(struct nlmsghdr, nlmsg_type)),
-    /* 1: jeq 0x18 jt 3 jf 6  */
+    /* 1: jeq 0x18 jt 3 jf 2  */
     BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, htons(RTM_NEWROUTE), 1, 0),
-    /* 2: jeq 0x19 jt 3 jf 6  */
-    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, htons(RTM_DELROUTE), 0, 3),
+    /* 2: jeq 0x19 jt 3 jf 7  */
+    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, htons(RTM_DELROUTE), 0, 4),
     /* 3: ldw [12]		  */
     BPF_STMT(BPF_LD|BPF_ABS|BPF_W, offsetof(struct nlmsghdr, nlmsg_pid)),
-    /* 4: jeq XX  jt 5 jf 6   */
-    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, htonl(pid), 0, 1),
-    /* 5: ret 0    (skip)     */
+    /* 4: jeq XX  jt 6 jf 5   */
+    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, htonl(pid), 1, 0),
+    /* 5: jeq YY  jt 6 jf 7   */
+    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, htonl(dplane_pid), 0, 1),
+    /* 6: ret 0    (skip)     */
     BPF_STMT(BPF_RET|BPF_K, 0),
-    /* 6: ret 0xffff (keep)   */
+    /* 7: ret 0xffff (keep)   */
     BPF_STMT(BPF_RET|BPF_K, 0xffff),
   };
 
@@ -1838,6 +2885,27 @@ static void netlink_install_filter (int sock, __u32 pid)
     zlog_warn ("Can't install socket filter: %s\n", safe_strerror(errno));
 }
 
+/* Read the events of a listening socket as they come. */
+static int
+kernel_listen (struct nlsock *nl)
+{
+  if (nl->sock <= 0)
+    return -1;
+
+  /* Only want non-blocking on the netlink event socket */
+  if (fcntl (nl->sock, F_SETFL, O_NONBLOCK) < 0)
+    zlog (NULL, LOG_ERR, "Can't set %s socket flags: %s", nl->name,
+          safe_strerror (errno));
+
+  /* Set receive buffer size if it's set from command line */
+  if (nl_rcvbufsize)
+    netlink_recvbuf (nl, nl_rcvbufsize);
+
+  nl->batch = NL_RCV_BATCH;
+  thread_add_read (zebrad.master, kernel_read, nl, nl->sock);
+  return 0;
+}
+
 /* Exported interface function.  This function simply calls
    netlink_socket (). */
 void
@@ -1845,26 +2913,48 @@ kernel_init (void)
 {
   unsigned long groups;
 
-  groups = RTMGRP_LINK | RTMGRP_IPV4_ROUTE | RTMGRP_IPV4_IFADDR;
+  /* Link and address events are listened to apart from route events, so
+     that the messages lost by one socket are about a single kind of
+     object. */
+  groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
 #ifdef HAVE_IPV6
-  groups |= RTMGRP_IPV6_ROUTE | RTMGRP_IPV6_IFADDR;
+  groups |= RTMGRP_IPV6_IFADDR;
 #endif /* HAVE_IPV6 */
   netlink_socket (&netlink, groups);
+  groups = RTMGRP_IPV4_ROUTE;
+#ifdef HAVE_IPV6
+  groups |= RTMGRP_IPV6_ROUTE;
+#endif /* HAVE_IPV6 */
+  netlink_socket (&netlink_route_listen, groups);
   netlink_socket (&netlink_cmd, 0);
+  netlink_socket (&netlink_dplane, 0);
+  netlink_socket (&netlink_dump, 0);
 
-  /* Register kernel socket. */
-  if (netlink.sock > 0)
+#if defined(SOL_NETLINK) && defined(NETLINK_CAP_ACK)
+  /* Errors need not echo the whole request, which keeps the answers to a
+     batch of route updates small. */
+  if (netlink_dplane.sock >= 0)
     {
-      /* Only want non-blocking on the netlink event socket */
-      if (fcntl (netlink.sock, F_SETFL, O_NONBLOCK) < 0)
-	zlog (NULL, LOG_ERR, "Can't set %s socket flags: %s", netlink.name,
-		safe_strerror (errno));
-
-      /* Set receive buffer size if it's set from command line */
-      if (nl_rcvbufsize)
-	netlink_recvbuf (&netlink, nl_rcvbufsize);
+      int on = 1;
 
-      netlink_install_filter (netlink.sock, netlink_cmd.snl.nl_pid);
-      thread_add_read (zebrad.master, kernel_read, NULL, netlink.sock);
+      setsockopt (netlink_dplane.sock, SOL_NETLINK, NETLINK_CAP_ACK, &on,
+                  sizeof on);
     }
+#endif /* SOL_NETLINK && NETLINK_CAP_ACK */
+  if (netlink_dplane.sock >= 0)
+    thread_add_event (zebrad.master, netlink_dplane_start, NULL, 0);
+
+#ifdef RTM_NEWNEXTHOP
+  if (netlink_cmd.sock >= 0)
+    netlink_nexthop_probe ();
+#endif /* RTM_NEWNEXTHOP */
+
+  /* Register kernel sockets. */
+  kernel_listen (&netlink);
+  if (kernel_listen (&netlink_route_listen) == 0)
+    netlink_install_filter (netlink_route_listen.sock,
+                            netlink_cmd.snl.nl_pid,
+                            netlink_dplane.sock >= 0
+                            ? netlink_dplane.snl.nl_pid
+                            : netlink_cmd.snl.nl_pid);
 }
@@ -28,6 +28,7 @@
 #include "log.h"
 #include "str.h"
 #include "privs.h"
+#include "vty.h"
 
 #include "zebra/debug.h"
 #include "zebra/rib.h"
@@ -106,7 +107,7 @@ kernel_rtm_ipv4 (int cmd, struct prefix *p, struct rib *rib, int family)
        * but this if statement seems overly cautious - what about
        * other than ADD and DELETE?
        */
-      if ((cmd == RTM_ADD
+      if (((cmd == RTM_ADD || cmd == RTM_CHANGE)
 	   && CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
 	  || (cmd == RTM_DELETE
 	      && CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB)
@@ -166,6 +167,10 @@ kernel_rtm_ipv4 (int cmd, struct prefix *p, struct rib *rib, int family)
 			     rib->flags,
 			     rib->metric);
 
+	  /* A route changed in place gets its other nexthops added. */
+	  if (cmd == RTM_CHANGE && error == ZEBRA_ERR_NOERROR)
+	    cmd = RTM_ADD;
+
            if (IS_ZEBRA_DEBUG_RIB)
            {
              if (!gate)
@@ -256,6 +261,48 @@ kernel_delete_ipv4 (struct prefix *p, struct rib *rib)
   return route;
 }
 
+/* Install RIB in place of OLD with RTM_CHANGE, there being a single
+   route per destination in the table. */
+int
+kernel_replace_ipv4 (struct prefix *p, struct rib *old, struct rib *rib)
+{
+  int route;
+
+  if (zserv_privs.change(ZPRIVS_RAISE))
+    zlog (NULL, LOG_ERR, "Can't raise privileges");
+  route = kernel_rtm_ipv4 (RTM_CHANGE, p, rib, AF_INET);
+  if (zserv_privs.change(ZPRIVS_LOWER))
+    zlog (NULL, LOG_ERR, "Can't lower privileges");
+
+  return route;
+}
+
+/* No nexthop objects in the routing socket API, routes sharing a nexthop
+   group are updated one by one. */
+int
+kernel_nhg_add (struct nhg *nhg)
+{
+  return -1;
+}
+
+int
+kernel_nhg_delete (struct nhg *nhg)
+{
+  return -1;
+}
+
+/* Route updates are made synchronously. */
+void
+kernel_flush (void)
+{
+}
+
+void
+kernel_dplane_show (struct vty *vty)
+{
+  vty_out (vty, "Kernel dataplane: %s, synchronous%s", "routing socket", VTY_NEWLINE);
+}
+
 #ifdef HAVE_IPV6
 
 /* Calculate sin6_len value for netmask socket value. */
@@ -380,7 +427,7 @@ kernel_rtm_ipv6_multipath (int cmd, struct prefix *p, struct rib *rib,
     {
       gate = 0;
 
-      if ((cmd == RTM_ADD
+      if (((cmd == RTM_ADD || cmd == RTM_CHANGE)
 	   && CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
 	  || (cmd == RTM_DELETE
 #if 0
@@ -419,7 +466,7 @@ kernel_rtm_ipv6_multipath (int cmd, struct prefix *p, struct rib *rib,
 		ifindex = nexthop->ifindex;
 	    }
 
-	  if (cmd == RTM_ADD)
+	  if (cmd == RTM_ADD || cmd == RTM_CHANGE)
 	    SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
 	}
 
@@ -456,6 +503,10 @@ kernel_rtm_ipv6_multipath (int cmd, struct prefix *p, struct rib *rib,
 			rib->flags,
 			rib->metric);
 
+      /* A route changed in place gets its other nexthops added. */
+      if (cmd == RTM_CHANGE)
+	cmd = RTM_ADD;
+
 #if 0
       if (error)
 	{
@@ -506,6 +557,20 @@ kernel_delete_ipv6 (struct prefix *p, struct rib *rib)
   return route;
 }
 
+int
+kernel_replace_ipv6 (struct prefix *p, struct rib *old, struct rib *rib)
+{
+  int route;
+
+  if (zserv_privs.change(ZPRIVS_RAISE))
+    zlog (NULL, LOG_ERR, "Can't raise privileges");
+  route =  kernel_rtm_ipv6_multipath (RTM_CHANGE, p, rib, AF_INET6);
+  if (zserv_privs.change(ZPRIVS_LOWER))
+    zlog (NULL, LOG_ERR, "Can't lower privileges");
+
+  return route;
+}
+
 /* Delete IPv6 route from the kernel. */
 int
 kernel_delete_ipv6_old (struct prefix_ipv6 *dest, struct in6_addr *gate,
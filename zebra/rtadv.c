@@ -176,24 +176,38 @@ struct rtadv_dnssl_entry
 
 extern struct zebra_t zebrad;
 
-enum rtadv_event {RTADV_START, RTADV_STOP, RTADV_TIMER, 
-		  RTADV_TIMER_MSEC, RTADV_READ};
+enum rtadv_event {RTADV_START, RTADV_STOP, RTADV_READ};
 
 static void rtadv_event (enum rtadv_event, int);
 
 static int if_join_all_router (int, struct interface *);
 static int if_leave_all_router (int, struct interface *);
 
+/* Unsolicited advertisements are scheduled in a timer wheel of ticks of
+   RTADV_WHEEL_TICK milliseconds, its last slot holding the interfaces to
+   send an advertisement to at once. */
+#define RTADV_WHEEL_TICK	10
+#define RTADV_WHEEL_SLOTS	4096
+#define RTADV_WHEEL_NOW		RTADV_WHEEL_SLOTS
+
 /* Structure which hold status of router advertisement. */
 struct rtadv
 {
   int sock;
 
   int adv_if_count;
-  int adv_msec_if_count;
 
   struct thread *ra_read;
   struct thread *ra_timer;
+
+  /* Timer wheel, tick it was last turned to, and tick of the timer. */
+  struct interface *wheel[RTADV_WHEEL_SLOTS + 1];
+  unsigned long wheel_tick;
+  unsigned long wheel_armed;
+
+  /* Bumped when router-scope options of the advertisements change. */
+  unsigned generation;
+
   /* router-scope setting; 0: disabled, 1: enabled */
   u_char AdvSendAdvertisements;
   /* router-scope RDNSS options */
@@ -400,61 +414,36 @@ rtadv_append_connprefix_tlvs (unsigned char *buf, const struct list *list,
   return len;
 }
 
-/* Send router advertisement packet. */
-static void
-rtadv_send_packet (const int sock, const struct interface *ifp)
+/* The link-layer address of an interface, as placed in the Source
+ * Link-layer Address option. */
+static const u_char *
+rtadv_hw_addr (const struct interface *ifp, int *len)
 {
-  struct msghdr msg;
-  struct iovec iov;
-  struct cmsghdr  *cmsgptr;
-  struct in6_pktinfo *pkt;
-  struct sockaddr_in6 addr;
 #ifdef HAVE_STRUCT_SOCKADDR_DL
-  struct sockaddr_dl *sdl;
+  *len = ifp->sdl.sdl_alen;
+  return (const u_char *) LLADDR (&ifp->sdl);
+#else
+  *len = ifp->hw_addr_len;
+  return ifp->hw_addr;
 #endif /* HAVE_STRUCT_SOCKADDR_DL */
-  static void *adata = NULL;
-  unsigned char buf[RTADV_MSG_SIZE];
+}
+
+/* Make router advertisement message. */
+static int
+rtadv_build_packet (unsigned char *buf, const struct interface *ifp)
+{
   struct nd_router_advert *ndra;
-  int ret;
   int len = 0;
   struct zebra_if *zif;
   struct rtadv_prefix *rprefix;
-  struct in6_addr all_nodes_addr = {{{0xff,0x02,0,0,0,0,0,0,0,0,0,0,0,0,0,1}}};
   struct listnode *node;
   u_int16_t pkt_RouterLifetime;
-
-  /*
-   * Allocate control message bufffer.  This is dynamic because
-   * CMSG_SPACE is not guaranteed not to call a function.  Note that
-   * the size will be different on different architectures due to
-   * differing alignment rules.
-   */
-  if (adata == NULL)
-    {
-      /* XXX Free on shutdown. */
-      adata = malloc(CMSG_SPACE(sizeof(struct in6_pktinfo)));
-	   
-      if (adata == NULL)
-	zlog_err("rtadv_send_packet: can't malloc control data\n");
-    }
-
-  /* Logging of packet. */
-  if (IS_ZEBRA_DEBUG_PACKET)
-    zlog_debug ("Router advertisement send to %s", ifp->name);
-
-  /* Fill in sockaddr_in6. */
-  memset (&addr, 0, sizeof (struct sockaddr_in6));
-  addr.sin6_family = AF_INET6;
-#ifdef SIN6_LEN
-  addr.sin6_len = sizeof (struct sockaddr_in6);
-#endif /* SIN6_LEN */
-  addr.sin6_port = htons (IPPROTO_ICMPV6);
-  IPV6_ADDR_COPY (&addr.sin6_addr, &all_nodes_addr);
+  const u_char *hw_addr;
+  int hw_addr_len;
 
   /* Fetch interface information. */
   zif = ifp->info;
 
-  /* Make router advertisement message. */
   ndra = (struct nd_router_advert *) buf;
 
   ndra->nd_ra_type = ND_ROUTER_ADVERT;
@@ -582,40 +571,22 @@ rtadv_send_packet (const int sock, const struct interface *ifp)
     }
 
   /* Hardware address. */
-#ifdef HAVE_STRUCT_SOCKADDR_DL
-  sdl = &ifp->sdl;
-  if (sdl != NULL && sdl->sdl_alen != 0)
-    {
-      buf[len++] = ND_OPT_SOURCE_LINKADDR;
-
-      /* Option length should be rounded up to next octet if
-         the link address does not end on an octet boundary. */
-      buf[len++] = (sdl->sdl_alen + 9) >> 3;
-
-      memcpy (buf + len, LLADDR (sdl), sdl->sdl_alen);
-      len += sdl->sdl_alen;
-
-      /* Pad option to end on an octet boundary. */
-      memset (buf + len, 0, -(sdl->sdl_alen + 2) & 0x7);
-      len += -(sdl->sdl_alen + 2) & 0x7;
-    }
-#else
-  if (ifp->hw_addr_len != 0)
+  hw_addr = rtadv_hw_addr (ifp, &hw_addr_len);
+  if (hw_addr_len != 0)
     {
       buf[len++] = ND_OPT_SOURCE_LINKADDR;
 
       /* Option length should be rounded up to next octet if
          the link address does not end on an octet boundary. */
-      buf[len++] = (ifp->hw_addr_len + 9) >> 3;
+      buf[len++] = (hw_addr_len + 9) >> 3;
 
-      memcpy (buf + len, ifp->hw_addr, ifp->hw_addr_len);
-      len += ifp->hw_addr_len;
+      memcpy (buf + len, hw_addr, hw_addr_len);
+      len += hw_addr_len;
 
       /* Pad option to end on an octet boundary. */
-      memset (buf + len, 0, -(ifp->hw_addr_len + 2) & 0x7);
-      len += -(ifp->hw_addr_len + 2) & 0x7;
+      memset (buf + len, 0, -(hw_addr_len + 2) & 0x7);
+      len += -(hw_addr_len + 2) & 0x7;
     }
-#endif /* HAVE_STRUCT_SOCKADDR_DL */
 
   /* MTU */
   if (zif->rtadv.AdvLinkMTU)
@@ -628,6 +599,91 @@ rtadv_send_packet (const int sock, const struct interface *ifp)
       len += sizeof (struct nd_opt_mtu);
     }
 
+  return len;
+}
+
+/* The advertisement of an interface, built again when the configuration
+ * of the interface changed (see rtadv_if_reset()), the one of the router
+ * did, or the link-layer address of the interface is not the same. */
+static u_char *
+rtadv_packet (const struct interface *ifp, unsigned *len)
+{
+  struct zebra_if *zif = ifp->info;
+  struct rtadvconf *conf = &zif->rtadv;
+  unsigned char buf[RTADV_MSG_SIZE];
+  const u_char *hw_addr;
+  int hw_addr_len;
+
+  hw_addr = rtadv_hw_addr (ifp, &hw_addr_len);
+  if (conf->AdvPacket
+      && conf->AdvPacketGeneration == rtadv->generation
+      && hw_addr_len <= INTERFACE_HWADDR_MAX
+      && conf->AdvPacketHwAddrLen == hw_addr_len
+      && ! memcmp (conf->AdvPacketHwAddr, hw_addr, hw_addr_len))
+    {
+      *len = conf->AdvPacketLen;
+      return conf->AdvPacket;
+    }
+
+  if (conf->AdvPacket)
+    XFREE (MTYPE_RTADV_PACKET, conf->AdvPacket);
+  conf->AdvPacketLen = rtadv_build_packet (buf, ifp);
+  conf->AdvPacket = XMALLOC (MTYPE_RTADV_PACKET, conf->AdvPacketLen);
+  memcpy (conf->AdvPacket, buf, conf->AdvPacketLen);
+  conf->AdvPacketGeneration = rtadv->generation;
+  conf->AdvPacketHwAddrLen = hw_addr_len;
+  memcpy (conf->AdvPacketHwAddr, hw_addr,
+	  MIN (hw_addr_len, INTERFACE_HWADDR_MAX));
+
+  *len = conf->AdvPacketLen;
+  return conf->AdvPacket;
+}
+
+/* Send router advertisement packet. */
+static void
+rtadv_send_packet (const int sock, const struct interface *ifp)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr  *cmsgptr;
+  struct in6_pktinfo *pkt;
+  struct sockaddr_in6 addr;
+  static void *adata = NULL;
+  u_char *buf;
+  unsigned len;
+  int ret;
+  struct in6_addr all_nodes_addr = {{{0xff,0x02,0,0,0,0,0,0,0,0,0,0,0,0,0,1}}};
+
+  /*
+   * Allocate control message bufffer.  This is dynamic because
+   * CMSG_SPACE is not guaranteed not to call a function.  Note that
+   * the size will be different on different architectures due to
+   * differing alignment rules.
+   */
+  if (adata == NULL)
+    {
+      /* XXX Free on shutdown. */
+      adata = malloc(CMSG_SPACE(sizeof(struct in6_pktinfo)));
+	   
+      if (adata == NULL)
+	zlog_err("rtadv_send_packet: can't malloc control data\n");
+    }
+
+  /* Logging of packet. */
+  if (IS_ZEBRA_DEBUG_PACKET)
+    zlog_debug ("Router advertisement send to %s", ifp->name);
+
+  /* Fill in sockaddr_in6. */
+  memset (&addr, 0, sizeof (struct sockaddr_in6));
+  addr.sin6_family = AF_INET6;
+#ifdef SIN6_LEN
+  addr.sin6_len = sizeof (struct sockaddr_in6);
+#endif /* SIN6_LEN */
+  addr.sin6_port = htons (IPPROTO_ICMPV6);
+  IPV6_ADDR_COPY (&addr.sin6_addr, &all_nodes_addr);
+
+  buf = rtadv_packet (ifp, &len);
+
   msg.msg_name = (void *) &addr;
   msg.msg_namelen = sizeof (struct sockaddr_in6);
   msg.msg_iov = &iov;
@@ -655,45 +711,151 @@ rtadv_send_packet (const int sock, const struct interface *ifp)
     }
 }
 
-static int
-rtadv_timer (struct thread *thread)
+#define RTADV_CONF(ifp) (&((struct zebra_if *) (ifp)->info)->rtadv)
+
+static unsigned long
+rtadv_wheel_now (void)
 {
-  struct listnode *node, *nnode;
-  struct interface *ifp;
-  struct zebra_if *zif;
-  int period;
+  struct timeval tv;
 
-  rtadv->ra_timer = NULL;
-  if (rtadv->adv_msec_if_count == 0)
-    {
-      period = 1000; /* 1 s */
-      rtadv_event (RTADV_TIMER, 1 /* 1 s */);
-    } 
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &tv);
+  return (tv.tv_sec * 1000UL + tv.tv_usec / 1000) / RTADV_WHEEL_TICK;
+}
+
+static void
+rtadv_wheel_remove (struct interface *ifp)
+{
+  struct rtadvconf *conf = RTADV_CONF (ifp);
+
+  if (conf->AdvIntervalSlot < 0)
+    return;
+  if (conf->AdvIntervalNext)
+    RTADV_CONF (conf->AdvIntervalNext)->AdvIntervalPrev = conf->AdvIntervalPrev;
+  if (conf->AdvIntervalPrev)
+    RTADV_CONF (conf->AdvIntervalPrev)->AdvIntervalNext = conf->AdvIntervalNext;
   else
+    rtadv->wheel[conf->AdvIntervalSlot] = conf->AdvIntervalNext;
+  conf->AdvIntervalNext = conf->AdvIntervalPrev = NULL;
+  conf->AdvIntervalSlot = -1;
+}
+
+/* Queue an interface in a slot, for its advertisement due at a tick. */
+static void
+rtadv_wheel_add (struct interface *ifp, int slot, unsigned long due)
+{
+  struct rtadvconf *conf = RTADV_CONF (ifp);
+
+  rtadv_wheel_remove (ifp);
+  conf->AdvIntervalDue = due;
+  conf->AdvIntervalSlot = slot;
+  conf->AdvIntervalNext = rtadv->wheel[slot];
+  if (conf->AdvIntervalNext)
+    RTADV_CONF (conf->AdvIntervalNext)->AdvIntervalPrev = ifp;
+  rtadv->wheel[slot] = ifp;
+}
+
+static int rtadv_timer (struct thread *);
+
+/* Have the timer go off at a tick, unless it does earlier. */
+static void
+rtadv_wheel_arm (unsigned long tick)
+{
+  unsigned long now = rtadv_wheel_now ();
+
+  if (rtadv->ra_timer)
     {
-      period = 10; /* 10 ms */
-      rtadv_event (RTADV_TIMER_MSEC, 10 /* 10 ms */);
+      if ((long) (tick - rtadv->wheel_armed) >= 0)
+	return;
+      thread_cancel (rtadv->ra_timer);
     }
+  rtadv->wheel_armed = tick;
+  if ((long) (tick - now) <= 0)
+    rtadv->ra_timer = thread_add_event (zebrad.master, rtadv_timer, NULL, 0);
+  else
+    rtadv->ra_timer = thread_add_timer_msec (zebrad.master, rtadv_timer, NULL,
+					     (tick - now) * RTADV_WHEEL_TICK);
+}
 
-  for (ALL_LIST_ELEMENTS (iflist, node, nnode, ifp))
+/* Schedule the next unsolicited advertisement of an interface. */
+static void
+rtadv_if_schedule (struct interface *ifp, unsigned long now)
+{
+  struct rtadvconf *conf = RTADV_CONF (ifp);
+  unsigned long due;
+
+  /* FIXME: using MaxRtrAdvInterval each time isn't what section
+     6.2.4 of RFC4861 tells to do. */
+  due = now + MAX (1, (conf->MaxRtrAdvInterval + RTADV_WHEEL_TICK - 1)
+		   / RTADV_WHEEL_TICK);
+  rtadv_wheel_add (ifp, due % RTADV_WHEEL_SLOTS, due);
+}
+
+/* Send the advertisement of an interface at once, the configuration of the
+ * interface having changed, and drop the one it was sending.  An interface
+ * which no longer sends advertisements is taken out of the wheel. */
+static void
+rtadv_if_reset (struct interface *ifp)
+{
+  struct rtadvconf *conf = RTADV_CONF (ifp);
+
+  if (conf->AdvPacket)
+    XFREE (MTYPE_RTADV_PACKET, conf->AdvPacket);
+  conf->AdvPacket = NULL;
+
+  if (! rtadv_ra_enabled (conf))
     {
-      if (if_is_loopback (ifp) || ! if_is_operative (ifp))
-	continue;
+      rtadv_wheel_remove (ifp);
+      return;
+    }
+  rtadv_wheel_add (ifp, RTADV_WHEEL_NOW, 0);
+  rtadv_wheel_arm (rtadv_wheel_now ());
+}
 
-      zif = ifp->info;
+static void
+rtadv_if_advertise (struct interface *ifp, unsigned long now)
+{
+  rtadv_if_schedule (ifp, now);
+  if (! if_is_loopback (ifp) && if_is_operative (ifp))
+    rtadv_send_packet (rtadv->sock, ifp);
+}
 
-      if (rtadv_ra_enabled (&zif->rtadv))
-	{ 
-	  zif->rtadv.AdvIntervalTimer -= period;
-	  if (zif->rtadv.AdvIntervalTimer <= 0)
-	    {
-	      /* FIXME: using MaxRtrAdvInterval each time isn't what section
-	         6.2.4 of RFC4861 tells to do. */
-	      zif->rtadv.AdvIntervalTimer = zif->rtadv.MaxRtrAdvInterval;
-	      rtadv_send_packet (rtadv->sock, ifp);
-	    }
+/* Send the advertisements due since the timer last went off, at most a
+ * turn of the wheel ago, and have it go off again for the next slot
+ * holding interfaces.  Interfaces in this slot may only be due at a later
+ * turn, the timer going off for nothing then. */
+static int
+rtadv_timer (struct thread *thread)
+{
+  struct interface *ifp, *next;
+  unsigned long now, tick;
+  int i;
+
+  rtadv->ra_timer = NULL;
+  now = rtadv_wheel_now ();
+
+  while ((ifp = rtadv->wheel[RTADV_WHEEL_NOW]))
+    rtadv_if_advertise (ifp, now);
+
+  tick = (long) (now - rtadv->wheel_tick) > RTADV_WHEEL_SLOTS ?
+    now - RTADV_WHEEL_SLOTS : rtadv->wheel_tick;
+  while ((long) (now - tick) > 0)
+    {
+      tick++;
+      for (ifp = rtadv->wheel[tick % RTADV_WHEEL_SLOTS]; ifp; ifp = next)
+	{
+	  next = RTADV_CONF (ifp)->AdvIntervalNext;
+	  if ((long) (RTADV_CONF (ifp)->AdvIntervalDue - now) <= 0)
+	    rtadv_if_advertise (ifp, now);
 	}
     }
+  rtadv->wheel_tick = now;
+
+  for (i = 1; i <= RTADV_WHEEL_SLOTS; i++)
+    if (rtadv->wheel[(now + i) % RTADV_WHEEL_SLOTS])
+      {
+	rtadv_wheel_arm (now + i);
+	break;
+      }
   return 0;
 }
 
@@ -949,16 +1111,11 @@ rtadv_update_counters()
   struct interface *ifp;
 
   rtadv->adv_if_count = 0;
-  rtadv->adv_msec_if_count = 0;
   for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
   {
     struct zebra_if *zif = ifp->info;
     if (rtadv_ra_enabled (&zif->rtadv))
-    {
       rtadv->adv_if_count++;
-      if (zif->rtadv.MaxRtrAdvInterval % 1000)
-        rtadv->adv_msec_if_count++;
-    }
   }
 }
 
@@ -978,11 +1135,10 @@ rtadv_set_if_enable_ra (struct interface *ifp, const int val)
   if (old_if_enabled && ! new_if_enabled)
     if_leave_all_router (rtadv->sock, ifp);
   else if (! old_if_enabled && new_if_enabled)
-  {
     if_join_all_router (rtadv->sock, ifp);
-    zif->rtadv.AdvIntervalTimer = 0;
-  }
   zif->rtadv.AdvSendAdvertisements = val;
+  if (old_if_enabled != new_if_enabled)
+    rtadv_if_reset (ifp);
   rtadv_update_counters();
   if (! old_adv_if_count && rtadv->adv_if_count)
     rtadv_event (RTADV_START, rtadv->sock);
@@ -1011,12 +1167,12 @@ rtadv_set_top_enable_ra (const int val)
     if (old_if_enabled && ! new_if_enabled)
       if_leave_all_router (rtadv->sock, ifp);
     else if (! old_if_enabled && new_if_enabled)
-    {
       if_join_all_router (rtadv->sock, ifp);
-      zif->rtadv.AdvIntervalTimer = 0;
-    }
   }
   rtadv->AdvSendAdvertisements = val;
+  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
+    if (RTADV_CONF (ifp)->AdvSendAdvertisements == -1)
+      rtadv_if_reset (ifp);
   rtadv_update_counters();
   if (! old_adv_if_count && rtadv->adv_if_count)
     rtadv_event (RTADV_START, rtadv->sock);
@@ -1037,11 +1193,11 @@ rtadv_set_if_cp_none (struct interface *ifp)
     return;
   case 1: /* RA will change */
     zif->rtadv.ConnpfxEnabled = 0;
-    zif->rtadv.AdvIntervalTimer = 0;
+    rtadv_if_reset (ifp);
     return;
   case -1: /* RA may change */
     if (rtadv_cp_enabled (&zif->rtadv))
-      zif->rtadv.AdvIntervalTimer = 0;
+      rtadv_if_reset (ifp);
     zif->rtadv.ConnpfxEnabled = 0;
     return;
   default:
@@ -1061,7 +1217,7 @@ rtadv_set_if_cp_auto (struct interface *ifp)
   case 0: /* RA may change */
     zif->rtadv.ConnpfxEnabled = -1;
     if (rtadv_cp_enabled (&zif->rtadv))
-      zif->rtadv.AdvIntervalTimer = 0;
+      rtadv_if_reset (ifp);
     return;
   case 1: /* RA may change */
     zif->rtadv.ConnpfxEnabled = -1;
@@ -1070,7 +1226,7 @@ rtadv_set_if_cp_auto (struct interface *ifp)
       ! rtadv_cp_enabled (&zif->rtadv) ||
       memcmp (&rtadv->ConnpfxConfig, &zif->rtadv.ConnpfxConfig, sizeof (struct rtadv_connprefix))
     )
-      zif->rtadv.AdvIntervalTimer = 0;
+      rtadv_if_reset (ifp);
     return;
   default:
     assert (0);
@@ -1088,12 +1244,12 @@ rtadv_set_if_cp_all (struct interface *ifp, struct rtadv_connprefix *rcp)
     if (memcmp (rcp, &zif->rtadv.ConnpfxConfig, sizeof (struct rtadv_connprefix)))
     {
       zif->rtadv.ConnpfxConfig = *rcp;
-      zif->rtadv.AdvIntervalTimer = 0;
+      rtadv_if_reset (ifp);
     }
     return;
   case 0: /* RA will change */
     zif->rtadv.ConnpfxConfig = *rcp;
-    zif->rtadv.AdvIntervalTimer = 0;
+    rtadv_if_reset (ifp);
     zif->rtadv.ConnpfxEnabled = 1;
     return;
   case -1: /* RA may change */
@@ -1103,7 +1259,7 @@ rtadv_set_if_cp_all (struct interface *ifp, struct rtadv_connprefix *rcp)
       ! rtadv_cp_enabled (&zif->rtadv) ||
       memcmp (&rtadv->ConnpfxConfig, &zif->rtadv.ConnpfxConfig, sizeof (struct rtadv_connprefix))
     )
-      zif->rtadv.AdvIntervalTimer = 0;
+      rtadv_if_reset (ifp);
     zif->rtadv.ConnpfxEnabled = 1;
     return;
   default:
@@ -1132,7 +1288,7 @@ rtadv_set_top_enable_cp (const int val, const struct rtadv_connprefix *rcp)
     struct zebra_if *zif = ifp->info;
     u_char new_if_enabled = zif->rtadv.ConnpfxEnabled == -1 ? val : zif->rtadv.ConnpfxEnabled;
     if (rtadv_cp_enabled (&zif->rtadv) != new_if_enabled || (zif->rtadv.ConnpfxEnabled == -1 && ! sameconf))
-      zif->rtadv.AdvIntervalTimer = 0;
+      rtadv_if_reset (ifp);
   }
   rtadv->ConnpfxEnabled = val;
   if (! sameconf)
@@ -1242,8 +1398,7 @@ DEFUN (ipv6_nd_ra_interval_msec,
     }
   zif->rtadv.MaxRtrAdvInterval = interval;
   zif->rtadv.MinRtrAdvInterval = 0.33 * interval;
-  zif->rtadv.AdvIntervalTimer = 0;
-  rtadv_update_counters();
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1296,8 +1451,7 @@ DEFUN (ipv6_nd_ra_interval,
   interval = interval * 1000; 
   zif->rtadv.MaxRtrAdvInterval = interval;
   zif->rtadv.MinRtrAdvInterval = 0.33 * interval;
-  zif->rtadv.AdvIntervalTimer = 0;
-  rtadv_update_counters();
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1316,8 +1470,7 @@ DEFUN (no_ipv6_nd_ra_interval,
   zif = ifp->info;
   zif->rtadv.MaxRtrAdvInterval = RTADV_MAX_RTR_ADV_INTERVAL;
   zif->rtadv.MinRtrAdvInterval = RTADV_MIN_RTR_ADV_INTERVAL;
-  zif->rtadv.AdvIntervalTimer = 0;
-  rtadv_update_counters();
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1367,7 +1520,7 @@ DEFUN (ipv6_nd_ra_lifetime,
 
   zif->rtadv.AdvDefaultLifetime = lifetime;
   
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1387,7 +1540,7 @@ DEFUN (no_ipv6_nd_ra_lifetime,
   zif = ifp->info;
 
   zif->rtadv.AdvDefaultLifetime = -1;
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1412,7 +1565,7 @@ DEFUN (ipv6_nd_reachable_time,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   VTY_GET_INTEGER_RANGE ("reachable time", zif->rtadv.AdvReachableTime, argv[0], 1, RTADV_MAX_REACHABLE_TIME);
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1431,7 +1584,7 @@ DEFUN (no_ipv6_nd_reachable_time,
   zif = ifp->info;
 
   zif->rtadv.AdvReachableTime = 0;
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1456,7 +1609,7 @@ DEFUN (ipv6_nd_homeagent_preference,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   VTY_GET_INTEGER_RANGE ("home agent preference", zif->rtadv.HomeAgentPreference, argv[0], 0, 65535);
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1475,7 +1628,7 @@ DEFUN (no_ipv6_nd_homeagent_preference,
   zif = ifp->info;
 
   zif->rtadv.HomeAgentPreference = 0;
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1500,7 +1653,7 @@ DEFUN (ipv6_nd_homeagent_lifetime,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   VTY_GET_INTEGER_RANGE ("home agent lifetime", zif->rtadv.HomeAgentLifetime, argv[0], 0, RTADV_MAX_HALIFETIME);
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1519,7 +1672,7 @@ DEFUN (no_ipv6_nd_homeagent_lifetime,
   zif = ifp->info;
 
   zif->rtadv.HomeAgentLifetime = -1;
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1547,7 +1700,7 @@ DEFUN (ipv6_nd_managed_config_flag,
   zif = ifp->info;
 
   zif->rtadv.AdvManagedFlag = 1;
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1567,7 +1720,7 @@ DEFUN (no_ipv6_nd_managed_config_flag,
   zif = ifp->info;
 
   zif->rtadv.AdvManagedFlag = 0;
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1586,7 +1739,7 @@ DEFUN (ipv6_nd_homeagent_config_flag,
   zif = ifp->info;
 
   zif->rtadv.AdvHomeAgentFlag = 1;
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1606,7 +1759,7 @@ DEFUN (no_ipv6_nd_homeagent_config_flag,
   zif = ifp->info;
 
   zif->rtadv.AdvHomeAgentFlag = 0;
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1625,6 +1778,7 @@ DEFUN (ipv6_nd_adv_interval_config_option,
   zif = ifp->info;
 
   zif->rtadv.AdvIntervalOption = 1;
+  rtadv_if_reset (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1644,6 +1798,7 @@ DEFUN (no_ipv6_nd_adv_interval_config_option,
   zif = ifp->info;
 
   zif->rtadv.AdvIntervalOption = 0;
+  rtadv_if_reset (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1662,7 +1817,7 @@ DEFUN (ipv6_nd_other_config_flag,
   zif = ifp->info;
 
   zif->rtadv.AdvOtherConfigFlag = 1;
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1682,7 +1837,7 @@ DEFUN (no_ipv6_nd_other_config_flag,
   zif = ifp->info;
 
   zif->rtadv.AdvOtherConfigFlag = 0;
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1765,7 +1920,7 @@ DEFUN (ipv6_nd_prefix,
 
   rtadv_prefix_set (zebra_if, &rp);
 
-  zebra_if->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1957,7 +2112,7 @@ DEFUN (no_ipv6_nd_prefix,
       return CMD_WARNING;
     }
 
-  zebra_if->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -2321,7 +2476,7 @@ DEFUN (ipv6_nd_router_preference,
       if (strncmp (argv[0], rtadv_pref_strs[i].str, 1) == 0)
 	{
 	  zif->rtadv.DefaultPreference = rtadv_pref_strs[i].key;
-	  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+	  rtadv_if_reset (ifp);
 	  return CMD_SUCCESS;
 	}
       i++;
@@ -2346,7 +2501,7 @@ DEFUN (no_ipv6_nd_router_preference,
 
   zif->rtadv.DefaultPreference = RTADV_PREF_MEDIUM; /* Default per RFC4191. */
 
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -2372,7 +2527,7 @@ DEFUN (ipv6_nd_mtu,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   VTY_GET_INTEGER_RANGE ("MTU", zif->rtadv.AdvLinkMTU, argv[0], 1, 65535);
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -2387,7 +2542,7 @@ DEFUN (no_ipv6_nd_mtu,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   zif->rtadv.AdvLinkMTU = 0;
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -2474,7 +2629,7 @@ DEFUN (ipv6_nd_rdnss_addr,
     listnode_add (zif->rtadv.AdvRDNSSList, stored);
   }
   memcpy (stored, &input, sizeof (struct rtadv_rdnss_entry));
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -2510,7 +2665,7 @@ DEFUN (no_ipv6_nd_rdnss_addr,
   }
   listnode_delete (zif->rtadv.AdvRDNSSList, entry);
   XFREE (MTYPE_RTADV_PREFIX, entry);
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -2703,7 +2858,7 @@ DEFUN (ipv6_nd_dnssl_domain,
     listnode_add (zif->rtadv.AdvDNSSLList, stored);
   }
   memcpy (stored, &input, sizeof (struct rtadv_dnssl_entry));
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -2736,7 +2891,7 @@ DEFUN (no_ipv6_nd_dnssl_domain,
   }
   listnode_delete (zif->rtadv.AdvDNSSLList, entry);
   XFREE (MTYPE_RTADV_PREFIX, entry);
-  zif->rtadv.AdvIntervalTimer = 0; /* resend immediately */
+  rtadv_if_reset (ifp);
   return CMD_SUCCESS;
 }
 
@@ -2987,6 +3142,7 @@ DEFUN (top_ipv6_nd_rdnss_addr,
     listnode_add (rtadv->AdvRDNSSList, stored);
   }
   memcpy (stored, &input, sizeof (struct rtadv_rdnss_entry));
+  rtadv->generation++;
   return CMD_SUCCESS;
 }
 
@@ -3011,6 +3167,7 @@ DEFUN (top_no_ipv6_nd_rdnss_addr,
   }
   listnode_delete (rtadv->AdvRDNSSList, entry);
   XFREE (MTYPE_RTADV_PREFIX, entry);
+  rtadv->generation++;
   return CMD_SUCCESS;
 }
 
@@ -3034,6 +3191,7 @@ DEFUN (top_ipv6_nd_dnssl_domain,
     listnode_add (rtadv->AdvDNSSLList, stored);
   }
   memcpy (stored, &input, sizeof (struct rtadv_dnssl_entry));
+  rtadv->generation++;
   return CMD_SUCCESS;
 }
 
@@ -3055,6 +3213,7 @@ DEFUN (top_no_ipv6_nd_dnssl_domain,
   }
   listnode_delete (rtadv->AdvDNSSLList, entry);
   XFREE (MTYPE_RTADV_PREFIX, entry);
+  rtadv->generation++;
   return CMD_SUCCESS;
 }
 
@@ -3079,9 +3238,6 @@ rtadv_event (const enum rtadv_event event, const int val)
     case RTADV_START:
       if (! rtadv->ra_read)
 	rtadv->ra_read = thread_add_read (zebrad.master, rtadv_read, NULL, val);
-      if (! rtadv->ra_timer)
-	rtadv->ra_timer = thread_add_event (zebrad.master, rtadv_timer,
-	                                    NULL, 0);
       break;
     case RTADV_STOP:
       if (rtadv->ra_timer)
@@ -3095,16 +3251,6 @@ rtadv_event (const enum rtadv_event event, const int val)
 	  rtadv->ra_read = NULL;
 	}
       break;
-    case RTADV_TIMER:
-      if (! rtadv->ra_timer)
-	rtadv->ra_timer = thread_add_timer (zebrad.master, rtadv_timer, NULL,
-	                                    val);
-      break;
-    case RTADV_TIMER_MSEC:
-      if (! rtadv->ra_timer)
-	rtadv->ra_timer = thread_add_timer_msec (zebrad.master, rtadv_timer, 
-					    NULL, val);
-      break;
     case RTADV_READ:
       if (! rtadv->ra_read)
 	rtadv->ra_read = thread_add_read (zebrad.master, rtadv_read, NULL, val);
@@ -3224,7 +3370,7 @@ rtadv_refresh_connected (struct interface *ifp)
   struct zebra_if *zif = ifp->info;
 
   if (rtadv_ra_enabled (&zif->rtadv) && rtadv_cp_enabled (&zif->rtadv))
-    zif->rtadv.AdvIntervalTimer = 0;
+    rtadv_if_reset (ifp);
 }
 
 static int
@@ -3288,6 +3434,12 @@ rtadv_if_dump_vty (struct vty *vty, struct interface *ifp)
   else
     vty_out (vty, "  ND router advertisements are sent every %d seconds%s",
              conf->MaxRtrAdvInterval / 1000, VTY_NEWLINE);
+  if (conf->AdvIntervalSlot == RTADV_WHEEL_NOW)
+    vty_out (vty, "  ND next router advertisement is sent now%s", VTY_NEWLINE);
+  else if (conf->AdvIntervalSlot >= 0)
+    vty_out (vty, "  ND next router advertisement in %ld milliseconds%s",
+             MAX (0L, (long) (conf->AdvIntervalDue - rtadv_wheel_now ()))
+             * RTADV_WHEEL_TICK, VTY_NEWLINE);
   if (conf->AdvDefaultLifetime != -1)
     vty_out (vty, "  ND router advertisements live for %d seconds%s",
              conf->AdvDefaultLifetime, VTY_NEWLINE);
@@ -3329,7 +3481,7 @@ rtadv_if_new_hook (struct rtadvconf *conf)
 
   conf->MaxRtrAdvInterval = RTADV_MAX_RTR_ADV_INTERVAL;
   conf->MinRtrAdvInterval = RTADV_MIN_RTR_ADV_INTERVAL;
-  conf->AdvIntervalTimer = 0;
+  conf->AdvIntervalSlot = -1;
   conf->AdvManagedFlag = 0;
   conf->AdvOtherConfigFlag = 0;
   conf->AdvHomeAgentFlag = 0;
@@ -3349,4 +3501,14 @@ rtadv_if_new_hook (struct rtadvconf *conf)
   rtadv_update_counters();
 }
 
+void
+rtadv_if_delete_hook (struct interface *ifp)
+{
+  struct rtadvconf *conf = RTADV_CONF (ifp);
+
+  rtadv_wheel_remove (ifp);
+  if (conf->AdvPacket)
+    XFREE (MTYPE_RTADV_PACKET, conf->AdvPacket);
+}
+
 #endif /* RTADV */
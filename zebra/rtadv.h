@@ -63,8 +63,22 @@ struct rtadvconf
   int MinRtrAdvInterval; /* This field is currently unused. */
 #define RTADV_MIN_RTR_ADV_INTERVAL (0.33 * RTADV_MAX_RTR_ADV_INTERVAL)
 
-  /* Unsolicited Router Advertisements' interval timer. */
-  int AdvIntervalTimer;
+  /* Unsolicited Router Advertisements' timer: the tick the next one is
+     due at, and the links of the interface in the slot of the timer
+     wheel for this tick, AdvIntervalSlot being -1 out of the wheel. */
+  unsigned long AdvIntervalDue;
+  int AdvIntervalSlot;
+  struct interface *AdvIntervalNext;
+  struct interface *AdvIntervalPrev;
+
+  /* The Router Advertisement last built, sent again as long as the
+     configuration, the addresses and the link-layer address of the
+     interface stay the same. */
+  u_char *AdvPacket;
+  unsigned AdvPacketLen;
+  unsigned AdvPacketGeneration;
+  u_char AdvPacketHwAddr[INTERFACE_HWADDR_MAX];
+  int AdvPacketHwAddrLen;
 
   /* The TRUE/FALSE value to be placed in the "Managed address
      configuration" flag field in the Router Advertisement.  See
@@ -195,6 +209,7 @@ extern void rtadv_config_write (struct vty *, struct interface *);
 extern void rtadv_init (void);
 extern void rtadv_if_dump_vty (struct vty *, struct interface *);
 extern void rtadv_if_new_hook (struct rtadvconf *);
+extern void rtadv_if_delete_hook (struct interface *);
 extern void rtadv_refresh_connected (struct interface *);
 #endif /* HAVE_IPV6 && HAVE_RTADV */
 
@@ -0,0 +1,673 @@
+/*
+ * Route replay benchmark for testzebra.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+
+#include <zebra.h>
+#include <sys/resource.h>
+
+#include "buffer.h"
+#include "if.h"
+#include "linklist.h"
+#include "log.h"
+#include "memory.h"
+#include "network.h"
+#include "prefix.h"
+#include "thread.h"
+#include "zclient.h"
+#include "zring.h"
+
+#include "zebra/rib.h"
+#include "zebra/zserv.h"
+#include "zebra/connected.h"
+#include "zebra/interface.h"
+#include "zebra/zebra_lpm.h"
+
+/* Fake clients replay route changes into zebra through socket pairs, so
+ * that their messages are read and decoded by zserv.c as those of real
+ * daemons, and the routes are processed by the RIB and redistributed to
+ * fake listeners.  Each phase runs until zebra is idle again and its
+ * results are printed as one line of key=value fields.
+ */
+
+extern struct zebra_t zebrad;
+
+/* Entry point, called from test_main.c. */
+extern void bench_start (unsigned long, int, int, int, u_int32_t, int);
+
+#define BENCH_CLIENTS_MAX	16
+#define BENCH_LISTENERS_MAX	16
+#define BENCH_IFACES		4
+
+/* Messages a client writes in one go before letting zebra run. */
+#define BENCH_CHUNK		1000
+
+/* Addresses looked up with rib_match_ipv4() once the routes are added. */
+#define BENCH_LOOKUPS		1000000
+
+/* Prefixes are /24s from 11.0.0.0, gateways are on the 172.16.N.0/24
+   subnets of the interfaces. */
+#define BENCH_PREFIX_BASE	0x0b000000
+#define BENCH_GATE_BASE		0xac100000
+
+/* Subscriber /32 addresses from 198.18.0.0 come and go on the interfaces
+   in rounds of that many changes, each round processed before the next. */
+#define BENCH_ADDR_BASE		0xc6120000
+#define BENCH_ADDR_CHUNK	16
+#define BENCH_ADDR_ROUNDS	200
+
+enum bench_phase
+{
+  BENCH_ADD,
+  BENCH_LOOKUP,
+  BENCH_CHANGE,
+  BENCH_FLAP,
+  BENCH_ADDR,
+  BENCH_DELETE,
+  BENCH_DONE,
+};
+
+static const char *bench_phase_name[] =
+  { "add", "lookup", "change", "flap", "addr", "delete" };
+
+/* Origins of the routes of the clients, in turn: BGP, then IGPs. */
+static const u_char bench_types[] =
+  { ZEBRA_ROUTE_BGP, ZEBRA_ROUTE_OSPF, ZEBRA_ROUTE_RIP, ZEBRA_ROUTE_ISIS };
+#define BENCH_TYPES (sizeof (bench_types) / sizeof (bench_types[0]))
+
+static const char *bench_queue_name[MQ_SIZE] =
+  { "connected", "static", "IGP", "BGP", "other" };
+
+struct bench_client
+{
+  struct zclient *zclient;
+
+  /* Zebra's end of the socket pair. */
+  int peer;
+
+  u_char type;
+  int index;
+
+  /* Routes of the phase sent so far, and first prefix of the client. */
+  unsigned long sent;
+  unsigned long offset;
+
+  /* Bytes redistributed to a listener. */
+  unsigned long long bytes;
+  struct thread *t_read;
+};
+
+static struct
+{
+  unsigned long routes;
+  int nclients;
+  int nlisteners;
+  int flaps;
+  u_int32_t ring;
+  int single;
+
+  struct bench_client client[BENCH_CLIENTS_MAX];
+  struct bench_client listener[BENCH_LISTENERS_MAX];
+  struct interface *ifp[BENCH_IFACES];
+
+  enum bench_phase phase;
+  int connecting;
+  int waiting;
+  int storms;
+  struct timeval start;
+  unsigned long events;
+  unsigned long long bytes;
+
+  /* Messages zebra received and sent, and its CPU time, at the start of
+     the phase. */
+  unsigned long msgs_in;
+  unsigned long msgs_out;
+  double cpu;
+
+  struct thread *t_run;
+} bench;
+
+static double
+bench_elapsed (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+static double
+bench_cpu (void)
+{
+  struct rusage ru;
+
+  getrusage (RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+	 + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static void
+bench_msgs (unsigned long *in, unsigned long *out)
+{
+  struct listnode *node;
+  struct zserv *client;
+
+  *in = *out = 0;
+  for (ALL_LIST_ELEMENTS_RO (zebrad.client_list, node, client))
+    {
+      *in += client->msgs_in;
+      *out += client->msgs_out;
+    }
+}
+
+static struct zserv *
+bench_zserv (struct bench_client *bc)
+{
+  struct listnode *node;
+  struct zserv *client;
+
+  for (ALL_LIST_ELEMENTS_RO (zebrad.client_list, node, client))
+    if (client->sock == bc->peer)
+      return client;
+  return NULL;
+}
+
+static unsigned long long
+bench_redist_bytes (void)
+{
+  unsigned long long bytes = 0;
+  int i;
+
+  for (i = 0; i < bench.nlisteners; i++)
+    bytes += bench.listener[i].bytes;
+  return bytes;
+}
+
+static int
+bench_readable (int fd)
+{
+  int n = 0;
+
+  return ioctl (fd, FIONREAD, &n) == 0 && n > 0;
+}
+
+/* Whether zebra is done with all that was sent: nothing left to read on
+   either side, nothing held back to be written, no route node queued. */
+static int
+bench_settled (void)
+{
+  struct listnode *node;
+  struct zserv *client;
+  struct bench_client *bc;
+  int i;
+
+  if (zebrad.mq->size)
+    return 0;
+
+  for (i = 0; i < bench.nclients + bench.nlisteners; i++)
+    {
+      bc = i < bench.nclients ? &bench.client[i]
+			      : &bench.listener[i - bench.nclients];
+      if (! buffer_empty (bc->zclient->wb) || bc->zclient->t_bulk
+	  || bench_readable (bc->peer) || bench_readable (bc->zclient->sock))
+	return 0;
+#ifdef ZSERV_RING
+      if (bc->zclient->ring_active && zring_pending (bc->zclient->ring))
+	return 0;
+#endif /* ZSERV_RING */
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (zebrad.client_list, node, client))
+    if (! buffer_empty (client->wb) || client->t_bulk)
+      return 0;
+
+  return 1;
+}
+
+static int
+bench_listener_read (struct thread *thread)
+{
+  struct bench_client *bc = THREAD_ARG (thread);
+  char buf[65536];
+  ssize_t n;
+
+  bc->t_read = thread_add_read (zebrad.master, bench_listener_read, bc,
+				bc->zclient->sock);
+  while ((n = read (bc->zclient->sock, buf, sizeof (buf))) > 0)
+    bc->bytes += n;
+  return 0;
+}
+
+/* Whether the clients offering zebra a ring or bulk messages got its
+   answer, and zebra got the offer of the listeners. */
+static int
+bench_connected (void)
+{
+  struct zclient *zclient;
+  struct zserv *client;
+  int i;
+
+  for (i = 0; i < bench.nclients; i++)
+    {
+      zclient = bench.client[i].zclient;
+      if (zclient->ring && ! zclient->ring_active)
+	return 0;
+      if (! zclient->no_bulk && ! zclient->bulk_agreed)
+	return 0;
+    }
+  for (i = 0; i < bench.nlisteners; i++)
+    {
+      client = bench_zserv (&bench.listener[i]);
+      if (! bench.single && (! client || ! client->bulk_agreed))
+	return 0;
+    }
+  return 1;
+}
+
+/* Connect a fake client to zebra. */
+static void
+bench_client_init (struct bench_client *bc, int index)
+{
+  int fds[2];
+
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+      perror ("socketpair");
+      exit (1);
+    }
+  set_nonblocking (fds[0]);
+  set_nonblocking (fds[1]);
+
+  bc->zclient = zclient_new ();
+  zclient_init (bc->zclient, ZEBRA_ROUTE_MAX);
+  bc->zclient->sock = fds[0];
+  bc->zclient->no_bulk = bench.single;
+  bc->peer = fds[1];
+  bc->index = index;
+  bc->type = bench_types[index % BENCH_TYPES];
+
+  zebra_client_create (bc->peer);
+}
+
+static void
+bench_send_route (struct bench_client *bc, unsigned long i)
+{
+  struct prefix_ipv4 p;
+  struct in_addr gate;
+  struct in_addr *gatep = &gate;
+  struct zapi_ipv4 api;
+  u_int32_t host;
+
+  p.family = AF_INET;
+  p.prefixlen = 24;
+  p.prefix.s_addr = htonl (BENCH_PREFIX_BASE + ((bc->offset + i) << 8));
+
+  /* Routes are spread over the interfaces, and change gateway after the
+     first phase. */
+  host = (bench.phase == BENCH_ADD ? 2 : 128) + bc->index;
+  gate.s_addr = htonl (BENCH_GATE_BASE + ((i % BENCH_IFACES) << 8) + host);
+
+  memset (&api, 0, sizeof (api));
+  api.type = bc->type;
+  api.message = ZAPI_MESSAGE_NEXTHOP;
+  api.safi = SAFI_UNICAST;
+  api.nexthop_num = 1;
+  api.nexthop = &gatep;
+
+  zapi_ipv4_route (bench.phase == BENCH_DELETE ? ZEBRA_IPV4_ROUTE_DELETE
+					       : ZEBRA_IPV4_ROUTE_ADD,
+		   bc->zclient, &p, &api);
+  bench.events++;
+}
+
+/* Send the next chunk of routes of each client.  Return 1 once all are
+   sent; BLOCKED is set when a client waits for zebra to read. */
+static int
+bench_send_routes (int *blocked)
+{
+  struct bench_client *bc;
+  int i, n, all = 1;
+
+  for (i = 0; i < bench.nclients; i++)
+    {
+      bc = &bench.client[i];
+      for (n = 0; bc->sent < bench.routes && n < BENCH_CHUNK; n++)
+	{
+	  if (! buffer_empty (bc->zclient->wb) || bc->zclient->t_ring)
+	    {
+	      *blocked = 1;
+	      break;
+	    }
+	  bench_send_route (bc, bc->sent++);
+	}
+      if (bc->sent < bench.routes)
+	all = 0;
+    }
+  return all;
+}
+
+/* Take all the interfaces down then up again at once. */
+static void
+bench_storm (void)
+{
+  int i;
+
+  for (i = 0; i < BENCH_IFACES; i++)
+    {
+      UNSET_FLAG (bench.ifp[i]->flags, IFF_UP);
+      if_down (bench.ifp[i]);
+      bench.events++;
+    }
+  for (i = 0; i < BENCH_IFACES; i++)
+    {
+      SET_FLAG (bench.ifp[i]->flags, IFF_UP);
+      if_up (bench.ifp[i]);
+      bench.events++;
+    }
+}
+
+/* Add a chunk of subscriber addresses in even rounds, delete them in odd
+   ones. */
+static void
+bench_addr (void)
+{
+  struct in_addr addr;
+  unsigned int i, n;
+  int up = ! (bench.storms % 2);
+
+  for (i = 0; i < BENCH_ADDR_CHUNK; i++)
+    {
+      n = (bench.storms / 2) * BENCH_ADDR_CHUNK + i;
+      addr.s_addr = htonl (BENCH_ADDR_BASE + n);
+      if (up)
+	connected_add_ipv4 (bench.ifp[n % BENCH_IFACES], 0, &addr, 32,
+			    NULL, NULL);
+      else
+	connected_delete_ipv4 (bench.ifp[n % BENCH_IFACES], 0, &addr, 32,
+			       NULL);
+      bench.events++;
+    }
+}
+
+static void
+bench_phase_begin (void)
+{
+  int i;
+
+  for (i = 0; i < bench.nclients; i++)
+    bench.client[i].sent = 0;
+  memset (zebrad.mq->stats, 0, sizeof (zebrad.mq->stats));
+  bench.events = 0;
+  bench.storms = 0;
+  bench.bytes = bench_redist_bytes ();
+  bench_msgs (&bench.msgs_in, &bench.msgs_out);
+  bench.cpu = bench_cpu ();
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &bench.start);
+}
+
+static void
+bench_phase_end (void)
+{
+  const char *name = bench_phase_name[bench.phase];
+  double seconds = bench_elapsed (&bench.start);
+  unsigned long processed = 0;
+  unsigned long msgs_in, msgs_out;
+  struct rusage ru;
+  int i;
+
+  for (i = 0; i < MQ_SIZE; i++)
+    processed += zebrad.mq->stats[i].processed;
+  if (seconds <= 0)
+    seconds = 1e-6;
+  getrusage (RUSAGE_SELF, &ru);
+  bench_msgs (&msgs_in, &msgs_out);
+  msgs_in -= bench.msgs_in;
+  msgs_out -= bench.msgs_out;
+
+  printf ("phase=%s seconds=%.6f events=%lu events_per_sec=%.0f "
+	  "nodes=%lu nodes_per_sec=%.0f redist_bytes=%llu maxrss_kb=%ld "
+	  "msgs_in=%lu msgs_out=%lu msgs_per_sec=%.0f cpu_seconds=%.6f\n",
+	  name, seconds, bench.events, bench.events / seconds,
+	  processed, processed / seconds,
+	  bench_redist_bytes () - bench.bytes, ru.ru_maxrss,
+	  msgs_in, msgs_out, (msgs_in + msgs_out) / seconds,
+	  bench_cpu () - bench.cpu);
+
+  for (i = 0; i < MQ_SIZE; i++)
+    if (zebrad.mq->stats[i].processed)
+      printf ("queue phase=%s name=%s processed=%lu deadline=%lu "
+	      "max_backlog=%u latency_avg_ms=%.3f latency_max_ms=%lu\n",
+	      name, bench_queue_name[i], zebrad.mq->stats[i].processed,
+	      zebrad.mq->stats[i].deadline, zebrad.mq->stats[i].max_backlog,
+	      (double) zebrad.mq->stats[i].latency_total
+	      / zebrad.mq->stats[i].processed,
+	      zebrad.mq->stats[i].latency_max);
+  fflush (stdout);
+}
+
+/* Look the same addresses up through the radix tree, then through the
+ * lookup table, and check both give the same routes.  Most addresses are
+ * in the range of the routes of the clients, the others anywhere.
+ */
+static void
+bench_lookup (void)
+{
+  static const char *path_name[] = { "radix", "lpm" };
+  struct in_addr *addrs;
+  struct rib **match;
+  struct timeval start;
+  unsigned long span, mismatches = 0;
+  u_int32_t seed = 1;
+  double seconds;
+  int path, enabled = lpm_active ();
+  int i;
+
+  addrs = XMALLOC (MTYPE_TMP, BENCH_LOOKUPS * sizeof (struct in_addr));
+  match = XMALLOC (MTYPE_TMP, BENCH_LOOKUPS * sizeof (struct rib *));
+
+  span = (bench.routes * (bench.nclients + 1) / 2) << 8;
+  for (i = 0; i < BENCH_LOOKUPS; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      if (i % 8)
+	addrs[i].s_addr = htonl (BENCH_PREFIX_BASE + seed % span);
+      else
+	addrs[i].s_addr = htonl (seed);
+    }
+
+  for (path = 0; path < 2; path++)
+    {
+      lpm_set (path);
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+      for (i = 0; i < BENCH_LOOKUPS; i++)
+	{
+	  struct rib *rib = rib_match_ipv4 (addrs[i]);
+
+	  if (! path)
+	    match[i] = rib;
+	  else if (rib != match[i])
+	    mismatches++;
+	}
+      seconds = bench_elapsed (&start);
+      if (seconds <= 0)
+	seconds = 1e-6;
+
+      printf ("lookup path=%s lookups=%d seconds=%.6f lookups_per_sec=%.0f\n",
+	      path_name[path], BENCH_LOOKUPS, seconds, BENCH_LOOKUPS / seconds);
+    }
+  printf ("lookup mismatches=%lu\n", mismatches);
+
+  lpm_set (enabled);
+  bench.events += 2 * BENCH_LOOKUPS;
+  XFREE (MTYPE_TMP, addrs);
+  XFREE (MTYPE_TMP, match);
+}
+
+static int bench_run (struct thread *);
+
+static void
+bench_schedule (long msec)
+{
+  if (msec)
+    bench.t_run = thread_add_timer_msec (zebrad.master, bench_run, NULL, msec);
+  else
+    bench.t_run = thread_add_event (zebrad.master, bench_run, NULL, 0);
+}
+
+static int
+bench_run (struct thread *thread)
+{
+  int blocked = 0;
+
+  bench.t_run = NULL;
+
+  /* Routes go out once the clients have switched to their ring. */
+  if (bench.connecting)
+    {
+      if (! bench_connected ())
+	{
+	  bench_schedule (1);
+	  return 0;
+	}
+      bench.connecting = 0;
+      bench_phase_begin ();
+    }
+
+  if (bench.waiting)
+    {
+      if (! bench_settled ())
+	{
+	  bench_schedule (1);
+	  return 0;
+	}
+      if (bench.phase == BENCH_FLAP && ++bench.storms < bench.flaps)
+	{
+	  bench_storm ();
+	  bench_schedule (0);
+	  return 0;
+	}
+      if (bench.phase == BENCH_ADDR && ++bench.storms < BENCH_ADDR_ROUNDS)
+	{
+	  bench_addr ();
+	  bench_schedule (0);
+	  return 0;
+	}
+
+      bench.waiting = 0;
+      bench_phase_end ();
+      if (++bench.phase == BENCH_DONE)
+	exit (0);
+      bench_phase_begin ();
+    }
+
+  if (bench.phase == BENCH_LOOKUP)
+    {
+      bench_lookup ();
+      bench.waiting = 1;
+    }
+  else if (bench.phase == BENCH_FLAP)
+    {
+      if (bench.flaps)
+	bench_storm ();
+      bench.waiting = 1;
+    }
+  else if (bench.phase == BENCH_ADDR)
+    {
+      bench_addr ();
+      bench.waiting = 1;
+    }
+  else if (bench_send_routes (&blocked))
+    bench.waiting = 1;
+
+  bench_schedule (blocked ? 1 : 0);
+  return 0;
+}
+
+/* Set up the interfaces and clients and start the first phase: each of
+ * CLIENTS clients adds ROUTES routes, half of them overlapping with the
+ * routes of the next client, addresses are looked up among them, the
+ * clients change the gateway of their routes, then the interfaces
+ * go down and up FLAPS times, subscriber addresses come and go on them,
+ * and the routes are deleted.  LISTENERS
+ * clients have the routes of all the origins redistributed to them.
+ * With RING, clients write to zebra through a ring of that many bytes.
+ * With SINGLE, route messages go one by one instead of in bulk.
+ */
+void
+bench_start (unsigned long routes, int clients, int listeners, int flaps,
+	     u_int32_t ring, int single)
+{
+  struct in_addr addr;
+  char name[INTERFACE_NAMSIZ];
+  unsigned int i;
+  int j;
+
+  bench.routes = routes;
+  bench.nclients = MAX (1, MIN (clients, BENCH_CLIENTS_MAX));
+  bench.nlisteners = MAX (0, MIN (listeners, BENCH_LISTENERS_MAX));
+  bench.flaps = MAX (0, flaps);
+  bench.ring = ring;
+  bench.single = single;
+
+  for (i = 0; i < BENCH_IFACES; i++)
+    {
+      snprintf (name, sizeof (name), "bench%u", i);
+      bench.ifp[i] = if_get_by_name (name);
+      if_set_index (bench.ifp[i], 1000 + i);
+      bench.ifp[i]->mtu = 1500;
+      bench.ifp[i]->flags = IFF_UP | IFF_RUNNING | IFF_BROADCAST;
+      if_add_update (bench.ifp[i]);
+
+      addr.s_addr = htonl (BENCH_GATE_BASE + (i << 8) + 1);
+      connected_add_ipv4 (bench.ifp[i], 0, &addr, 24, NULL, NULL);
+    }
+
+  for (j = 0; j < bench.nclients; j++)
+    {
+      bench_client_init (&bench.client[j], j);
+      bench.client[j].offset = j * (routes / 2);
+      bench.client[j].zclient->ring_size = ring;
+      zclient_hello_start (bench.client[j].zclient);
+    }
+  for (j = 0; j < bench.nlisteners; j++)
+    {
+      bench_client_init (&bench.listener[j], j);
+      /* The listener reads what is redistributed to it itself. */
+      zclient_hello_start (bench.listener[j].zclient);
+      THREAD_OFF (bench.listener[j].zclient->t_read);
+      for (i = 0; i < BENCH_TYPES; i++)
+	zebra_redistribute_send (ZEBRA_REDISTRIBUTE_ADD,
+				 bench.listener[j].zclient, bench_types[i]);
+      bench.listener[j].t_read = thread_add_read (zebrad.master,
+						  bench_listener_read,
+						  &bench.listener[j],
+						  bench.listener[j].zclient->sock);
+    }
+
+  printf ("bench routes=%lu clients=%d listeners=%d flaps=%d ifaces=%d "
+	  "ring_kb=%u bulk=%d\n", bench.routes, bench.nclients,
+	  bench.nlisteners, bench.flaps, BENCH_IFACES, bench.ring / 1024,
+	  ! bench.single);
+  fflush (stdout);
+
+  bench.phase = BENCH_ADD;
+  bench.connecting = 1;
+  bench_schedule (0);
+}
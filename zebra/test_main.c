@@ -35,6 +35,7 @@
 #include "zebra/debug.h"
 #include "zebra/router-id.h"
 #include "zebra/interface.h"
+#include "zebra/rtadv.h"
 
 /* Zebra instance */
 struct zebra_t zebrad =
@@ -51,6 +52,9 @@ extern int rib_process_hold_time;
 /* Pacify zclient.o in libzebra, which expects this variable. */
 struct thread_master *master;
 
+/* Route replay benchmark, see test_bench.c. */
+extern void bench_start (unsigned long, int, int, int, u_int32_t, int);
+
 /* Command line options. */
 struct option longopts[] = 
 {
@@ -62,6 +66,12 @@ struct option longopts[] =
   { "vty_port",    required_argument, NULL, 'P'},
   { "version",     no_argument,       NULL, 'v'},
   { "rib_hold",	   required_argument, NULL, 'r'},
+  { "bench",       required_argument, NULL, 'B'},
+  { "bench_clients", required_argument, NULL, 'C'},
+  { "bench_listeners", required_argument, NULL, 'L'},
+  { "bench_flaps", required_argument, NULL, 'F'},
+  { "bench_ring",  required_argument, NULL, 'R'},
+  { "bench_single", no_argument,      NULL, 'S'},
   { 0 }
 };
 
@@ -110,6 +120,12 @@ usage (char *progname, int status)
 	      "-A, --vty_addr     Set vty's bind address\n"\
 	      "-P, --vty_port     Set vty's port number\n"\
 	      "-r, --rib_hold	  Set rib-queue hold time\n"\
+	      "-B, --bench        Replay this many routes per client and exit\n"\
+	      "-C, --bench_clients   Number of clients replaying routes\n"\
+	      "-L, --bench_listeners Number of clients routes are redistributed to\n"\
+	      "-F, --bench_flaps     Number of interface down/up storms\n"\
+	      "-R, --bench_ring      Size in kilobytes of the rings clients write to\n"\
+	      "-S, --bench_single    Send route messages one by one, not in bulk\n"\
               "-v, --version      Print program version\n"\
 	      "-h, --help         Display this help and exit\n"\
 	      "\n"\
@@ -136,7 +152,7 @@ DEFUN (test_interface_state,
   ifp = vty->index;
   if (ifp->ifindex == IFINDEX_INTERNAL)
     {
-      ifp->ifindex = ++test_ifindex;
+      if_set_index (ifp, ++test_ifindex);
       ifp->mtu = 1500;
       ifp->flags = IFF_BROADCAST|IFF_MULTICAST;
     }
@@ -223,6 +239,12 @@ main (int argc, char **argv)
   char *config_file = NULL;
   char *progname;
   struct thread thread;
+  unsigned long bench_routes = 0;
+  int bench_clients = 4;
+  int bench_listeners = 2;
+  int bench_flaps = 4;
+  u_int32_t bench_ring = 0;
+  int bench_single = 0;
 
   /* Set umask before anything for security */
   umask (0027);
@@ -237,7 +259,7 @@ main (int argc, char **argv)
     {
       int opt;
   
-      opt = getopt_long (argc, argv, "bdf:hA:P:r:v", longopts, 0);
+      opt = getopt_long (argc, argv, "bdf:hA:P:r:vB:C:L:F:R:S", longopts, 0);
 
       if (opt == EOF)
 	break;
@@ -270,6 +292,24 @@ main (int argc, char **argv)
 	case 'r':
 	  rib_process_hold_time = atoi(optarg);
 	  break;
+	case 'B':
+	  bench_routes = strtoul (optarg, NULL, 10);
+	  break;
+	case 'C':
+	  bench_clients = atoi (optarg);
+	  break;
+	case 'L':
+	  bench_listeners = atoi (optarg);
+	  break;
+	case 'F':
+	  bench_flaps = atoi (optarg);
+	  break;
+	case 'R':
+	  bench_ring = strtoul (optarg, NULL, 10) * 1024;
+	  break;
+	case 'S':
+	  bench_single = 1;
+	  break;
 	case 'v':
 	  print_version (progname);
 	  exit (0);
@@ -283,8 +323,8 @@ main (int argc, char **argv)
 	}
     }
   
-  /* port and conf file mandatory */
-  if (!vty_port || !config_file)
+  /* port and conf file mandatory, but for benchmarks */
+  if (!bench_routes && (!vty_port || !config_file))
     {
       fprintf (stderr, "Error: --vty_port and --config_file arguments"
                        " are both required\n");
@@ -293,6 +333,7 @@ main (int argc, char **argv)
   
   /* Make master thread emulator. */
   zebrad.master = thread_master_create ();
+  master = zebrad.master;
 
   zprivs_init (&zserv_privs);
   /* Vty related initialize. */
@@ -306,7 +347,12 @@ main (int argc, char **argv)
   test_cmd_init ();
 
   /* Zebra related initialize. */
+  zebra_init ();
   rib_init ();
+  router_id_init ();
+#ifdef RTADV
+  rtadv_init ();
+#endif
   access_list_init ();
 
   /* Make kernel routing socket. */
@@ -318,11 +364,21 @@ main (int argc, char **argv)
   sort_node ();
 
   /* Configuration file read*/
-  vty_read_config (config_file, config_default);
+  if (config_file || ! bench_routes)
+    vty_read_config (config_file, config_default);
 
   /* Clean up rib. */
   rib_weed_tables ();
 
+  /* Run the benchmark, which exits when done. */
+  if (bench_routes)
+    {
+      bench_start (bench_routes, bench_clients, bench_listeners, bench_flaps,
+		   bench_ring, bench_single);
+      while (thread_fetch (zebrad.master, &thread))
+	thread_call (&thread);
+    }
+
   /* Exit when zebra is working in batch mode. */
   if (batch_mode)
     exit (0);
@@ -0,0 +1,338 @@
+/*
+ * FIB compression for zebra.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+
+#include <zebra.h>
+
+#include "command.h"
+#include "prefix.h"
+#include "table.h"
+#include "vty.h"
+#include "rib.h"
+
+#include "zebra/zebra_fibc.h"
+
+/* Set by "ip fib-compression". */
+static int fibc_enabled;
+
+/* Installs left out of the kernel, and routes left out installed back
+   since, counted by zebra_rib.c. */
+unsigned long fibc_suppressed;
+unsigned long fibc_restored;
+
+/* Routes of table 0 are installed in the main table. */
+#define FIBC_TABLE(rib) ((rib)->table ? (rib)->table : RT_TABLE_MAIN)
+
+static struct rib *
+fibc_selected (struct route_node *rn)
+{
+  struct rib *rib;
+
+  for (rib = rn->info; rib; rib = rib->next)
+    if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED))
+      return rib;
+  return NULL;
+}
+
+/* The selected entry of a node if the kernel forwards with it: installed,
+ * left out for being covered, or a route the kernel has by itself.  A
+ * selected route the kernel refused forwards through the one covering it.
+ */
+static struct rib *
+fibc_forwarding (struct route_node *rn)
+{
+  struct rib *rib;
+  struct nexthop *nexthop;
+
+  if (! (rib = fibc_selected (rn)))
+    return NULL;
+  if (RIB_SYSTEM_ROUTE (rib)
+      || CHECK_FLAG (rib->status, RIB_ENTRY_FIB_SUPPRESSED))
+    return rib;
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB))
+      return rib;
+  return NULL;
+}
+
+static int
+fibc_nexthop_same (int family, struct nexthop *a, struct nexthop *b)
+{
+  u_char type_a, type_b;
+  union g_addr *gate_a, *gate_b;
+  unsigned int ifindex_a, ifindex_b;
+
+  if (CHECK_FLAG (a->flags, NEXTHOP_FLAG_RECURSIVE))
+    {
+      type_a = a->rtype;
+      gate_a = &a->rgate;
+      ifindex_a = a->rifindex;
+    }
+  else
+    {
+      type_a = a->type;
+      gate_a = &a->gate;
+      ifindex_a = a->ifindex;
+    }
+  if (CHECK_FLAG (b->flags, NEXTHOP_FLAG_RECURSIVE))
+    {
+      type_b = b->rtype;
+      gate_b = &b->rgate;
+      ifindex_b = b->rifindex;
+    }
+  else
+    {
+      type_b = b->type;
+      gate_b = &b->gate;
+      ifindex_b = b->ifindex;
+    }
+
+  if (type_a != type_b || ifindex_a != ifindex_b)
+    return 0;
+
+  switch (type_a)
+    {
+    case NEXTHOP_TYPE_IPV4:
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+    case NEXTHOP_TYPE_IPV4_IFINDEX_OL:
+      if (! IPV4_ADDR_SAME (&gate_a->ipv4, &gate_b->ipv4))
+	return 0;
+      break;
+#ifdef HAVE_IPV6
+    case NEXTHOP_TYPE_IPV6:
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+    case NEXTHOP_TYPE_IPV6_IFNAME:
+      if (! IPV6_ADDR_SAME (&gate_a->ipv6, &gate_b->ipv6))
+	return 0;
+      break;
+#endif /* HAVE_IPV6 */
+    default:
+      break;
+    }
+
+  if (family == AF_INET && ! IPV4_ADDR_SAME (&a->src.ipv4, &b->src.ipv4))
+    return 0;
+  return 1;
+}
+
+/* Whether two routes have the same forwarding in the kernel: the same
+ * active nexthops, resolved the same way, in the same order. */
+static int
+fibc_same (int family, struct rib *a, struct rib *b)
+{
+  struct nexthop *na, *nb;
+
+  if (FIBC_TABLE (a) != FIBC_TABLE (b))
+    return 0;
+  if ((a->flags ^ b->flags) & (ZEBRA_FLAG_BLACKHOLE | ZEBRA_FLAG_REJECT))
+    return 0;
+
+  na = a->nexthop;
+  nb = b->nexthop;
+  for (;;)
+    {
+      while (na && ! CHECK_FLAG (na->flags, NEXTHOP_FLAG_ACTIVE))
+	na = na->next;
+      while (nb && ! CHECK_FLAG (nb->flags, NEXTHOP_FLAG_ACTIVE))
+	nb = nb->next;
+      if (! na || ! nb)
+	return na == nb;
+      if (! fibc_nexthop_same (family, na, nb))
+	return 0;
+      na = na->next;
+      nb = nb->next;
+    }
+}
+
+/* Return 1 if RIB, about to be installed in place of the other entries
+ * of RN, may be left out of the kernel.  Routes bound to a nexthop group
+ * are always installed, so that the group keeps following them.
+ */
+int
+fibc_covered (struct route_node *rn, struct rib *rib)
+{
+  struct route_node *up;
+  struct rib *cover = NULL;
+
+  if (! fibc_enabled || rib->nhg_ref)
+    return 0;
+
+  for (up = rn->parent; up; up = up->parent)
+    if ((cover = fibc_forwarding (up)))
+      break;
+  return cover && fibc_same (rn->p.family, rib, cover);
+}
+
+/* Next node of the subtree of TOP after NODE, in prefix order, without
+ * descending below NODE if SKIP is set.  The nodes of the subtree are
+ * locked by their routes: none is freed while it is walked. */
+static struct route_node *
+fibc_next (struct route_node *node, struct route_node *top, int skip)
+{
+  if (! skip)
+    {
+      if (node->l_left)
+	return node->l_left;
+      if (node->l_right)
+	return node->l_right;
+    }
+  while (node != top)
+    {
+      if (node->parent->l_left == node && node->parent->l_right)
+	return node->parent->l_right;
+      node = node->parent;
+    }
+  return NULL;
+}
+
+/* The forwarding of RN changed in the kernel: decide again for the routes
+ * it covers.  The walk stops below the routes forwarding by themselves,
+ * which the routes more specific still depend on instead of RN. */
+void
+fibc_update (struct route_node *rn)
+{
+  struct route_node *node;
+  struct rib *rib;
+  int skip = 0;
+
+  if (! fibc_enabled)
+    return;
+
+  node = rn;
+  while ((node = fibc_next (node, rn, skip)))
+    {
+      skip = 0;
+      if (! (rib = fibc_selected (node)))
+	continue;
+      if (! RIB_SYSTEM_ROUTE (rib))
+	rib_fibc_refresh (node, rib);
+      skip = (fibc_forwarding (node) != NULL);
+    }
+}
+
+/* Decide again for all the routes of TABLE, the less specific first. */
+static void
+fibc_refresh_table (struct route_table *table)
+{
+  struct route_node *rn;
+  struct rib *rib;
+
+  if (! table)
+    return;
+
+  for (rn = route_top (table); rn; rn = route_next (rn))
+    if ((rib = fibc_selected (rn)) && ! RIB_SYSTEM_ROUTE (rib))
+      rib_fibc_refresh (rn, rib);
+}
+
+static void
+fibc_set (int enabled)
+{
+  if (fibc_enabled == enabled)
+    return;
+
+  fibc_enabled = enabled;
+  fibc_refresh_table (vrf_table (AFI_IP, SAFI_UNICAST, 0));
+#ifdef HAVE_IPV6
+  fibc_refresh_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
+#endif /* HAVE_IPV6 */
+}
+
+static void
+fibc_show_table (struct vty *vty, const char *name, struct route_table *table)
+{
+  struct route_node *rn;
+  struct rib *rib;
+  unsigned long routes = 0, suppressed = 0;
+
+  if (! table)
+    return;
+
+  for (rn = route_top (table); rn; rn = route_next (rn))
+    if ((rib = fibc_selected (rn)) && ! RIB_SYSTEM_ROUTE (rib))
+      {
+	routes++;
+	if (CHECK_FLAG (rib->status, RIB_ENTRY_FIB_SUPPRESSED))
+	  suppressed++;
+      }
+
+  vty_out (vty, "  %s: %lu routes, %lu installed, %lu left out",
+	   name, routes, routes - suppressed, suppressed);
+  if (routes)
+    vty_out (vty, " (%.1f%% of the routes installed)",
+	     100.0 * (routes - suppressed) / routes);
+  vty_out (vty, "%s", VTY_NEWLINE);
+}
+
+DEFUN (ip_fib_compression,
+       ip_fib_compression_cmd,
+       "ip fib-compression",
+       IP_STR
+       "Leave out of the kernel the routes forwarding like the route covering them\n")
+{
+  fibc_set (1);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_ip_fib_compression,
+       no_ip_fib_compression_cmd,
+       "no ip fib-compression",
+       NO_STR
+       IP_STR
+       "Leave out of the kernel the routes forwarding like the route covering them\n")
+{
+  fibc_set (0);
+  return CMD_SUCCESS;
+}
+
+DEFUN (show_ip_fib_compression,
+       show_ip_fib_compression_cmd,
+       "show ip fib-compression",
+       SHOW_STR
+       IP_STR
+       "Routes left out of the kernel by FIB compression\n")
+{
+  vty_out (vty, "FIB compression is %s%s",
+	   fibc_enabled ? "enabled" : "disabled", VTY_NEWLINE);
+  fibc_show_table (vty, "IPv4", vrf_table (AFI_IP, SAFI_UNICAST, 0));
+#ifdef HAVE_IPV6
+  fibc_show_table (vty, "IPv6", vrf_table (AFI_IP6, SAFI_UNICAST, 0));
+#endif /* HAVE_IPV6 */
+  vty_out (vty, "  %lu installs left out, %lu installed back since startup%s",
+	   fibc_suppressed, fibc_restored, VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
+void
+fibc_config_write (struct vty *vty)
+{
+  if (fibc_enabled)
+    vty_out (vty, "ip fib-compression%s", VTY_NEWLINE);
+}
+
+void
+fibc_init (void)
+{
+  install_element (CONFIG_NODE, &ip_fib_compression_cmd);
+  install_element (CONFIG_NODE, &no_ip_fib_compression_cmd);
+  install_element (VIEW_NODE, &show_ip_fib_compression_cmd);
+  install_element (ENABLE_NODE, &show_ip_fib_compression_cmd);
+}
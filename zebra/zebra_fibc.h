@@ -0,0 +1,43 @@
+/*
+ * FIB compression for zebra.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+
+#ifndef _ZEBRA_FIBC_H
+#define _ZEBRA_FIBC_H
+
+#include "table.h"
+#include "rib.h"
+
+/* With FIB compression, a selected route is left out of the kernel when
+ * the closest less specific route forwarding in the kernel in its place
+ * forwards the same way: the kernel then has the same forwarding with
+ * fewer routes.  The routes more specific than one which changed are
+ * reconsidered by fibc_update().
+ */
+extern unsigned long fibc_suppressed;
+extern unsigned long fibc_restored;
+
+extern void fibc_init (void);
+extern int fibc_covered (struct route_node *, struct rib *);
+extern void fibc_update (struct route_node *);
+extern void fibc_config_write (struct vty *);
+
+#endif /* _ZEBRA_FIBC_H */
@@ -0,0 +1,400 @@
+/*
+ * Multibit trie answering IPv4 nexthop lookups for zebra.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+
+#include <zebra.h>
+
+#include "command.h"
+#include "memory.h"
+#include "prefix.h"
+#include "table.h"
+#include "vty.h"
+#include "rib.h"
+
+#include "zebra/zebra_lpm.h"
+
+/* The first level has an entry for each /16, the others are chunks of an
+ * entry for each of the 256 prefixes one level longer.  An entry is 0 for
+ * no route, the route_node of the route covering its whole range, or the
+ * index of the chunk of the next level with its low bit set.  The route
+ * nodes of the trie are locked, and marked with RIB_ROUTE_LPM.
+ */
+#define LPM_L1_BITS		16
+#define LPM_BITS		8
+#define LPM_CHUNK		(1 << LPM_BITS)
+
+#define LPM_IS_CHUNK(e)		((e) & 1)
+#define LPM_CHUNK_ENTRY(c)	(((uintptr_t) (c) << 1) | 1)
+#define LPM_CHUNK_INDEX(e)	((u_int32_t) ((e) >> 1))
+
+static struct
+{
+  /* Set by "ip lookup-table". */
+  int enabled;
+  struct route_table *table;
+
+  uintptr_t *l1;
+
+  /* Chunks, unused ones being chained through their first entry. */
+  uintptr_t *chunks;
+  u_int32_t chunks_max;
+  u_int32_t chunks_top;
+  u_int32_t chunks_free;
+  u_int32_t chunks_used;
+
+  unsigned long routes;
+  unsigned long updates;
+  unsigned long lookups;
+} lpm;
+
+/* Entries of a level: the first one, or a chunk. */
+static uintptr_t *
+lpm_level (int chunk)
+{
+  return chunk < 0 ? lpm.l1 : lpm.chunks + (size_t) chunk * LPM_CHUNK;
+}
+
+static u_char
+lpm_len (uintptr_t e)
+{
+  return e ? ((struct route_node *) e)->p.prefixlen : 0;
+}
+
+/* A chunk with all its entries set to e. */
+static u_int32_t
+lpm_chunk_new (uintptr_t e)
+{
+  uintptr_t *entries;
+  u_int32_t chunk;
+  int i;
+
+  if (lpm.chunks_free)
+    {
+      chunk = lpm.chunks_free - 1;
+      lpm.chunks_free = lpm_level (chunk)[0];
+    }
+  else
+    {
+      if (lpm.chunks_top == lpm.chunks_max)
+	{
+	  lpm.chunks_max = lpm.chunks_max ? lpm.chunks_max * 2 : 64;
+	  lpm.chunks = XREALLOC (MTYPE_LPM_TABLE, lpm.chunks,
+				 (size_t) lpm.chunks_max * LPM_CHUNK
+				 * sizeof (uintptr_t));
+	}
+      chunk = lpm.chunks_top++;
+    }
+  lpm.chunks_used++;
+
+  entries = lpm_level (chunk);
+  for (i = 0; i < LPM_CHUNK; i++)
+    entries[i] = e;
+  return chunk;
+}
+
+static void
+lpm_chunk_free (u_int32_t chunk)
+{
+  lpm_level (chunk)[0] = lpm.chunks_free;
+  lpm.chunks_free = chunk + 1;
+  lpm.chunks_used--;
+}
+
+/* The value of all the entries of a chunk, if they are all the same
+ * route, for the chunk to be replaced with it. */
+static int
+lpm_chunk_uniform (u_int32_t chunk, uintptr_t *e)
+{
+  uintptr_t *entries = lpm_level (chunk);
+  int i;
+
+  for (i = 0; i < LPM_CHUNK; i++)
+    if (LPM_IS_CHUNK (entries[i]) || entries[i] != entries[0])
+      return 0;
+  *e = entries[0];
+  return 1;
+}
+
+/* Set to new the entries in a range of a level, and in the chunks below,
+ * which hold old when a route is deleted, or a route less specific than
+ * one of length len when it is added. */
+static void
+lpm_fill (int chunk, int from, int count, uintptr_t old, uintptr_t new,
+	  u_char len)
+{
+  uintptr_t e;
+  int i;
+
+  for (i = from; i < from + count; i++)
+    {
+      e = lpm_level (chunk)[i];
+      if (LPM_IS_CHUNK (e))
+	{
+	  lpm_fill (LPM_CHUNK_INDEX (e), 0, LPM_CHUNK, old, new, len);
+	  if (lpm_chunk_uniform (LPM_CHUNK_INDEX (e), &lpm_level (chunk)[i]))
+	    lpm_chunk_free (LPM_CHUNK_INDEX (e));
+	}
+      else if (old ? e == old : lpm_len (e) <= len)
+	lpm_level (chunk)[i] = new;
+    }
+}
+
+/* Replace old with new over the range of the prefix of a node, the route
+ * node being added when old is 0.  The chunks on the way to the range end
+ * up replaced with their entries when these are all the same route. */
+static void
+lpm_change (struct route_node *rn, uintptr_t old, uintptr_t new)
+{
+  u_int32_t addr = ntohl (rn->p.u.prefix4.s_addr);
+  u_char len = rn->p.prefixlen;
+  int path_chunk[3], path_index[3];
+  int depth = 0;
+  int chunk = -1;
+  int consumed = 0;
+  int bits, index, span;
+  uintptr_t e;
+
+  for (;;)
+    {
+      bits = chunk < 0 ? LPM_L1_BITS : LPM_BITS;
+      index = (addr >> (IPV4_MAX_BITLEN - consumed - bits)) & ((1 << bits) - 1);
+
+      if (len <= consumed + bits)
+	{
+	  span = 1 << (consumed + bits - len);
+	  lpm_fill (chunk, index & ~(span - 1), span, old, new, len);
+	  break;
+	}
+
+      e = lpm_level (chunk)[index];
+      if (! LPM_IS_CHUNK (e))
+	{
+	  /* Nothing below to delete. */
+	  if (old)
+	    return;
+	  e = LPM_CHUNK_ENTRY (lpm_chunk_new (e));
+	  lpm_level (chunk)[index] = e;
+	}
+
+      path_chunk[depth] = chunk;
+      path_index[depth++] = index;
+      chunk = LPM_CHUNK_INDEX (e);
+      consumed += bits;
+    }
+
+  while (depth-- > 0
+	 && lpm_chunk_uniform (chunk,
+			       &lpm_level (path_chunk[depth])[path_index[depth]]))
+    {
+      lpm_chunk_free (chunk);
+      chunk = path_chunk[depth];
+    }
+}
+
+static int
+lpm_member (struct route_node *rn)
+{
+  return rn->info
+    && CHECK_FLAG (((struct rib *) rn->info)->rn_status, RIB_ROUTE_LPM);
+}
+
+/* Whether rib_match_ipv4() may return the selected route of a node, as
+ * opposed to looking at a less specific one. */
+static int
+lpm_matchable (struct route_node *rn)
+{
+  struct rib *rib;
+
+  for (rib = rn->info; rib; rib = rib->next)
+    {
+      if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+	continue;
+      if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED))
+	return rib->type != ZEBRA_ROUTE_BGP;
+    }
+  return 0;
+}
+
+static void
+lpm_add (struct route_node *rn)
+{
+  lpm_change (rn, 0, (uintptr_t) rn);
+  SET_FLAG (((struct rib *) rn->info)->rn_status, RIB_ROUTE_LPM);
+  route_lock_node (rn);
+  lpm.routes++;
+}
+
+/* Take a node out of the trie, the entries it had going to the closest
+ * less specific node there.  Called by rib_unlink() as well, for a node
+ * losing its last route while in the trie. */
+void
+lpm_delete (struct route_node *rn)
+{
+  struct route_node *parent;
+
+  for (parent = rn->parent; parent; parent = parent->parent)
+    if (lpm_member (parent))
+      break;
+
+  lpm_change (rn, (uintptr_t) rn, (uintptr_t) parent);
+  if (rn->info)
+    UNSET_FLAG (((struct rib *) rn->info)->rn_status, RIB_ROUTE_LPM);
+  route_unlock_node (rn);
+  lpm.routes--;
+}
+
+/* The selected route of a node changed. */
+void
+lpm_update (struct route_node *rn)
+{
+  int member, matchable;
+
+  if (! lpm.enabled || rn->table != lpm.table)
+    return;
+
+  member = lpm_member (rn);
+  matchable = lpm_matchable (rn);
+  if (member == matchable)
+    return;
+
+  lpm.updates++;
+  if (matchable)
+    lpm_add (rn);
+  else
+    lpm_delete (rn);
+}
+
+int
+lpm_active (void)
+{
+  return lpm.enabled;
+}
+
+/* The node of the most specific route covering an address among those
+ * rib_match_ipv4() may return, or NULL. */
+struct route_node *
+lpm_match (struct in_addr *addr)
+{
+  u_int32_t a = ntohl (addr->s_addr);
+  uintptr_t e;
+
+  lpm.lookups++;
+  e = lpm.l1[a >> (IPV4_MAX_BITLEN - LPM_L1_BITS)];
+  if (LPM_IS_CHUNK (e))
+    {
+      e = lpm_level (LPM_CHUNK_INDEX (e))[(a >> LPM_BITS) & (LPM_CHUNK - 1)];
+      if (LPM_IS_CHUNK (e))
+	e = lpm_level (LPM_CHUNK_INDEX (e))[a & (LPM_CHUNK - 1)];
+    }
+  return (struct route_node *) e;
+}
+
+void
+lpm_set (int enabled)
+{
+  struct route_node *rn;
+
+  if (enabled == lpm.enabled)
+    return;
+
+  if (enabled)
+    {
+      lpm.table = vrf_table (AFI_IP, SAFI_UNICAST, 0);
+      if (! lpm.table)
+	return;
+      lpm.l1 = XCALLOC (MTYPE_LPM_TABLE,
+			(1 << LPM_L1_BITS) * sizeof (uintptr_t));
+      lpm.enabled = 1;
+      for (rn = route_top (lpm.table); rn; rn = route_next (rn))
+	lpm_update (rn);
+      return;
+    }
+
+  for (rn = route_top (lpm.table); rn; rn = route_next (rn))
+    if (lpm_member (rn))
+      {
+	UNSET_FLAG (((struct rib *) rn->info)->rn_status, RIB_ROUTE_LPM);
+	route_unlock_node (rn);
+      }
+  XFREE (MTYPE_LPM_TABLE, lpm.l1);
+  if (lpm.chunks)
+    XFREE (MTYPE_LPM_TABLE, lpm.chunks);
+  memset (&lpm, 0, sizeof (lpm));
+}
+
+DEFUN (ip_lookup_table,
+       ip_lookup_table_cmd,
+       "ip lookup-table",
+       IP_STR
+       "Answer nexthop lookups from a multibit trie of the routes\n")
+{
+  lpm_set (1);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_ip_lookup_table,
+       no_ip_lookup_table_cmd,
+       "no ip lookup-table",
+       NO_STR
+       IP_STR
+       "Answer nexthop lookups from a multibit trie of the routes\n")
+{
+  lpm_set (0);
+  return CMD_SUCCESS;
+}
+
+DEFUN (show_ip_lookup_table,
+       show_ip_lookup_table_cmd,
+       "show ip lookup-table",
+       SHOW_STR
+       IP_STR
+       "Multibit trie answering nexthop lookups\n")
+{
+  vty_out (vty, "Lookup table is %s%s",
+	   lpm.enabled ? "enabled" : "disabled", VTY_NEWLINE);
+  if (! lpm.enabled)
+    return CMD_SUCCESS;
+
+  vty_out (vty, "  %lu routes, %u chunks of %d entries in use, %lu KiB%s",
+	   lpm.routes, lpm.chunks_used, LPM_CHUNK,
+	   (unsigned long) (((1 << LPM_L1_BITS)
+			     + (size_t) lpm.chunks_max * LPM_CHUNK)
+			    * sizeof (uintptr_t) / 1024), VTY_NEWLINE);
+  vty_out (vty, "  %lu updates, %lu lookups%s",
+	   lpm.updates, lpm.lookups, VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
+void
+lpm_config_write (struct vty *vty)
+{
+  if (lpm.enabled)
+    vty_out (vty, "ip lookup-table%s", VTY_NEWLINE);
+}
+
+void
+lpm_init (void)
+{
+  install_element (CONFIG_NODE, &ip_lookup_table_cmd);
+  install_element (CONFIG_NODE, &no_ip_lookup_table_cmd);
+  install_element (VIEW_NODE, &show_ip_lookup_table_cmd);
+  install_element (ENABLE_NODE, &show_ip_lookup_table_cmd);
+}
@@ -0,0 +1,43 @@
+/*
+ * Multibit trie answering IPv4 nexthop lookups for zebra.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_LPM_H
+#define _ZEBRA_LPM_H
+
+#include "table.h"
+#include "rib.h"
+
+/* With the lookup table, rib_match_ipv4() finds the node of the route it
+ * returns in a multibit trie of the nodes of the IPv4 unicast table whose
+ * selected route is one it may return, instead of walking the radix tree
+ * from the most specific node.  The trie is indexed by the 16 high bits of
+ * the address, then 8 bits at a time, and kept up to date by lpm_update()
+ * as the selected routes change.
+ */
+extern void lpm_init (void);
+extern void lpm_set (int);
+extern int lpm_active (void);
+extern struct route_node *lpm_match (struct in_addr *);
+extern void lpm_update (struct route_node *);
+extern void lpm_delete (struct route_node *);
+extern void lpm_config_write (struct vty *);
+
+#endif /* _ZEBRA_LPM_H */
@@ -0,0 +1,975 @@
+/*
+ * Shared nexthop groups for zebra.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "hash.h"
+#include "jhash.h"
+#include "linklist.h"
+#include "log.h"
+#include "memory.h"
+#include "table.h"
+#include "vty.h"
+#include "if.h"
+#include "rib.h"
+
+#include "zebra/zserv.h"
+#include "zebra/zebra_nhg.h"
+#include "zebra/rt.h"
+#include "zebra/debug.h"
+
+/* All groups known, keyed by owner and id. */
+static struct hash *nhg_hash;
+
+/* Groups orphaned while routes still referred to them. */
+static unsigned long nhg_orphans;
+
+/* Interned nexthop sets, keyed by nexthops. */
+static struct hash *nhe_hash;
+
+/* Sets by gateway, sets by interface their nexthops go through, and
+ * sets with nexthops naming an interface. */
+static struct route_table *nhe_gw_table4;
+static struct route_table *nhe_gw_table6;
+static struct hash *nhe_ifdep_hash;
+static struct list *nhe_if_list;
+
+/* Sets with nexthops through an interface. */
+struct nhe_ifdep
+{
+  unsigned int ifindex;
+  struct list *nhes;
+};
+
+/* How often sets were resolved or had their resolution reused, and how
+ * often a change of route made them stale. */
+static unsigned long nhe_resolves;
+static unsigned long nhe_reuses;
+static unsigned long nhe_stales;
+static unsigned long nhe_requeues;
+
+/* Next kernel nexthop object id to hand out. */
+static u_int32_t nhg_kernel_next_id = 1;
+
+static unsigned int
+nhg_hash_key (void *arg)
+{
+  struct nhg *nhg = arg;
+
+  return jhash_2words ((u_int32_t) (uintptr_t) nhg->owner, nhg->id, 0);
+}
+
+static int
+nhg_hash_cmp (const void *a, const void *b)
+{
+  const struct nhg *nhg1 = a;
+  const struct nhg *nhg2 = b;
+
+  return nhg1->owner == nhg2->owner && nhg1->id == nhg2->id;
+}
+
+static void *
+nhg_hash_alloc (void *arg)
+{
+  struct nhg *key = arg;
+  struct nhg *nhg;
+
+  nhg = XCALLOC (MTYPE_NHG, sizeof (struct nhg));
+  nhg->owner = key->owner;
+  nhg->id = key->id;
+  return nhg;
+}
+
+static void
+nhg_free (struct nhg *nhg)
+{
+  assert (nhg->refs == NULL);
+
+  if (CHECK_FLAG (nhg->status, NHG_KERNEL))
+    kernel_nhg_delete (nhg);
+  if (CHECK_FLAG (nhg->status, NHG_ORPHAN))
+    nhg_orphans--;
+
+  rib_nhg_copy_nexthops (nhg->tmpl, NULL);
+  XFREE (MTYPE_RIB, nhg->tmpl);
+  XFREE (MTYPE_NHG, nhg);
+}
+
+/* Unhash the group.  It is freed now if no route uses it, otherwise when
+ * the last one goes. */
+static void
+nhg_orphan (struct nhg *nhg)
+{
+  hash_release (nhg_hash, nhg);
+  nhg->owner = NULL;
+
+  if (nhg->refcnt == 0)
+    {
+      nhg_free (nhg);
+      return;
+    }
+  SET_FLAG (nhg->status, NHG_ORPHAN);
+  nhg_orphans++;
+}
+
+struct nhg *
+nhg_lookup (void *owner, u_int32_t id)
+{
+  struct nhg key;
+
+  key.owner = owner;
+  key.id = id;
+  return hash_lookup (nhg_hash, &key);
+}
+
+/* The single nexthop a RIB entry resolves to, as a gateway and interface
+ * a kernel nexthop object can be given.  Return 0 if there is none. */
+static int
+nhg_resolved_hop (struct rib *rib, struct in_addr *gate,
+                  unsigned int *ifindex)
+{
+  struct nexthop *nexthop;
+  struct nexthop *hop = NULL;
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+      {
+        if (hop)
+          return 0;
+        hop = nexthop;
+      }
+
+  if (! hop || hop->src.ipv4.s_addr)
+    return 0;
+
+  if (CHECK_FLAG (hop->flags, NEXTHOP_FLAG_RECURSIVE))
+    {
+      if (hop->rtype != NEXTHOP_TYPE_IPV4
+          && hop->rtype != NEXTHOP_TYPE_IPV4_IFINDEX)
+        return 0;
+      *gate = hop->rgate.ipv4;
+      *ifindex = hop->rifindex;
+    }
+  else
+    {
+      if (hop->type != NEXTHOP_TYPE_IPV4
+          && hop->type != NEXTHOP_TYPE_IPV4_IFINDEX)
+        return 0;
+      *gate = hop->gate.ipv4;
+      *ifindex = hop->ifindex;
+    }
+  return *ifindex != 0;
+}
+
+/* Point the kernel nexthop object of the group at the given hop. */
+static int
+nhg_kernel_set (struct nhg *nhg, struct in_addr gate, unsigned int ifindex)
+{
+  if (CHECK_FLAG (nhg->status, NHG_KERNEL)
+      && nhg->kernel_gate.s_addr == gate.s_addr
+      && nhg->kernel_ifindex == ifindex)
+    return 0;
+
+  if (! nhg->kernel_id)
+    nhg->kernel_id = nhg_kernel_next_id++;
+  nhg->kernel_gate = gate;
+  nhg->kernel_ifindex = ifindex;
+
+  if (kernel_nhg_add (nhg) < 0)
+    {
+      UNSET_FLAG (nhg->status, NHG_KERNEL);
+      return -1;
+    }
+  SET_FLAG (nhg->status, NHG_KERNEL);
+  nhg->kernel_updates++;
+  return 0;
+}
+
+/* Called by the kernel interface when installing a RIB entry.  Return the
+ * id of the kernel nexthop object to install the route with, or 0 if the
+ * route is to carry its own nexthops.  The object is (re)programmed on
+ * demand as long as no route is using it yet. */
+u_int32_t
+nhg_kernel_bind (struct rib *rib)
+{
+  struct nhg *nhg;
+  struct in_addr gate;
+  unsigned int ifindex;
+
+  if (! rib->nhg_ref)
+    return 0;
+  nhg = rib->nhg_ref->nhg;
+
+  if (CHECK_FLAG (nhg->status, NHG_KERNEL_FAILED)
+      || ! nhg_resolved_hop (rib, &gate, &ifindex))
+    return 0;
+
+  if (nhg->kernel_refcnt == 0)
+    {
+      if (nhg_kernel_set (nhg, gate, ifindex) < 0)
+        return 0;
+    }
+  else if (! CHECK_FLAG (nhg->status, NHG_KERNEL)
+           || nhg->kernel_gate.s_addr != gate.s_addr
+           || nhg->kernel_ifindex != ifindex)
+    return 0;
+
+  SET_FLAG (rib->status, RIB_ENTRY_NHG_FIB);
+  nhg->kernel_refcnt++;
+  return nhg->kernel_id;
+}
+
+/* The route of a RIB entry bound to a kernel nexthop object has left the
+ * kernel.  If 'lost' is set, the object itself is not to be trusted any
+ * longer, and not used again until the group is updated. */
+void
+nhg_kernel_unbind (struct rib *rib, int lost)
+{
+  struct nhg *nhg;
+
+  if (! CHECK_FLAG (rib->status, RIB_ENTRY_NHG_FIB))
+    return;
+  UNSET_FLAG (rib->status, RIB_ENTRY_NHG_FIB);
+
+  if (! rib->nhg_ref)
+    return;
+  nhg = rib->nhg_ref->nhg;
+
+  if (nhg->kernel_refcnt)
+    nhg->kernel_refcnt--;
+  if (lost)
+    {
+      UNSET_FLAG (nhg->status, NHG_KERNEL);
+      SET_FLAG (nhg->status, NHG_KERNEL_FAILED);
+    }
+}
+
+/* Propagate a change of the group to the routes using it.  If only the
+ * resolution of the nexthops changed and the kernel object can express
+ * it, replacing the object moves every route in one go and the RIB
+ * entries are merely brought in line.  Otherwise each route is requeued
+ * for rib_process(), with the new nexthops if 'swapped' is set. */
+static void
+nhg_refresh (struct nhg *nhg, int swapped)
+{
+  struct nhg_ref *ref, *next;
+  struct in_addr gate;
+  unsigned int ifindex;
+
+  nhg->updates++;
+  UNSET_FLAG (nhg->status, NHG_KERNEL_FAILED);
+  rib_nhg_resolve (nhg->tmpl);
+
+  if (! swapped && nhg->kernel_refcnt
+      && CHECK_FLAG (nhg->status, NHG_KERNEL)
+      && nhg_resolved_hop (nhg->tmpl, &gate, &ifindex)
+      && nhg_kernel_set (nhg, gate, ifindex) == 0)
+    {
+      for (ref = nhg->refs; ref; ref = next)
+        {
+          next = ref->next;
+          if (CHECK_FLAG (ref->rib->status, RIB_ENTRY_NHG_FIB))
+            rib_nhg_sync (ref->rn, ref->rib, nhg->tmpl);
+          else
+            {
+              rib_nhg_requeue (ref->rn, ref->rib, NULL);
+              nhg->requeues++;
+            }
+        }
+      return;
+    }
+
+  if (IS_ZEBRA_DEBUG_RIB)
+    zlog_debug ("%s: group %u: requeueing %lu routes", __func__,
+                nhg->id, nhg->refcnt);
+
+  for (ref = nhg->refs; ref; ref = next)
+    {
+      next = ref->next;
+      rib_nhg_requeue (ref->rn, ref->rib, swapped ? nhg->tmpl : NULL);
+      nhg->requeues++;
+    }
+}
+
+static int
+nhg_same_ifname (struct nexthop *nh1, struct nexthop *nh2)
+{
+  if (! nh1->ifname || ! nh2->ifname)
+    return nh1->ifname == nh2->ifname;
+  return strcmp (nh1->ifname, nh2->ifname) == 0;
+}
+
+/* Whether two nexthops are the same, bar their resolution. */
+static int
+nhg_same_nexthop (struct nexthop *nh1, struct nexthop *nh2)
+{
+  if (nh1->type != nh2->type)
+    return 0;
+
+  switch (nh1->type)
+    {
+    case NEXTHOP_TYPE_IPV4:
+      return nh1->gate.ipv4.s_addr == nh2->gate.ipv4.s_addr;
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+    case NEXTHOP_TYPE_IPV4_IFINDEX_OL:
+      return nh1->gate.ipv4.s_addr == nh2->gate.ipv4.s_addr
+        && nh1->ifindex == nh2->ifindex;
+#ifdef HAVE_IPV6
+    case NEXTHOP_TYPE_IPV6:
+      return IPV6_ADDR_SAME (&nh1->gate.ipv6, &nh2->gate.ipv6);
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+      return IPV6_ADDR_SAME (&nh1->gate.ipv6, &nh2->gate.ipv6)
+        && nh1->ifindex == nh2->ifindex;
+    case NEXTHOP_TYPE_IPV6_IFNAME:
+      return IPV6_ADDR_SAME (&nh1->gate.ipv6, &nh2->gate.ipv6)
+        && nhg_same_ifname (nh1, nh2);
+#endif /* HAVE_IPV6 */
+    case NEXTHOP_TYPE_IFNAME:
+      return nhg_same_ifname (nh1, nh2);
+    default:
+      return nh1->ifindex == nh2->ifindex;
+    }
+}
+
+/* Whether two RIB entries have the same nexthops, bar their resolution. */
+static int
+nhg_same_nexthops (struct rib *rib1, struct rib *rib2)
+{
+  struct nexthop *nh1, *nh2;
+
+  for (nh1 = rib1->nexthop, nh2 = rib2->nexthop; nh1 && nh2;
+       nh1 = nh1->next, nh2 = nh2->next)
+    if (! nhg_same_nexthop (nh1, nh2))
+      return 0;
+
+  return nh1 == NULL && nh2 == NULL;
+}
+
+static int
+nhg_same (struct rib *rib1, struct rib *rib2)
+{
+  return rib1->flags == rib2->flags && nhg_same_nexthops (rib1, rib2);
+}
+
+/* Define a group, or update it with the given template.  Updating a group
+ * with the nexthops it already has asks for them to be resolved again. */
+void
+nhg_update (void *owner, u_int32_t id, struct rib *tmpl)
+{
+  struct nhg key;
+  struct nhg *nhg;
+  int swapped;
+
+  key.owner = owner;
+  key.id = id;
+  nhg = hash_get (nhg_hash, &key, nhg_hash_alloc);
+
+  if (! nhg->tmpl)
+    {
+      nhg->tmpl = tmpl;
+      rib_nhg_resolve (tmpl);
+      return;
+    }
+
+  swapped = ! nhg_same (nhg->tmpl, tmpl);
+  if (swapped)
+    {
+      rib_nhg_copy_nexthops (nhg->tmpl, NULL);
+      XFREE (MTYPE_RIB, nhg->tmpl);
+      nhg->tmpl = tmpl;
+    }
+  else
+    {
+      rib_nhg_copy_nexthops (tmpl, NULL);
+      XFREE (MTYPE_RIB, tmpl);
+    }
+
+  nhg_refresh (nhg, swapped);
+}
+
+/* The routes using a deleted group keep their nexthops, they can just no
+ * longer be updated through it. */
+void
+nhg_delete (void *owner, u_int32_t id)
+{
+  struct nhg *nhg;
+
+  nhg = nhg_lookup (owner, id);
+  if (nhg)
+    nhg_orphan (nhg);
+}
+
+static void
+nhg_owner_close_iter (struct hash_backet *backet, void *owner)
+{
+  struct nhg *nhg = backet->data;
+
+  /* Only releases the backet being visited, so the walk may go on. */
+  if (nhg->owner == owner)
+    nhg_orphan (nhg);
+}
+
+/* Drop all groups of a client going away. */
+void
+nhg_owner_close (void *owner)
+{
+  hash_iterate (nhg_hash, nhg_owner_close_iter, owner);
+}
+
+/* Make a RIB entry use a group: the group nexthops replace its own, and it
+ * joins the group once linked to its route node. */
+void
+nhg_ref_add (struct nhg *nhg, struct rib *rib)
+{
+  struct nhg_ref *ref;
+
+  ref = XCALLOC (MTYPE_NHG_REF, sizeof (struct nhg_ref));
+  ref->nhg = nhg;
+  ref->rib = rib;
+  rib->nhg_ref = ref;
+
+  rib_nhg_copy_nexthops (rib, nhg->tmpl);
+}
+
+void
+nhg_ref_link (struct nhg_ref *ref, struct route_node *rn)
+{
+  struct nhg *nhg = ref->nhg;
+
+  ref->rn = rn;
+  ref->prev = NULL;
+  ref->next = nhg->refs;
+  if (nhg->refs)
+    nhg->refs->prev = ref;
+  nhg->refs = ref;
+  nhg->refcnt++;
+}
+
+void
+nhg_ref_free (struct nhg_ref *ref)
+{
+  struct nhg *nhg = ref->nhg;
+
+  /* Not linked if the RIB entry never made it into a table. */
+  if (ref->rn)
+    {
+      if (ref->next)
+        ref->next->prev = ref->prev;
+      if (ref->prev)
+        ref->prev->next = ref->next;
+      else
+        nhg->refs = ref->next;
+      nhg->refcnt--;
+    }
+
+  ref->rib->nhg_ref = NULL;
+  XFREE (MTYPE_NHG_REF, ref);
+
+  if (nhg->refcnt == 0 && CHECK_FLAG (nhg->status, NHG_ORPHAN))
+    nhg_free (nhg);
+}
+
+/* Only the flags affecting resolution make part of the key of a set. */
+#define NHE_FLAGS(rib)	((rib)->flags & ZEBRA_FLAG_INTERNAL)
+
+static unsigned int
+nhe_hash_key (void *arg)
+{
+  struct rib *rib = ((struct nhe *) arg)->tmpl;
+  struct nexthop *nexthop;
+  u_int32_t key;
+
+  key = NHE_FLAGS (rib);
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    switch (nexthop->type)
+      {
+      case NEXTHOP_TYPE_IPV4:
+      case NEXTHOP_TYPE_IPV4_IFINDEX:
+      case NEXTHOP_TYPE_IPV4_IFINDEX_OL:
+        key = jhash_2words (nexthop->gate.ipv4.s_addr, nexthop->type, key);
+        break;
+#ifdef HAVE_IPV6
+      case NEXTHOP_TYPE_IPV6:
+      case NEXTHOP_TYPE_IPV6_IFINDEX:
+      case NEXTHOP_TYPE_IPV6_IFNAME:
+        key = jhash2 ((u_int32_t *) &nexthop->gate.ipv6, 4, key);
+        break;
+#endif /* HAVE_IPV6 */
+      default:
+        key = jhash_2words (nexthop->ifindex, nexthop->type, key);
+        break;
+      }
+  return key;
+}
+
+static int
+nhe_same (struct rib *tmpl, struct rib *rib)
+{
+  return NHE_FLAGS (tmpl) == NHE_FLAGS (rib) && nhg_same_nexthops (tmpl, rib);
+}
+
+static int
+nhe_hash_cmp (const void *a, const void *b)
+{
+  return nhe_same (((const struct nhe *) a)->tmpl,
+                   ((const struct nhe *) b)->tmpl);
+}
+
+/* The gateway a nexthop is resolved through by a route lookup, if any,
+ * as a host prefix.  Other nexthops depend on the state of an interface.
+ */
+static int
+nhe_gateway (struct nexthop *nexthop, struct prefix *p)
+{
+  switch (nexthop->type)
+    {
+    case NEXTHOP_TYPE_IPV4:
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+      p->family = AF_INET;
+      p->prefixlen = IPV4_MAX_BITLEN;
+      p->u.prefix4 = nexthop->gate.ipv4;
+      return 1;
+#ifdef HAVE_IPV6
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+      if (IN6_IS_ADDR_LINKLOCAL (&nexthop->gate.ipv6))
+        return 0;
+      /* Fall through. */
+    case NEXTHOP_TYPE_IPV6:
+      p->family = AF_INET6;
+      p->prefixlen = IPV6_MAX_BITLEN;
+      p->u.prefix6 = nexthop->gate.ipv6;
+      return 1;
+#endif /* HAVE_IPV6 */
+    default:
+      return 0;
+    }
+}
+
+static struct route_table *
+nhe_gw_table (int family)
+{
+  return family == AF_INET ? nhe_gw_table4 : nhe_gw_table6;
+}
+
+/* The interface a nexthop without a gateway to resolve goes through, if
+ * known by index. */
+static unsigned int
+nhe_ifindex (struct nexthop *nexthop)
+{
+  switch (nexthop->type)
+    {
+    case NEXTHOP_TYPE_IFINDEX:
+    case NEXTHOP_TYPE_IPV4_IFINDEX_OL:
+#ifdef HAVE_IPV6
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+#endif /* HAVE_IPV6 */
+      return nexthop->ifindex;
+    default:
+      return IFINDEX_INTERNAL;
+    }
+}
+
+static unsigned int
+nhe_ifdep_key (void *arg)
+{
+  struct nhe_ifdep *dep = arg;
+
+  return jhash_1word (dep->ifindex, 0);
+}
+
+static int
+nhe_ifdep_cmp (const void *a, const void *b)
+{
+  return ((const struct nhe_ifdep *) a)->ifindex
+         == ((const struct nhe_ifdep *) b)->ifindex;
+}
+
+static void *
+nhe_ifdep_alloc (void *arg)
+{
+  struct nhe_ifdep *key = arg;
+  struct nhe_ifdep *dep;
+
+  dep = XCALLOC (MTYPE_NHE_IFDEP, sizeof (struct nhe_ifdep));
+  dep->ifindex = key->ifindex;
+  dep->nhes = list_new ();
+  return dep;
+}
+
+/* Record the set among those depending on each of its gateways, or on
+ * interfaces. */
+static void
+nhe_deps_add (struct nhe *nhe)
+{
+  struct nexthop *nexthop;
+  struct route_node *rn;
+  struct prefix p;
+  struct nhe_ifdep key;
+  struct nhe_ifdep *dep;
+
+  for (nexthop = nhe->tmpl->nexthop; nexthop; nexthop = nexthop->next)
+    if (nhe_gateway (nexthop, &p))
+      {
+        rn = route_node_get (nhe_gw_table (p.family), &p);
+        if (! rn->info)
+          rn->info = list_new ();
+        else
+          route_unlock_node (rn);
+        listnode_add (rn->info, nhe);
+      }
+    else if ((key.ifindex = nhe_ifindex (nexthop)) != IFINDEX_INTERNAL)
+      {
+        dep = hash_get (nhe_ifdep_hash, &key, nhe_ifdep_alloc);
+        listnode_add (dep->nhes, nhe);
+      }
+    else if (nexthop->type != NEXTHOP_TYPE_BLACKHOLE
+             && ! CHECK_FLAG (nhe->status, NHE_INTERFACE))
+      {
+        SET_FLAG (nhe->status, NHE_INTERFACE);
+        listnode_add (nhe_if_list, nhe);
+      }
+}
+
+static void
+nhe_deps_del (struct nhe *nhe)
+{
+  struct nexthop *nexthop;
+  struct route_node *rn;
+  struct prefix p;
+  struct nhe_ifdep key;
+  struct nhe_ifdep *dep;
+
+  for (nexthop = nhe->tmpl->nexthop; nexthop; nexthop = nexthop->next)
+    if (nhe_gateway (nexthop, &p))
+      {
+        if ((rn = route_node_lookup (nhe_gw_table (p.family), &p)) == NULL)
+          continue;
+        listnode_delete (rn->info, nhe);
+        if (listcount ((struct list *) rn->info) == 0)
+          {
+            list_delete (rn->info);
+            rn->info = NULL;
+            route_unlock_node (rn);
+          }
+        route_unlock_node (rn);
+      }
+    else if ((key.ifindex = nhe_ifindex (nexthop)) != IFINDEX_INTERNAL
+             && (dep = hash_lookup (nhe_ifdep_hash, &key)) != NULL)
+      {
+        listnode_delete (dep->nhes, nhe);
+        if (list_isempty (dep->nhes))
+          {
+            hash_release (nhe_ifdep_hash, dep);
+            list_delete (dep->nhes);
+            XFREE (MTYPE_NHE_IFDEP, dep);
+          }
+      }
+
+  if (CHECK_FLAG (nhe->status, NHE_INTERFACE))
+    listnode_delete (nhe_if_list, nhe);
+}
+
+static void *
+nhe_hash_alloc (void *arg)
+{
+  struct nhe *key = arg;
+  struct nhe *nhe;
+
+  nhe = XCALLOC (MTYPE_NHE, sizeof (struct nhe));
+  nhe->tmpl = XCALLOC (MTYPE_RIB, sizeof (struct rib));
+  nhe->tmpl->flags = NHE_FLAGS (key->tmpl);
+  rib_nhg_copy_nexthops (nhe->tmpl, key->tmpl);
+  SET_FLAG (nhe->status, NHE_STALE);
+  nhe_deps_add (nhe);
+  return nhe;
+}
+
+static void
+nhe_free (struct nhe *nhe)
+{
+  hash_release (nhe_hash, nhe);
+  nhe_deps_del (nhe);
+  rib_nhg_copy_nexthops (nhe->tmpl, NULL);
+  XFREE (MTYPE_RIB, nhe->tmpl);
+  XFREE (MTYPE_NHE, nhe);
+}
+
+/* A route covering one of its gateways may not resolve it through itself,
+ * which a resolution made on behalf of all routes does not account for. */
+static int
+nhe_covers_gateway (struct route_node *rn, struct rib *rib)
+{
+  struct nexthop *nexthop;
+  struct prefix p;
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    if (nhe_gateway (nexthop, &p) && prefix_match (&rn->p, &p))
+      return 1;
+  return 0;
+}
+
+/* Make a RIB entry use the interned set of its nexthops, which may have
+ * changed since it joined its current one. */
+static struct nhe *
+nhe_ref_get (struct route_node *rn, struct rib *rib)
+{
+  struct nhe_ref *ref = &rib->nhe_ref;
+  struct nhe key;
+  struct nhe *nhe;
+
+  if (ref->nhe && ref->rn == rn && nhe_same (ref->nhe->tmpl, rib))
+    return ref->nhe;
+  nhe_release (rib);
+
+  key.tmpl = rib;
+  nhe = hash_get (nhe_hash, &key, nhe_hash_alloc);
+
+  ref->nhe = nhe;
+  ref->rn = rn;
+  if (nhe_covers_gateway (rn, rib))
+    SET_FLAG (rib->status, RIB_ENTRY_NHE_OWN);
+  else
+    UNSET_FLAG (rib->status, RIB_ENTRY_NHE_OWN);
+  ref->next = nhe->refs;
+  if (nhe->refs)
+    nhe->refs->prev = ref;
+  nhe->refs = ref;
+  nhe->refcnt++;
+
+  return nhe;
+}
+
+/* Find the interned set of the nexthops of a RIB entry, resolving it
+ * unless its resolution is still valid.  Returns NULL if the entry is to
+ * resolve its nexthops itself. */
+struct nhe *
+nhe_resolve (struct route_node *rn, struct rib *rib)
+{
+  struct nhe *nhe;
+
+  if (! rib->nexthop)
+    {
+      nhe_release (rib);
+      return NULL;
+    }
+
+  nhe = nhe_ref_get (rn, rib);
+  if (CHECK_FLAG (rib->status, RIB_ENTRY_NHE_OWN))
+    return NULL;
+
+  if (CHECK_FLAG (nhe->status, NHE_STALE))
+    {
+      rib_nhe_resolve (nhe->tmpl);
+      UNSET_FLAG (nhe->status, NHE_STALE);
+      nhe_resolves++;
+    }
+  else
+    nhe_reuses++;
+
+  return nhe;
+}
+
+/* Drop the reference of a RIB entry to its set, if any. */
+void
+nhe_release (struct rib *rib)
+{
+  struct nhe_ref *ref = &rib->nhe_ref;
+  struct nhe *nhe = ref->nhe;
+
+  if (! nhe)
+    return;
+
+  if (ref->next)
+    ref->next->prev = ref->prev;
+  if (ref->prev)
+    ref->prev->next = ref->next;
+  else
+    nhe->refs = ref->next;
+  memset (ref, 0, sizeof (struct nhe_ref));
+  UNSET_FLAG (rib->status, RIB_ENTRY_NHE_OWN);
+
+  if (--nhe->refcnt == 0)
+    nhe_free (nhe);
+}
+
+/* The resolution of a set no longer holds: have the routes using it
+ * processed again. */
+static void
+nhe_stale (struct nhe *nhe)
+{
+  struct nhe_ref *ref;
+
+  if (CHECK_FLAG (nhe->status, NHE_STALE))
+    return;
+
+  SET_FLAG (nhe->status, NHE_STALE);
+  nhe_stales++;
+  for (ref = nhe->refs; ref; ref = ref->next)
+    {
+      rib_nhe_requeue (ref->rn);
+      nhe_requeues++;
+    }
+}
+
+/* A route able to resolve nexthops changed: the sets with a gateway it
+ * covers are to be resolved again. */
+void
+nhe_invalidate (struct prefix *p)
+{
+  struct route_table *table;
+  struct route_node *top, *rn;
+  struct listnode *node;
+  struct nhe *nhe;
+
+  if (p->family != AF_INET && p->family != AF_INET6)
+    return;
+
+  table = nhe_gw_table (p->family);
+  top = route_node_get (table, p);
+  for (rn = top; rn; rn = route_next_until (rn, top))
+    if (rn->info)
+      for (ALL_LIST_ELEMENTS_RO ((struct list *) rn->info, node, nhe))
+        nhe_stale (nhe);
+}
+
+static void
+nhe_ifdep_stale (struct nhe_ifdep *dep)
+{
+  struct listnode *node;
+  struct nhe *nhe;
+
+  for (ALL_LIST_ELEMENTS_RO (dep->nhes, node, nhe))
+    nhe_stale (nhe);
+}
+
+static void
+nhe_ifdep_stale_iter (struct hash_backet *backet, void *arg)
+{
+  nhe_ifdep_stale (backet->data);
+}
+
+/* Interfaces changed state: the sets depending on them are to be
+ * resolved again. */
+void
+nhe_invalidate_interfaces (void)
+{
+  struct listnode *node;
+  struct nhe *nhe;
+
+  for (ALL_LIST_ELEMENTS_RO (nhe_if_list, node, nhe))
+    nhe_stale (nhe);
+  hash_iterate (nhe_ifdep_hash, nhe_ifdep_stale_iter, NULL);
+}
+
+/* An interface changed state: the sets with nexthops through it, or
+ * naming an interface, are to be resolved again. */
+void
+nhe_invalidate_interface (struct interface *ifp)
+{
+  struct listnode *node;
+  struct nhe *nhe;
+  struct nhe_ifdep key;
+  struct nhe_ifdep *dep;
+
+  for (ALL_LIST_ELEMENTS_RO (nhe_if_list, node, nhe))
+    nhe_stale (nhe);
+
+  key.ifindex = ifp->ifindex;
+  if (key.ifindex != IFINDEX_INTERNAL
+      && (dep = hash_lookup (nhe_ifdep_hash, &key)) != NULL)
+    nhe_ifdep_stale (dep);
+}
+
+static void
+nhg_show_one (struct vty *vty, struct nhg *nhg)
+{
+  struct nexthop *nexthop;
+  struct interface *ifp;
+
+  if (nhg->owner)
+    vty_out (vty, "Group %u, client %d, %lu routes%s", nhg->id,
+             ((struct zserv *) nhg->owner)->sock, nhg->refcnt, VTY_NEWLINE);
+  else
+    vty_out (vty, "Group %u, orphaned, %lu routes%s", nhg->id,
+             nhg->refcnt, VTY_NEWLINE);
+
+  for (nexthop = nhg->tmpl->nexthop; nexthop; nexthop = nexthop->next)
+    {
+      vty_out (vty, "  %c via %s",
+               CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE) ? '*' : ' ',
+               inet_ntoa (nexthop->gate.ipv4));
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE))
+        vty_out (vty, " (recursive via %s)", inet_ntoa (nexthop->rgate.ipv4));
+      else if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE)
+               && (ifp = if_lookup_by_index (nexthop->ifindex)) != NULL)
+        vty_out (vty, ", %s", ifp->name);
+      vty_out (vty, "%s", VTY_NEWLINE);
+    }
+
+  if (CHECK_FLAG (nhg->status, NHG_KERNEL))
+    {
+      ifp = if_lookup_by_index (nhg->kernel_ifindex);
+      vty_out (vty, "  kernel nexthop %u via %s, %s, %lu routes%s",
+               nhg->kernel_id, inet_ntoa (nhg->kernel_gate),
+               ifp ? ifp->name : "unknown", nhg->kernel_refcnt, VTY_NEWLINE);
+    }
+
+  vty_out (vty, "  %lu updates, %lu kernel updates, %lu routes requeued%s",
+           nhg->updates, nhg->kernel_updates, nhg->requeues, VTY_NEWLINE);
+}
+
+static void
+nhg_show_iter (struct hash_backet *backet, void *vty)
+{
+  nhg_show_one (vty, backet->data);
+}
+
+DEFUN (show_ip_nexthop_group,
+       show_ip_nexthop_group_cmd,
+       "show ip nexthop-group",
+       SHOW_STR
+       IP_STR
+       "Nexthop groups shared by client routes\n")
+{
+  vty_out (vty, "%lu shared nexthop sets, %lu resolutions, %lu reused%s",
+           nhe_hash->count, nhe_resolves, nhe_reuses, VTY_NEWLINE);
+  vty_out (vty, "%lu invalidated by route changes, %lu routes requeued%s",
+           nhe_stales, nhe_requeues, VTY_NEWLINE);
+  vty_out (vty, "%lu groups, %lu orphaned%s", nhg_hash->count, nhg_orphans,
+           VTY_NEWLINE);
+  hash_iterate (nhg_hash, nhg_show_iter, vty);
+  return CMD_SUCCESS;
+}
+
+void
+nhg_init (void)
+{
+  nhg_hash = hash_create (nhg_hash_key, nhg_hash_cmp);
+  nhe_hash = hash_create (nhe_hash_key, nhe_hash_cmp);
+  nhe_gw_table4 = route_table_init ();
+  nhe_gw_table6 = route_table_init ();
+  nhe_ifdep_hash = hash_create (nhe_ifdep_key, nhe_ifdep_cmp);
+  nhe_if_list = list_new ();
+
+  install_element (VIEW_NODE, &show_ip_nexthop_group_cmd);
+  install_element (ENABLE_NODE, &show_ip_nexthop_group_cmd);
+}
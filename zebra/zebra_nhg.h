@@ -0,0 +1,116 @@
+/*
+ * Shared nexthop groups for zebra.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_NHG_H
+#define _ZEBRA_NHG_H
+
+#include "if.h"
+#include "table.h"
+#include "rib.h"
+
+/* A set of nexthops defined by a client with ZEBRA_NEXTHOP_GROUP_ADD and
+ * shared by all the routes the client installs referring to its id. When
+ * the nexthops of the group resolve differently, the routes are updated
+ * together: through a single kernel nexthop object where the kernel has
+ * them, otherwise by requeueing each route for rib_process().
+ */
+struct nhg
+{
+  /* Client which defined the group, NULL once the group is orphaned. */
+  void *owner;
+  u_int32_t id;
+
+  /* Template RIB entry holding the flags and nexthops of the group. */
+  struct rib *tmpl;
+
+  /* RIB entries using the group. */
+  struct nhg_ref *refs;
+  unsigned long refcnt;
+
+  /* Kernel nexthop object and the resolved nexthop it was given. */
+  u_int32_t kernel_id;
+  struct in_addr kernel_gate;
+  unsigned int kernel_ifindex;
+  unsigned long kernel_refcnt;
+
+  u_char status;
+#define NHG_KERNEL		(1 << 0)
+#define NHG_ORPHAN		(1 << 1)
+#define NHG_KERNEL_FAILED	(1 << 2)
+
+  /* Statistics. */
+  unsigned long updates;
+  unsigned long kernel_updates;
+  unsigned long requeues;
+};
+
+/* Link of a RIB entry into the reference list of its group. */
+struct nhg_ref
+{
+  struct nhg_ref *next;
+  struct nhg_ref *prev;
+
+  struct nhg *nhg;
+  struct route_node *rn;
+  struct rib *rib;
+};
+
+/* A set of nexthops interned for all the RIB entries having the same ones,
+ * whatever their origin, so that they are resolved once for all of them.
+ * The resolution is computed on a template and holds until a route
+ * covering one of the gateways changes, or an interface the nexthops
+ * depend on does: the routes using the set are then queued for
+ * processing again.
+ */
+struct nhe
+{
+  /* Template RIB entry holding the nexthops and their resolution. */
+  struct rib *tmpl;
+
+  /* RIB entries using the set. */
+  struct nhe_ref *refs;
+  unsigned long refcnt;
+
+  u_char status;
+#define NHE_STALE		(1 << 0)
+#define NHE_INTERFACE		(1 << 1)
+};
+
+extern void nhg_init (void);
+extern struct nhg *nhg_lookup (void *, u_int32_t);
+extern void nhg_update (void *, u_int32_t, struct rib *);
+extern void nhg_delete (void *, u_int32_t);
+extern void nhg_owner_close (void *);
+
+extern void nhg_ref_add (struct nhg *, struct rib *);
+extern void nhg_ref_link (struct nhg_ref *, struct route_node *);
+extern void nhg_ref_free (struct nhg_ref *);
+
+extern u_int32_t nhg_kernel_bind (struct rib *);
+extern void nhg_kernel_unbind (struct rib *, int);
+
+extern struct nhe *nhe_resolve (struct route_node *, struct rib *);
+extern void nhe_release (struct rib *);
+extern void nhe_invalidate (struct prefix *);
+extern void nhe_invalidate_interfaces (void);
+extern void nhe_invalidate_interface (struct interface *);
+
+#endif /* _ZEBRA_NHG_H */
@@ -40,6 +40,9 @@
 #include "zebra/zserv.h"
 #include "zebra/redistribute.h"
 #include "zebra/debug.h"
+#include "zebra/zebra_nhg.h"
+#include "zebra/zebra_fibc.h"
+#include "zebra/zebra_lpm.h"
 
 /* Default rtm_table for all clients */
 extern struct zebra_t zebrad;
@@ -196,13 +199,26 @@ nexthop_delete (struct rib *rib, struct nexthop *nexthop)
   rib->nexthop_num--;
 }
 
+/* Allocate a nexthop for a RIB entry, in the entry itself if its storage
+   for the first nexthop is unused. */
+static struct nexthop *
+nexthop_new (struct rib *rib)
+{
+  if (rib->nexthop_first.type == 0)
+    return &rib->nexthop_first;
+  return XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+}
+
 /* Free nexthop. */
 static void
-nexthop_free (struct nexthop *nexthop)
+nexthop_free (struct rib *rib, struct nexthop *nexthop)
 {
   if (nexthop->ifname)
     XFREE (0, nexthop->ifname);
-  XFREE (MTYPE_NEXTHOP, nexthop);
+  if (nexthop == &rib->nexthop_first)
+    memset (nexthop, 0, sizeof (struct nexthop));
+  else
+    XFREE (MTYPE_NEXTHOP, nexthop);
 }
 
 struct nexthop *
@@ -210,7 +226,7 @@ nexthop_ifindex_add (struct rib *rib, unsigned int ifindex)
 {
   struct nexthop *nexthop;
 
-  nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+  nexthop = nexthop_new (rib);
   nexthop->type = NEXTHOP_TYPE_IFINDEX;
   nexthop->ifindex = ifindex;
 
@@ -224,7 +240,7 @@ nexthop_ifname_add (struct rib *rib, char *ifname)
 {
   struct nexthop *nexthop;
 
-  nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+  nexthop = nexthop_new (rib);
   nexthop->type = NEXTHOP_TYPE_IFNAME;
   nexthop->ifname = XSTRDUP (0, ifname);
 
@@ -238,7 +254,7 @@ nexthop_ipv4_add (struct rib *rib, struct in_addr *ipv4, struct in_addr *src)
 {
   struct nexthop *nexthop;
 
-  nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+  nexthop = nexthop_new (rib);
   nexthop->type = NEXTHOP_TYPE_IPV4;
   nexthop->gate.ipv4 = *ipv4;
   if (src)
@@ -255,7 +271,7 @@ nexthop_ipv4_ifindex_add (struct rib *rib, struct in_addr *ipv4,
 {
   struct nexthop *nexthop;
 
-  nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+  nexthop = nexthop_new (rib);
   nexthop->type = NEXTHOP_TYPE_IPV4_IFINDEX;
   nexthop->gate.ipv4 = *ipv4;
   if (src)
@@ -271,7 +287,7 @@ struct nexthop *
 nexthop_ipv4_ifindex_ol_add (struct rib *rib, const struct in_addr *ipv4,
                              const struct in_addr *src, const unsigned int ifindex)
 {
-  struct nexthop *nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+  struct nexthop *nexthop = nexthop_new (rib);
 
   nexthop->type = NEXTHOP_TYPE_IPV4_IFINDEX_OL;
   IPV4_ADDR_COPY (&nexthop->gate.ipv4, ipv4);
@@ -288,7 +304,7 @@ nexthop_ipv6_add (struct rib *rib, struct in6_addr *ipv6)
 {
   struct nexthop *nexthop;
 
-  nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+  nexthop = nexthop_new (rib);
   nexthop->type = NEXTHOP_TYPE_IPV6;
   nexthop->gate.ipv6 = *ipv6;
 
@@ -303,7 +319,7 @@ nexthop_ipv6_ifname_add (struct rib *rib, struct in6_addr *ipv6,
 {
   struct nexthop *nexthop;
 
-  nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+  nexthop = nexthop_new (rib);
   nexthop->type = NEXTHOP_TYPE_IPV6_IFNAME;
   nexthop->gate.ipv6 = *ipv6;
   nexthop->ifname = XSTRDUP (0, ifname);
@@ -319,7 +335,7 @@ nexthop_ipv6_ifindex_add (struct rib *rib, struct in6_addr *ipv6,
 {
   struct nexthop *nexthop;
 
-  nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+  nexthop = nexthop_new (rib);
   nexthop->type = NEXTHOP_TYPE_IPV6_IFINDEX;
   nexthop->gate.ipv6 = *ipv6;
   nexthop->ifindex = ifindex;
@@ -335,7 +351,7 @@ nexthop_blackhole_add (struct rib *rib)
 {
   struct nexthop *nexthop;
 
-  nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+  nexthop = nexthop_new (rib);
   nexthop->type = NEXTHOP_TYPE_BLACKHOLE;
 
   nexthop_add (rib, nexthop);
@@ -425,8 +441,11 @@ nexthop_active_ipv4 (struct rib *rib, struct nexthop *nexthop, int set,
 			if (newhop->type == NEXTHOP_TYPE_IPV4 ||
 			    newhop->type == NEXTHOP_TYPE_IPV4_IFINDEX)
 			  nexthop->rgate.ipv4 = newhop->gate.ipv4;
+			/* The interface of a plain gateway is kept as well,
+			   kernel nexthop objects need it. */
 			if (newhop->type == NEXTHOP_TYPE_IFINDEX
 			    || newhop->type == NEXTHOP_TYPE_IFNAME
+			    || newhop->type == NEXTHOP_TYPE_IPV4
 			    || newhop->type == NEXTHOP_TYPE_IPV4_IFINDEX)
 			  nexthop->rifindex = newhop->ifindex;
 		      }
@@ -567,7 +586,16 @@ rib_match_ipv4 (struct in_addr addr)
   p.prefixlen = IPV4_MAX_PREFIXLEN;
   p.prefix = addr;
 
-  rn = route_node_match (table, (struct prefix *) &p);
+  /* The lookup table holds the node the walk below would stop at. */
+  if (lpm_active ())
+    {
+      rn = lpm_match (&addr);
+      if (! rn)
+	return NULL;
+      route_lock_node (rn);
+    }
+  else
+    rn = route_node_match (table, (struct prefix *) &p);
 
   while (rn)
     {
@@ -793,30 +821,70 @@ rib_match_ipv6 (struct in6_addr *addr)
 }
 #endif /* HAVE_IPV6 */
 
-#define RIB_SYSTEM_ROUTE(R) \
-        ((R)->type == ZEBRA_ROUTE_KERNEL || (R)->type == ZEBRA_ROUTE_CONNECT)
-
-/* This function verifies reachability of one given nexthop, which can be
- * numbered or unnumbered, IPv4 or IPv6. The result is unconditionally stored
- * in nexthop->flags field. If the 4th parameter, 'set', is non-zero,
- * nexthop->ifindex will be updated appropriately as well.
- * An existing route map can turn (otherwise active) nexthop into inactive, but
- * not vice versa.
- *
- * The return value is the final value of 'ACTIVE' flag.
+/* Apply the protocol route-map, if any, to a nexthop of a RIB entry once
+ * its reachability is known.  Returns the final value of the ACTIVE flag.
  */
-
 static unsigned
-nexthop_active_check (struct route_node *rn, struct rib *rib,
-		      struct nexthop *nexthop, int set)
+nexthop_active_filter (struct route_node *rn, struct rib *rib,
+		       struct nexthop *nexthop, int family)
 {
-  struct interface *ifp;
   route_map_result_t ret = RMAP_MATCH;
   extern char *proto_rm[AFI_MAX][ZEBRA_ROUTE_MAX+1];
   struct route_map *rmap;
-  int family;
 
-  family = 0;
+  if (! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+    return 0;
+
+  if (RIB_SYSTEM_ROUTE(rib) ||
+      (family == AFI_IP && rn->p.family != AF_INET) ||
+      (family == AFI_IP6 && rn->p.family != AF_INET6))
+    return CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+
+  rmap = 0;
+  if (rib->type >= 0 && rib->type < ZEBRA_ROUTE_MAX &&
+        	proto_rm[family][rib->type])
+    rmap = route_map_lookup_by_name (proto_rm[family][rib->type]);
+  if (!rmap && proto_rm[family][ZEBRA_ROUTE_MAX])
+    rmap = route_map_lookup_by_name (proto_rm[family][ZEBRA_ROUTE_MAX]);
+  if (rmap) {
+      ret = route_map_apply(rmap, &rn->p, RMAP_ZEBRA, nexthop);
+  }
+
+  if (ret == RMAP_DENYMATCH)
+    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+  return CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+}
+
+/* Address family of the protocol route-maps applying to a nexthop. */
+static int
+nexthop_rmap_family (struct nexthop *nexthop)
+{
+  switch (nexthop->type)
+    {
+    case NEXTHOP_TYPE_IPV4:
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+      return AFI_IP;
+    case NEXTHOP_TYPE_IPV6_IFNAME:
+#ifdef HAVE_IPV6
+    case NEXTHOP_TYPE_IPV6:
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+#endif /* HAVE_IPV6 */
+      return AFI_IP6;
+    default:
+      return 0;
+    }
+}
+
+/* Verify the reachability of one nexthop of a RIB entry, leaving aside
+ * the protocol route-maps, and store the result in nexthop->flags.  The
+ * route node of the entry, if given, may not be resolved through.
+ */
+static void
+nexthop_active_resolve (struct route_node *top, struct rib *rib,
+			struct nexthop *nexthop, int set)
+{
+  struct interface *ifp;
+
   switch (nexthop->type)
     {
     case NEXTHOP_TYPE_IFINDEX:
@@ -828,7 +896,6 @@ nexthop_active_check (struct route_node *rn, struct rib *rib,
 	UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
       break;
     case NEXTHOP_TYPE_IPV6_IFNAME:
-      family = AFI_IP6;
     case NEXTHOP_TYPE_IFNAME:
       ifp = if_lookup_by_name (nexthop->ifname);
       if (ifp && if_is_operative(ifp))
@@ -846,22 +913,19 @@ nexthop_active_check (struct route_node *rn, struct rib *rib,
       break;
     case NEXTHOP_TYPE_IPV4:
     case NEXTHOP_TYPE_IPV4_IFINDEX:
-      family = AFI_IP;
-      if (nexthop_active_ipv4 (rib, nexthop, set, rn))
+      if (nexthop_active_ipv4 (rib, nexthop, set, top))
 	SET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
       else
 	UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
       break;
 #ifdef HAVE_IPV6
     case NEXTHOP_TYPE_IPV6:
-      family = AFI_IP6;
-      if (nexthop_active_ipv6 (rib, nexthop, set, rn))
+      if (nexthop_active_ipv6 (rib, nexthop, set, top))
 	SET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
       else
 	UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
       break;
     case NEXTHOP_TYPE_IPV6_IFINDEX:
-      family = AFI_IP6;
       if (IN6_IS_ADDR_LINKLOCAL (&nexthop->gate.ipv6))
 	{
 	  ifp = if_lookup_by_index (nexthop->ifindex);
@@ -872,7 +936,7 @@ nexthop_active_check (struct route_node *rn, struct rib *rib,
 	}
       else
 	{
-	  if (nexthop_active_ipv6 (rib, nexthop, set, rn))
+	  if (nexthop_active_ipv6 (rib, nexthop, set, top))
 	    SET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
 	  else
 	    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
@@ -885,27 +949,84 @@ nexthop_active_check (struct route_node *rn, struct rib *rib,
     default:
       break;
     }
-  if (! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
-    return 0;
+}
 
-  if (RIB_SYSTEM_ROUTE(rib) ||
-      (family == AFI_IP && rn->p.family != AF_INET) ||
-      (family == AFI_IP6 && rn->p.family != AF_INET6))
-    return CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+/* This function verifies reachability of one given nexthop, which can be
+ * numbered or unnumbered, IPv4 or IPv6. The result is unconditionally stored
+ * in nexthop->flags field. If the 4th parameter, 'set', is non-zero,
+ * nexthop->ifindex will be updated appropriately as well.
+ * An existing route map can turn (otherwise active) nexthop into inactive, but
+ * not vice versa.
+ *
+ * The return value is the final value of 'ACTIVE' flag.
+ */
 
-  rmap = 0;
-  if (rib->type >= 0 && rib->type < ZEBRA_ROUTE_MAX &&
-        	proto_rm[family][rib->type])
-    rmap = route_map_lookup_by_name (proto_rm[family][rib->type]);
-  if (!rmap && proto_rm[family][ZEBRA_ROUTE_MAX])
-    rmap = route_map_lookup_by_name (proto_rm[family][ZEBRA_ROUTE_MAX]);
-  if (rmap) {
-      ret = route_map_apply(rmap, &rn->p, RMAP_ZEBRA, nexthop);
-  }
+static unsigned
+nexthop_active_check (struct route_node *rn, struct rib *rib,
+		      struct nexthop *nexthop, int set)
+{
+  nexthop_active_resolve (rn, rib, nexthop, set);
+  return nexthop_active_filter (rn, rib, nexthop,
+				nexthop_rmap_family (nexthop));
+}
 
-  if (ret == RMAP_DENYMATCH)
+/* Same as nexthop_active_check(), for a nexthop of a RIB entry the
+ * interned nexthop set of which was resolved already: the result is taken
+ * from the matching nexthop of the set template.
+ */
+static unsigned
+nexthop_active_copy (struct route_node *rn, struct rib *rib,
+		     struct nexthop *nexthop, struct nexthop *from, int set)
+{
+  switch (nexthop->type)
+    {
+    case NEXTHOP_TYPE_IPV4:
+    case NEXTHOP_TYPE_IPV6:
+      nexthop->ifindex = from->ifindex;
+      break;
+    case NEXTHOP_TYPE_IFNAME:
+    case NEXTHOP_TYPE_IPV6_IFNAME:
+      if (set)
+	nexthop->ifindex = from->ifindex;
+      break;
+    default:
+      break;
+    }
+
+  if (set)
+    {
+      if (CHECK_FLAG (from->flags, NEXTHOP_FLAG_RECURSIVE))
+	SET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+      else
+	UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+      nexthop->rtype = from->rtype;
+      nexthop->rgate = from->rgate;
+      nexthop->rifindex = from->rifindex;
+    }
+
+  if (CHECK_FLAG (from->flags, NEXTHOP_FLAG_ACTIVE))
+    SET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+  else
     UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
-  return CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+
+  return nexthop_active_filter (rn, rib, nexthop,
+				nexthop_rmap_family (nexthop));
+}
+
+/* Whether a nexthop installed recursively now resolves otherwise than
+ * the matching nexthop of its set template.
+ */
+static int
+nexthop_recursion_changed (struct nexthop *nexthop, struct nexthop *from)
+{
+  if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+      != CHECK_FLAG (from->flags, NEXTHOP_FLAG_RECURSIVE))
+    return 1;
+  if (! CHECK_FLAG (from->flags, NEXTHOP_FLAG_RECURSIVE))
+    return 0;
+  return nexthop->rtype != from->rtype
+    || memcmp (&nexthop->rgate, &from->rgate, sizeof (union g_addr)) != 0
+    || nexthop->rifindex != from->rifindex;
 }
 
 /* Iterate over all nexthops of the given RIB entry and refresh their
@@ -921,16 +1042,32 @@ static int
 nexthop_active_update (struct route_node *rn, struct rib *rib, int set)
 {
   struct nexthop *nexthop;
+  struct nexthop *from = NULL;
+  struct nhe *nhe;
   unsigned int prev_active, prev_index, new_active;
 
   rib->nexthop_active_num = 0;
   UNSET_FLAG (rib->flags, ZEBRA_FLAG_CHANGED);
 
+  /* Routes with the same gateways share their resolution. */
+  nhe = nhe_resolve (rn, rib);
+  if (nhe)
+    from = nhe->tmpl->nexthop;
+
   for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
   {
     prev_active = CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
     prev_index = nexthop->ifindex;
-    if ((new_active = nexthop_active_check (rn, rib, nexthop, set)))
+    if (from)
+      {
+	if (nexthop_recursion_changed (nexthop, from))
+	  SET_FLAG (rib->flags, ZEBRA_FLAG_CHANGED);
+	new_active = nexthop_active_copy (rn, rib, nexthop, from, set);
+	from = from->next;
+      }
+    else
+      new_active = nexthop_active_check (rn, rib, nexthop, set);
+    if (new_active)
       rib->nexthop_active_num++;
     if (prev_active != new_active ||
 	prev_index != nexthop->ifindex)
@@ -940,6 +1077,19 @@ nexthop_active_update (struct route_node *rn, struct rib *rib, int set)
 }
 
 
+/* Only routes other than BGP ones resolve the nexthops of others, see
+ * nexthop_active_ipv4(): the shared resolutions of the nexthop sets with
+ * a gateway covered by such a route no longer hold once it is selected,
+ * unselected, installed or withdrawn.  The lookup table follows the same
+ * changes for rib_match_ipv4().
+ */
+static void
+rib_resolver_changed (struct route_node *rn, struct rib *rib)
+{
+  if (rib->type != ZEBRA_ROUTE_BGP)
+    nhe_invalidate (&rn->p);
+  lpm_update (rn);
+}
 
 static void
 rib_install_kernel (struct route_node *rn, struct rib *rib)
@@ -947,6 +1097,19 @@ rib_install_kernel (struct route_node *rn, struct rib *rib)
   int ret = 0;
   struct nexthop *nexthop;
 
+  rib_resolver_changed (rn, rib);
+
+  /* Left out of the kernel, which forwards the same way without it. */
+  if (fibc_covered (rn, rib))
+    {
+      for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+	if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+	  SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+      SET_FLAG (rib->status, RIB_ENTRY_FIB_SUPPRESSED);
+      fibc_suppressed++;
+      return;
+    }
+
   switch (PREFIX_FAMILY (&rn->p))
     {
     case AF_INET:
@@ -967,6 +1130,35 @@ rib_install_kernel (struct route_node *rn, struct rib *rib)
     }
 }
 
+/* Install the route in the kernel in place of OLD, which is already
+ * there. */
+static void
+rib_replace_kernel (struct route_node *rn, struct rib *old, struct rib *rib)
+{
+  int ret = 0;
+  struct nexthop *nexthop;
+
+  rib_resolver_changed (rn, rib);
+
+  switch (PREFIX_FAMILY (&rn->p))
+    {
+    case AF_INET:
+      ret = kernel_replace_ipv4 (&rn->p, old, rib);
+      break;
+#ifdef HAVE_IPV6
+    case AF_INET6:
+      ret = kernel_replace_ipv6 (&rn->p, old, rib);
+      break;
+#endif /* HAVE_IPV6 */
+    }
+
+  if (ret < 0)
+    {
+      for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+	UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+    }
+}
+
 /* Uninstall the route from kernel. */
 static int
 rib_uninstall_kernel (struct route_node *rn, struct rib *rib)
@@ -974,6 +1166,16 @@ rib_uninstall_kernel (struct route_node *rn, struct rib *rib)
   int ret = 0;
   struct nexthop *nexthop;
 
+  rib_resolver_changed (rn, rib);
+
+  if (CHECK_FLAG (rib->status, RIB_ENTRY_FIB_SUPPRESSED))
+    {
+      UNSET_FLAG (rib->status, RIB_ENTRY_FIB_SUPPRESSED);
+      for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+	UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+      return 0;
+    }
+
   switch (PREFIX_FAMILY (&rn->p))
     {
     case AF_INET:
@@ -992,6 +1194,83 @@ rib_uninstall_kernel (struct route_node *rn, struct rib *rib)
   return ret;
 }
 
+/* The route covering the selected entry RIB of RN changed: install or
+ * withdraw it if it no longer forwards like the kernel would in its place.
+ */
+void
+rib_fibc_refresh (struct route_node *rn, struct rib *rib)
+{
+  struct nexthop *nexthop;
+  int covered = fibc_covered (rn, rib);
+
+  if (CHECK_FLAG (rib->status, RIB_ENTRY_FIB_SUPPRESSED))
+    {
+      if (covered)
+	return;
+      UNSET_FLAG (rib->status, RIB_ENTRY_FIB_SUPPRESSED);
+      fibc_restored++;
+      rib_install_kernel (rn, rib);
+      return;
+    }
+
+  if (! covered)
+    return;
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB))
+      break;
+  /* A route the kernel refused is left out as well. */
+  if (nexthop)
+    rib_uninstall_kernel (rn, rib);
+  rib_install_kernel (rn, rib);
+}
+
+/* The kernel refused a route queued by rib_install_kernel(), which
+ * returned before knowing.  The entry is looked up again by prefix and
+ * the sequence number of the update: it may have been replaced or
+ * removed in the meantime. */
+void
+rib_kernel_failed (struct prefix *p, struct rib *rib, u_int32_t seq)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  struct rib *cur;
+  struct nexthop *nexthop;
+  safi_t safi;
+
+  for (safi = SAFI_UNICAST; safi <= SAFI_MULTICAST; safi++)
+    {
+      table = vrf_table (family2afi (p->family), safi, 0);
+      if (! table || ! (rn = route_node_lookup (table, p)))
+        continue;
+
+      for (cur = rn->info; cur; cur = cur->next)
+        if (cur == rib && cur->kernel_seq == seq)
+          break;
+      if (! cur)
+        {
+          route_unlock_node (rn);
+          continue;
+        }
+
+      for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+        UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+      rib_resolver_changed (rn, rib);
+      fibc_update (rn);
+
+      /* A route installed through a nexthop group is retried with its own
+         nexthops. */
+      if (CHECK_FLAG (rib->status, RIB_ENTRY_NHG_FIB))
+        {
+          nhg_kernel_unbind (rib, 1);
+          if (! CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+            rib_nhg_requeue (rn, rib, NULL);
+        }
+
+      route_unlock_node (rn);
+      return;
+    }
+}
+
 /* Uninstall the route from kernel. */
 static void
 rib_uninstall (struct route_node *rn, struct rib *rib)
@@ -1002,11 +1281,154 @@ rib_uninstall (struct route_node *rn, struct rib *rib)
       if (! RIB_SYSTEM_ROUTE (rib))
 	rib_uninstall_kernel (rn, rib);
       UNSET_FLAG (rib->flags, ZEBRA_FLAG_SELECTED);
+      rib_resolver_changed (rn, rib);
     }
 }
 
 static void rib_unlink (struct route_node *, struct rib *);
 
+/* Reconciliation of the routes left in the kernel by a previous run. */
+static struct
+{
+  /* Routes read from the kernel and retained, still retained. */
+  unsigned long retained;
+  unsigned long pending;
+
+  /* Retained routes installed again the same and left untouched,
+     installed again differently, and swept for not being installed
+     again in time. */
+  unsigned long kept;
+  unsigned long replaced;
+  unsigned long swept;
+
+  int time;
+  struct thread *t_sweep;
+} rib_retain;
+
+/* Whether a route retained in the kernel is what installing the nexthop
+ * of the selected route would make it.  Retained routes are read with a
+ * single nexthop, so that only single path routes may match.
+ */
+static int
+rib_retained_same (struct route_node *rn, struct rib *retained,
+                   struct rib *select)
+{
+  struct nexthop *kernel = retained->nexthop;
+  struct nexthop *nexthop, *found = NULL;
+  union g_addr *gate;
+  unsigned int ifindex;
+  u_char type;
+  int kernel_gate, select_gate;
+
+  if (! kernel || kernel->next)
+    return 0;
+  /* Routes of table 0 are installed in the main table. */
+  if (retained->metric != select->metric
+      || retained->table != (select->table ? select->table : RT_TABLE_MAIN))
+    return 0;
+  if (CHECK_FLAG (select->flags, ZEBRA_FLAG_BLACKHOLE | ZEBRA_FLAG_REJECT))
+    return 0;
+  /* Installing the route binds it to the kernel nexthop object. */
+  if (select->nhg_ref)
+    return 0;
+
+  for (nexthop = select->nexthop; nexthop; nexthop = nexthop->next)
+    if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+      {
+        if (found)
+          return 0;
+        found = nexthop;
+      }
+  if (! found)
+    return 0;
+
+  if (CHECK_FLAG (found->flags, NEXTHOP_FLAG_RECURSIVE))
+    {
+      type = found->rtype;
+      gate = &found->rgate;
+      ifindex = found->rifindex;
+    }
+  else
+    {
+      type = found->type;
+      gate = &found->gate;
+      ifindex = found->ifindex;
+    }
+
+  if (rn->p.family == AF_INET)
+    {
+      select_gate = (type == NEXTHOP_TYPE_IPV4
+                     || type == NEXTHOP_TYPE_IPV4_IFINDEX
+                     || type == NEXTHOP_TYPE_IPV4_IFINDEX_OL);
+      kernel_gate = (kernel->type == NEXTHOP_TYPE_IPV4
+                     || kernel->type == NEXTHOP_TYPE_IPV4_IFINDEX);
+      if (select_gate != kernel_gate
+          || (select_gate
+              && ! IPV4_ADDR_SAME (&gate->ipv4, &kernel->gate.ipv4))
+          || ! IPV4_ADDR_SAME (&found->src.ipv4, &kernel->src.ipv4))
+        return 0;
+    }
+#ifdef HAVE_IPV6
+  else
+    {
+      select_gate = (type == NEXTHOP_TYPE_IPV6
+                     || type == NEXTHOP_TYPE_IPV6_IFINDEX
+                     || type == NEXTHOP_TYPE_IPV6_IFNAME);
+      kernel_gate = (kernel->type == NEXTHOP_TYPE_IPV6
+                     || kernel->type == NEXTHOP_TYPE_IPV6_IFINDEX);
+      if (select_gate != kernel_gate
+          || (select_gate
+              && ! IPV6_ADDR_SAME (&gate->ipv6, &kernel->gate.ipv6)))
+        return 0;
+    }
+#endif /* HAVE_IPV6 */
+
+  return ifindex == kernel->ifindex;
+}
+
+/* Reconcile a route retained in the kernel with the route selected in its
+ * place, and return 1 if the kernel is up to date.  A retained route which
+ * differs is replaced by the selected one in a single change, so that the
+ * prefix keeps forwarding, unless the selected one is left out of the
+ * kernel: it is then withdrawn, the covering route forwarding the same.
+ */
+static int
+rib_retained_adopt (struct route_node *rn, struct rib *select)
+{
+  struct rib *rib;
+  struct nexthop *nexthop;
+
+  for (rib = rn->info; rib; rib = rib->next)
+    if (CHECK_FLAG (rib->status, RIB_ENTRY_RETAINED)
+        && ! CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+      break;
+  if (! rib)
+    return 0;
+
+  if (rib_retained_same (rn, rib, select) && ! fibc_covered (rn, select))
+    {
+      for (nexthop = select->nexthop; nexthop; nexthop = nexthop->next)
+        if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+          SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+      rib_resolver_changed (rn, select);
+      rib_retain.kept++;
+      rib_unlink (rn, rib);
+      return 1;
+    }
+
+  rib_retain.replaced++;
+  if (fibc_covered (rn, select))
+    {
+      rib_uninstall_kernel (rn, rib);
+      rib_unlink (rn, rib);
+      return 0;
+    }
+
+  rib_replace_kernel (rn, rib, select);
+  rib_unlink (rn, rib);
+  return 1;
+}
+
 /* Core function for processing routing information base. */
 static void
 rib_process (struct route_node *rn)
@@ -1057,6 +1479,11 @@ rib_process (struct route_node *rn)
           continue;
         }
       
+      /* Routes retained from a previous run are never selected, the
+         route installed again in their place adopts them. */
+      if (CHECK_FLAG (rib->status, RIB_ENTRY_RETAINED))
+        continue;
+
       /* Skip unreachable nexthop. */
       if (! nexthop_active_update (rn, rib, 0))
         continue;
@@ -1121,7 +1548,8 @@ rib_process (struct route_node *rn)
       if (IS_ZEBRA_DEBUG_RIB)
         zlog_debug ("%s: %s/%d: Updating existing route, select %p, fib %p",
                      __func__, buf, rn->p.prefixlen, select, fib);
-      if (CHECK_FLAG (select->flags, ZEBRA_FLAG_CHANGED))
+      if (CHECK_FLAG (select->flags, ZEBRA_FLAG_CHANGED)
+          || CHECK_FLAG (select->status, RIB_ENTRY_NHG_CHANGED))
         {
           redistribute_delete (&rn->p, select);
           if (! RIB_SYSTEM_ROUTE (select))
@@ -1133,6 +1561,7 @@ rib_process (struct route_node *rn)
           if (! RIB_SYSTEM_ROUTE (select))
             rib_install_kernel (rn, select);
           redistribute_add (&rn->p, select);
+          fibc_update (rn);
         }
       else if (! RIB_SYSTEM_ROUTE (select))
         {
@@ -1150,7 +1579,10 @@ rib_process (struct route_node *rn)
               break;
             }
           if (! installed) 
-            rib_install_kernel (rn, select);
+            {
+              rib_install_kernel (rn, select);
+              fibc_update (rn);
+            }
         }
       goto end;
     }
@@ -1168,6 +1600,7 @@ rib_process (struct route_node *rn)
       if (! RIB_SYSTEM_ROUTE (fib))
 	rib_uninstall_kernel (rn, fib);
       UNSET_FLAG (fib->flags, ZEBRA_FLAG_SELECTED);
+      rib_resolver_changed (rn, fib);
 
       /* Set real nexthop. */
       nexthop_active_update (rn, fib, 1);
@@ -1185,12 +1618,17 @@ rib_process (struct route_node *rn)
       /* Set real nexthop. */
       nexthop_active_update (rn, select, 1);
 
-      if (! RIB_SYSTEM_ROUTE (select))
+      if (! RIB_SYSTEM_ROUTE (select) && ! rib_retained_adopt (rn, select))
         rib_install_kernel (rn, select);
       SET_FLAG (select->flags, ZEBRA_FLAG_SELECTED);
+      rib_resolver_changed (rn, select);
       redistribute_add (&rn->p, select);
     }
 
+  /* The routes this one covers may have to be installed or withdrawn. */
+  if (fib || select)
+    fibc_update (rn);
+
   /* FIB route was removed, should be deleted */
   if (del)
     {
@@ -1201,24 +1639,43 @@ rib_process (struct route_node *rn)
     }
 
 end:
+  for (rib = rn->info; rib; rib = rib->next)
+    UNSET_FLAG (rib->status, RIB_ENTRY_NHG_CHANGED);
+
   if (IS_ZEBRA_DEBUG_RIB_Q)
     zlog_debug ("%s: %s/%d: rn %p dequeued", __func__, buf, rn->p.prefixlen, rn);
 }
 
-/* Take a list of route_node structs and return 1, if there was a record
- * picked from it and processed by rib_process(). Don't process more, 
- * than one RN record; operate only in the specified sub-queue.
+/* Weight of each sub-queue in the round-robin: the number of nodes it
+ * may have processed in a row while the others are waiting. */
+static const u_int32_t meta_queue_weight[MQ_SIZE] = { 16, 8, 8, 2, 1 };
+
+/* Time a node may wait in one of the first MQ_DEADLINE_SIZE sub-queues
+ * before it is processed ahead of its turn, in milliseconds. */
+#define MQ_DEADLINE 50
+
+static const char *meta_queue_name[MQ_SIZE] =
+  { "connected", "static", "IGP", "BGP", "other" };
+
+static unsigned long
+meta_queue_wait (struct meta_queue_item *item, struct timeval *now)
+{
+  return (now->tv_sec - item->queued.tv_sec) * 1000
+         + (now->tv_usec - item->queued.tv_usec) / 1000;
+}
+
+/* Take the oldest route_node queued in the sub-queue, process it with
+ * rib_process() and update the statistics of the sub-queue.
  */
-static unsigned int
-process_subq (struct list * subq, u_char qindex)
+static void
+process_subq (struct meta_queue *mq, u_char qindex, struct timeval *now)
 {
+  struct list *subq = mq->subq[qindex];
   struct listnode *lnode  = listhead (subq);
-  struct route_node *rnode;
+  struct meta_queue_item *item = listgetdata (lnode);
+  struct route_node *rnode = item->rn;
+  unsigned long wait;
 
-  if (!lnode)
-    return 0;
-
-  rnode = listgetdata (lnode);
   rib_process (rnode);
 
   if (rnode->info) /* The first RIB record is holding the flags bitmask. */
@@ -1231,27 +1688,62 @@ process_subq (struct list * subq, u_char qindex)
       zlog_backtrace(LOG_DEBUG);
     }
 #endif
+  wait = meta_queue_wait (item, now);
+  mq->stats[qindex].processed++;
+  mq->stats[qindex].latency_total += wait;
+  if (wait > mq->stats[qindex].latency_max)
+    mq->stats[qindex].latency_max = wait;
+
   route_unlock_node (rnode);
   list_delete_node (subq, lnode);
-  return 1;
+  XFREE (MTYPE_RIB_QUEUE, item);
+}
+
+/* Pick the sub-queue to process the next node from: one of the first
+ * MQ_DEADLINE_SIZE sub-queues if its oldest node is past the deadline,
+ * else the sub-queue whose turn it is in the round-robin.
+ */
+static u_char
+meta_queue_pick (struct meta_queue *mq, struct timeval *now)
+{
+  u_char i;
+
+  for (i = 0; i < MQ_DEADLINE_SIZE; i++)
+    if (listcount (mq->subq[i])
+        && meta_queue_wait (listgetdata (listhead (mq->subq[i])), now)
+           >= MQ_DEADLINE)
+      {
+        if (i != mq->current)
+          mq->stats[i].deadline++;
+        return i;
+      }
+
+  while (! mq->credit || ! listcount (mq->subq[mq->current]))
+    {
+      mq->current = (mq->current + 1) % MQ_SIZE;
+      mq->credit = meta_queue_weight[mq->current];
+    }
+  mq->credit--;
+  return mq->current;
 }
 
-/* Dispatch the meta queue by picking, processing and unlocking the next RN from
- * a non-empty sub-queue with lowest priority. wq is equal to zebra->ribq and data
- * is pointed to the meta queue structure.
+/* Dispatch the meta queue by processing one RN from the sub-queue picked
+ * by meta_queue_pick(). wq is equal to zebra->ribq and data is pointed to
+ * the meta queue structure.
  */
 static wq_item_status
 meta_queue_process (struct work_queue *dummy, void *data)
 {
   struct meta_queue * mq = data;
-  unsigned i;
+  struct timeval now;
+
+  if (! mq->size)
+    return WQ_SUCCESS;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  process_subq (mq, meta_queue_pick (mq, &now), &now);
+  mq->size--;
 
-  for (i = 0; i < MQ_SIZE; i++)
-    if (process_subq (mq->subq[i], i))
-      {
-	mq->size--;
-	break;
-      }
   return mq->size ? WQ_REQUEUE : WQ_SUCCESS;
 }
 
@@ -1278,6 +1770,7 @@ static void
 rib_meta_queue_add (struct meta_queue *mq, struct route_node *rn)
 {
   struct rib *rib;
+  struct meta_queue_item *item;
   char buf[INET6_ADDRSTRLEN];
 
   if (IS_ZEBRA_DEBUG_RIB_Q)
@@ -1297,10 +1790,17 @@ rib_meta_queue_add (struct meta_queue *mq, struct route_node *rn)
 	}
 
       SET_FLAG (((struct rib *)rn->info)->rn_status, RIB_ROUTE_QUEUED(qindex));
-      listnode_add (mq->subq[qindex], rn);
+      item = XMALLOC (MTYPE_RIB_QUEUE, sizeof (struct meta_queue_item));
+      item->rn = rn;
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &item->queued);
+      listnode_add (mq->subq[qindex], item);
       route_lock_node (rn);
       mq->size++;
 
+      mq->stats[qindex].queued++;
+      if (listcount (mq->subq[qindex]) > mq->stats[qindex].max_backlog)
+        mq->stats[qindex].max_backlog = listcount (mq->subq[qindex]);
+
       if (IS_ZEBRA_DEBUG_RIB_Q)
 	zlog_debug ("%s: %s/%d: queued rn %p into sub-queue %u",
 		    __func__, buf, rn->p.prefixlen, rn, qindex);
@@ -1335,6 +1835,28 @@ rib_queue_add (struct zebra_t *zebra, struct route_node *rn)
   rib_meta_queue_add (zebra->mq, rn);
 }
 
+/* Show the backlog and latency of each sub-queue under the RIB work
+ * queue in "show work-queues". */
+static void
+meta_queue_show (struct vty *vty, struct work_queue *wq)
+{
+  struct meta_queue *mq = zebrad.mq;
+  u_char i;
+
+  vty_out (vty, "  %-10s %8s %8s %10s %10s %8s %8s %8s%s",
+           "Sub-queue", "Backlog", "Max", "Queued", "Processed",
+           "Deadline", "Avg(ms)", "Max(ms)", VTY_NEWLINE);
+  for (i = 0; i < MQ_SIZE; i++)
+    vty_out (vty, "  %-10s %8u %8u %10lu %10lu %8lu %8lu %8lu%s",
+             meta_queue_name[i], listcount (mq->subq[i]),
+             mq->stats[i].max_backlog, mq->stats[i].queued,
+             mq->stats[i].processed, mq->stats[i].deadline,
+             mq->stats[i].processed ?
+               (unsigned long) (mq->stats[i].latency_total
+                                / mq->stats[i].processed) : 0,
+             mq->stats[i].latency_max, VTY_NEWLINE);
+}
+
 /* Create new meta queue.
    A destructor function doesn't seem to be necessary here.
  */
@@ -1373,6 +1895,7 @@ rib_queue_init (struct zebra_t *zebra)
   /* XXX: TODO: These should be runtime configurable via vty */
   zebra->ribq->spec.max_retries = 3;
   zebra->ribq->spec.hold = rib_process_hold_time;
+  zebra->ribq->spec.show_func = &meta_queue_show;
   
   if (!(zebra->mq = meta_queue_new ()))
     zlog_err ("%s: could not initialise meta queue!", __func__);
@@ -1446,6 +1969,8 @@ rib_link (struct route_node *rn, struct rib *rib)
     }
   rib->next = head;
   rn->info = rib;
+  if (rib->nhg_ref)
+    nhg_ref_link (rib->nhg_ref, rn);
   rib_queue_add (&zebrad, rn);
 }
 
@@ -1465,6 +1990,7 @@ rib_addnode (struct route_node *rn, struct rib *rib)
                     __func__, buf, rn->p.prefixlen, rn, rib);
       }
       UNSET_FLAG (rib->status, RIB_ENTRY_REMOVED);
+      rib_resolver_changed (rn, rib);
       return;
     }
   rib_link (rn, rib);
@@ -1501,13 +2027,22 @@ rib_unlink (struct route_node *rn, struct rib *rib)
                         __func__, buf, rn->p.prefixlen, rn, rib);
           rib->next->rn_status = rib->rn_status;
         }
+      else if (CHECK_FLAG (rib->rn_status, RIB_ROUTE_LPM))
+        lpm_delete (rn);
     }
 
+  if (CHECK_FLAG (rib->status, RIB_ENTRY_RETAINED))
+    rib_retain.pending--;
+
+  if (rib->nhg_ref)
+    nhg_ref_free (rib->nhg_ref);
+  nhe_release (rib);
+
   /* free RIB and nexthops */
   for (nexthop = rib->nexthop; nexthop; nexthop = next)
     {
       next = nexthop->next;
-      nexthop_free (nexthop);
+      nexthop_free (rib, nexthop);
     }
   XFREE (MTYPE_RIB, rib);
 
@@ -1525,6 +2060,132 @@ rib_delnode (struct route_node *rn, struct rib *rib)
       buf, rn->p.prefixlen, rn, rib);
   }
   SET_FLAG (rib->status, RIB_ENTRY_REMOVED);
+  rib_resolver_changed (rn, rib);
+  rib_queue_add (&zebrad, rn);
+}
+
+/* Resolve the nexthops of a nexthop group template the way rib_process()
+ * resolves those of the routes using the group, and return the number of
+ * active ones.
+ */
+int
+rib_nhg_resolve (struct rib *rib)
+{
+  struct nexthop *nexthop;
+
+  rib->nexthop_active_num = 0;
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    if ((nexthop->type == NEXTHOP_TYPE_IPV4
+         || nexthop->type == NEXTHOP_TYPE_IPV4_IFINDEX)
+        && nexthop_active_ipv4 (rib, nexthop, 1, NULL))
+      {
+        SET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+        rib->nexthop_active_num++;
+      }
+    else
+      UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+
+  return rib->nexthop_active_num;
+}
+
+/* Resolve the nexthops of the template of an interned nexthop set, as
+ * nexthop_active_check() does for a route not covering any of them.
+ */
+void
+rib_nhe_resolve (struct rib *rib)
+{
+  struct nexthop *nexthop;
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    nexthop_active_resolve (NULL, rib, nexthop, 1);
+}
+
+/* Have rib_process() look again at a route node, the resolution of the
+ * nexthops of some of its entries having changed.
+ */
+void
+rib_nhe_requeue (struct route_node *rn)
+{
+  rib_queue_add (&zebrad, rn);
+}
+
+/* Replace the nexthops of a RIB entry with copies of those of another one,
+ * or just free them if that is NULL.
+ */
+void
+rib_nhg_copy_nexthops (struct rib *rib, struct rib *from)
+{
+  struct nexthop *nexthop, *next, *copy;
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = next)
+    {
+      next = nexthop->next;
+      nexthop_free (rib, nexthop);
+    }
+  rib->nexthop = NULL;
+  rib->nexthop_num = 0;
+  rib->nexthop_active_num = 0;
+
+  if (! from)
+    return;
+
+  for (nexthop = from->nexthop; nexthop; nexthop = nexthop->next)
+    {
+      copy = nexthop_new (rib);
+      *copy = *nexthop;
+      copy->next = copy->prev = NULL;
+      if (nexthop->ifname)
+        copy->ifname = XSTRDUP (0, nexthop->ifname);
+      UNSET_FLAG (copy->flags, NEXTHOP_FLAG_FIB);
+      nexthop_add (rib, copy);
+    }
+}
+
+/* The installed route of a RIB entry follows the kernel nexthop object of
+ * its group, which now points at the new resolution of the group template.
+ * Bring the RIB entry in line without reinstalling it, unless a protocol
+ * route-map may judge the nexthops differently.
+ */
+void
+rib_nhg_sync (struct route_node *rn, struct rib *rib, struct rib *tmpl)
+{
+  extern char *proto_rm[AFI_MAX][ZEBRA_ROUTE_MAX+1];
+  struct nexthop *nexthop, *from;
+
+  if (proto_rm[AFI_IP][rib->type] || proto_rm[AFI_IP][ZEBRA_ROUTE_MAX])
+    {
+      rib_nhg_requeue (rn, rib, NULL);
+      return;
+    }
+
+  for (nexthop = rib->nexthop, from = tmpl->nexthop; nexthop && from;
+       nexthop = nexthop->next, from = from->next)
+    {
+      nexthop->flags = from->flags & ~NEXTHOP_FLAG_FIB;
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+        SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+      nexthop->ifindex = from->ifindex;
+      nexthop->rtype = from->rtype;
+      nexthop->rgate = from->rgate;
+      nexthop->rifindex = from->rifindex;
+    }
+  rib->nexthop_active_num = tmpl->nexthop_active_num;
+  rib_resolver_changed (rn, rib);
+}
+
+/* Have rib_process() reinstall a RIB entry after a change of its nexthop
+ * group.  If a template is given, the group nexthops were replaced: the
+ * route is withdrawn with its old nexthops and takes the new ones.
+ */
+void
+rib_nhg_requeue (struct route_node *rn, struct rib *rib, struct rib *tmpl)
+{
+  if (tmpl && ! CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+    {
+      rib_uninstall (rn, rib);
+      rib_nhg_copy_nexthops (rib, tmpl);
+    }
+  SET_FLAG (rib->status, RIB_ENTRY_NHG_CHANGED);
   rib_queue_add (&zebrad, rn);
 }
 
@@ -1646,7 +2307,7 @@ void rib_dump (const char * func, const struct prefix_ipv4 * p, const struct rib
   zlog_debug ("%s: dumping RIB entry %p for %s/%d", func, rib, straddr1, p->prefixlen);
   zlog_debug
   (
-    "%s: refcnt == %lu, uptime == %lu, type == %u, table == %d",
+    "%s: refcnt == %u, uptime == %lu, type == %u, table == %d",
     func,
     rib->refcnt,
     (unsigned long) rib->uptime,
@@ -1959,6 +2620,7 @@ rib_delete_ipv4 (int type, int flags, struct prefix_ipv4 *p,
 	    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
 
 	  UNSET_FLAG (fib->flags, ZEBRA_FLAG_SELECTED);
+	  rib_resolver_changed (rn, fib);
 	}
       else
 	{
@@ -2136,7 +2798,7 @@ static_uninstall_ipv4 (struct prefix_ipv4 *p, struct static_ipv4 *si)
       if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB))
         rib_uninstall (rn, rib);
       nexthop_delete (rib, nexthop);
-      nexthop_free (nexthop);
+      nexthop_free (rib, nexthop);
       rib_queue_add (&zebrad, rn);
     }
   /* Unlock node. */
@@ -2693,7 +3355,7 @@ static_uninstall_ipv6 (struct prefix_ipv6 *p, struct static_ipv6 *si)
       if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB))
         rib_uninstall (rn, rib);
       nexthop_delete (rib, nexthop);
-      nexthop_free (nexthop);
+      nexthop_free (rib, nexthop);
       rib_queue_add (&zebrad, rn);
     }
   /* Unlock node. */
@@ -2842,24 +3504,26 @@ static_delete_ipv6 (struct prefix_ipv6 *p, u_char type, struct in6_addr *gate,
 }
 #endif /* HAVE_IPV6 */
 
-/* RIB update function. */
+/* RIB update function, for interface changes.  Connected routes come and
+ * go through the RIB like others, and the routes resolved through them
+ * are requeued then: only those with nexthops naming an interface are
+ * left to look at.
+ */
 void
 rib_update (void)
 {
-  struct route_node *rn;
-  struct route_table *table;
-  
-  table = vrf_table (AFI_IP, SAFI_UNICAST, 0);
-  if (table)
-    for (rn = route_top (table); rn; rn = route_next (rn))
-      if (rn->info)
-        rib_queue_add (&zebrad, rn);
+  nhe_invalidate_interfaces ();
+}
 
-  table = vrf_table (AFI_IP6, SAFI_UNICAST, 0);
-  if (table)
-    for (rn = route_top (table); rn; rn = route_next (rn))
-      if (rn->info)
-        rib_queue_add (&zebrad, rn);
+/* Same as rib_update(), for a change of a single interface: only the
+ * routes with nexthops through it, or naming an interface, are requeued.
+ * Addresses coming and going don't need it, as they change no interface
+ * nexthop.
+ */
+void
+rib_update_interface (struct interface *ifp)
+{
+  nhe_invalidate_interface (ifp);
 }
 
 
@@ -2930,6 +3594,159 @@ rib_sweep_route (void)
   rib_sweep_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
 }
 
+/* Mark the routes zebra installed in a previous run as retained.  */
+static void
+rib_retain_table (struct route_table *table)
+{
+  struct route_node *rn;
+  struct rib *rib;
+
+  if (table)
+    for (rn = route_top (table); rn; rn = route_next (rn))
+      for (rib = rn->info; rib; rib = rib->next)
+	if (rib->type == ZEBRA_ROUTE_KERNEL
+	    && CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELFROUTE)
+	    && ! CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+	  {
+	    SET_FLAG (rib->status, RIB_ENTRY_RETAINED);
+	    rib_retain.retained++;
+	    rib_retain.pending++;
+	  }
+}
+
+/* Delete the retained routes which were not installed again.  */
+static void
+rib_retain_sweep_table (struct route_table *table)
+{
+  struct route_node *rn;
+  struct rib *rib;
+  struct rib *next;
+
+  if (table)
+    for (rn = route_top (table); rn; rn = route_next (rn))
+      for (rib = rn->info; rib; rib = next)
+	{
+	  next = rib->next;
+
+	  if (CHECK_FLAG (rib->status, RIB_ENTRY_RETAINED)
+	      && ! CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+	    {
+	      if (! rib_uninstall_kernel (rn, rib))
+		{
+		  rib_retain.swept++;
+		  rib_delnode (rn, rib);
+		}
+	    }
+	}
+}
+
+static int
+rib_retain_expire (struct thread *thread)
+{
+  rib_retain.t_sweep = NULL;
+
+  if (rib_retain.pending)
+    {
+      zlog_info ("Removing %lu routes not installed again in %d seconds",
+		 rib_retain.pending, rib_retain.time);
+      rib_retain_sweep_table (vrf_table (AFI_IP, SAFI_UNICAST, 0));
+      rib_retain_sweep_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
+    }
+  return 0;
+}
+
+/* Retain the routes zebra installed in a previous run instead of sweeping
+ * them at once: for the given seconds, a route installed again in place of
+ * one of them only updates the kernel if it differs.  Those still retained
+ * then are swept.
+ */
+void
+rib_retain_route (int time)
+{
+  rib_retain.time = time;
+  rib_retain_table (vrf_table (AFI_IP, SAFI_UNICAST, 0));
+  rib_retain_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
+
+  zlog_info ("Retaining %lu routes of a previous run for %d seconds",
+	     rib_retain.retained, time);
+  rib_retain.t_sweep = thread_add_timer (zebrad.master, rib_retain_expire,
+					 NULL, time);
+}
+
+void
+rib_retain_show (struct vty *vty)
+{
+  if (! rib_retain.time)
+    {
+      vty_out (vty, "Routes of a previous run are not retained%s",
+	       VTY_NEWLINE);
+      return;
+    }
+
+  if (rib_retain.t_sweep)
+    vty_out (vty, "Retaining routes of a previous run, %lu of %d seconds "
+	     "left%s", thread_timer_remain_second (rib_retain.t_sweep),
+	     rib_retain.time, VTY_NEWLINE);
+  else
+    vty_out (vty, "Retained routes of a previous run for %d seconds%s",
+	     rib_retain.time, VTY_NEWLINE);
+  vty_out (vty, "  Retained: %lu, still retained: %lu%s",
+	   rib_retain.retained, rib_retain.pending, VTY_NEWLINE);
+  vty_out (vty, "  Installed again: %lu unchanged, %lu updated%s",
+	   rib_retain.kept, rib_retain.replaced, VTY_NEWLINE);
+  vty_out (vty, "  Swept: %lu%s", rib_retain.swept, VTY_NEWLINE);
+}
+
+static void
+rib_resync_mark_table (struct route_table *table)
+{
+  struct route_node *rn;
+  struct rib *rib;
+
+  if (table)
+    for (rn = route_top (table); rn; rn = route_next (rn))
+      for (rib = rn->info; rib; rib = rib->next)
+	if (rib->type == ZEBRA_ROUTE_KERNEL
+	    && ! CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELFROUTE)
+	    && ! CHECK_FLAG (rib->status, RIB_ENTRY_RETAINED))
+	  SET_FLAG (rib->status, RIB_ENTRY_RESYNC);
+}
+
+/* Mark the kernel routes before the kernel table is read again: the
+   routes read replace the marked entries through rib_add_ipv4/6().  The
+   routes zebra installed itself are not read again, and not marked. */
+void
+rib_resync_mark (void)
+{
+  rib_resync_mark_table (vrf_table (AFI_IP, SAFI_UNICAST, 0));
+  rib_resync_mark_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
+}
+
+static void
+rib_resync_sweep_table (struct route_table *table)
+{
+  struct route_node *rn;
+  struct rib *rib;
+
+  if (table)
+    for (rn = route_top (table); rn; rn = route_next (rn))
+      for (rib = rn->info; rib; rib = rib->next)
+	if (CHECK_FLAG (rib->status, RIB_ENTRY_RESYNC))
+	  {
+	    UNSET_FLAG (rib->status, RIB_ENTRY_RESYNC);
+	    if (! CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+	      rib_delnode (rn, rib);
+	  }
+}
+
+/* Delete the kernel routes which were not read again. */
+void
+rib_resync_sweep (void)
+{
+  rib_resync_sweep_table (vrf_table (AFI_IP, SAFI_UNICAST, 0));
+  rib_resync_sweep_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
+}
+
 /* Remove specific by protocol routes from 'table'. */
 static unsigned long
 rib_score_proto_table (u_char proto, struct route_table *table)
@@ -2987,6 +3804,7 @@ rib_close (void)
 {
   rib_close_table (vrf_table (AFI_IP, SAFI_UNICAST, 0));
   rib_close_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
+  kernel_flush ();
 }
 
 /* Routing information base initialize. */
@@ -2996,4 +3814,7 @@ rib_init (void)
   rib_queue_init (&zebrad);
   /* VRF initialization.  */
   vrf_init ();
+  nhg_init ();
+  fibc_init ();
+  lpm_init ();
 }
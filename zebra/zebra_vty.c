@@ -27,6 +27,7 @@
 #include "command.h"
 #include "table.h"
 #include "rib.h"
+#include "plist.h"
 
 #include "zebra/zserv.h"
 
@@ -551,7 +552,7 @@ vty_show_ip_route_detail (struct vty *vty, struct route_node *rn)
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED))
 	vty_out (vty, ", best");
       if (rib->refcnt)
-	vty_out (vty, ", refcnt %ld", rib->refcnt);
+	vty_out (vty, ", refcnt %u", rib->refcnt);
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_BLACKHOLE))
        vty_out (vty, ", blackhole");
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_REJECT))
@@ -818,36 +819,260 @@ vty_show_ip_route (struct vty *vty, struct route_node *rn, struct rib *rib)
     }
 }
 
-DEFUN (show_ip_route,
-       show_ip_route_cmd,
-       "show ip route",
-       SHOW_STR
-       IP_STR
-       "IP routing table\n")
+#ifdef HAVE_IPV6
+static void vty_show_ipv6_route (struct vty *, struct route_node *,
+				 struct rib *);
+#endif /* HAVE_IPV6 */
+
+/* Number of nodes a route table walk visits each time the vty asks for
+   more output. */
+#define ZEBRA_SHOW_BATCH 256
+
+enum zebra_show_type
 {
-  struct route_table *table;
+  zebra_show_all,
+  zebra_show_longer,
+  zebra_show_supernets,
+  zebra_show_protocol,
+  zebra_show_prefix_list,
+};
+
+/* A route table walk for a "show ip route" or "show ipv6 route"
+   command, resumed by the vty each time its output buffer has
+   drained. */
+struct zebra_show_cursor
+{
+  afi_t afi;
+  enum zebra_show_type type;
+
+  /* Next node to be displayed and, when only a subtree is walked, its
+     top; both locked. */
+  struct route_node *rn;
+  struct route_node *limit;
+
+  /* Route type, or name of the prefix-list, to match. */
+  int protocol;
+  char *name;
+
+  /* Count the matching routes instead of displaying them. */
+  int count;
+
+  int header;
+  unsigned long routes;
+  unsigned long prefixes;
+};
+
+static void
+zebra_show_cursor_free (void *arg)
+{
+  struct zebra_show_cursor *zsc = arg;
+
+  if (zsc->rn)
+    route_unlock_node (zsc->rn);
+  if (zsc->limit)
+    route_unlock_node (zsc->limit);
+  if (zsc->name)
+    XFREE (MTYPE_TMP, zsc->name);
+  XFREE (MTYPE_ZEBRA_SHOW_CURSOR, zsc);
+}
+
+static int
+zebra_show_match (struct zebra_show_cursor *zsc, struct route_node *rn,
+		  struct rib *rib, struct prefix_list *plist)
+{
+  u_int32_t addr;
+
+  switch (zsc->type)
+    {
+    case zebra_show_supernets:
+      addr = ntohl (rn->p.u.prefix4.s_addr);
+      return ((IN_CLASSC (addr) && rn->p.prefixlen < 24)
+	      || (IN_CLASSB (addr) && rn->p.prefixlen < 16)
+	      || (IN_CLASSA (addr) && rn->p.prefixlen < 8));
+    case zebra_show_protocol:
+      return rib->type == zsc->protocol;
+    case zebra_show_prefix_list:
+      return prefix_list_apply (plist, &rn->p) == PREFIX_PERMIT;
+    default:
+      return 1;
+    }
+}
+
+/* Display the next batch of routes.  Returns 0 once the walk is done. */
+static int
+zebra_show_route_next (struct vty *vty, void *arg)
+{
+  struct zebra_show_cursor *zsc = arg;
+  struct prefix_list *plist = NULL;
   struct route_node *rn;
   struct rib *rib;
-  int first = 1;
+  int matched;
+  int count;
 
-  table = vrf_table (AFI_IP, SAFI_UNICAST, 0);
+  /* The prefix-list may have been deleted while output was suspended. */
+  if (zsc->type == zebra_show_prefix_list)
+    {
+      plist = prefix_list_lookup (zsc->afi, zsc->name);
+      if (plist == NULL)
+	{
+	  vty_out (vty, "%% %s has been deleted%s", zsc->name, VTY_NEWLINE);
+	  return 0;
+	}
+    }
+
+  for (rn = zsc->rn, count = 0; rn && count < ZEBRA_SHOW_BATCH;
+       rn = route_next_until (rn, zsc->limit), count++)
+    {
+      matched = 0;
+      for (rib = rn->info; rib; rib = rib->next)
+	{
+	  if (! zebra_show_match (zsc, rn, rib, plist))
+	    continue;
+
+	  matched = 1;
+	  zsc->routes++;
+	  if (zsc->count)
+	    continue;
+
+	  if (zsc->afi == AFI_IP)
+	    {
+	      if (zsc->header)
+		vty_out (vty, SHOW_ROUTE_V4_HEADER);
+	      vty_show_ip_route (vty, rn, rib);
+	    }
+#ifdef HAVE_IPV6
+	  else
+	    {
+	      if (zsc->header)
+		vty_out (vty, SHOW_ROUTE_V6_HEADER);
+	      vty_show_ipv6_route (vty, rn, rib);
+	    }
+#endif /* HAVE_IPV6 */
+	  zsc->header = 0;
+	}
+      if (matched)
+	zsc->prefixes++;
+    }
+
+  zsc->rn = rn;
+  if (rn)
+    return 1;
+
+  if (zsc->count)
+    vty_out (vty, "%lu routes for %lu prefixes%s", zsc->routes,
+	     zsc->prefixes, VTY_NEWLINE);
+  return 0;
+}
+
+/* Top of the subtree of the nodes covered by P, locked, found without
+   adding a node for P to the table. */
+static struct route_node *
+zebra_show_subtree (struct route_table *table, struct prefix *p)
+{
+  struct route_node *node = table->top;
+
+  while (node && node->p.prefixlen < p->prefixlen
+	 && prefix_match (&node->p, p))
+    node = node->link[prefix_bit (&p->u.prefix, node->p.prefixlen)];
+
+  if (node && prefix_match (p, &node->p))
+    return route_lock_node (node);
+  return NULL;
+}
+
+/* Display, or count, the routes of a table which match the filter.
+   The table is walked a batch of nodes at a time as the vty drains, so
+   neither the output nor the time spent before returning to the other
+   threads grows with the size of the table. */
+static int
+zebra_show_route (struct vty *vty, afi_t afi, safi_t safi,
+		  enum zebra_show_type type, const char *arg, int count)
+{
+  struct zebra_show_cursor *zsc;
+  struct route_table *table;
+  struct prefix p;
+  int protocol = 0;
+
+  switch (type)
+    {
+    case zebra_show_longer:
+      if (! str2prefix (arg, &p) || afi2family (afi) != p.family)
+	{
+	  vty_out (vty, "%% Malformed Prefix%s", VTY_NEWLINE);
+	  return CMD_WARNING;
+	}
+      apply_mask (&p);
+      break;
+    case zebra_show_protocol:
+      protocol = proto_redistnum (afi, arg);
+      if (protocol < 0)
+	{
+	  vty_out (vty, "Unknown route type%s", VTY_NEWLINE);
+	  return CMD_WARNING;
+	}
+      break;
+    case zebra_show_prefix_list:
+      if (prefix_list_lookup (afi, arg) == NULL)
+	{
+	  vty_out (vty, "%% %s is not a valid prefix-list name%s", arg,
+		   VTY_NEWLINE);
+	  return CMD_WARNING;
+	}
+      break;
+    default:
+      break;
+    }
+
+  table = vrf_table (afi, safi, 0);
   if (! table)
     return CMD_SUCCESS;
 
-  /* Show all IPv4 routes. */
-  for (rn = route_top (table); rn; rn = route_next (rn))
-    for (rib = rn->info; rib; rib = rib->next)
-      {
-	if (first)
-	  {
-	    vty_out (vty, SHOW_ROUTE_V4_HEADER);
-	    first = 0;
-	  }
-	vty_show_ip_route (vty, rn, rib);
-      }
+  zsc = XCALLOC (MTYPE_ZEBRA_SHOW_CURSOR, sizeof (struct zebra_show_cursor));
+  zsc->afi = afi;
+  zsc->type = type;
+  zsc->protocol = protocol;
+  zsc->count = count;
+  zsc->header = 1;
+
+  /* Longer prefixes are all in the subtree covered by the prefix. */
+  if (type == zebra_show_longer)
+    {
+      zsc->limit = zebra_show_subtree (table, &p);
+      if (zsc->limit)
+	zsc->rn = route_lock_node (zsc->limit);
+    }
+  else
+    zsc->rn = route_top (table);
+  if (type == zebra_show_prefix_list)
+    zsc->name = XSTRDUP (MTYPE_TMP, arg);
+
+  vty_output_start (vty, zebra_show_route_next, zebra_show_cursor_free, zsc);
   return CMD_SUCCESS;
 }
 
+DEFUN (show_ip_route,
+       show_ip_route_cmd,
+       "show ip route",
+       SHOW_STR
+       IP_STR
+       "IP routing table\n")
+{
+  return zebra_show_route (vty, AFI_IP, SAFI_UNICAST, zebra_show_all,
+			   NULL, 0);
+}
+
+DEFUN (show_ip_route_count,
+       show_ip_route_count_cmd,
+       "show ip route count",
+       SHOW_STR
+       IP_STR
+       "IP routing table\n"
+       "Count the routes instead of displaying them\n")
+{
+  return zebra_show_route (vty, AFI_IP, SAFI_UNICAST, zebra_show_all,
+			   NULL, 1);
+}
+
 DEFUN (show_ip_route_prefix_longer,
        show_ip_route_prefix_longer_cmd,
        "show ip route A.B.C.D/M longer-prefixes",
@@ -857,37 +1082,22 @@ DEFUN (show_ip_route_prefix_longer,
        "IP prefix <network>/<length>, e.g., 35.0.0.0/8\n"
        "Show route matching the specified Network/Mask pair only\n")
 {
-  struct route_table *table;
-  struct route_node *rn;
-  struct rib *rib;
-  struct prefix p;
-  int ret;
-  int first = 1;
-
-  ret = str2prefix (argv[0], &p);
-  if (! ret)
-    {
-      vty_out (vty, "%% Malformed Prefix%s", VTY_NEWLINE);
-      return CMD_WARNING;
-    }
-  
-  table = vrf_table (AFI_IP, SAFI_UNICAST, 0);
-  if (! table)
-    return CMD_SUCCESS;
+  return zebra_show_route (vty, AFI_IP, SAFI_UNICAST, zebra_show_longer,
+			   argv[0], 0);
+}
 
-  /* Show matched type IPv4 routes. */
-  for (rn = route_top (table); rn; rn = route_next (rn))
-    for (rib = rn->info; rib; rib = rib->next)
-      if (prefix_match (&p, &rn->p))
-	{
-	  if (first)
-	    {
-	      vty_out (vty, SHOW_ROUTE_V4_HEADER);
-	      first = 0;
-	    }
-	  vty_show_ip_route (vty, rn, rib);
-	}
-  return CMD_SUCCESS;
+DEFUN (show_ip_route_prefix_longer_count,
+       show_ip_route_prefix_longer_count_cmd,
+       "show ip route A.B.C.D/M longer-prefixes count",
+       SHOW_STR
+       IP_STR
+       "IP routing table\n"
+       "IP prefix <network>/<length>, e.g., 35.0.0.0/8\n"
+       "Show route matching the specified Network/Mask pair only\n"
+       "Count the routes instead of displaying them\n")
+{
+  return zebra_show_route (vty, AFI_IP, SAFI_UNICAST, zebra_show_longer,
+			   argv[0], 1);
 }
 
 DEFUN (show_ip_route_supernets,
@@ -898,35 +1108,8 @@ DEFUN (show_ip_route_supernets,
        "IP routing table\n"
        "Show supernet entries only\n")
 {
-  struct route_table *table;
-  struct route_node *rn;
-  struct rib *rib;
-  u_int32_t addr; 
-  int first = 1;
-
-  table = vrf_table (AFI_IP, SAFI_UNICAST, 0);
-  if (! table)
-    return CMD_SUCCESS;
-
-  /* Show matched type IPv4 routes. */
-  for (rn = route_top (table); rn; rn = route_next (rn))
-    for (rib = rn->info; rib; rib = rib->next)
-      {
-	addr = ntohl (rn->p.u.prefix4.s_addr);
-
-	if ((IN_CLASSC (addr) && rn->p.prefixlen < 24)
-	   || (IN_CLASSB (addr) && rn->p.prefixlen < 16)
-	   || (IN_CLASSA (addr) && rn->p.prefixlen < 8)) 
-	  {
-	    if (first)
-	      {
-		vty_out (vty, SHOW_ROUTE_V4_HEADER);
-		first = 0;
-	      }
-	    vty_show_ip_route (vty, rn, rib);
-	  }
-      }
-  return CMD_SUCCESS;
+  return zebra_show_route (vty, AFI_IP, SAFI_UNICAST, zebra_show_supernets,
+			   NULL, 0);
 }
 
 DEFUN (show_ip_route_protocol,
@@ -937,36 +1120,48 @@ DEFUN (show_ip_route_protocol,
        "IP routing table\n"
        QUAGGA_IP_REDIST_HELP_STR_ZEBRA)
 {
-  int type;
-  struct route_table *table;
-  struct route_node *rn;
-  struct rib *rib;
-  int first = 1;
+  return zebra_show_route (vty, AFI_IP, SAFI_UNICAST, zebra_show_protocol,
+			   argv[0], 0);
+}
 
-  type = proto_redistnum (AFI_IP, argv[0]);
-  if (type < 0)
-    {
-      vty_out (vty, "Unknown route type%s", VTY_NEWLINE);
-      return CMD_WARNING;
-    }
-  
-  table = vrf_table (AFI_IP, SAFI_UNICAST, 0);
-  if (! table)
-    return CMD_SUCCESS;
+DEFUN (show_ip_route_protocol_count,
+       show_ip_route_protocol_count_cmd,
+       "show ip route " QUAGGA_IP_REDIST_STR_ZEBRA " count",
+       SHOW_STR
+       IP_STR
+       "IP routing table\n"
+       QUAGGA_IP_REDIST_HELP_STR_ZEBRA
+       "Count the routes instead of displaying them\n")
+{
+  return zebra_show_route (vty, AFI_IP, SAFI_UNICAST, zebra_show_protocol,
+			   argv[0], 1);
+}
 
-  /* Show matched type IPv4 routes. */
-  for (rn = route_top (table); rn; rn = route_next (rn))
-    for (rib = rn->info; rib; rib = rib->next)
-      if (rib->type == type)
-	{
-	  if (first)
-	    {
-	      vty_out (vty, SHOW_ROUTE_V4_HEADER);
-	      first = 0;
-	    }
-	  vty_show_ip_route (vty, rn, rib);
-	}
-  return CMD_SUCCESS;
+DEFUN (show_ip_route_prefix_list,
+       show_ip_route_prefix_list_cmd,
+       "show ip route prefix-list WORD",
+       SHOW_STR
+       IP_STR
+       "IP routing table\n"
+       "Show routes matching the prefix-list\n"
+       "IP prefix-list name\n")
+{
+  return zebra_show_route (vty, AFI_IP, SAFI_UNICAST, zebra_show_prefix_list,
+			   argv[0], 0);
+}
+
+DEFUN (show_ip_route_prefix_list_count,
+       show_ip_route_prefix_list_count_cmd,
+       "show ip route prefix-list WORD count",
+       SHOW_STR
+       IP_STR
+       "IP routing table\n"
+       "Show routes matching the prefix-list\n"
+       "IP prefix-list name\n"
+       "Count the routes instead of displaying them\n")
+{
+  return zebra_show_route (vty, AFI_IP, SAFI_UNICAST, zebra_show_prefix_list,
+			   argv[0], 1);
 }
 
 DEFUN (show_ip_route_addr,
@@ -1226,27 +1421,8 @@ DEFUN (show_ip_mroute,
        IP_STR
        "IP Multicast routing table\n")
 {
-  struct route_table *table;
-  struct route_node *rn;
-  struct rib *rib;
-  int first = 1;
-
-  table = vrf_table (AFI_IP, SAFI_MULTICAST, 0);
-  if (! table)
-    return CMD_SUCCESS;
-
-  /* Show all IPv4 routes. */
-  for (rn = route_top (table); rn; rn = route_next (rn))
-    for (rib = rn->info; rib; rib = rib->next)
-      {
-       if (first)
-         {
-	   vty_out (vty, SHOW_ROUTE_V4_HEADER);
-           first = 0;
-         }
-       vty_show_ip_route (vty, rn, rib);
-      }
-  return CMD_SUCCESS;
+  return zebra_show_route (vty, AFI_IP, SAFI_MULTICAST, zebra_show_all,
+			   NULL, 0);
 }
 
 
@@ -1575,7 +1751,7 @@ vty_show_ipv6_route_detail (struct vty *vty, struct route_node *rn)
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED))
 	vty_out (vty, ", best");
       if (rib->refcnt)
-	vty_out (vty, ", refcnt %ld", rib->refcnt);
+	vty_out (vty, ", refcnt %u", rib->refcnt);
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_BLACKHOLE))
        vty_out (vty, ", blackhole");
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_REJECT))
@@ -1808,27 +1984,20 @@ DEFUN (show_ipv6_route,
        IP_STR
        "IPv6 routing table\n")
 {
-  struct route_table *table;
-  struct route_node *rn;
-  struct rib *rib;
-  int first = 1;
-
-  table = vrf_table (AFI_IP6, SAFI_UNICAST, 0);
-  if (! table)
-    return CMD_SUCCESS;
+  return zebra_show_route (vty, AFI_IP6, SAFI_UNICAST, zebra_show_all,
+			   NULL, 0);
+}
 
-  /* Show all IPv6 route. */
-  for (rn = route_top (table); rn; rn = route_next (rn))
-    for (rib = rn->info; rib; rib = rib->next)
-      {
-	if (first)
-	  {
-	    vty_out (vty, SHOW_ROUTE_V6_HEADER);
-	    first = 0;
-	  }
-	vty_show_ipv6_route (vty, rn, rib);
-      }
-  return CMD_SUCCESS;
+DEFUN (show_ipv6_route_count,
+       show_ipv6_route_count_cmd,
+       "show ipv6 route count",
+       SHOW_STR
+       IP_STR
+       "IPv6 routing table\n"
+       "Count the routes instead of displaying them\n")
+{
+  return zebra_show_route (vty, AFI_IP6, SAFI_UNICAST, zebra_show_all,
+			   NULL, 1);
 }
 
 DEFUN (show_ipv6_route_prefix_longer,
@@ -1840,37 +2009,22 @@ DEFUN (show_ipv6_route_prefix_longer,
        "IPv6 prefix\n"
        "Show route matching the specified Network/Mask pair only\n")
 {
-  struct route_table *table;
-  struct route_node *rn;
-  struct rib *rib;
-  struct prefix p;
-  int ret;
-  int first = 1;
-
-  table = vrf_table (AFI_IP6, SAFI_UNICAST, 0);
-  if (! table)
-    return CMD_SUCCESS;
-
-  ret = str2prefix (argv[0], &p);
-  if (! ret)
-    {
-      vty_out (vty, "%% Malformed Prefix%s", VTY_NEWLINE);
-      return CMD_WARNING;
-    }
+  return zebra_show_route (vty, AFI_IP6, SAFI_UNICAST, zebra_show_longer,
+			   argv[0], 0);
+}
 
-  /* Show matched type IPv6 routes. */
-  for (rn = route_top (table); rn; rn = route_next (rn))
-    for (rib = rn->info; rib; rib = rib->next)
-      if (prefix_match (&p, &rn->p))
-	{
-	  if (first)
-	    {
-	      vty_out (vty, SHOW_ROUTE_V6_HEADER);
-	      first = 0;
-	    }
-	  vty_show_ipv6_route (vty, rn, rib);
-	}
-  return CMD_SUCCESS;
+DEFUN (show_ipv6_route_prefix_longer_count,
+       show_ipv6_route_prefix_longer_count_cmd,
+       "show ipv6 route X:X::X:X/M longer-prefixes count",
+       SHOW_STR
+       IP_STR
+       "IPv6 routing table\n"
+       "IPv6 prefix\n"
+       "Show route matching the specified Network/Mask pair only\n"
+       "Count the routes instead of displaying them\n")
+{
+  return zebra_show_route (vty, AFI_IP6, SAFI_UNICAST, zebra_show_longer,
+			   argv[0], 1);
 }
 
 DEFUN (show_ipv6_route_protocol,
@@ -1881,36 +2035,48 @@ DEFUN (show_ipv6_route_protocol,
        "IP routing table\n"
 	QUAGGA_IP6_REDIST_HELP_STR_ZEBRA)
 {
-  int type;
-  struct route_table *table;
-  struct route_node *rn;
-  struct rib *rib;
-  int first = 1;
+  return zebra_show_route (vty, AFI_IP6, SAFI_UNICAST, zebra_show_protocol,
+			   argv[0], 0);
+}
 
-  type = proto_redistnum (AFI_IP6, argv[0]);
-  if (type < 0)
-    {
-      vty_out (vty, "Unknown route type%s", VTY_NEWLINE);
-      return CMD_WARNING;
-    }
-  
-  table = vrf_table (AFI_IP6, SAFI_UNICAST, 0);
-  if (! table)
-    return CMD_SUCCESS;
+DEFUN (show_ipv6_route_protocol_count,
+       show_ipv6_route_protocol_count_cmd,
+       "show ipv6 route " QUAGGA_IP6_REDIST_STR_ZEBRA " count",
+       SHOW_STR
+       IP_STR
+       "IP routing table\n"
+       QUAGGA_IP6_REDIST_HELP_STR_ZEBRA
+       "Count the routes instead of displaying them\n")
+{
+  return zebra_show_route (vty, AFI_IP6, SAFI_UNICAST, zebra_show_protocol,
+			   argv[0], 1);
+}
 
-  /* Show matched type IPv6 routes. */
-  for (rn = route_top (table); rn; rn = route_next (rn))
-    for (rib = rn->info; rib; rib = rib->next)
-      if (rib->type == type)
-	{
-	  if (first)
-	    {
-	      vty_out (vty, SHOW_ROUTE_V6_HEADER);
-	      first = 0;
-	    }
-	  vty_show_ipv6_route (vty, rn, rib);
-	}
-  return CMD_SUCCESS;
+DEFUN (show_ipv6_route_prefix_list,
+       show_ipv6_route_prefix_list_cmd,
+       "show ipv6 route prefix-list WORD",
+       SHOW_STR
+       IP_STR
+       "IPv6 routing table\n"
+       "Show routes matching the prefix-list\n"
+       "IPv6 prefix-list name\n")
+{
+  return zebra_show_route (vty, AFI_IP6, SAFI_UNICAST, zebra_show_prefix_list,
+			   argv[0], 0);
+}
+
+DEFUN (show_ipv6_route_prefix_list_count,
+       show_ipv6_route_prefix_list_count_cmd,
+       "show ipv6 route prefix-list WORD count",
+       SHOW_STR
+       IP_STR
+       "IPv6 routing table\n"
+       "Show routes matching the prefix-list\n"
+       "IPv6 prefix-list name\n"
+       "Count the routes instead of displaying them\n")
+{
+  return zebra_show_route (vty, AFI_IP6, SAFI_UNICAST, zebra_show_prefix_list,
+			   argv[0], 1);
 }
 
 DEFUN (show_ipv6_route_addr,
@@ -2021,27 +2187,8 @@ DEFUN (show_ipv6_mroute,
        IP_STR
        "IPv6 Multicast routing table\n")
 {
-  struct route_table *table;
-  struct route_node *rn;
-  struct rib *rib;
-  int first = 1;
-
-  table = vrf_table (AFI_IP6, SAFI_MULTICAST, 0);
-  if (! table)
-    return CMD_SUCCESS;
-
-  /* Show all IPv6 route. */
-  for (rn = route_top (table); rn; rn = route_next (rn))
-    for (rib = rn->info; rib; rib = rib->next)
-      {
-       if (first)
-         {
-	   vty_out (vty, SHOW_ROUTE_V6_HEADER);
-           first = 0;
-         }
-       vty_show_ipv6_route (vty, rn, rib);
-      }
-  return CMD_SUCCESS;
+  return zebra_show_route (vty, AFI_IP6, SAFI_MULTICAST, zebra_show_all,
+			   NULL, 0);
 }
 
 
@@ -2177,17 +2324,27 @@ zebra_vty_init (void)
   install_element (CONFIG_NODE, &no_ip_route_mask_flags_distance2_cmd);
 
   install_element (VIEW_NODE, &show_ip_route_cmd);
+  install_element (VIEW_NODE, &show_ip_route_count_cmd);
   install_element (VIEW_NODE, &show_ip_route_addr_cmd);
   install_element (VIEW_NODE, &show_ip_route_prefix_cmd);
   install_element (VIEW_NODE, &show_ip_route_prefix_longer_cmd);
+  install_element (VIEW_NODE, &show_ip_route_prefix_longer_count_cmd);
+  install_element (VIEW_NODE, &show_ip_route_prefix_list_cmd);
+  install_element (VIEW_NODE, &show_ip_route_prefix_list_count_cmd);
   install_element (VIEW_NODE, &show_ip_route_protocol_cmd);
+  install_element (VIEW_NODE, &show_ip_route_protocol_count_cmd);
   install_element (VIEW_NODE, &show_ip_route_supernets_cmd);
   install_element (VIEW_NODE, &show_ip_route_summary_cmd);
   install_element (ENABLE_NODE, &show_ip_route_cmd);
+  install_element (ENABLE_NODE, &show_ip_route_count_cmd);
   install_element (ENABLE_NODE, &show_ip_route_addr_cmd);
   install_element (ENABLE_NODE, &show_ip_route_prefix_cmd);
   install_element (ENABLE_NODE, &show_ip_route_prefix_longer_cmd);
+  install_element (ENABLE_NODE, &show_ip_route_prefix_longer_count_cmd);
+  install_element (ENABLE_NODE, &show_ip_route_prefix_list_cmd);
+  install_element (ENABLE_NODE, &show_ip_route_prefix_list_count_cmd);
   install_element (ENABLE_NODE, &show_ip_route_protocol_cmd);
+  install_element (ENABLE_NODE, &show_ip_route_protocol_count_cmd);
   install_element (ENABLE_NODE, &show_ip_route_supernets_cmd);
   install_element (ENABLE_NODE, &show_ip_route_summary_cmd);
 
@@ -2213,16 +2370,26 @@ zebra_vty_init (void)
   install_element (CONFIG_NODE, &no_ipv6_route_ifname_pref_cmd);
   install_element (CONFIG_NODE, &no_ipv6_route_ifname_flags_pref_cmd);
   install_element (VIEW_NODE, &show_ipv6_route_cmd);
+  install_element (VIEW_NODE, &show_ipv6_route_count_cmd);
   install_element (VIEW_NODE, &show_ipv6_route_summary_cmd);
   install_element (VIEW_NODE, &show_ipv6_route_protocol_cmd);
+  install_element (VIEW_NODE, &show_ipv6_route_protocol_count_cmd);
   install_element (VIEW_NODE, &show_ipv6_route_addr_cmd);
   install_element (VIEW_NODE, &show_ipv6_route_prefix_cmd);
   install_element (VIEW_NODE, &show_ipv6_route_prefix_longer_cmd);
+  install_element (VIEW_NODE, &show_ipv6_route_prefix_longer_count_cmd);
+  install_element (VIEW_NODE, &show_ipv6_route_prefix_list_cmd);
+  install_element (VIEW_NODE, &show_ipv6_route_prefix_list_count_cmd);
   install_element (ENABLE_NODE, &show_ipv6_route_cmd);
+  install_element (ENABLE_NODE, &show_ipv6_route_count_cmd);
   install_element (ENABLE_NODE, &show_ipv6_route_protocol_cmd);
+  install_element (ENABLE_NODE, &show_ipv6_route_protocol_count_cmd);
   install_element (ENABLE_NODE, &show_ipv6_route_addr_cmd);
   install_element (ENABLE_NODE, &show_ipv6_route_prefix_cmd);
   install_element (ENABLE_NODE, &show_ipv6_route_prefix_longer_cmd);
+  install_element (ENABLE_NODE, &show_ipv6_route_prefix_longer_count_cmd);
+  install_element (ENABLE_NODE, &show_ipv6_route_prefix_list_cmd);
+  install_element (ENABLE_NODE, &show_ipv6_route_prefix_list_count_cmd);
   install_element (ENABLE_NODE, &show_ipv6_route_summary_cmd);
 
   install_element (VIEW_NODE, &show_ipv6_mroute_cmd);
@@ -36,12 +36,18 @@
 #include "privs.h"
 #include "network.h"
 #include "buffer.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "zebra/zserv.h"
 #include "zebra/router-id.h"
 #include "zebra/redistribute.h"
 #include "zebra/debug.h"
 #include "zebra/ipforward.h"
+#include "zebra/rt.h"
+#include "zebra/zebra_nhg.h"
+#include "zebra/zebra_fibc.h"
+#include "zebra/zebra_lpm.h"
 
 /* Event list of zebra. */
 enum event { ZEBRA_SERV, ZEBRA_READ, ZEBRA_WRITE };
@@ -103,13 +109,13 @@ zserv_flush_data(struct thread *thread)
   return 0;
 }
 
+/* Write a message to the client, or enqueue it. */
 static int
-zebra_server_send_message(struct zserv *client)
+zebra_server_write (struct zserv *client, struct stream *s)
 {
-  if (client->t_suicide)
-    return -1;
-  switch (buffer_write(client->wb, client->sock, STREAM_DATA(client->obuf),
-		       stream_get_endp(client->obuf)))
+  client->msgs_out++;
+  switch (buffer_write(client->wb, client->sock, STREAM_DATA(s),
+		       stream_get_endp(s)))
     {
     case BUFFER_ERROR:
       zlog_warn("%s: buffer_write failed to zserv client fd %d, closing",
@@ -132,6 +138,63 @@ zebra_server_send_message(struct zserv *client)
   return 0;
 }
 
+/* Send the route messages held back, if any. */
+static int
+zebra_server_send_bulk (struct zserv *client)
+{
+  struct stream *s;
+
+  THREAD_OFF (client->t_bulk);
+  if ((s = zapi_bulk_take (&client->bulk)) == NULL)
+    return 0;
+  return zebra_server_write (client, s);
+}
+
+static int
+zserv_bulk_flush (struct thread *thread)
+{
+  struct zserv *client = THREAD_ARG (thread);
+
+  client->t_bulk = NULL;
+  if (client->t_suicide)
+    return -1;
+  return zebra_server_send_bulk (client);
+}
+
+static int
+zebra_server_send_message(struct zserv *client)
+{
+  int ret;
+
+  if (client->t_suicide)
+    return -1;
+
+  /* Routes are redistributed in bulk to the clients which offered to
+     receive them so: route messages are held back for a moment, to be
+     sent with the ones following them.  Other messages go out after
+     them. */
+  ret = client->bulk_agreed ? zapi_bulk_add (&client->bulk, client->obuf)
+			    : -1;
+  if (ret > 0)
+    {
+      if (zebra_server_send_bulk (client) < 0)
+	return -1;
+      ret = zapi_bulk_add (&client->bulk, client->obuf);
+    }
+  if (ret == 0)
+    {
+      if (! client->t_bulk)
+	client->t_bulk = thread_add_timer_msec (zebrad.master,
+						zserv_bulk_flush, client,
+						ZAPI_BULK_HOLD);
+      return 0;
+    }
+
+  if (zebra_server_send_bulk (client) < 0)
+    return -1;
+  return zebra_server_write (client, client->obuf);
+}
+
 static void
 zserv_create_header (struct stream *s, uint16_t cmd)
 {
@@ -142,6 +205,189 @@ zserv_create_header (struct stream *s, uint16_t cmd)
   stream_putw (s, cmd);
 }
 
+/* Longest window a client may have its interface events held back for,
+   in milliseconds, and size of the interface event messages held. */
+#define ZSERV_IF_HOLD_MAX	1000
+#define ZSERV_IF_EVENT_SIZE	64
+
+/* Interface event held back for a client asking for them coalesced: the
+   last message queued for a state change of an interface, or for an
+   address of it. */
+struct zserv_if_event
+{
+  /* Interface, and address for an address event, family 0 otherwise. */
+  struct interface *ifp;
+  struct prefix p;
+
+  u_int16_t len;
+  u_char msg[ZSERV_IF_EVENT_SIZE];
+};
+
+static unsigned int
+zserv_if_event_key (void *arg)
+{
+  struct zserv_if_event *ev = arg;
+
+  return jhash2 ((u_int32_t *) &ev->p.u.prefix6, 4,
+		 jhash_3words ((u_int32_t) (uintptr_t) ev->ifp,
+			       ev->p.family, ev->p.prefixlen, 0));
+}
+
+static int
+zserv_if_event_cmp (const void *a, const void *b)
+{
+  const struct zserv_if_event *ev1 = a;
+  const struct zserv_if_event *ev2 = b;
+
+  return ev1->ifp == ev2->ifp
+    && ev1->p.family == ev2->p.family
+    && ev1->p.prefixlen == ev2->p.prefixlen
+    && ! memcmp (&ev1->p.u.prefix6, &ev2->p.u.prefix6,
+		 sizeof (ev1->p.u.prefix6));
+}
+
+static void *
+zserv_if_event_alloc (void *arg)
+{
+  struct zserv_if_event *ev;
+
+  ev = XCALLOC (MTYPE_ZSERV_IF_EVENT, sizeof (struct zserv_if_event));
+  ev->ifp = ((struct zserv_if_event *) arg)->ifp;
+  ev->p = ((struct zserv_if_event *) arg)->p;
+  return ev;
+}
+
+static void
+zserv_if_event_free (void *arg)
+{
+  XFREE (MTYPE_ZSERV_IF_EVENT, arg);
+}
+
+/* Send the interface events put into s after a bulk header, or the first
+   one alone if there is no other.  The route messages held back go out
+   before. */
+static int
+zserv_if_bulk_send (struct zserv *client, struct stream *s,
+		    struct zserv_if_event *first, u_int16_t count)
+{
+  if (client->t_suicide)
+    return -1;
+
+  if (count == 1)
+    {
+      stream_reset (s);
+      stream_put (s, first->msg, first->len);
+    }
+  else
+    {
+      stream_putw_at (s, ZEBRA_HEADER_SIZE, count);
+      stream_putw_at (s, 0, stream_get_endp (s));
+      client->if_bulk_msgs++;
+    }
+
+  if (zebra_server_send_bulk (client) < 0)
+    return -1;
+  return zebra_server_write (client, s);
+}
+
+/* Send the interface events held back for the client, in bulk.  The
+   output buffer of the client is left alone. */
+static int
+zserv_if_event_flush (struct zserv *client)
+{
+  static struct stream *s;
+  struct listnode *node;
+  struct zserv_if_event *ev;
+  struct zserv_if_event *first = NULL;
+  u_int16_t count = 0;
+  int ret = 0;
+
+  THREAD_OFF (client->t_if_events);
+  if (! client->if_events || ! listcount (client->if_events))
+    return 0;
+
+  if (! s)
+    s = stream_new (ZEBRA_MAX_PACKET_SIZ);
+
+  for (ALL_LIST_ELEMENTS_RO (client->if_events, node, ev))
+    {
+      if (count && STREAM_WRITEABLE (s) < ev->len)
+	{
+	  if ((ret = zserv_if_bulk_send (client, s, first, count)) < 0)
+	    break;
+	  count = 0;
+	}
+      if (count == 0)
+	{
+	  stream_reset (s);
+	  zserv_create_header (s, ZEBRA_INTERFACE_BULK);
+	  stream_putw (s, 0);
+	  first = ev;
+	}
+      stream_put (s, ev->msg, ev->len);
+      count++;
+    }
+  if (ret == 0 && count)
+    ret = zserv_if_bulk_send (client, s, first, count);
+
+  hash_clean (client->if_event_hash, zserv_if_event_free);
+  list_delete_all_node (client->if_events);
+  return ret;
+}
+
+static int
+zserv_if_event_timer (struct thread *thread)
+{
+  struct zserv *client = THREAD_ARG (thread);
+
+  client->t_if_events = NULL;
+  return zserv_if_event_flush (client);
+}
+
+/* Hold back the interface event message in the output buffer of the
+   client, in place of the one held for the same interface, or address p
+   of it, if any. */
+static int
+zserv_if_event_queue (struct zserv *client, struct interface *ifp,
+		      struct prefix *p)
+{
+  struct stream *s = client->obuf;
+  struct zserv_if_event key;
+  struct zserv_if_event *ev;
+
+  if (stream_get_endp (s) > ZSERV_IF_EVENT_SIZE)
+    {
+      if (zserv_if_event_flush (client) < 0)
+	return -1;
+      return zebra_server_send_message (client);
+    }
+
+  memset (&key, 0, sizeof (struct zserv_if_event));
+  key.ifp = ifp;
+  if (p)
+    {
+      key.p.family = p->family;
+      key.p.prefixlen = p->prefixlen;
+      memcpy (&key.p.u.prefix, &p->u.prefix, prefix_blen (p));
+    }
+
+  ev = hash_get (client->if_event_hash, &key, zserv_if_event_alloc);
+  if (ev->len)
+    client->if_events_coalesced++;
+  else
+    listnode_add (client->if_events, ev);
+  client->if_events_queued++;
+
+  ev->len = stream_get_endp (s);
+  memcpy (ev->msg, STREAM_DATA (s), ev->len);
+
+  if (! client->t_if_events)
+    client->t_if_events = thread_add_timer_msec (zebrad.master,
+						 zserv_if_event_timer, client,
+						 client->if_hold);
+  return 0;
+}
+
 /* Interface is added. Send ZEBRA_INTERFACE_ADD to client. */
 /*
  * This function is called in the following situations:
@@ -162,6 +408,10 @@ zsend_interface_add (struct zserv *client, struct interface *ifp)
   if (! client->ifinfo)
     return 0;
 
+  /* Events held back for the interfaces go out before. */
+  if (zserv_if_event_flush (client) < 0)
+    return -1;
+
   s = client->obuf;
   stream_reset (s);
 
@@ -201,6 +451,10 @@ zsend_interface_delete (struct zserv *client, struct interface *ifp)
   if (! client->ifinfo)
     return 0;
 
+  /* Events held back for the interfaces go out before. */
+  if (zserv_if_event_flush (client) < 0)
+    return -1;
+
   s = client->obuf;
   stream_reset (s);
   
@@ -304,6 +558,8 @@ zsend_interface_address (int cmd, struct zserv *client,
   /* Write packet size. */
   stream_putw_at (s, 0, stream_get_endp (s));
 
+  if (client->if_hold)
+    return zserv_if_event_queue (client, ifp, ifc->address);
   return zebra_server_send_message(client);
 }
 
@@ -344,6 +600,8 @@ zsend_interface_update (int cmd, struct zserv *client, struct interface *ifp)
   /* Write packet size. */
   stream_putw_at (s, 0, stream_get_endp (s));
 
+  if (client->if_hold)
+    return zserv_if_event_queue (client, ifp, NULL);
   return zebra_server_send_message(client);
 }
 
@@ -820,6 +1078,24 @@ zread_ipv4_add (struct zserv *client, u_short length)
 	}
     }
 
+  /* Shared nexthop group, its nexthops replace any given above. */
+  if (CHECK_FLAG (message, ZAPI_MESSAGE_NEXTHOP_GROUP))
+    {
+      u_int32_t id = stream_getl (s);
+      struct nhg *nhg = nhg_lookup (client, id);
+
+      if (! nhg)
+	{
+	  zlog_warn ("%s: client %d: unknown nexthop group %u, %s/%d dropped",
+		     __func__, client->sock, id, inet_ntoa (p.prefix),
+		     p.prefixlen);
+	  rib_nhg_copy_nexthops (rib, NULL);
+	  XFREE (MTYPE_RIB, rib);
+	  return -1;
+	}
+      nhg_ref_add (nhg, rib);
+    }
+
   /* Distance. */
   if (CHECK_FLAG (message, ZAPI_MESSAGE_DISTANCE))
     rib->distance = stream_getc (s);
@@ -892,6 +1168,10 @@ zread_ipv4_delete (struct zserv *client, u_short length)
 	}
     }
 
+  /* Nexthop group, the route is matched by its nexthop, if any. */
+  if (CHECK_FLAG (api.message, ZAPI_MESSAGE_NEXTHOP_GROUP))
+    api.nhg_id = stream_getl (s);
+
   /* Distance. */
   if (CHECK_FLAG (api.message, ZAPI_MESSAGE_DISTANCE))
     api.distance = stream_getc (s);
@@ -909,6 +1189,56 @@ zread_ipv4_delete (struct zserv *client, u_short length)
   return 0;
 }
 
+/* Zebra server nexthop group add: define a group of the client, or update
+ * it.  The routes using the group follow.
+ */
+static int
+zread_nhg_add (struct zserv *client, u_short length)
+{
+  int i;
+  struct stream *s;
+  struct rib *tmpl;
+  struct in_addr nexthop;
+  u_int32_t id;
+  u_char nexthop_num;
+
+  s = client->ibuf;
+
+  id = stream_getl (s);
+  tmpl = XCALLOC (MTYPE_RIB, sizeof (struct rib));
+  tmpl->flags = stream_getc (s);
+  nexthop_num = stream_getc (s);
+
+  for (i = 0; i < nexthop_num; i++)
+    {
+      if (stream_getc (s) != ZEBRA_NEXTHOP_IPV4)
+	{
+	  zlog_warn ("%s: client %d: nexthop group %u: bad nexthop type",
+		     __func__, client->sock, id);
+	  rib_nhg_copy_nexthops (tmpl, NULL);
+	  XFREE (MTYPE_RIB, tmpl);
+	  return -1;
+	}
+      nexthop.s_addr = stream_get_ipv4 (s);
+      nexthop_ipv4_add (tmpl, &nexthop, NULL);
+    }
+
+  if (IS_ZEBRA_DEBUG_EVENT)
+    zlog_debug ("%s: client %d: nexthop group %u, %u nexthops", __func__,
+		client->sock, id, nexthop_num);
+
+  nhg_update (client, id, tmpl);
+  return 0;
+}
+
+/* Zebra server nexthop group delete. */
+static int
+zread_nhg_delete (struct zserv *client, u_short length)
+{
+  nhg_delete (client, stream_getl (client->ibuf));
+  return 0;
+}
+
 /* Nexthop lookup for IPv4. */
 static int
 zread_ipv4_nexthop_lookup (struct zserv *client, u_short length)
@@ -1296,13 +1626,79 @@ zread_router_id_delete (struct zserv *client, u_short length)
   return 0;
 }
 
+#ifdef ZSERV_RING
+/* Answer the ring offered by the client with its hello. */
+static int
+zsend_ring (struct zserv *client, u_char accepted)
+{
+  struct stream *s;
+
+  s = client->obuf;
+  stream_reset (s);
+
+  zserv_create_header (s, ZEBRA_RING);
+  stream_putc (s, accepted);
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  return zebra_server_send_message (client);
+}
+
+/* Map the ring whose file descriptors came with the hello. */
+static void
+zserv_ring_accept (struct zserv *client)
+{
+  if (! client->ring && client->ring_fd[ZRING_FD_MEM] >= 0)
+    client->ring = zring_attach (client->ring_fd);
+
+  if (client->ring)
+    zlog_info ("client %d writes to a ring of %u bytes",
+	       client->sock, client->ring->size);
+  else
+    zlog_warn ("client %d offered an unusable ring", client->sock);
+
+  zsend_ring (client, client->ring != NULL);
+}
+#endif /* ZSERV_RING */
+
+/* Agree to the bulk route messages offered by the client with its
+   hello. */
+static int
+zsend_hello (struct zserv *client)
+{
+  struct stream *s;
+
+  s = client->obuf;
+  stream_reset (s);
+
+  zserv_create_header (s, ZEBRA_HELLO);
+  stream_putc (s, ZEBRA_HELLO_BULK);
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  return zebra_server_send_message (client);
+}
+
 /* Tie up route-type and client->sock */
 static void
-zread_hello (struct zserv *client)
+zread_hello (struct zserv *client, uint16_t length)
 {
   /* type of protocol (lib/zebra.h) */
   u_char proto;
+  u_char flags = 0;
+
   proto = stream_getc (client->ibuf);
+  if (length > 1)
+    flags = stream_getc (client->ibuf);
+
+#ifdef ZSERV_RING
+  if (CHECK_FLAG (flags, ZEBRA_HELLO_RING))
+    zserv_ring_accept (client);
+#endif /* ZSERV_RING */
+
+  if (CHECK_FLAG (flags, ZEBRA_HELLO_BULK))
+    {
+      client->bulk_agreed = 1;
+      zsend_hello (client);
+    }
 
   /* accept only dynamic routing protocols */
   if ((proto < ZEBRA_ROUTE_MAX)
@@ -1321,6 +1717,28 @@ zread_hello (struct zserv *client)
     }
 }
 
+/* The client asks for its interface events to be held back for a
+   moment, to be sent coalesced, or no more. */
+static void
+zread_interface_hold (struct zserv *client)
+{
+  u_int16_t hold;
+
+  hold = stream_getw (client->ibuf);
+  if (hold > ZSERV_IF_HOLD_MAX)
+    hold = ZSERV_IF_HOLD_MAX;
+
+  if (hold && ! client->if_events)
+    {
+      client->if_events = list_new ();
+      client->if_event_hash = hash_create (zserv_if_event_key,
+					   zserv_if_event_cmp);
+    }
+  client->if_hold = hold;
+  if (! hold)
+    zserv_if_event_flush (client);
+}
+
 /* If client sent routes of specific type, zebra removes it
  * and returns number of deleted routes.
  */
@@ -1343,6 +1761,10 @@ zebra_score_rib (int client_sock)
 static void
 zebra_client_close (struct zserv *client)
 {
+#ifdef ZSERV_RING
+  int i;
+#endif /* ZSERV_RING */
+
   /* Close file descriptor. */
   if (client->sock)
     {
@@ -1351,13 +1773,36 @@ zebra_client_close (struct zserv *client)
       client->sock = -1;
     }
 
+  /* Let go of its nexthop groups, once the routes using them are gone. */
+  nhg_owner_close (client);
+  zebra_redistribute_filter_free (client);
+
   /* Free stream buffers. */
   if (client->ibuf)
     stream_free (client->ibuf);
+  if (client->rbuf)
+    stream_free (client->rbuf);
   if (client->obuf)
     stream_free (client->obuf);
   if (client->wb)
     buffer_free(client->wb);
+  zapi_bulk_finish (&client->bulk);
+  if (client->if_events)
+    {
+      hash_clean (client->if_event_hash, zserv_if_event_free);
+      hash_free (client->if_event_hash);
+      list_delete (client->if_events);
+    }
+
+#ifdef ZSERV_RING
+  if (client->ring)
+    zring_free (client->ring);
+  for (i = 0; i < ZRING_FDS; i++)
+    if (client->ring_fd[i] >= 0)
+      close (client->ring_fd[i]);
+  if (client->t_ring)
+    thread_cancel (client->t_ring);
+#endif /* ZSERV_RING */
 
   /* Release threads. */
   if (client->t_read)
@@ -1366,6 +1811,10 @@ zebra_client_close (struct zserv *client)
     thread_cancel (client->t_write);
   if (client->t_suicide)
     thread_cancel (client->t_suicide);
+  if (client->t_bulk)
+    thread_cancel (client->t_bulk);
+  if (client->t_if_events)
+    thread_cancel (client->t_if_events);
 
   /* Free client structure. */
   listnode_delete (zebrad.client_list, client);
@@ -1373,18 +1822,23 @@ zebra_client_close (struct zserv *client)
 }
 
 /* Make new client. */
-static void
+void
 zebra_client_create (int sock)
 {
   struct zserv *client;
+  int i;
 
   client = XCALLOC (0, sizeof (struct zserv));
 
   /* Make client input/output buffer. */
   client->sock = sock;
+  for (i = 0; i < ZRING_FDS; i++)
+    client->ring_fd[i] = -1;
   client->ibuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  client->rbuf = stream_new (ZEBRA_READ_BUFSIZ);
   client->obuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   client->wb = buffer_new(0);
+  zapi_bulk_init (&client->bulk, ZAPI_ROUTE_LEAD_ZEBRA);
 
   /* Set table number. */
   client->rtm_table = zebrad.rtm_table_default;
@@ -1396,106 +1850,17 @@ zebra_client_create (int sock)
   zebra_event (ZEBRA_READ, sock, client);
 }
 
-/* Handler of zebra service request. */
-static int
-zebra_client_read (struct thread *thread)
-{
-  int sock;
-  struct zserv *client;
-  size_t already;
-  uint16_t length, command;
-  uint8_t marker, version;
-
-  /* Get thread data.  Reset reading thread because I'm running. */
-  sock = THREAD_FD (thread);
-  client = THREAD_ARG (thread);
-  client->t_read = NULL;
-
-  if (client->t_suicide)
-    {
-      zebra_client_close(client);
-      return -1;
-    }
-
-  /* Read length and command (if we don't have it already). */
-  if ((already = stream_get_endp(client->ibuf)) < ZEBRA_HEADER_SIZE)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try (client->ibuf, sock,
-				     ZEBRA_HEADER_SIZE-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (IS_ZEBRA_DEBUG_EVENT)
-	    zlog_debug ("connection closed socket [%d]", sock);
-	  zebra_client_close (client);
-	  return -1;
-	}
-      if (nbyte != (ssize_t)(ZEBRA_HEADER_SIZE-already))
-	{
-	  /* Try again later. */
-	  zebra_event (ZEBRA_READ, sock, client);
-	  return 0;
-	}
-      already = ZEBRA_HEADER_SIZE;
-    }
-
-  /* Reset to read from the beginning of the incoming packet. */
-  stream_set_getp(client->ibuf, 0);
-
-  /* Fetch header values */
-  length = stream_getw (client->ibuf);
-  marker = stream_getc (client->ibuf);
-  version = stream_getc (client->ibuf);
-  command = stream_getw (client->ibuf);
-
-  if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
-    {
-      zlog_err("%s: socket %d version mismatch, marker %d, version %d",
-               __func__, sock, marker, version);
-      zebra_client_close (client);
-      return -1;
-    }
-  if (length < ZEBRA_HEADER_SIZE) 
-    {
-      zlog_warn("%s: socket %d message length %u is less than header size %d",
-	        __func__, sock, length, ZEBRA_HEADER_SIZE);
-      zebra_client_close (client);
-      return -1;
-    }
-  if (length > STREAM_SIZE(client->ibuf))
-    {
-      zlog_warn("%s: socket %d message length %u exceeds buffer size %lu",
-	        __func__, sock, length, (u_long)STREAM_SIZE(client->ibuf));
-      zebra_client_close (client);
-      return -1;
-    }
-
-  /* Read rest of data. */
-  if (already < length)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try (client->ibuf, sock,
-				     length-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (IS_ZEBRA_DEBUG_EVENT)
-	    zlog_debug ("connection closed [%d] when reading zebra data", sock);
-	  zebra_client_close (client);
-	  return -1;
-	}
-      if (nbyte != (ssize_t)(length-already))
-        {
-	  /* Try again later. */
-	  zebra_event (ZEBRA_READ, sock, client);
-	  return 0;
-	}
-    }
-
-  length -= ZEBRA_HEADER_SIZE;
+static void zread_route_bulk (struct zserv *, uint16_t);
+static void zread_ring (struct zserv *);
 
+/* Handle a message of the client, its body is in client->ibuf. */
+static void
+zebra_client_dispatch (struct zserv *client, uint16_t command,
+		       uint16_t length)
+{
   /* Debug packet information. */
   if (IS_ZEBRA_DEBUG_EVENT)
-    zlog_debug ("zebra message comes from socket [%d]", sock);
+    zlog_debug ("zebra message comes from socket [%d]", client->sock);
 
   if (IS_ZEBRA_DEBUG_PACKET && IS_ZEBRA_DEBUG_RECV)
     zlog_debug ("zebra message received [%s] %d", 
@@ -1553,25 +1918,334 @@ zebra_client_read (struct thread *thread)
       zread_ipv4_import_lookup (client, length);
       break;
     case ZEBRA_HELLO:
-      zread_hello (client);
+      zread_hello (client, length);
       break;
     case ZEBRA_BGP_IPV4_RGATE_VERIFY:
       zread_bgp_ipv4_rgate_verify (client, length);
       break;
+    case ZEBRA_NEXTHOP_GROUP_ADD:
+      zread_nhg_add (client, length);
+      break;
+    case ZEBRA_NEXTHOP_GROUP_DELETE:
+      zread_nhg_delete (client, length);
+      break;
+    case ZEBRA_IPV4_ROUTE_ADD_BULK:
+    case ZEBRA_IPV4_ROUTE_DELETE_BULK:
+    case ZEBRA_IPV6_ROUTE_ADD_BULK:
+    case ZEBRA_IPV6_ROUTE_DELETE_BULK:
+      zread_route_bulk (client, command);
+      break;
+    case ZEBRA_INTERFACE_HOLD:
+      zread_interface_hold (client);
+      break;
+    case ZEBRA_REDISTRIBUTE_FILTER:
+      zebra_redistribute_filter (command, client, length);
+      break;
+    case ZEBRA_RING:
+      zread_ring (client);
+      break;
     default:
       zlog_info ("Zebra received unknown command %d", command);
       break;
     }
+}
+
+/* Handle the routes of a bulk message as the route messages it stands
+   for. */
+static void
+zread_route_bulk (struct zserv *client, uint16_t command)
+{
+  static struct stream *msg;
+  struct stream *bulk = client->ibuf;
+  int ret;
+
+  if (! msg)
+    msg = stream_new (ZEBRA_MAX_PACKET_SIZ);
+
+  client->bulk_msgs++;
+  client->ibuf = msg;
+  while ((ret = zapi_bulk_next (bulk, ZAPI_ROUTE_LEAD_CLIENT, msg)) > 0)
+    {
+      client->bulk_routes++;
+      zebra_client_dispatch (client, zapi_bulk_single (command),
+			     stream_get_endp (msg) - ZEBRA_HEADER_SIZE);
+      if (client->t_suicide)
+	break;
+    }
+  client->ibuf = bulk;
+
+  if (ret < 0)
+    zlog_warn ("%s: socket %d malformed bulk route message",
+	       __func__, client->sock);
+}
+
+/* Check the header of the next message in the read buffer of the client.
+   Returns the length of the message once it has been read entirely, 0 if
+   more data is needed and -1 if the header is invalid. */
+static int
+zebra_client_frame (struct zserv *client)
+{
+  int length;
+
+  if ((length = zapi_frame (client->rbuf, client->sock)) <= 0)
+    return length;
+
+  if ((size_t) length > STREAM_SIZE(client->ibuf))
+    {
+      zlog_warn("%s: socket %d message length %u exceeds buffer size %lu",
+	        __func__, client->sock, length,
+	        (u_long)STREAM_SIZE(client->ibuf));
+      return -1;
+    }
+  return length;
+}
+
+/* Handle the complete messages in the read buffer of the client, up to
+   ZEBRA_READ_BUDGET of them before letting other threads run.  Returns 1
+   if messages are left for later, 0 once more data is needed and -1 if
+   the client was closed. */
+static int
+zebra_client_process (struct zserv *client)
+{
+  int length;
+  int budget;
+  uint16_t command;
+
+  for (budget = ZEBRA_READ_BUDGET;
+       (length = zebra_client_frame (client)) > 0; )
+    {
+      if (budget-- == 0)
+	return 1;
+
+      /* Handlers read the message from the input buffer. */
+      stream_reset (client->ibuf);
+      stream_put (client->ibuf, STREAM_PNT (client->rbuf), length);
+      stream_forward_getp (client->rbuf, length);
+      stream_set_getp (client->ibuf, ZEBRA_HEADER_SIZE - 2);
+      command = stream_getw (client->ibuf);
+      client->msgs_in++;
+
+      zebra_client_dispatch (client, command, length - ZEBRA_HEADER_SIZE);
+
+      if (client->t_suicide)
+	{
+	  /* No need to wait for thread callback, just kill immediately. */
+	  zebra_client_close(client);
+	  return -1;
+	}
+    }
+
+  if (length < 0)
+    {
+      zebra_client_close (client);
+      return -1;
+    }
+  return 0;
+}
+
+#ifdef ZSERV_RING
+static int zebra_client_ring_wake (struct thread *);
+
+/* Read from the socket of the client like stream_read_try(), keeping the
+   file descriptors of the ring it may hand over with its hello. */
+static ssize_t
+zebra_client_recv (struct zserv *client, int sock)
+{
+  struct stream *s = client->rbuf;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE (sizeof (int) * ZRING_FDS)];
+  } control;
+  int fds[ZRING_FDS];
+  ssize_t nbytes;
+  size_t i, n;
+
+  memset (&msg, 0, sizeof (msg));
+  iov.iov_base = STREAM_DATA (s) + stream_get_endp (s);
+  iov.iov_len = STREAM_WRITEABLE (s);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof (control.buf);
+
+  if ((nbytes = recvmsg (sock, &msg, MSG_CMSG_CLOEXEC)) < 0)
+    {
+      if (ERRNO_IO_RETRY (errno))
+	return -2;
+      zlog_warn ("%s: recvmsg failed on fd %d: %s",
+		 __func__, sock, safe_strerror (errno));
+      return -1;
+    }
+  stream_forward_endp (s, nbytes);
+
+  for (cmsg = CMSG_FIRSTHDR (&msg); cmsg; cmsg = CMSG_NXTHDR (&msg, cmsg))
+    {
+      if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+	continue;
+
+      n = (cmsg->cmsg_len - CMSG_LEN (0)) / sizeof (int);
+      n = MIN (n, ZRING_FDS);
+      memcpy (fds, CMSG_DATA (cmsg), n * sizeof (int));
+
+      /* Only the first set of descriptors of a ring is kept. */
+      if (n == ZRING_FDS && ! client->ring
+	  && client->ring_fd[ZRING_FD_MEM] < 0)
+	memcpy (client->ring_fd, fds, sizeof (fds));
+      else
+	for (i = 0; i < n; i++)
+	  close (fds[i]);
+    }
+
+  return nbytes;
+}
+
+/* Handler of the ring of the client.  Reads as much of the ring as the
+   read buffer has room for and handles the complete messages, then comes
+   back at once if there is more, or waits for the client to write. */
+static int
+zebra_client_ring_read (struct thread *thread)
+{
+  struct zserv *client;
+  int ret;
+
+  client = THREAD_ARG (thread);
+  client->t_ring = NULL;
+
+  if (client->t_suicide)
+    {
+      zebra_client_close(client);
+      return -1;
+    }
+
+  if (zebra_client_frame (client) == 0)
+    {
+      stream_pulldown (client->rbuf);
+      if (zring_read (client->ring, client->rbuf) < 0)
+	{
+	  zlog_warn ("%s: client %d corrupted its ring",
+		     __func__, client->sock);
+	  zebra_client_close (client);
+	  return -1;
+	}
+    }
+
+  if ((ret = zebra_client_process (client)) < 0)
+    return -1;
+
+  if (ret > 0 || ! zring_idle (client->ring))
+    client->t_ring = thread_add_event (zebrad.master, zebra_client_ring_read,
+				       client, 0);
+  else
+    client->t_ring = thread_add_read (zebrad.master, zebra_client_ring_wake,
+				      client,
+				      client->ring->fd[ZRING_FD_DATA]);
+  return 0;
+}
+
+/* The client wrote to the ring while zebra was waiting. */
+static int
+zebra_client_ring_wake (struct thread *thread)
+{
+  struct zserv *client = THREAD_ARG (thread);
+
+  zring_ack (client->ring, ZRING_FD_DATA);
+  return zebra_client_ring_read (thread);
+}
+#endif /* ZSERV_RING */
+
+/* The client sends its messages through its ring from now on. */
+static void
+zread_ring (struct zserv *client)
+{
+#ifdef ZSERV_RING
+  if (! client->ring || client->ring_active)
+    return;
+
+  client->ring_active = 1;
+  client->t_ring = thread_add_event (zebrad.master, zebra_client_ring_read,
+				     client, 0);
+#endif /* ZSERV_RING */
+}
+
+/* Handler of zebra service request.  Reads as much as the socket has and
+   handles the complete messages, up to ZEBRA_READ_BUDGET of them before
+   letting other threads run.  A partial message is kept for the next
+   read. */
+static int
+zebra_client_read (struct thread *thread)
+{
+  int sock;
+  struct zserv *client;
+  ssize_t nbyte;
+
+  /* Get thread data.  Reset reading thread because I'm running. */
+  sock = THREAD_FD (thread);
+  client = THREAD_ARG (thread);
+  client->t_read = NULL;
 
   if (client->t_suicide)
     {
-      /* No need to wait for thread callback, just kill immediately. */
       zebra_client_close(client);
       return -1;
     }
 
-  stream_reset (client->ibuf);
+#ifdef ZSERV_RING
+  /* A client writing to its ring only closes the socket. */
+  if (client->ring_active)
+    {
+      char c;
+
+      if ((nbyte = read (sock, &c, 1)) < 0 && ERRNO_IO_RETRY (errno))
+	{
+	  zebra_event (ZEBRA_READ, sock, client);
+	  return 0;
+	}
+      if (nbyte > 0)
+	zlog_warn ("%s: client %d wrote to its socket after ZEBRA_RING",
+		   __func__, sock);
+      else if (IS_ZEBRA_DEBUG_EVENT)
+	zlog_debug ("connection closed socket [%d]", sock);
+      zebra_client_close (client);
+      return -1;
+    }
+#endif /* ZSERV_RING */
+
+  /* Read from the socket, unless messages were left from the last run. */
+  if (zebra_client_frame (client) == 0)
+    {
+      stream_pulldown (client->rbuf);
+#ifdef ZSERV_RING
+      nbyte = zebra_client_recv (client, sock);
+#else
+      nbyte = stream_read_try (client->rbuf, sock,
+			       STREAM_WRITEABLE (client->rbuf));
+#endif /* ZSERV_RING */
+      if (nbyte == 0 || nbyte == -1)
+	{
+	  if (IS_ZEBRA_DEBUG_EVENT)
+	    zlog_debug ("connection closed socket [%d]", sock);
+	  zebra_client_close (client);
+	  return -1;
+	}
+    }
+
+  switch (zebra_client_process (client))
+    {
+    case -1:
+      return -1;
+    case 1:
+      /* Come back to the messages already read after other threads. */
+      client->t_read =
+	thread_add_event (zebrad.master, zebra_client_read, client, sock);
+      return 0;
+    }
+
   zebra_event (ZEBRA_READ, sock, client);
+
   return 0;
 }
 
@@ -1838,11 +2512,68 @@ DEFUN (show_zebra_client,
       if (route_type_oaths[i] == client->sock)
         vty_out (vty, " (%s)", zebra_route_string (i));
     vty_out (vty, "%s", VTY_NEWLINE);
+    vty_out (vty, "  Messages: received %lu, sent %lu%s",
+	     client->msgs_in, client->msgs_out, VTY_NEWLINE);
+    vty_out (vty, "  Bulk route messages%s: received %lu (%lu routes), "
+	     "sent %lu (%lu routes)%s",
+	     client->bulk_agreed ? "" : " (not offered by the client)",
+	     client->bulk_msgs, client->bulk_routes, client->bulk.msgs,
+	     client->bulk.routes, VTY_NEWLINE);
+    if (client->redist_filtered)
+      vty_out (vty, "  Redistributed routes filtered out: %lu%s",
+	       client->redist_filtered, VTY_NEWLINE);
+    if (client->if_hold)
+      vty_out (vty, "  Interface events held %u ms: queued %lu, "
+	       "coalesced %lu, bulk messages %lu%s", client->if_hold,
+	       client->if_events_queued, client->if_events_coalesced,
+	       client->if_bulk_msgs, VTY_NEWLINE);
+#ifdef ZSERV_RING
+    if (client->ring)
+      vty_out (vty, "  Ring of %u bytes%s: read %lu bytes, "
+	       "woke the client up %lu times%s", client->ring->size,
+	       client->ring_active ? "" : " (not in use yet)",
+	       client->ring->bytes, client->ring->wakeups, VTY_NEWLINE);
+#endif /* ZSERV_RING */
   }
 
   return CMD_SUCCESS;
 }
 
+DEFUN (show_zebra_dataplane,
+       show_zebra_dataplane_cmd,
+       "show zebra dataplane",
+       SHOW_STR
+       "Zebra information\n"
+       "Kernel route update statistics\n")
+{
+  kernel_dplane_show (vty);
+  return CMD_SUCCESS;
+}
+
+#ifdef HAVE_NETLINK
+DEFUN (show_zebra_netlink,
+       show_zebra_netlink_cmd,
+       "show zebra netlink",
+       SHOW_STR
+       "Zebra information\n"
+       "Netlink socket statistics\n")
+{
+  kernel_netlink_show (vty);
+  return CMD_SUCCESS;
+}
+#endif /* HAVE_NETLINK */
+
+DEFUN (show_zebra_kernel_sync,
+       show_zebra_kernel_sync_cmd,
+       "show zebra kernel-sync",
+       SHOW_STR
+       "Zebra information\n"
+       "Routes retained in the kernel from a previous run\n")
+{
+  rib_retain_show (vty);
+  return CMD_SUCCESS;
+}
+
 /* Table configuration write function. */
 static int
 config_write_table (struct vty *vty)
@@ -1969,6 +2700,8 @@ config_write_forwarding (struct vty *vty)
   if (ipforward_ipv6 ())
     vty_out (vty, "ipv6 forwarding%s", VTY_NEWLINE);
 #endif /* HAVE_IPV6 */
+  fibc_config_write (vty);
+  lpm_config_write (vty);
   vty_out (vty, "!%s", VTY_NEWLINE);
   return 0;
 }
@@ -1998,6 +2731,14 @@ zebra_init (void)
   install_element (CONFIG_NODE, &ip_forwarding_cmd);
   install_element (CONFIG_NODE, &no_ip_forwarding_cmd);
   install_element (ENABLE_NODE, &show_zebra_client_cmd);
+  install_element (VIEW_NODE, &show_zebra_dataplane_cmd);
+  install_element (ENABLE_NODE, &show_zebra_dataplane_cmd);
+  install_element (VIEW_NODE, &show_zebra_kernel_sync_cmd);
+  install_element (ENABLE_NODE, &show_zebra_kernel_sync_cmd);
+#ifdef HAVE_NETLINK
+  install_element (VIEW_NODE, &show_zebra_netlink_cmd);
+  install_element (ENABLE_NODE, &show_zebra_netlink_cmd);
+#endif /* HAVE_NETLINK */
 
 #ifdef HAVE_NETLINK
   install_element (VIEW_NODE, &show_table_cmd);
@@ -25,6 +25,8 @@
 #include "rib.h"
 #include "if.h"
 #include "workqueue.h"
+#include "zclient.h"
+#include "zring.h"
 
 /* Default port information. */
 #define ZEBRA_VTY_PORT                2601
@@ -42,6 +44,10 @@ struct zserv
   struct stream *ibuf;
   struct stream *obuf;
 
+  /* Data read from the client, possibly several messages and a partial
+     one. */
+  struct stream *rbuf;
+
   /* Buffer of data waiting to be written to client. */
   struct buffer *wb;
 
@@ -52,6 +58,34 @@ struct zserv
   /* Thread for delayed close. */
   struct thread *t_suicide;
 
+  /* Route messages held back to be sent in bulk, once the client has
+     offered to receive them with its hello. */
+  struct zapi_bulk bulk;
+  struct thread *t_bulk;
+  u_char bulk_agreed;
+
+  /* Bulk messages received and the routes they carried. */
+  unsigned long bulk_msgs;
+  unsigned long bulk_routes;
+
+  /* Messages received from and sent to the client. */
+  unsigned long msgs_in;
+  unsigned long msgs_out;
+
+  /* Interface events held back to be sent coalesced, in the order they
+     were first queued, with their window in milliseconds, 0 if the client
+     did not ask for it. */
+  u_int16_t if_hold;
+  struct list *if_events;
+  struct hash *if_event_hash;
+  struct thread *t_if_events;
+
+  /* Interface events queued, those replaced by a later one before being
+     sent, and the bulk messages they went out in. */
+  unsigned long if_events_queued;
+  unsigned long if_events_coalesced;
+  unsigned long if_bulk_msgs;
+
   /* default routing table this client munges */
   int rtm_table;
 
@@ -61,11 +95,26 @@ struct zserv
   /* Redistribute default route flag. */
   u_char redist_default;
 
+  /* Prefix-lists the routes redistributed to the client are filtered
+     with, per address family and route type, and the number of route
+     messages they held back. */
+  struct prefix_list *redist_filter[AFI_MAX][ZEBRA_ROUTE_MAX];
+  u_int32_t redist_filter_gen;
+  unsigned long redist_filtered;
+
   /* Interface information. */
   u_char ifinfo;
 
   /* Router-id information. */
   u_char ridinfo;
+
+  /* File descriptors of the shared memory ring offered by the client with
+     its hello, then the ring, read instead of the socket once the client
+     has sent ZEBRA_RING. */
+  int ring_fd[ZRING_FDS];
+  struct zring *ring;
+  u_char ring_active;
+  struct thread *t_ring;
 };
 
 /* Zebra instance */
@@ -90,6 +139,7 @@ struct zebra_t
 extern void zebra_init (void);
 extern void zebra_if_init (void);
 extern void zebra_zserv_socket_init (char *path);
+extern void zebra_client_create (int);
 extern void hostinfo_get (void);
 extern void rib_init (void);
 extern void interface_list (void);